@@ -57,6 +57,12 @@ layout (std430, binding = 7) restrict readonly buffer boneStartIndexData
     uint boneStartIndices[];
 };
 
+// Entity matrices stay in persistent slots, draw instances refer to them.
+layout (std430, binding = 8) restrict readonly buffer instanceSlotData
+{
+    uint instanceSlots[];
+};
+
 #if DEPTH_ONLY
 #else
     layout (location = 0) out vec4 colOut;
@@ -68,6 +74,7 @@ layout (std430, binding = 7) restrict readonly buffer boneStartIndexData
 void main()
 {
     uint instanceIndex = gl_InstanceIndex;
+    uint slotIndex = instanceSlots[instanceIndex];
     #if USE_ANIMATION
         AnimatedVData animData = animationVertexValues[gl_VertexIndex];
         VData data = animData.data;
@@ -130,7 +137,7 @@ void main()
         vec4 nor = vec4(dataNormal.xyz, 0.0f);
     #endif
 
-    mat4x3 entityMatrix4x3 = enityModelMatrices[instanceIndex * 2];
+    mat4x3 entityMatrix4x3 = enityModelMatrices[slotIndex * 2];
     mat4 entityMatrix;
     entityMatrix[0] = vec4(entityMatrix4x3[0], 0.0f);
     entityMatrix[1] = vec4(entityMatrix4x3[1], 0.0f);
@@ -154,7 +161,7 @@ void main()
             float((data.color >> 16) & 255),
             float((data.color >> 24) & 255)) / 255.0f;
 
-        mat4x3 entityNormalMatrix4x3 = enityModelMatrices[instanceIndex * 2 + 1];
+        mat4x3 entityNormalMatrix4x3 = enityModelMatrices[slotIndex * 2 + 1];
         mat4 entityNormalMatrix;
         entityNormalMatrix[0] = vec4(entityNormalMatrix4x3[0], 0.0f);
         entityNormalMatrix[1] = vec4(entityNormalMatrix4x3[1], 0.0f);
@@ -46,6 +46,9 @@ set(HEADER_FILE_WRITE "${MY_HEADER_FIRST_LINE}
 ${MY_FILE_HEADER}")
 
 file(WRITE "${FILENAME_TO_MODIFY}_systems.h" "${HEADER_FILE_WRITE}
+#include <components/chunkstorage.h>
+#include <components/entitycommandbuffer.h>
+#include <container/bytebuffer.h>
 #include <atomic>
 #include <mutex>
 #include <vector>\n")
@@ -55,7 +58,10 @@ set(CPP_FILE_WRITE "${MY_HEADER_FIRST_LINE}
 #include \"generated_components.h\"
 #include \"generated_systems.h\"
 ${MY_FILE_HEADER}
-#include \"imgui.h\"\n")
+#include <core/general.h>
+#include \"imgui.h\"
+#include <bit>
+#include <type_traits>\n")
 
 file(WRITE "${FILENAME_TO_MODIFY}_systems.cpp" "${CPP_FILE_WRITE}")
 file(WRITE "${FILENAME_TO_MODIFY}_components.cpp" "${CPP_FILE_WRITE}")
@@ -87,6 +93,181 @@ foreach(DEF_ROW ${DEF_LIST})
     elseif(DEF_ROW STREQUAL "EntityEnd" AND READ_STATE EQUAL READ_STATE_ENTITY_FIELDS)
         set(READ_STATE ${READ_STATE_NONE})
 
+        if(ENTITY_STORAGE STREQUAL "Chunks")
+            set(ENTITY_USES_CHUNK_STORAGE "true")
+            set(ENTITY_STORAGE_FIELDS "
+    ChunkStorage chunkStorage { componentSizes, componentTypeCount };")
+            set(ENTITY_ADD_STORAGE "
+    chunkStorage.addEntity(addIndex);")
+            set(ENTITY_REMOVE_STORAGE "
+    chunkStorage.removeEntity(freeIndex);")
+            set(ENTITY_ARRAY_PUSHBACKS "")
+            set(ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS "${ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS_CHUNKS}")
+            set(ENTITY_BINARY_WRITE_PREPARE "")
+            set(ENTITY_IS_ALIVE "chunkStorage.hasEntity(entityIndex)")
+            set(ENTITY_WRITE_DELTA_CONTENTS "${ENTITY_WRITE_DELTA_CONTENTS_CHUNKS}")
+            set(ENTITY_BINARY_WRITE_COMPONENT "        for(u32 j = 0; j < entityCount; ++j)
+            writeBinaryBytes(outBuffer, chunkStorage.getComponent(j, i), componentSizes[i]);")
+            set(ENTITY_BINARY_LOAD_STORAGE "
+    for(u32 i = 0; i < entityCount; ++i)
+        chunkStorage.addEntity(i);
+    for(u32 freeIndex : freeEntityIndices)
+        chunkStorage.removeEntity(freeIndex);
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        if(entityComponents[i] == 0)
+            continue;
+        chunkStorage.setComponentMask(i, entityComponents[i]);
+        for(u32 j = 0; j < componentTypeCount; ++j)
+        {
+            if(((entityComponents[i] >> j) & 1) == 1)
+                Supa::memcpy(chunkStorage.getComponent(i, j), componentDatas[j] + u64(i) * componentSizes[j], componentSizes[j]);
+        }
+    }")
+            set(ENTITY_COMPONENT_ARRAY_GETTERS "
+const u64* ${ENTITY_NAME}::getComponentsReadArray() const
+{
+    return entityComponents.data();
+}\n")
+            set(ENTITY_ADD_COMPONENT "${ENTITY_ADD_COMPONENT_CHUNKS}")
+            set(ENTITY_WRITE_CONTENTS "${ENTITY_WRITE_CONTENTS_CHUNKS}")
+            set(ENTITY_LOAD_CONTENTS "${ENTITY_LOAD_CONTENTS_CHUNKS}")
+            set(ENTITY_WRITE_IMGUI_CONTENTS "(void)handle;${ENTITY_WRITE_IMGUI_CONTENTS_CHUNKS}")
+            set(ENTITY_COMPONENT_ARRAY_GETTING_IMGUI "    // Chunk components are fetched per entity.
+    (void)rwhandle;\n")
+            set(ENTITY_QUERY_FIELDS "
+        ${ENTITY_NAME}* entitySystem = nullptr;
+        ChunkStorage* chunkStorage = nullptr;
+        u64 readArrays = 0;
+        u64 writeArrays = 0;
+        u32 archetypeIndex = 0;
+        u32 chunkIndex = 0;
+        u32 chunkRow = 0;
+        u32 maxBatchCount = ~0u;
+${ENTITY_QUERY_ARRAY_FIELDS}")
+            set(ENTITY_QUERY_FUNCTIONS "
+${ENTITY_NAME}::${ENTITY_NAME}Query ${ENTITY_NAME}::getQuery(const EntityRWHandle& handle, u32 maxBatchCount)
+{
+    if(handle.rwHandleTypeId != entitySystemID || handle.syncIndexPoint != currentSyncIndex)
+    {
+        ASSERT(handle.rwHandleTypeId == entitySystemID);
+        ASSERT(handle.syncIndexPoint == currentSyncIndex);
+        return ${ENTITY_NAME}Query{};
+    }
+
+    ${ENTITY_NAME}Query query;
+    query.entitySystem = this;
+    query.chunkStorage = &chunkStorage;
+    query.readArrays = handle.readArrays;
+    query.writeArrays = handle.writeArrays;
+    query.maxBatchCount = maxBatchCount;
+    return query;
+}
+
+bool ${ENTITY_NAME}::${ENTITY_NAME}Query::nextBatch(${ENTITY_NAME}QueryBatch &outBatch)
+{
+    u32 chunkEntityCount = 0;
+    if(chunkStorage == nullptr || maxBatchCount == 0 ||
+        !chunkStorage->findNextChunk(readArrays | writeArrays, archetypeIndex, chunkIndex, chunkEntityCount))
+    {
+        return false;
+    }
+
+    u32 count = chunkEntityCount - chunkRow;
+    count = count < maxBatchCount ? count : maxBatchCount;
+
+    outBatch.startIndex = 0;
+    outBatch.count = count;
+    outBatch.entityIndices = chunkStorage->getEntityIndices(archetypeIndex, chunkIndex) + chunkRow;
+    if(writeArrays != 0 && entitySystem->changeTracking)
+    {
+        for(u32 i = 0; i < count; ++i)
+            entitySystem->markComponentsChanged(writeArrays, outBatch.entityIndices[i], 1);
+    }
+${ENTITY_QUERY_BATCH_COLUMNS}
+    chunkRow += count;
+    if(chunkRow >= chunkEntityCount)
+    {
+        chunkRow = 0;
+        ++chunkIndex;
+    }
+    return true;
+}
+")
+        else()
+            set(ENTITY_USES_CHUNK_STORAGE "false")
+            set(ENTITY_IS_ALIVE "entityIndex < getEntityCount() && ((aliveEntityBits[entityIndex / 64] >> (entityIndex % 64)) & 1) == 1")
+            set(ENTITY_BINARY_WRITE_PREPARE "
+    const void* componentArrays[] =
+    {${ENTITY_BINARY_ARRAY_POINTERS}
+    };")
+            set(ENTITY_BINARY_WRITE_COMPONENT "        writeBinaryBytes(outBuffer, componentArrays[i], u64(entityCount) * componentSizes[i]);")
+            set(ENTITY_BINARY_LOAD_STORAGE "${ENTITY_BINARY_LOAD_ARRAYS}
+    aliveEntityBits.assign((entityCount + 63) / 64, 0);
+    for(u32 i = 0; i < entityCount; ++i)
+        aliveEntityBits[i / 64] |= u64(1) << (i % 64);
+    for(u32 freeIndex : freeEntityIndices)
+        aliveEntityBits[freeIndex / 64] &= ~(u64(1) << (freeIndex % 64));")
+            set(ENTITY_STORAGE_FIELDS "${ENTITY_ARRAYS_FIELD}
+    // One bit per entity index, cleared for removed entities.
+    std::vector<u64> aliveEntityBits;")
+            set(ENTITY_ADD_STORAGE "
+    aliveEntityBits.resize((entityComponents.size() + 63) / 64, 0);
+    aliveEntityBits[addIndex / 64] |= u64(1) << (addIndex % 64);")
+            set(ENTITY_REMOVE_STORAGE "
+    aliveEntityBits[freeIndex / 64] &= ~(u64(1) << (freeIndex % 64));")
+            set(ENTITY_QUERY_FIELDS "
+        ${ENTITY_NAME}* entitySystem = nullptr;
+        const u64* entityComponents = nullptr;
+        const u64* aliveEntityBits = nullptr;
+        u32 entityCount = 0;
+        u32 nextIndex = 0;
+        u32 maxBatchCount = ~0u;
+        u64 componentMask = 0;
+        u64 writeArrays = 0;
+${ENTITY_QUERY_ARRAY_FIELDS}")
+            set(ENTITY_QUERY_FUNCTIONS "
+${ENTITY_NAME}::${ENTITY_NAME}Query ${ENTITY_NAME}::getQuery(const EntityRWHandle& handle, u32 maxBatchCount)
+{
+    if(handle.rwHandleTypeId != entitySystemID || handle.syncIndexPoint != currentSyncIndex)
+    {
+        ASSERT(handle.rwHandleTypeId == entitySystemID);
+        ASSERT(handle.syncIndexPoint == currentSyncIndex);
+        return ${ENTITY_NAME}Query{};
+    }
+
+    ${ENTITY_NAME}Query query;
+    query.entitySystem = this;
+    query.entityComponents = entityComponents.data();
+    query.aliveEntityBits = aliveEntityBits.data();
+    query.entityCount = getEntityCount();
+    query.maxBatchCount = maxBatchCount;
+    query.componentMask = handle.readArrays | handle.writeArrays;
+    query.writeArrays = handle.writeArrays;
+${ENTITY_QUERY_GET_ARRAYS}
+    return query;
+}
+
+bool ${ENTITY_NAME}::${ENTITY_NAME}Query::nextBatch(${ENTITY_NAME}QueryBatch &outBatch)
+{
+    u32 startIndex = 0;
+    u32 count = 0;
+    if(!findNextEntityBatch(entityComponents, aliveEntityBits, entityCount, componentMask, maxBatchCount,
+        nextIndex, startIndex, count))
+    {
+        return false;
+    }
+
+    outBatch.startIndex = startIndex;
+    outBatch.count = count;
+    if(writeArrays != 0 && entitySystem->changeTracking)
+        entitySystem->markComponentsChanged(writeArrays, startIndex, count);
+${ENTITY_QUERY_BATCH_OFFSETS}
+    return true;
+}
+")
+        endif()
+
        ####################### ENTITY HEADER ############################
 
         file(APPEND "${FILENAME_TO_MODIFY}_systems.h" "
@@ -106,14 +287,41 @@ struct ${ENTITY_NAME}
         u64 lockIndex = 0;
     };
 
+    struct ${ENTITY_NAME}QueryBatch
+    {
+        // Every entity in the batch is alive and has every queried component.
+        // Arrays storage: entities from startIndex to startIndex + count - 1, entityIndices is nullptr.
+        // Chunks storage: part of one chunk, startIndex is 0, entityIndices has entity index of each row.
+        u32 startIndex = 0;
+        u32 count = 0;
+        const u32* entityIndices = nullptr;
+
+        // Already offset by startIndex, nullptr if the array is not in the query handle.${ENTITY_QUERY_ARRAY_FIELDS}
+    };
+
+    struct ${ENTITY_NAME}Query
+    {
+        bool nextBatch(${ENTITY_NAME}QueryBatch &outBatch);
+${ENTITY_QUERY_FIELDS}
+    };
+
     static constexpr ComponentType componentTypes[] =
     {${ENTITY_COMPONENT_TYPES_ARRAY}
     };
 
+    static constexpr u32 componentSizes[] =
+    {${ENTITY_COMPONENT_SIZES_ARRAY}
+    };
+    static constexpr u32 componentVersions[] =
+    {${ENTITY_COMPONENT_VERSIONS_ARRAY}
+    };
+
     static constexpr const char* entitySystemName = \"${ENTITY_NAME}\";
     static constexpr EntitySystemType entitySystemID = ${ENTITY_ID};
     static constexpr u32 entityVersion = ${ENTITY_VERSION};
     static constexpr u32 componentTypeCount = sizeof(componentTypes) / sizeof(ComponentType);
+    // Chunks storage has no per component arrays, components are reached through getQuery.
+    static constexpr bool usesChunkStorage = ${ENTITY_USES_CHUNK_STORAGE};
 
     static u32 getComponentIndex(ComponentType componentType);
 
@@ -136,20 +344,60 @@ struct ${ENTITY_NAME}
 
     bool syncReadWrites();
 
+    // Iterates alive entities having every read and write array of the handle, in batches
+    // of consecutive entity indices or chunk rows, with arrays fetched once per query or chunk.
+    ${ENTITY_NAME}Query getQuery(const EntityRWHandle& handle, u32 maxBatchCount = ~0u);
+
+    // Change tracking is off by default. Write arrays and query batches with write arrays mark
+    // entities changed, syncReadWrites stamps them with the sync index they were written in.
+    void setChangeTracking(bool enabled);
+    bool isChangeTracking() const { return changeTracking; }
+    u32 getCurrentSyncIndex() const { return currentSyncIndex; }
+    // ~0u if not changed while tracking. Adding and removing entity or its components changes the entity.
+    u32 getEntityChangeSyncIndex(u32 entityIndex) const;
+    u32 getComponentChangeSyncIndex(u32 entityIndex, u32 componentIndex) const;
+
+    // Arrays requested through getRWHandle since the last sync point.
+    u64 getSyncReadArrays() const { return readArrays.load(); }
+    u64 getSyncWriteArrays() const { return writeArrays.load(); }
+
     EntitySystemHandle getEntitySystemHandle(u32 index) const;
     EntitySystemHandle addEntity(const ${ENTITY_NAME}EntityLockedMutexHandle& handle);
     bool removeEntity(EntitySystemHandle handle, const ${ENTITY_NAME}EntityLockedMutexHandle &mutexHandle);
 
     ${ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS}
 ${ENTITY_ADD_COMPONENT_HEADER}
+    // Deferred adds and removes can be recorded from jobs without the mutex, every job system
+    // thread records into its own buffer. syncReadWrites applies them ordered by sortKey, so
+    // giving each job its own key, like the job index, keeps the result same for any thread count.
+    // Commands using a deferred entity need to sort after the command adding it.
+    DeferredEntityHandle deferAddEntity(u32 sortKey);
+    void deferRemoveEntity(const EntityCommandTarget& target, u32 sortKey);
+${ENTITY_DEFER_ADD_COMPONENT_HEADER}
+    // Workers of this job system get their own command buffers, other threads share one under
+    // a mutex. Only change when nothing is recording.
+    void setCommandJobSystem(const JobSystem* jobSystem) { commandBuffers.setJobSystem(jobSystem); }
+
 
     bool serialize(WriteJson &json) const;
     bool deserialize(const JsonBlock &json, const ${ENTITY_NAME}EntityLockedMutexHandle &mutexHandle);
+
+    // Like serialize, but only entities and components changed at or after sinceSyncIndex, up to
+    // the last syncReadWrites. Changed entities get written with all components, removed ones marked.
+    bool serializeDelta(WriteJson &json, u32 sinceSyncIndex) const;
+
+    // Snapshot with components copied as raw bytes, appended to buffer with data type size of 1.
+    // Loading needs same component versions and sizes, JSON is for anything else.
+    bool serializeBinary(ByteBuffer &outBuffer) const;
+    // Entity system has to be empty. inOutReadOffset is moved past the snapshot only on success,
+    // nothing gets modified if the snapshot is invalid.
+    bool deserializeBinary(const ByteBuffer &buffer, u32 &inOutReadOffset,
+        const ${ENTITY_NAME}EntityLockedMutexHandle &mutexHandle);
     u32 getEntityCount() const { return (u32)entityComponents.size(); }
 
     void imguiRenderEntity();
 
-private:${ENTITY_ARRAYS_FIELD}
+private:${ENTITY_STORAGE_FIELDS}
     std::vector<u16> entityVersions;
 
     // This might be problematic if component is activated/deactived in middle of a frame
@@ -169,6 +417,24 @@ private:${ENTITY_ARRAYS_FIELD}
 
     bool entitiesAdded = false;
     bool entitiesRemoved = false;
+
+    bool applyCommands();
+
+    EntityCommandBuffers commandBuffers;
+    std::vector<const EntityCommand*> sortedCommands;
+
+    void resizeChangeTracking();
+    void markComponentsChanged(u64 componentMask, u32 startIndex, u32 count);
+    void markEntityChanged(u32 entityIndex);
+    void applyChangedBits();
+    bool isEntityAlive(u32 entityIndex) const;
+
+    bool changeTracking = false;
+    // Bit per entity for each component, written since the last sync point.
+    std::vector<u64> changedBits[componentTypeCount];
+    // Sync index of last change, entityIndex * componentTypeCount + componentIndex, ~0u if none.
+    std::vector<u32> componentChangeSyncIndices;
+    std::vector<u32> entityChangeSyncIndices;
 };\n")
 
 
@@ -336,7 +602,6 @@ bool ${ENTITY_NAME}::syncReadWrites()
 
     readArrays.store(u64(0));
     writeArrays.store(u64(0));
-    ++currentSyncIndex;
 
     // Cannot have both reading and writing to same array in same sync point.
     ASSERT((reads & writes) == 0);
@@ -345,12 +610,74 @@ bool ${ENTITY_NAME}::syncReadWrites()
     bool addRemove = entitiesAdded || entitiesRemoved;
     ASSERT(!(readWrite && addRemove));
 
+    // Deferred commands get applied after the reads and writes of this sync point are done.
+    bool commandsApplied = true;
+    if(commandBuffers.hasCommands())
+        commandsApplied = applyCommands();
+
+    if(changeTracking)
+        applyChangedBits();
+    ++currentSyncIndex;
+
     entitiesAdded = false;
     entitiesRemoved = false;
 
-    return ((reads & writes) == 0) && !(readWrite && addRemove);
+    return ((reads & writes) == 0) && !(readWrite && addRemove) && commandsApplied;
+}
+
+DeferredEntityHandle ${ENTITY_NAME}::deferAddEntity(u32 sortKey)
+{
+    return commandBuffers.addEntity(sortKey);
+}
+
+void ${ENTITY_NAME}::deferRemoveEntity(const EntityCommandTarget& target, u32 sortKey)
+{
+    commandBuffers.removeEntity(target, sortKey);
 }
+${ENTITY_DEFER_ADD_COMPONENT}
+bool ${ENTITY_NAME}::applyCommands()
+{
+    commandBuffers.getSortedCommands(sortedCommands);
+
+    bool success = true;
+    auto mutexHandle = getLockedMutexHandle();
+    for(const EntityCommand* command : sortedCommands)
+    {
+        if(command->commandType == EntityCommandType::AddEntity)
+        {
+            commandBuffers.setResolvedEntity(*command, addEntity(mutexHandle));
+            continue;
+        }
+
+        EntitySystemHandle handle = commandBuffers.resolveTarget(command->target);
+        // Deferred entity that was not added before this command.
+        ASSERT(handle.entitySystemType == entitySystemID);
+        if(handle.entitySystemType != entitySystemID)
+        {
+            success = false;
+            continue;
+        }
+
+        if(command->commandType == EntityCommandType::RemoveEntity)
+        {
+            // Several systems can remove same entity, only the first one does anything.
+            if(handle.entityIndex < entityComponents.size()
+                && handle.entityIndexVersion == entityVersions[handle.entityIndex])
+            {
+                removeEntity(handle, mutexHandle);
+            }
+            continue;
+        }
 
+        const u8* data = commandBuffers.getCommandData(*command);${ENTITY_APPLY_ADD_COMPONENT}
+    }
+    releaseLockedMutexHandle(mutexHandle);
+
+    commandBuffers.clear();
+    sortedCommands.clear();
+    return success;
+}
+${ENTITY_QUERY_FUNCTIONS}
 EntitySystemHandle ${ENTITY_NAME}::addEntity(const ${ENTITY_NAME}EntityLockedMutexHandle& handle)
 {
     u32 addIndex = ~0u;
@@ -369,7 +696,9 @@ EntitySystemHandle ${ENTITY_NAME}::addEntity(const ${ENTITY_NAME}EntityLockedMut
         entityComponents[freeIndex] = 0;
         ++entityVersions[freeIndex];
         addIndex = freeIndex;
-    }
+    }${ENTITY_ADD_STORAGE}
+    if(changeTracking)
+        markEntityChanged(addIndex);
     entitiesAdded = true;
     return getEntitySystemHandle(addIndex);
 }
@@ -395,7 +724,9 @@ bool ${ENTITY_NAME}::removeEntity(EntitySystemHandle handle, const ${ENTITY_NAME
     u32 freeIndex = handle.entityIndex;
     entityComponents[freeIndex] = 0;
     ++entityVersions[freeIndex];
-    freeEntityIndices.emplace_back(freeIndex);
+    freeEntityIndices.emplace_back(freeIndex);${ENTITY_REMOVE_STORAGE}
+    if(changeTracking)
+        markEntityChanged(freeIndex);
 
     entitiesRemoved = true;
 
@@ -451,6 +782,231 @@ bool ${ENTITY_NAME}::deserialize(const JsonBlock &json, const ${ENTITY_NAME}Enti
     return true;
 }
 
+void ${ENTITY_NAME}::setChangeTracking(bool enabled)
+{
+    changeTracking = enabled;
+    if(enabled)
+        resizeChangeTracking();
+}
+
+u32 ${ENTITY_NAME}::getEntityChangeSyncIndex(u32 entityIndex) const
+{
+    if(entityIndex >= entityChangeSyncIndices.size())
+        return ~0u;
+    return entityChangeSyncIndices[entityIndex];
+}
+
+u32 ${ENTITY_NAME}::getComponentChangeSyncIndex(u32 entityIndex, u32 componentIndex) const
+{
+    if(componentIndex >= componentTypeCount || entityIndex >= entityChangeSyncIndices.size())
+        return ~0u;
+    return componentChangeSyncIndices[entityIndex * componentTypeCount + componentIndex];
+}
+
+void ${ENTITY_NAME}::resizeChangeTracking()
+{
+    u32 entityCount = getEntityCount();
+    for(std::vector<u64> &bits : changedBits)
+        bits.resize((entityCount + 63) / 64, 0);
+    componentChangeSyncIndices.resize(entityCount * componentTypeCount, ~0u);
+    entityChangeSyncIndices.resize(entityCount, ~0u);
+}
+
+void ${ENTITY_NAME}::markComponentsChanged(u64 componentMask, u32 startIndex, u32 count)
+{
+    count = startIndex < getEntityCount() ? Supa::minu32(count, getEntityCount() - startIndex) : 0;
+    for(u32 i = 0; i < componentTypeCount && count > 0; ++i)
+    {
+        if(((componentMask >> i) & 1) == 1)
+            setBitRange(changedBits[i].data(), startIndex, count);
+    }
+}
+
+void ${ENTITY_NAME}::markEntityChanged(u32 entityIndex)
+{
+    if(entityIndex >= entityChangeSyncIndices.size())
+        resizeChangeTracking();
+    entityChangeSyncIndices[entityIndex] = currentSyncIndex;
+    markComponentsChanged(entityComponents[entityIndex], entityIndex, 1);
+}
+
+void ${ENTITY_NAME}::applyChangedBits()
+{
+    for(u32 i = 0; i < componentTypeCount; ++i)
+    {
+        for(u32 word = 0; word < changedBits[i].size(); ++word)
+        {
+            u64 bits = changedBits[i][word];
+            changedBits[i][word] = 0;
+            while(bits != 0)
+            {
+                u32 entityIndex = word * 64 + u32(std::countr_zero(bits));
+                componentChangeSyncIndices[entityIndex * componentTypeCount + i] = currentSyncIndex;
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+bool ${ENTITY_NAME}::isEntityAlive(u32 entityIndex) const
+{
+    return ${ENTITY_IS_ALIVE};
+}
+
+bool ${ENTITY_NAME}::serializeDelta(WriteJson &json, u32 sinceSyncIndex) const
+{
+    json.addObject(entitySystemName);
+    json.addString(\"EntitySystemName\", entitySystemName);
+    json.addInteger(\"EntitySystemTypeId\", u32(entitySystemID));
+    json.addInteger(\"EntityVersion\", entityVersion);
+    json.addInteger(\"SinceSyncIndex\", sinceSyncIndex);
+    json.addInteger(\"SyncIndex\", currentSyncIndex);
+    json.addArray(\"Entities\");
+    for(u32 i = 0; i < entityChangeSyncIndices.size(); ++i)
+    {
+        u32 entityChange = entityChangeSyncIndices[i];
+        bool entityChanged = entityChange != ~0u && entityChange >= sinceSyncIndex;
+        u64 changedComponents = entityChanged ? entityComponents[i] : 0;
+        for(u32 j = 0; j < componentTypeCount; ++j)
+        {
+            u32 componentChange = componentChangeSyncIndices[i * componentTypeCount + j];
+            if(componentChange != ~0u && componentChange >= sinceSyncIndex)
+                changedComponents |= u64(1) << j;
+        }
+        changedComponents &= entityComponents[i];
+        if(!entityChanged && changedComponents == 0)
+            continue;
+
+        json.addObject();
+        json.addInteger(\"EntityIndex\", i);
+        json.addInteger(\"EntityIndexVersion\", entityVersions[i]);
+        json.addBool(\"Removed\", !isEntityAlive(i));
+        json.addArray(\"Components\");
+${ENTITY_WRITE_DELTA_CONTENTS}
+        json.endArray();
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return json.isValid();
+}
+
+bool ${ENTITY_NAME}::serializeBinary(ByteBuffer &outBuffer) const
+{${ENTITY_BINARY_STATIC_ASSERTS}
+
+    ASSERT(outBuffer.getDataSize() == 1);
+    if(outBuffer.getDataSize() != 1)
+        return false;
+
+    u32 entityCount = getEntityCount();
+    BinarySnapshotHeader header {
+        .entitySystemId = u32(entitySystemID),
+        .entityVersion = entityVersion,
+        .entityCount = entityCount,
+        .componentCount = componentTypeCount,
+        .freeEntityIndexCount = u32(freeEntityIndices.size()) };
+
+    writeBinaryBytes(outBuffer, &header, sizeof(header));
+    writeBinaryBytes(outBuffer, entityVersions.data(), u64(entityCount) * sizeof(u16));
+    writeBinaryBytes(outBuffer, entityComponents.data(), u64(entityCount) * sizeof(u64));
+    writeBinaryBytes(outBuffer, freeEntityIndices.data(), u64(freeEntityIndices.size()) * sizeof(u32));
+${ENTITY_BINARY_WRITE_PREPARE}
+    for(u32 i = 0; i < componentTypeCount; ++i)
+    {
+        BinaryComponentHeader componentHeader {
+            .componentId = u32(componentTypes[i]),
+            .componentVersion = componentVersions[i],
+            .componentSize = componentSizes[i] };
+        writeBinaryBytes(outBuffer, &componentHeader, sizeof(componentHeader));
+${ENTITY_BINARY_WRITE_COMPONENT}
+    }
+    return true;
+}
+
+bool ${ENTITY_NAME}::deserializeBinary(const ByteBuffer &buffer, u32 &inOutReadOffset,
+    const ${ENTITY_NAME}EntityLockedMutexHandle &mutexHandle)
+{
+    ASSERT(mutexHandle.lockIndex == mutexLockIndex);
+    ASSERT(getEntityCount() == 0);
+    if(mutexHandle.lockIndex != mutexLockIndex || getEntityCount() != 0)
+        return false;
+
+    u32 readOffset = inOutReadOffset;
+    const u8* headerData = readBinaryBytes(buffer, readOffset, sizeof(BinarySnapshotHeader));
+    if(headerData == nullptr)
+        return false;
+
+    BinarySnapshotHeader header;
+    Supa::memcpy(&header, headerData, sizeof(header));
+    if(header.entitySystemId != u32(entitySystemID) ||
+        header.entityVersion != entityVersion ||
+        header.componentCount != componentTypeCount ||
+        header.freeEntityIndexCount > header.entityCount)
+    {
+        return false;
+    }
+
+    u32 entityCount = header.entityCount;
+    const u8* versionData = readBinaryBytes(buffer, readOffset, u64(entityCount) * sizeof(u16));
+    const u8* componentMaskData = readBinaryBytes(buffer, readOffset, u64(entityCount) * sizeof(u64));
+    const u8* freeIndexData = readBinaryBytes(buffer, readOffset, u64(header.freeEntityIndexCount) * sizeof(u32));
+    if(versionData == nullptr || componentMaskData == nullptr || freeIndexData == nullptr)
+        return false;
+
+    // Free indices have to be unique removed entities, removing clears the component mask.
+    std::vector<u64> freeIndexBits((entityCount + 63) / 64, 0);
+    for(u32 i = 0; i < header.freeEntityIndexCount; ++i)
+    {
+        u32 freeIndex = 0;
+        Supa::memcpy(&freeIndex, freeIndexData + u64(i) * sizeof(u32), sizeof(u32));
+        if(freeIndex >= entityCount || ((freeIndexBits[freeIndex / 64] >> (freeIndex % 64)) & 1) == 1)
+            return false;
+
+        u64 componentMask = 0;
+        Supa::memcpy(&componentMask, componentMaskData + u64(freeIndex) * sizeof(u64), sizeof(u64));
+        if(componentMask != 0)
+            return false;
+        freeIndexBits[freeIndex / 64] |= u64(1) << (freeIndex % 64);
+    }
+
+    // Validate every component before modifying anything.
+    const u8* componentDatas[componentTypeCount] = {};
+    for(u32 i = 0; i < componentTypeCount; ++i)
+    {
+        const u8* componentHeaderData = readBinaryBytes(buffer, readOffset, sizeof(BinaryComponentHeader));
+        if(componentHeaderData == nullptr)
+            return false;
+
+        BinaryComponentHeader componentHeader;
+        Supa::memcpy(&componentHeader, componentHeaderData, sizeof(componentHeader));
+        if(componentHeader.componentId != u32(componentTypes[i]) ||
+            componentHeader.componentVersion != componentVersions[i] ||
+            componentHeader.componentSize != componentSizes[i])
+        {
+            return false;
+        }
+        componentDatas[i] = readBinaryBytes(buffer, readOffset, u64(entityCount) * componentSizes[i]);
+        if(componentDatas[i] == nullptr)
+            return false;
+    }
+
+    entityVersions.resize(entityCount);
+    entityComponents.resize(entityCount);
+    freeEntityIndices.resize(header.freeEntityIndexCount);
+    Supa::memcpy(entityVersions.data(), versionData, u64(entityCount) * sizeof(u16));
+    Supa::memcpy(entityComponents.data(), componentMaskData, u64(entityCount) * sizeof(u64));
+    Supa::memcpy(freeEntityIndices.data(), freeIndexData, u64(header.freeEntityIndexCount) * sizeof(u32));
+${ENTITY_BINARY_LOAD_STORAGE}
+    if(changeTracking)
+    {
+        for(u32 i = 0; i < entityCount; ++i)
+            markEntityChanged(i);
+    }
+    entitiesAdded = true;
+    inOutReadOffset = readOffset;
+    return true;
+}
+
 void ${ENTITY_NAME}::imguiRenderEntity()
 {
     auto builder = getComponentArrayHandleBuilder();
@@ -489,8 +1045,27 @@ ${ENTITY_COMPONENT_ARRAY_GETTING_IMGUI}
         set(ENTITY_WRITE_IMGUI_CONTENTS "")
         set(ENTITY_ARRAYS_FIELD "")
         set(ENTITY_ARRAY_PUSHBACKS "")
+        set(ENTITY_QUERY_ARRAY_FIELDS "")
+        set(ENTITY_QUERY_GET_ARRAYS "")
+        set(ENTITY_QUERY_BATCH_OFFSETS "")
+        set(ENTITY_QUERY_BATCH_COLUMNS "")
+        set(ENTITY_COMPONENT_SIZES_ARRAY "")
+        set(ENTITY_COMPONENT_VERSIONS_ARRAY "")
+        set(ENTITY_WRITE_DELTA_CONTENTS "")
+        set(ENTITY_WRITE_DELTA_CONTENTS_CHUNKS "")
+        set(ENTITY_BINARY_STATIC_ASSERTS "")
+        set(ENTITY_BINARY_ARRAY_POINTERS "")
+        set(ENTITY_BINARY_LOAD_ARRAYS "")
+        set(ENTITY_ADD_COMPONENT_CHUNKS "")
+        set(ENTITY_WRITE_CONTENTS_CHUNKS "")
+        set(ENTITY_LOAD_CONTENTS_CHUNKS "")
+        set(ENTITY_WRITE_IMGUI_CONTENTS_CHUNKS "")
+        set(ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS_CHUNKS "const u64* getComponentsReadArray() const;")
         set(ENTITY_ADD_COMPONENT "")
         set(ENTITY_ADD_COMPONENT_HEADER "")
+        set(ENTITY_DEFER_ADD_COMPONENT "")
+        set(ENTITY_DEFER_ADD_COMPONENT_HEADER "")
+        set(ENTITY_APPLY_ADD_COMPONENT "")
         set(ENTITY_COMPONENT_TYPES_ARRAY "")
         set(ENTITY_COMPONENT_ARRAY_GETTING_IMGUI "")
         set(ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS "const u64* getComponentsReadArray() const;")
@@ -513,6 +1088,18 @@ ${ENTITY_COMPONENT_ARRAY_GETTING_IMGUI}
         set(ENTITY_ID ${ELEM1})
         set(ENTITY_VERSION ${ELEM2})
 
+        # Optional storage mode: Arrays (default) has array per component indexed by entity index,
+        # Chunks groups entities by component mask into 16 KB chunks, see ChunkStorage.
+        set(ENTITY_STORAGE "Arrays")
+        list(LENGTH DEF_ROW_CONTENTS DEF_ROW_LENGTH)
+        if(DEF_ROW_LENGTH GREATER 3)
+            list(GET DEF_ROW_CONTENTS 3 ELEM3) # storage mode
+            string(STRIP ${ELEM3} ENTITY_STORAGE)
+        endif()
+        if(NOT ENTITY_STORAGE STREQUAL "Arrays" AND NOT ENTITY_STORAGE STREQUAL "Chunks")
+            message(FATAL_ERROR "Entity ${ENTITY_NAME} has unknown storage mode: ${ENTITY_STORAGE}, use Arrays or Chunks")
+        endif()
+
         set(ENTITY_COMPONENT_ARRAY_GETTERS "
 const u64* ${ENTITY_NAME}::getComponentsReadArray() const
 {
@@ -553,7 +1140,9 @@ const u64* ${ENTITY_NAME}::getComponentsReadArray() const
         return;\n\n")
     string(APPEND ENTITY_COMPONENT_ARRAY_GETTERS_HEADERS "
     const ${ELEM0}* get${ELEM1}ReadArray(const EntityRWHandle& handle) const;
-    ${ELEM0}* get${ELEM1}WriteArray(const EntityRWHandle& handle);")
+    // Marks every entity changed when change tracking is on, ranged one only the given entities.
+    ${ELEM0}* get${ELEM1}WriteArray(const EntityRWHandle& handle);
+    ${ELEM0}* get${ELEM1}WriteArray(const EntityRWHandle& handle, u32 startIndex, u32 count);")
         string(APPEND ENTITY_COMPONENT_ARRAY_GETTERS "
 const ${ELEM0}* ${ENTITY_NAME}::get${ELEM1}ReadArray(const EntityRWHandle& handle) const
 {
@@ -574,6 +1163,10 @@ const ${ELEM0}* ${ENTITY_NAME}::get${ELEM1}ReadArray(const EntityRWHandle& handl
     return ${ELEM1}Array.data();
 }
 ${ELEM0}* ${ENTITY_NAME}::get${ELEM1}WriteArray(const EntityRWHandle& handle)
+{
+    return get${ELEM1}WriteArray(handle, 0, getEntityCount());
+}
+${ELEM0}* ${ENTITY_NAME}::get${ELEM1}WriteArray(const EntityRWHandle& handle, u32 startIndex, u32 count)
 {
     u64 componentIndex = getComponentIndex(${ELEM0}::componentID);
     ASSERT(componentIndex < componentTypeCount);
@@ -588,11 +1181,24 @@ ${ELEM0}* ${ENTITY_NAME}::get${ELEM1}WriteArray(const EntityRWHandle& handle)
         ASSERT(((handle.writeArrays >> componentIndex) & 1) == 1);
         return nullptr;
     }
+    if(changeTracking)
+        markComponentsChanged(u64(1) << componentIndex, startIndex, count);
     return ${ELEM1}Array.data();
 }")
 
         string(APPEND ENTITY_COMPONENT_TYPES_ARRAY "\n        ${ELEM0}::componentID,")
         string(APPEND ENTITY_ARRAY_PUSHBACKS "\n        ${ELEM1}Array.emplace_back();")
+        string(APPEND ENTITY_QUERY_ARRAY_FIELDS "
+        const ${ELEM0}* ${ELEM1}ReadArray = nullptr;
+        ${ELEM0}* ${ELEM1}WriteArray = nullptr;")
+        string(APPEND ENTITY_QUERY_GET_ARRAYS "
+    if(((handle.readArrays >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1)
+        query.${ELEM1}ReadArray = get${ELEM1}ReadArray(handle);
+    if(((handle.writeArrays >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1)
+        query.${ELEM1}WriteArray = get${ELEM1}WriteArray(handle, 0, 0);")
+        string(APPEND ENTITY_QUERY_BATCH_OFFSETS "
+    outBatch.${ELEM1}ReadArray = ${ELEM1}ReadArray ? ${ELEM1}ReadArray + startIndex : nullptr;
+    outBatch.${ELEM1}WriteArray = ${ELEM1}WriteArray ? ${ELEM1}WriteArray + startIndex : nullptr;")
         string(APPEND ENTITY_ARRAYS_FIELD "\n    std::vector<${ELEM0}> ${ELEM1}Array;")
         string(APPEND ENTITY_LOAD_CONTENTS "
                 if(${ELEM1}Array[addedCount].deserialize(obj))
@@ -604,7 +1210,110 @@ ${ELEM0}* ${ENTITY_NAME}::get${ELEM1}WriteArray(const EntityRWHandle& handle)
                     entityComponents[addedCount] |= u64(1) << componentIndex;
                     continue;
                 }")
-        string(APPEND ENTITY_ADD_COMPONENT_HEADER "    bool add${ELEM0}(EntitySystemHandle handle, const ${ELEM0}& component);\n")
+        string(APPEND ENTITY_ADD_COMPONENT_HEADER "    bool add${ELEM0}(EntitySystemHandle handle, const ${ELEM0}& component);
+    bool remove${ELEM0}(EntitySystemHandle handle);\n")
+        string(APPEND ENTITY_DEFER_ADD_COMPONENT_HEADER "    void deferAdd${ELEM0}(const EntityCommandTarget& target, const ${ELEM0}& component, u32 sortKey);\n")
+        string(APPEND ENTITY_DEFER_ADD_COMPONENT "
+void ${ENTITY_NAME}::deferAdd${ELEM0}(const EntityCommandTarget& target, const ${ELEM0}& component, u32 sortKey)
+{
+    commandBuffers.addComponent(target, getComponentIndex(${ELEM0}::componentID), &component, sizeof(${ELEM0}), sortKey);
+}\n")
+        string(APPEND ENTITY_APPLY_ADD_COMPONENT "
+        if(command->componentIndex == getComponentIndex(${ELEM0}::componentID))
+        {
+            ${ELEM0} component;
+            Supa::memcpy(&component, data, sizeof(${ELEM0}));
+            add${ELEM0}(handle, component);
+        }")
+        string(APPEND ENTITY_COMPONENT_SIZES_ARRAY "\n        sizeof(${ELEM0}),")
+        string(APPEND ENTITY_COMPONENT_VERSIONS_ARRAY "\n        ${ELEM0}::componentVersion,")
+        string(APPEND ENTITY_WRITE_DELTA_CONTENTS "
+        if(((changedComponents >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1)
+        {
+            ${ELEM1}Array[i].serialize(json);
+        }")
+        string(APPEND ENTITY_WRITE_DELTA_CONTENTS_CHUNKS "
+        if(((changedComponents >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1)
+        {
+            ((const ${ELEM0}*)chunkStorage.getComponent(i, getComponentIndex(${ELEM0}::componentID)))->serialize(json);
+        }")
+        string(APPEND ENTITY_BINARY_STATIC_ASSERTS "
+    static_assert(std::is_trivially_copyable_v<${ELEM0}>, \"Binary snapshot copies ${ELEM0} as bytes!\");")
+        string(APPEND ENTITY_BINARY_ARRAY_POINTERS "\n        ${ELEM1}Array.data(),")
+        string(APPEND ENTITY_BINARY_LOAD_ARRAYS "
+    ${ELEM1}Array.resize(entityCount);
+    Supa::memcpy(${ELEM1}Array.data(), componentDatas[getComponentIndex(${ELEM0}::componentID)],
+        u64(entityCount) * sizeof(${ELEM0}));")
+        string(APPEND ENTITY_QUERY_BATCH_COLUMNS "
+    outBatch.${ELEM1}ReadArray = ((readArrays >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1
+        ? (const ${ELEM0}*)chunkStorage->getColumn(archetypeIndex, chunkIndex, getComponentIndex(${ELEM0}::componentID)) + chunkRow
+        : nullptr;
+    outBatch.${ELEM1}WriteArray = ((writeArrays >> getComponentIndex(${ELEM0}::componentID)) & 1) == 1
+        ? (${ELEM0}*)chunkStorage->getColumn(archetypeIndex, chunkIndex, getComponentIndex(${ELEM0}::componentID)) + chunkRow
+        : nullptr;")
+        string(APPEND ENTITY_WRITE_CONTENTS_CHUNKS "
+            if(const ${ELEM0}* component = (const ${ELEM0}*)chunkStorage.getComponent(i, getComponentIndex(${ELEM0}::componentID)))
+            {
+                component->serialize(json);
+            }")
+        string(APPEND ENTITY_WRITE_IMGUI_CONTENTS_CHUNKS "
+        if(${ELEM0}* component = (${ELEM0}*)chunkStorage.getComponent(i, getComponentIndex(${ELEM0}::componentID)))
+        {
+            ImGui::Text(\"        ${ELEM0}\");
+            component->imguiRenderComponent();
+        }")
+        string(APPEND ENTITY_LOAD_CONTENTS_CHUNKS "
+                ${ELEM0} ${ELEM1}Value;
+                if(${ELEM1}Value.deserialize(obj))
+                {
+                    if(!add${ELEM0}(getEntitySystemHandle(addedCount), ${ELEM1}Value))
+                        return false;
+                    continue;
+                }")
+        string(APPEND ENTITY_ADD_COMPONENT_CHUNKS "
+bool ${ENTITY_NAME}::add${ELEM0}(EntitySystemHandle handle, const ${ELEM0}& component)
+{
+    if(handle.entitySystemType != entitySystemID)
+        return false;
+
+    if(handle.entityIndex >= entityComponents.size())
+        return false;
+
+    if(handle.entityIndexVersion != entityVersions[handle.entityIndex])
+        return false;
+
+    u64 componentIndex = getComponentIndex(${ELEM0}::componentID);
+
+    if(componentIndex >= componentTypeCount)
+        return false;
+
+    if(hasComponent(handle, ${ELEM0}::componentID))
+        return false;
+
+    // Moves the entity into another archetype, invalidating query columns.
+    entityComponents[handle.entityIndex] |= u64(1) << componentIndex;
+    chunkStorage.setComponentMask(handle.entityIndex, entityComponents[handle.entityIndex]);
+    *(${ELEM0}*)chunkStorage.getComponent(handle.entityIndex, componentIndex) = component;
+    if(changeTracking)
+        markEntityChanged(handle.entityIndex);
+    entitiesAdded = true;
+
+    return true;
+}
+
+bool ${ENTITY_NAME}::remove${ELEM0}(EntitySystemHandle handle)
+{
+    if(!hasComponent(handle, ${ELEM0}::componentID))
+        return false;
+
+    entityComponents[handle.entityIndex] &= ~(u64(1) << getComponentIndex(${ELEM0}::componentID));
+    chunkStorage.setComponentMask(handle.entityIndex, entityComponents[handle.entityIndex]);
+    if(changeTracking)
+        markEntityChanged(handle.entityIndex);
+    entitiesRemoved = true;
+
+    return true;
+}\n")
         string(APPEND ENTITY_ADD_COMPONENT "
 bool ${ENTITY_NAME}::add${ELEM0}(EntitySystemHandle handle, const ${ELEM0}& component)
 {
@@ -629,6 +1338,20 @@ bool ${ENTITY_NAME}::add${ELEM0}(EntitySystemHandle handle, const ${ELEM0}& comp
 
     ${ELEM1}Array[handle.entityIndex] = component;
     entityComponents[handle.entityIndex] |= u64(1) << componentIndex;
+    if(changeTracking)
+        markEntityChanged(handle.entityIndex);
+
+    return true;
+}
+
+bool ${ENTITY_NAME}::remove${ELEM0}(EntitySystemHandle handle)
+{
+    if(!hasComponent(handle, ${ELEM0}::componentID))
+        return false;
+
+    entityComponents[handle.entityIndex] &= ~(u64(1) << getComponentIndex(${ELEM0}::componentID));
+    if(changeTracking)
+        markEntityChanged(handle.entityIndex);
 
     return true;
 }\n")
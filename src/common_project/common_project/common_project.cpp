@@ -12,6 +12,7 @@
 
 #include "core/camera.h"
 #include "core/general.h"
+#include "core/jobsystem.h"
 #include "core/json.h"
 #include "core/timer.h"
 #include "core/mytypes.h"
@@ -42,6 +43,7 @@
 #include "render/lightrendersystem.h"
 #include "render/linerendersystem.h"
 #include "render/meshrendersystem.h"
+#include "render/rendergraph.h"
 #include "render/tonemaprendersystem.h"
 
 #include "render/lightingrendertargets.h"
@@ -58,15 +60,29 @@
 struct CommonVulkan
 {
     myUpdateFunctionPtr m_updateFunc = nullptr;
+    // Workers shared by vulkan and the scene, started first in sInit.
+    JobSystem m_jobSystem;
     Scene m_scene;
 
     LightingRenderTargets m_lightingRenderTargets;
     MeshRenderTargets m_meshRenderTargets;
 
+    RenderGraph m_renderGraph;
+    // Memory slots of the transient render targets.
+    PodVector<VmaAllocation_T *> m_transientMemory;
+
+    // Render graph barriers of the pass about to run, see sFlushRenderGraphBarriers.
+    PodVector<VkImageMemoryBarrier> m_graphImageBarriers;
+    VkPipelineStageFlags m_graphSrcStages = 0;
+    VkPipelineStageFlags m_graphDstStages = 0;
+    // Writes to the memory of discarded images that have to be visible before the layout changes.
+    VkAccessFlags m_graphWaitWrites = 0;
+    VkAccessFlags m_graphWaitDstAccess = 0;
+
     ConvertRenderTarget m_convertFromS16{ VK_FORMAT_R16G16B16A16_SNORM };
     Vec2 m_fontSize{ 8.0f, 12.0f };
 
-    u32 m_selectedEntityIndex = ~0u;
+    EntityHandle m_selectedEntity;
     float m_rotationAmount = 0.0f;
 
     bool m_showNormalMap = false;
@@ -79,6 +95,7 @@ struct CommonVulkan
 Nullable<CommonVulkan> s_data;
 
 static bool sResize();
+static bool sBindTransientMemory();
 static void sResized(int width, int height);
 static void sDeinit();
 static bool sInit(const char *windowStr, i32 screenWidth, i32 screenHeight);
@@ -89,8 +106,16 @@ static bool sInit(const char *windowStr, i32 screenWidth, i32 screenHeight);
 //
 ////////////////////////
 
+static void sFreeTransientMemory()
+{
+    for(VmaAllocation_T *memory : s_data.get()->m_transientMemory)
+        VulkanResources::freeImageMemory(memory);
+    s_data.get()->m_transientMemory.clear();
+}
+
 static void sDeinit()
 {
+    sFreeTransientMemory();
     FontRenderSystem::deinit();
     MeshRenderSystem::deinit();
     LightRenderSystem::deinit();
@@ -111,10 +136,14 @@ static bool sInit(const char* windowStr, i32 screenWidth, i32 screenHeight)
     auto &vulkanInitParams = VulkanInitializationParameters::getRef();
     vulkanInitParams.useIntegratedGpu = true;
 
+    // Without workers everything runs on this thread.
+    if(!s_data.get()->m_jobSystem.init(JobSystem::getHardwareThreadCount() - 1u))
+        printf("Failed to start job system, running serially\n");
+
     if(!VulkanApp::initApp(windowStr, screenWidth, screenHeight)
        || !InputApp::init()
        || !CameraSystem::init()
-       || !MyVulkan::init()
+       || !MyVulkan::init(&s_data.get()->m_jobSystem)
        || !FontRenderSystem::init("assets/font/new_font.dat"))
     {
         return false;
@@ -129,7 +158,7 @@ static bool sInit(const char* windowStr, i32 screenWidth, i32 screenHeight)
     if (!MeshRenderSystem::init())
         return false;
 
-    if (!s_data.get()->m_scene.init())
+    if (!s_data.get()->m_scene.init(&s_data.get()->m_jobSystem))
         return false;
 
     if (!LightRenderSystem::init())
@@ -141,8 +170,6 @@ static bool sInit(const char* windowStr, i32 screenWidth, i32 screenHeight)
     if (!LineRenderSystem::init())
         return false;
 
-    if (!s_data.get()->m_meshRenderTargets.resizeShadowTarget(c_ShadowWidth, c_ShadowHeight))
-        return false;
 /*
     s_data.get()->m_scene.addGameEntity({ .transform = {.pos = {0.0f, -0.1f, 0.0f }, .scale = { 10.0f, 1.0f, 10.0f } }, .entityType = EntityType::FLOOR });
 
@@ -192,10 +219,20 @@ static void sResized(int w, int h)
 
 static bool sResize()
 {
-    if (!s_data.get()->m_meshRenderTargets.resizeMeshTargets())
-        return false;
-    if (!s_data.get()->m_lightingRenderTargets.resizeLightingTargets())
-        return false;
+    const Image &albedoImage = s_data.get()->m_meshRenderTargets.albedoImage;
+    if (albedoImage.width != vulk->swapchain.width || albedoImage.height != vulk->swapchain.height)
+    {
+        // Transient targets get new images and memory, the old ones cannot be in use.
+        VK_CHECK(vkDeviceWaitIdle(vulk->device));
+        if (!s_data.get()->m_meshRenderTargets.resizeMeshTargets(true))
+            return false;
+        if (!s_data.get()->m_meshRenderTargets.resizeShadowTarget(c_ShadowWidth, c_ShadowHeight, true))
+            return false;
+        if (!s_data.get()->m_lightingRenderTargets.resizeLightingTargets(true))
+            return false;
+        if (!sBindTransientMemory())
+            return false;
+    }
 
     MeshRenderSystem::setRenderTargets(s_data.get()->m_meshRenderTargets);
     LineRenderSystem::setRendertargets(
@@ -229,17 +266,17 @@ static void sHandleInput()
 
     if (InputApp::isPressed(GLFW_KEY_KP_ADD))
     {
-        for (auto &entity : s_data.get()->m_scene.getEntities())
+        for(u32 &animationIndex : s_data.get()->m_scene.getEntities().animationIndices)
         {
-            ++entity.animationIndex;
+            ++animationIndex;
         }
     }
     if (InputApp::isPressed(GLFW_KEY_KP_SUBTRACT))
     {
-        for(auto &entity : s_data.get()->m_scene.getEntities())
+        for(u32 &animationIndex : s_data.get()->m_scene.getEntities().animationIndices)
         {
-            if(entity.animationIndex > 0)
-                --entity.animationIndex;
+            if(animationIndex > 0)
+                --animationIndex;
         }
     }
 
@@ -280,18 +317,23 @@ static void sHandleInput()
     FontRenderSystem::addText(tmpStr,
                               renderPos + Vec2(0.0f, fontSize.y * 2.0f), fontSize, Vector4(1.0f, 1.0f, 1.0f, 1.0f));
 
+    snprintf(tmpStr, 1024, "Scene matrices recomputed: %u",
+             s_data.get()->m_scene.getSceneGraphStats().matricesRecomputed);
+    FontRenderSystem::addText(tmpStr,
+                              renderPos + Vec2(0.0f, fontSize.y * 3.0f), fontSize, Vector4(1.0f, 1.0f, 1.0f, 1.0f));
+
     if(mouseState.leftButtonDown &&
        mouseState.x >= 0 && mouseState.y >= 0 &&
        mouseState.x < vulk->swapchain.width && mouseState.y < vulk->swapchain.height)
     {
-        s_data.get()->m_selectedEntityIndex = ~0u;
+        s_data.get()->m_selectedEntity = EntityHandle();
 
         Vec2 coord = Vec2(mouseState.x, mouseState.y);
         Ray ray = camera.getRayFromScreenPixelCoordinates(coord);
 
         HitPoint hitPoint{ Uninit };
-        s_data.get()->m_selectedEntityIndex = s_data.get()->m_scene.castRay(ray, hitPoint);
-        if(s_data.get()->m_selectedEntityIndex != ~0u)
+        s_data.get()->m_selectedEntity = s_data.get()->m_scene.castRay(ray, hitPoint);
+        if(s_data.get()->m_scene.isValidEntity(s_data.get()->m_selectedEntity))
         {
             s_data.get()->m_lineTo = s_data.get()->m_lineTo = hitPoint.point;
             s_data.get()->m_lineFrom = ray.pos;
@@ -339,13 +381,15 @@ static void sRenderUpdate()
     u32 selectedGreenColor = getColor(Vec4(1.0f, 1.0f, 1.0f, 1.0f) * Vec4(0.0f, 1.0f, 0.0f, 1.0f));
     u32 selectedBlueColor = getColor(Vec4(1.0f, 1.0f, 1.0f, 1.0f) * Vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
-    for (auto &entity : s_data.get()->m_scene.getEntities())
+    EntityStore &entities = s_data.get()->m_scene.getEntities();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
     {
         Vec4 linePoints4[8];
         Vec3 linePoints[8];
 
-        Mat3x4 m = getModelMatrix(entity.transform);
-        const auto &bounds = s_data.get()->m_scene.getBounds(entity.index);
+        EntityHandle entityHandle = entities.getHandle(entityIndex);
+        const Mat3x4 &m = s_data.get()->m_scene.getWorldMatrix(entityHandle);
+        const auto &bounds = s_data.get()->m_scene.getBounds(entityHandle);
         const auto &bmin = bounds.min;
         const auto &bmax = bounds.max;
 
@@ -362,7 +406,7 @@ static void sRenderUpdate()
             linePoints[i] = Vec3(linePoints4[i].x, linePoints4[i].y, linePoints4[i].z);
 
         Vec4 multip(0.5f, 0.5f, 0.5f, 1.0f);
-        u32 drawColor = s_data.get()->m_selectedEntityIndex == entity.index ? selectedColor : grayColor;
+        u32 drawColor = s_data.get()->m_selectedEntity == entityHandle ? selectedColor : grayColor;
         LineRenderSystem::addLine(linePoints[1], linePoints[3], drawColor);
         LineRenderSystem::addLine(linePoints[2], linePoints[3], drawColor);
         LineRenderSystem::addLine(linePoints[1], linePoints[5], drawColor);
@@ -373,19 +417,19 @@ static void sRenderUpdate()
         LineRenderSystem::addLine(linePoints[5], linePoints[7], drawColor);
         LineRenderSystem::addLine(linePoints[6], linePoints[7], drawColor);
 
-        u32 redColor = s_data.get()->m_selectedEntityIndex == entity.index ? selectedRedColor : unSelectedRedColor;
-        u32 greenColor = s_data.get()->m_selectedEntityIndex == entity.index ? selectedGreenColor : unSelectedGreenColor;
-        u32 blueColor = s_data.get()->m_selectedEntityIndex == entity.index ? selectedBlueColor : unSelectedBlueColor;
+        u32 redColor = s_data.get()->m_selectedEntity == entityHandle ? selectedRedColor : unSelectedRedColor;
+        u32 greenColor = s_data.get()->m_selectedEntity == entityHandle ? selectedGreenColor : unSelectedGreenColor;
+        u32 blueColor = s_data.get()->m_selectedEntity == entityHandle ? selectedBlueColor : unSelectedBlueColor;
 
         LineRenderSystem::addLine(linePoints[0], linePoints[1], redColor);
         LineRenderSystem::addLine(linePoints[0], linePoints[2], greenColor);
         LineRenderSystem::addLine(linePoints[0], linePoints[4], blueColor);
 
-        if (entity.entityType == EntityType::NUM_OF_ENTITY_TYPES ||
-            entity.entityType == EntityType::FLOOR)
+        if (entities.entityTypes[entityIndex] == EntityType::NUM_OF_ENTITY_TYPES ||
+            entities.entityTypes[entityIndex] == EntityType::FLOOR)
             continue;
 
-        entity.transform.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 0.0f, 1.0f), s_data.get()->m_rotationAmount);
+        entities.transforms[entityIndex].rot = getQuaternionFromAxisAngle(Vec3(0.0f, 0.0f, 1.0f), s_data.get()->m_rotationAmount);
     }
     if (s_data.get()->m_rotateOn)
     {
@@ -403,55 +447,277 @@ static void sRenderUpdate()
     LineRenderSystem::prepareToRender();
 }
 
-static void sDraw()
+////////////////////////
+//
+// RENDER GRAPH
+//
+////////////////////////
+
+// Passes recorded into secondary command buffers, in the order of their records.
+enum DrawRecord : u32
+{
+    DrawRecordMesh,
+    DrawRecordShadow,
+    DrawRecordLine,
+    DrawRecordFont,
+    DrawRecordCount,
+};
+
+static void sMeshPass(void *passData)
+{
+    MeshRenderSystem::render(s_data.get()->m_meshRenderTargets, (const SecondaryCommandRecord *)passData);
+}
+
+static void sShadowPass(void *passData)
+{
+    MeshRenderSystem::renderShadows(s_data.get()->m_meshRenderTargets, (const SecondaryCommandRecord *)passData);
+}
+
+static void sLightingPass(void *passData)
+{
+    Image& image = s_data.get()->m_lightingRenderTargets.lightingTargetImage;
+    LightRenderSystem::render(image.width, image.height);
+}
+
+static void sTonemapPass(void *passData)
+{
+    Image& image = s_data.get()->m_meshRenderTargets.albedoImage;
+    TonemapRenderSystem::render(image.width, image.height);
+}
+
+static void sNormalMapPass(void *passData)
+{
+    Image& image = s_data.get()->m_meshRenderTargets.albedoImage;
+    s_data.get()->m_convertFromS16.render(image.width, image.height);
+}
+
+static void sLinePass(void *passData)
+{
+    LineRenderSystem::render(s_data.get()->m_meshRenderTargets.albedoImage,
+        s_data.get()->m_meshRenderTargets.depthImage, (const SecondaryCommandRecord *)passData);
+}
+
+static void sFontPass(void *passData)
+{
+    FontRenderSystem::render((const SecondaryCommandRecord *)passData);
+}
+
+static void sPresentPass(void *passData)
 {
-    s_data.get()->m_meshRenderTargets.prepareTargetsForMeshRendering();
-    s_data.get()->m_meshRenderTargets.prepareTargetsForShadowRendering();
-    // Drawingg
+    MyVulkan::present(s_data.get()->m_meshRenderTargets.albedoImage);
+}
+
+// Stages, accesses and layout of a render graph usage. Attachments are loaded by later passes,
+// so they read as well as write.
+struct RenderGraphUsageState
+{
+    VkPipelineStageFlags stageMask;
+    VkAccessFlags accessMask;
+    VkAccessFlags writeMask;
+    VkImageLayout layout;
+};
+
+static RenderGraphUsageState sGetUsageState(RenderGraphUsage usage)
+{
+    switch (usage)
     {
-        MeshRenderSystem::render(s_data.get()->m_meshRenderTargets);
-        MeshRenderSystem::renderShadows(s_data.get()->m_meshRenderTargets);
+        case RenderGraphUsage::ColorAttachment:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        case RenderGraphUsage::DepthAttachment:
+            return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        case RenderGraphUsage::GraphicsSampleRead:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case RenderGraphUsage::ComputeSampleRead:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case RenderGraphUsage::ComputeImageRead:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL };
+        case RenderGraphUsage::ComputeImageWrite:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        // MyVulkan::present blits the image to the swapchain.
+        case RenderGraphUsage::Present:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+        case RenderGraphUsage::None:
+            break;
     }
+    return { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+}
 
-    if (s_data.get()->m_showNormalMap)
+// Source stages and accesses come from the usage the image had, not from whatever ran last.
+// Discarded contents go from undefined layout, and the wait for the last use of their memory
+// is a global memory barrier, since that use can be another image bound to the same memory.
+static void sApplyRenderGraphBarrier(void *imageData, const RenderGraphBarrier &barrier)
+{
+    // MyVulkan::present makes its own barrier from the layout the image is left in.
+    if (barrier.dstUsage == RenderGraphUsage::Present)
+        return;
+
+    CommonVulkan &data = *s_data.get();
+    RenderGraphUsageState src = sGetUsageState(barrier.srcUsage);
+    RenderGraphUsageState dst = sGetUsageState(barrier.dstUsage);
+    RenderGraphUsageState wait = sGetUsageState(barrier.waitUsage);
+
+    data.m_graphSrcStages |= src.stageMask | wait.stageMask;
+    data.m_graphDstStages |= dst.stageMask;
+    if (wait.writeMask)
     {
-        VulkanResources::prepareToComputeSampleRead(s_data.get()->m_meshRenderTargets.normalMapImage);
-
-        VulkanResources::prepareToComputeImageWrite(s_data.get()->m_meshRenderTargets.albedoImage);
-        Image& image = s_data.get()->m_meshRenderTargets.albedoImage;
-        s_data.get()->m_convertFromS16.render(image.width, image.height);
+        data.m_graphWaitWrites |= wait.writeMask;
+        data.m_graphWaitDstAccess |= dst.accessMask;
     }
-    else
-    {
-        {
-            s_data.get()->m_meshRenderTargets.prepareTargetsForLightingComputeSampling();
-            s_data.get()->m_lightingRenderTargets.prepareTargetsForLightingComputeWriting();
 
-            Image& image = s_data.get()->m_lightingRenderTargets.lightingTargetImage;
-            LightRenderSystem::render(image.width, image.height);
-        }
+    // Read to read with the same layout needs no image barrier.
+    VkImageMemoryBarrier imageBarrier = VulkanResources::imageBarrier(*(Image *)imageData,
+        src.writeMask, src.layout, dst.accessMask, dst.layout);
+    if (imageBarrier.sType == VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER)
+        data.m_graphImageBarriers.push_back(imageBarrier);
+}
 
-        {
-            s_data.get()->m_lightingRenderTargets.prepareForTonemapSampling();
-            Image& image = s_data.get()->m_meshRenderTargets.albedoImage;
-            VulkanResources::prepareToComputeImageWrite(image);
-            TonemapRenderSystem::render(image.width, image.height);
-        }
+static void sFlushRenderGraphBarriers()
+{
+    CommonVulkan &data = *s_data.get();
+    if (data.m_graphImageBarriers.size() > 0u || data.m_graphWaitWrites != 0u)
+    {
+        VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        memoryBarrier.srcAccessMask = data.m_graphWaitWrites;
+        memoryBarrier.dstAccessMask = data.m_graphWaitDstAccess;
+        vkCmdPipelineBarrier(vulk->commandBuffer, data.m_graphSrcStages, data.m_graphDstStages, 0,
+            data.m_graphWaitWrites != 0u ? 1u : 0u, &memoryBarrier,
+            0, nullptr,
+            data.m_graphImageBarriers.size(), data.m_graphImageBarriers.data());
     }
+    data.m_graphImageBarriers.clear();
+    data.m_graphSrcStages = 0;
+    data.m_graphDstStages = 0;
+    data.m_graphWaitWrites = 0;
+    data.m_graphWaitDstAccess = 0;
+}
+
+static u32 sAddTransientImage(RenderGraph &graph, Image &image)
+{
+    VkMemoryRequirements requirements = VulkanResources::getImageMemoryRequirements(image);
+    return graph.addTransientImage(image.imageName, &image,
+        requirements.size, requirements.alignment, requirements.memoryTypeBits);
+}
 
-    VulkanResources::prepareToGraphicsSampleWrite(s_data.get()->m_meshRenderTargets.albedoImage);
+// Records can be null when the graph is only built for its memory slots. Normal map view
+// overwrites the tonemapped albedo, so lighting, tonemap and shadows get culled with it.
+static void sBuildRenderGraph(RenderGraph &graph, SecondaryCommandRecord *records, bool showNormalMap)
+{
+    MeshRenderTargets &meshTargets = s_data.get()->m_meshRenderTargets;
+    LightingRenderTargets &lightingTargets = s_data.get()->m_lightingRenderTargets;
+
+    graph.clear();
+    u32 albedo = graph.addImage(meshTargets.albedoImage.imageName, &meshTargets.albedoImage);
+    u32 normalMap = sAddTransientImage(graph, meshTargets.normalMapImage);
+    u32 depth = sAddTransientImage(graph, meshTargets.depthImage);
+    u32 shadowDepth = sAddTransientImage(graph, meshTargets.shadowDepthImage);
+    u32 lighting = sAddTransientImage(graph, lightingTargets.lightingTargetImage);
+
+    graph.addPass("Mesh", sMeshPass, records ? &records[DrawRecordMesh] : nullptr);
+    graph.write(albedo, RenderGraphUsage::ColorAttachment);
+    graph.write(normalMap, RenderGraphUsage::ColorAttachment);
+    graph.write(depth, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("Shadow", sShadowPass, records ? &records[DrawRecordShadow] : nullptr);
+    graph.write(shadowDepth, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("Lighting", sLightingPass, nullptr);
+    graph.read(albedo, RenderGraphUsage::ComputeSampleRead);
+    graph.read(normalMap, RenderGraphUsage::ComputeSampleRead);
+    graph.read(depth, RenderGraphUsage::ComputeSampleRead);
+    graph.read(shadowDepth, RenderGraphUsage::ComputeSampleRead);
+    graph.write(lighting, RenderGraphUsage::ComputeImageWrite);
+
+    graph.addPass("Tonemap", sTonemapPass, nullptr);
+    graph.read(lighting, RenderGraphUsage::ComputeSampleRead);
+    graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
+
+    if (showNormalMap)
     {
-        VulkanResources::prepareToGraphicsSampleWrite(s_data.get()->m_meshRenderTargets.depthImage);
-        LineRenderSystem::render(s_data.get()->m_meshRenderTargets.albedoImage,
-                                 s_data.get()->m_meshRenderTargets.depthImage);
+        graph.addPass("Normal map", sNormalMapPass, nullptr);
+        graph.read(normalMap, RenderGraphUsage::ComputeSampleRead);
+        graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
     }
 
+    graph.addPass("Lines", sLinePass, records ? &records[DrawRecordLine] : nullptr);
+    graph.readWrite(albedo, RenderGraphUsage::ColorAttachment);
+    graph.readWrite(depth, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("Font", sFontPass, records ? &records[DrawRecordFont] : nullptr);
+    graph.readWrite(albedo, RenderGraphUsage::ColorAttachment);
+
+    graph.addPass("Present", sPresentPass, nullptr, true);
+    graph.read(albedo, RenderGraphUsage::Present);
+}
+
+// Memory slots come from a graph with every optional pass, so they stay valid with any of
+// them culled. All transient targets are alive in the lighting pass, so each gets its own slot.
+static bool sBindTransientMemory()
+{
+    sFreeTransientMemory();
+
+    RenderGraph &graph = s_data.get()->m_renderGraph;
+    sBuildRenderGraph(graph, nullptr, true);
+    if (!graph.compile())
+        return false;
+
+    for (const RenderGraphMemorySlot &slot : graph.getMemorySlots())
     {
-        FontRenderSystem::render();
+        VkMemoryRequirements requirements = { slot.size, slot.alignment, slot.memoryTypeBits };
+        VmaAllocation_T *memory = VulkanResources::allocateImageMemory(requirements);
+        if (!memory)
+            return false;
+        s_data.get()->m_transientMemory.push_back(memory);
     }
+    for (u32 imageIndex = 0; imageIndex < graph.getImageCount(); ++imageIndex)
+    {
+        u32 slotIndex = graph.getMemorySlot(imageIndex);
+        if (slotIndex == ~0u)
+            continue;
+        Image &image = *(Image *)graph.getImageData(imageIndex);
+        if (!VulkanResources::bindImageMemory(image, s_data.get()->m_transientMemory[slotIndex]))
+            return false;
+    }
+    printf("Transient render targets: %.1f MB in %.1f MB of memory\n",
+        double(graph.getTransientImageBytes()) / (1024.0 * 1024.0),
+        double(graph.getMemorySlotBytes()) / (1024.0 * 1024.0));
+    return true;
+}
 
+static void sDraw()
+{
+    // Render pass contents get recorded in parallel, the graph executes them in order.
+    SecondaryCommandRecord records[DrawRecordCount] =
+    {
+        MeshRenderSystem::getRenderRecord(),
+        MeshRenderSystem::getShadowRenderRecord(),
+        LineRenderSystem::getRenderRecord(),
+        FontRenderSystem::getRenderRecord(),
+    };
+
+    RenderGraph &graph = s_data.get()->m_renderGraph;
+    sBuildRenderGraph(graph, records, s_data.get()->m_showNormalMap);
+    bool compiled = graph.compile();
+    ASSERT(compiled);
+
+    // Culled passes do not get recorded.
+    for (u32 passIndex = 0; passIndex < graph.getPassCount(); ++passIndex)
+    {
+        SecondaryCommandRecord *record = (SecondaryCommandRecord *)graph.getPassData(passIndex);
+        if (record && graph.isPassCulled(passIndex))
+            record->recordFunc = nullptr;
+    }
+    MyVulkan::recordSecondaryCommandBuffers(records, DrawRecordCount);
 
-    MyVulkan::present(s_data.get()->m_meshRenderTargets.albedoImage);
+    graph.execute(sApplyRenderGraphBarrier, sFlushRenderGraphBarriers);
 }
 
 
@@ -484,9 +750,11 @@ static void sRunApp()
 
 void commonMain(const char* windowStr, i32 windowWidth, i32 windowHeight,
                 myInitFunctionPtr initFunc,
-                myUpdateFunctionPtr updateFunc)
+                myUpdateFunctionPtr updateFunc,
+                i32 argCount, char **argv)
 {
     initMemory();
+    VulkanInitializationParameters::parseCommandLine(argCount, argv);
 
     initGlobalResources();
     s_data.create();
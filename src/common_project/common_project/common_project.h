@@ -14,6 +14,8 @@ static constexpr i32 c_ShadowWidth = 2048;
 static constexpr i32 c_ShadowHeight = 2048;
 
 
+// argCount and argv are the ones from main, see VulkanInitializationParameters::parseCommandLine.
 void commonMain(const char* windowStr, i32 windowWidth, i32 windowHeight,
                 myInitFunctionPtr initFunc,
-                myUpdateFunctionPtr updateFunc);
+                myUpdateFunctionPtr updateFunc,
+                i32 argCount = 0, char **argv = nullptr);
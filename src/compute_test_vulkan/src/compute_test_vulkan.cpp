@@ -24,7 +24,7 @@ i32 main(i32 argCount, char **argv)
 {
     commonMain("Vulkan, compute test",
                c_ScreenWidth, c_ScreenHeight,
-               testInit, testUpdate);
+               testInit, testUpdate, argCount, argv);
     return 0;
 }
 
@@ -376,17 +376,17 @@ static void sHandleInput()
 
     if(InputApp::isPressed(GLFW_KEY_KP_ADD))
     {
-        for(auto &entity : s_computeData->m_scene.getEntities())
+        for(u32 &animationIndex : s_computeData->m_scene.getEntities().animationIndices)
         {
-            ++entity.animationIndex;
+            ++animationIndex;
         }
     }
     if(InputApp::isPressed(GLFW_KEY_KP_SUBTRACT))
     {
-        for(auto &entity : s_computeData->m_scene.getEntities())
+        for(u32 &animationIndex : s_computeData->m_scene.getEntities().animationIndices)
         {
-            if(entity.animationIndex > 0)
-                --entity.animationIndex;
+            if(animationIndex > 0)
+                --animationIndex;
         }
     }
 
@@ -75,7 +75,7 @@ struct VulkanDrawStuffData
     Camera m_camera;
     Camera m_sunCamera;
 
-    u32 m_selectedEntityIndex = ~0u;
+    EntityHandle m_selectedEntity;
     float m_rotationAmount = 0.0f;
 
     bool m_showNormalMap = false;
@@ -248,17 +248,17 @@ static void sHandleInput()
 
     if (InputApp::isPressed(GLFW_KEY_KP_ADD))
     {
-        for (auto &entity : s_data->m_scene.getEntities())
+        for(u32 &animationIndex : s_data->m_scene.getEntities().animationIndices)
         {
-            ++entity.animationIndex;
+            ++animationIndex;
         }
     }
     if (InputApp::isPressed(GLFW_KEY_KP_SUBTRACT))
     {
-        for(auto &entity : s_data->m_scene.getEntities())
+        for(u32 &animationIndex : s_data->m_scene.getEntities().animationIndices)
         {
-            if(entity.animationIndex > 0)
-                --entity.animationIndex;
+            if(animationIndex > 0)
+                --animationIndex;
         }
     }
 
@@ -313,7 +313,7 @@ static void sHandleInput()
         mouseState.x >= 0 && mouseState.y >= 0 &&
         mouseState.x < vulk->swapchain.width && mouseState.y < vulk->swapchain.height)
     {
-        s_data->m_selectedEntityIndex = ~0u;
+        s_data->m_selectedEntity = EntityHandle();
 
         Vec2 coord = Vec2(mouseState.x, mouseState.y);
         const auto& app = VulkanApp::getWindowApp();
@@ -325,8 +325,8 @@ static void sHandleInput()
             ray = s_data->m_camera.getRayFromScreenPixelCoordinates(coord, windowSize);
 
         HitPoint hitpoint{ Uninit };
-        s_data->m_selectedEntityIndex = s_data->m_scene.castRay(ray, hitpoint);
-        if(s_data->m_selectedEntityIndex != ~0u)
+        s_data->m_selectedEntity = s_data->m_scene.castRay(ray, hitpoint);
+        if(s_data->m_scene.isValidEntity(s_data->m_selectedEntity))
         {
             s_data->m_lineTo = s_data->m_lineTo = hitpoint.point;
             s_data->m_lineFrom = ray.pos;
@@ -408,13 +408,15 @@ static void sRenderUpdate()
     u32 selectedGreenColor = getColor(Vec4(1.0f, 1.0f, 1.0f, 1.0f) * Vec4(0.0f, 1.0f, 0.0f, 1.0f));
     u32 selectedBlueColor = getColor(Vec4(1.0f, 1.0f, 1.0f, 1.0f) * Vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
-    for (auto &entity : s_data->m_scene.getEntities())
+    EntityStore &entities = s_data->m_scene.getEntities();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
     {
         Vec4 linePoints4[8];
         Vec3 linePoints[8];
 
-        Mat3x4 m = getModelMatrix(entity.transform);
-        const auto &bounds = s_data->m_scene.getBounds(entity.index);
+        EntityHandle entityHandle = entities.getHandle(entityIndex);
+        const Mat3x4 &m = s_data->m_scene.getWorldMatrix(entityHandle);
+        const auto &bounds = s_data->m_scene.getBounds(entityHandle);
         const auto &bmin = bounds.min;
         const auto &bmax = bounds.max;
 
@@ -431,7 +433,7 @@ static void sRenderUpdate()
             linePoints[i] = Vec3(linePoints4[i].x, linePoints4[i].y, linePoints4[i].z);
 
         Vec4 multip(0.5f, 0.5f, 0.5f, 1.0f);
-        u32 drawColor = s_data->m_selectedEntityIndex == entity.index ? selectedColor : grayColor;
+        u32 drawColor = s_data->m_selectedEntity == entityHandle ? selectedColor : grayColor;
         LineRenderSystem::addLine(linePoints[1], linePoints[3], drawColor);
         LineRenderSystem::addLine(linePoints[2], linePoints[3], drawColor);
         LineRenderSystem::addLine(linePoints[1], linePoints[5], drawColor);
@@ -442,19 +444,19 @@ static void sRenderUpdate()
         LineRenderSystem::addLine(linePoints[5], linePoints[7], drawColor);
         LineRenderSystem::addLine(linePoints[6], linePoints[7], drawColor);
 
-        u32 redColor = s_data->m_selectedEntityIndex == entity.index ? selectedRedColor : unSelectedRedColor;
-        u32 greenColor = s_data->m_selectedEntityIndex == entity.index ? selectedGreenColor : unSelectedGreenColor;
-        u32 blueColor = s_data->m_selectedEntityIndex == entity.index ? selectedBlueColor : unSelectedBlueColor;
+        u32 redColor = s_data->m_selectedEntity == entityHandle ? selectedRedColor : unSelectedRedColor;
+        u32 greenColor = s_data->m_selectedEntity == entityHandle ? selectedGreenColor : unSelectedGreenColor;
+        u32 blueColor = s_data->m_selectedEntity == entityHandle ? selectedBlueColor : unSelectedBlueColor;
 
         LineRenderSystem::addLine(linePoints[0], linePoints[1], redColor);
         LineRenderSystem::addLine(linePoints[0], linePoints[2], greenColor);
         LineRenderSystem::addLine(linePoints[0], linePoints[4], blueColor);
 
-        if (entity.entityType == EntityType::NUM_OF_ENTITY_TYPES ||
-            entity.entityType == EntityType::FLOOR)
+        if (entities.entityTypes[entityIndex] == EntityType::NUM_OF_ENTITY_TYPES ||
+            entities.entityTypes[entityIndex] == EntityType::FLOOR)
             continue;
 
-        entity.transform.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 0.0f, 1.0f), s_data->m_rotationAmount);
+        entities.transforms[entityIndex].rot = getQuaternionFromAxisAngle(Vec3(0.0f, 0.0f, 1.0f), s_data->m_rotationAmount);
     }
     if (s_data->m_rotateOn)
     {
@@ -192,17 +192,17 @@ void EditorTest::logicUpdate()
 
         if(isPressed(GLFW_KEY_KP_ADD))
         {
-            for(auto &entity : scene.getEntities())
+            for(u32 &animationIndex : scene.getEntities().animationIndices)
             {
-                ++entity.animationIndex;
+                ++animationIndex;
             }
         }
         if(isPressed(GLFW_KEY_KP_SUBTRACT))
         {
-            for(auto &entity : scene.getEntities())
+            for(u32 &animationIndex : scene.getEntities().animationIndices)
             {
-                if(entity.animationIndex > 0)
-                    --entity.animationIndex;
+                if(animationIndex > 0)
+                    --animationIndex;
             }
         }
 
@@ -79,7 +79,7 @@ public:
     ConvertRenderTarget convertFromS16{ VK_FORMAT_R16G16B16A16_SNORM };
     Vec2 fontSize{ 8.0f, 12.0f };
 
-    u32 selectedEntityIndex = ~0u;
+    EntityHandle selectedEntity;
 
     bool showNormalMap = false;
 
@@ -87,8 +87,8 @@ public:
     Vec3 lineTo;
 
 
-    u32 characterEntityIndex = ~0u;
-    u32 characterEntityIndex2 = ~0u;
+    EntityHandle characterEntity;
+    EntityHandle characterEntity2;
 
     u32 moveAnimationIndex = ~0u;
     float angle = 0.0f;
@@ -137,11 +137,11 @@ bool GameApp::init(const char* windowStr, i32 screenWidth, i32 screenHeight)
 
     scene.addGameEntity({ .transform = {.pos = {0.0f, -0.1f, 0.0f }, .scale = { 10.0f, 1.0f, 10.0f } }, .entityType = EntityType::FLOOR });
 
-    characterEntityIndex = scene.addGameEntity({ .transform = { .pos = { 0.0f, 0.0f, 0.0f } }, .entityType = EntityType::NEW_CHARACTER_TEST });
-    moveAnimationIndex = scene.addAnimation(characterEntityIndex, "Run", PlayMode::Loop);
+    characterEntity = scene.addGameEntity({ .transform = { .pos = { 0.0f, 0.0f, 0.0f } }, .entityType = EntityType::NEW_CHARACTER_TEST });
+    moveAnimationIndex = scene.addAnimation(characterEntity, "Run", PlayMode::Loop);
 
-    characterEntityIndex2 = scene.addGameEntity({ .transform = { .pos = { 1.5f, 0.0f, 1.5f } }, .entityType = EntityType::NEW_CHARACTER_TEST });
-    scene.addAnimation(characterEntityIndex2, "Punch", PlayMode::Loop);
+    characterEntity2 = scene.addGameEntity({ .transform = { .pos = { 1.5f, 0.0f, 1.5f } }, .entityType = EntityType::NEW_CHARACTER_TEST });
+    scene.addAnimation(characterEntity2, "Punch", PlayMode::Loop);
 
     for(float x = -10.0f; x <= 10.0f; x += 5.0f)
     {
@@ -190,8 +190,9 @@ void GameApp::logicUpdate()
     MouseState mouseState = getMouseState();
 
     //checkCameraKeypresses(dt, camera);
-    GameEntity &entity = scene.getEntity(characterEntityIndex);
-    GameEntity &entity2 = scene.getEntity(characterEntityIndex2);
+    EntityStore &entities = scene.getEntities();
+    Transform &transform = scene.getTransform(characterEntity);
+    Transform &transform2 = scene.getTransform(characterEntity2);
 
     float moveSpeed = dt * 5.0f;
     Vec3 dir;
@@ -237,39 +238,40 @@ void GameApp::logicUpdate()
 
     if(isPressed(GLFW_KEY_SPACE))
     {
-        scene.addAnimation(characterEntityIndex, "Punch", PlayMode::PlayOnce);
+        scene.addAnimation(characterEntity, "Punch", PlayMode::PlayOnce);
     }
     if(isPressed(GLFW_KEY_X))
     {
         if(moveAnimationIndex != ~0u)
         {
-            scene.replaceAnimation(characterEntityIndex, "Run", moveAnimationIndex);
+            scene.replaceAnimation(characterEntity, "Run", moveAnimationIndex);
         }
     }
     if(isPressed(GLFW_KEY_Z))
     {
         if(moveAnimationIndex != ~0u)
         {
-            scene.replaceAnimation(characterEntityIndex, "walk", moveAnimationIndex);
+            scene.replaceAnimation(characterEntity, "walk", moveAnimationIndex);
         }
     }
 
-    if(entity.animationIndex != animIndex)
+    u32 characterIndex = entities.getDenseIndex(characterEntity);
+    if(characterIndex != ~0u && entities.animationIndices[characterIndex] != animIndex)
     {
-        entity.animationIndex = animIndex;
-        entity.animationTime = 0.0;
+        entities.animationIndices[characterIndex] = animIndex;
+        entities.animationTimes[characterIndex] = 0.0;
     }
 
-    entity.transform.pos = entity.transform.pos + dir * moveSpeed;
+    transform.pos = transform.pos + dir * moveSpeed;
     Quat newRot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), angle);
-    entity.transform.rot = newRot;
+    transform.rot = newRot;
 
-    entity2.transform.pos = entity2.transform.pos + dir * moveSpeed;
-    entity2.transform.rot = newRot;
+    transform2.pos = transform2.pos + dir * moveSpeed;
+    transform2.rot = newRot;
     camera.position = camera.position + dir * moveSpeed;
-    camera.lookAt(entity.transform.pos);
+    camera.lookAt(transform.pos);
 
-    sunCamera.lookAt(entity.transform.pos);
+    sunCamera.lookAt(transform.pos);
     if (isPressed(GLFW_KEY_P))
         showNormalMap = !showNormalMap;
 
@@ -296,7 +298,7 @@ void GameApp::logicUpdate()
         mouseState.x >= 0 && mouseState.y >= 0 &&
         mouseState.x < vulk->swapchain.width && mouseState.y < vulk->swapchain.height)
     {
-        selectedEntityIndex = ~0u;
+        selectedEntity = EntityHandle();
 
         Vec2 coord = Vec2(mouseState.x, mouseState.y);
         Ray ray{ Uninit };
@@ -306,8 +308,8 @@ void GameApp::logicUpdate()
             ray = camera.getRayFromScreenPixelCoordinates(coord, getWindowSize());
 
         HitPoi32 hitpoint{ Uninit };
-        selectedEntityIndex = scene.castRay(ray, hitpoint);
-        if(selectedEntityIndex != ~0u)
+        selectedEntity = scene.castRay(ray, hitpoint);
+        if(scene.isValidEntity(selectedEntity))
         {
             lineTo = lineTo = hitpoint.point;
             lineFrom = ray.pos;
@@ -164,17 +164,17 @@ void ImguiTest::logicUpdate()
 
     if (isPressed(GLFW_KEY_KP_ADD))
     {
-        for (auto &entity : scene.getEntities())
+        for(u32 &animationIndex : scene.getEntities().animationIndices)
         {
-            ++entity.animationIndex;
+            ++animationIndex;
         }
     }
     if (isPressed(GLFW_KEY_KP_SUBTRACT))
     {
-        for(auto &entity : scene.getEntities())
+        for(u32 &animationIndex : scene.getEntities().animationIndices)
         {
-            if(entity.animationIndex > 0)
-                --entity.animationIndex;
+            if(animationIndex > 0)
+                --animationIndex;
         }
     }
 
@@ -218,13 +218,14 @@ void ImguiTest::renderUpdate()
     VulkanApp::renderUpdate();
     imgui.renderBegin();
 
-    for (auto &entity : scene.getEntities())
+    EntityStore &entities = scene.getEntities();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
     {
-        if (entity.entityType == EntityType::NUM_OF_ENTITY_TYPES ||
-            entity.entityType == EntityType::FLOOR)
+        if (entities.entityTypes[entityIndex] == EntityType::NUM_OF_ENTITY_TYPES ||
+            entities.entityTypes[entityIndex] == EntityType::FLOOR)
             continue;
 
-        entity.transform.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), rotationAmount);
+        entities.transforms[entityIndex].rot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), rotationAmount);
     }
     if (rotateOn)
     {
@@ -6,6 +6,8 @@
 #include <core/mytypes.h>
 #include <core/general.h>
 
+#include <myvulkan/vulkaninitparameters.h>
+
 #include <GLFW/glfw3.h>
 
 static const i32 KEYCOUNT = 512;
@@ -63,6 +65,10 @@ static void sKBHandlerCB(GLFWwindow *window, i32 key, i32 scancode, i32 action,
 
 bool InputApp::init()
 {
+    // No window to get keys from, every key stays up.
+    if(VulkanInitializationParameters::get().headless)
+        return true;
+
     GLFWwindow* window = VulkanApp::getWindowRef();
     ASSERT(window);
     glfwSetKeyCallback(window, sKBHandlerCB);
@@ -124,9 +130,12 @@ u32 InputApp::getBufferedInputCount()
 
 MouseState InputApp::getMouseState()
 {
+    MouseState mouseState{};
+    if(VulkanInitializationParameters::get().headless)
+        return mouseState;
+
     GLFWwindow* window = VulkanApp::getWindowRef();
     ASSERT(window);
-    MouseState mouseState{};
 
     double xpos, ypos;
     glfwGetCursorPos(window, &xpos, &ypos);
@@ -4,6 +4,9 @@
 
 #include <core/assert.h>
 #include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <myvulkan/vulkaninitparameters.h>
 
 #if WIN32
     #include <Windows.h> // begintimeperiod
@@ -20,6 +23,10 @@
 static WindowApp sWindowApp;
 static GLFWwindow* sWindow = nullptr;
 
+// Headless runs without glfw, time comes from timer and frames are counted for the frame limit.
+static Timer::TimePoint sHeadlessStartTime;
+static u32 sHeadlessFrames = 0u;
+
 static void sResizeWindow(i32 width, i32 height);
 
 static void sErrorCB(i32 error, const char* description)
@@ -54,6 +61,14 @@ bool VulkanApp::initApp(const char *windowStr, i32 screenWidth, i32 screenHeight
     sWindowApp.windowWidth = screenWidth;
     sWindowApp.windowHeight = screenHeight;
 
+    if(VulkanInitializationParameters::get().headless)
+    {
+        sResizeWindow(screenWidth, screenHeight);
+        sHeadlessStartTime = Timer::getTime(Timer::ClockId);
+        sHeadlessFrames = 0u;
+        return screenWidth > 0 && screenHeight > 0;
+    }
+
     glfwSetErrorCallback(sErrorCB);
     i32 rc = glfwInit();
     ASSERT(rc);
@@ -92,6 +107,7 @@ void VulkanApp::deinitApp()
     if(sWindowApp.inited)
         glfwTerminate();
     sWindow = nullptr;
+    sWindowApp.inited = false;
 }
 
 const WindowApp& VulkanApp::getWindowApp()
@@ -111,18 +127,37 @@ GLFWwindow* VulkanApp::getWindowRef()
 
 void VulkanApp::setTitle(const char *str)
 {
+    if(VulkanInitializationParameters::get().headless)
+        return;
     ASSERT(sWindow);
     glfwSetWindowTitle(sWindow, str);
 }
 
 void VulkanApp::setWindowPosition(u32 x, u32 y)
 {
+    if(VulkanInitializationParameters::get().headless)
+        return;
     ASSERT(sWindow);
     glfwSetWindowPos(sWindow, x, y);
 }
 
 bool VulkanApp::updateApp()
 {
+    const auto &initParams = VulkanInitializationParameters::get();
+    if(initParams.headless)
+    {
+        if(initParams.headlessFrameCount > 0u && sHeadlessFrames >= initParams.headlessFrameCount)
+            return false;
+        ++sHeadlessFrames;
+
+        double headlessTime = Timer::getTimeDifferenceInNanos(
+            sHeadlessStartTime, Timer::getTime(Timer::ClockId));
+        InputApp::reset();
+        sWindowApp.frameDt = headlessTime - sWindowApp.appRuntime;
+        sWindowApp.appRuntime = headlessTime;
+        return true;
+    }
+
     double currTime = glfwGetTime();
     if(glfwWindowShouldClose(sWindow))
     {
@@ -137,6 +172,9 @@ bool VulkanApp::updateApp()
 
 void VulkanApp::frameEnd()
 {
+    // Headless is for tests and benchmarks, nothing to throttle for.
+    if(VulkanInitializationParameters::get().headless)
+        return;
     static constexpr u32 SleepDuration = 5;
     #if WIN32
         timeBeginPeriod(1);
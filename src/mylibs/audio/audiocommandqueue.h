@@ -0,0 +1,64 @@
+#pragma once
+
+#include <audio/myaudio.h>
+
+#include <atomic>
+
+enum class AudioCommandType : u32
+{
+    NoteOn,
+    NoteOff,
+    SetNote,
+};
+
+// Frame is the device frame the command happens at, frames already played apply at the start
+// of the next rendered frame.
+struct AudioCommand
+{
+    NoteFromMainToThread note;
+    u64 frame = 0u;
+    u32 noteId = ~0u;
+    AudioCommandType type = AudioCommandType::NoteOn;
+};
+
+// Wait free ring buffer from one producer thread to one consumer thread, meant for main thread
+// sending commands to the audio callback. Neither side locks or allocates.
+class AudioCommandQueue
+{
+public:
+    // Producer, returns false when the queue is full.
+    bool push(const AudioCommand &command)
+    {
+        u32 writeIndex = writePos.load(std::memory_order_relaxed);
+        if(writeIndex - readPos.load(std::memory_order_acquire) >= Capacity)
+            return false;
+        commands[writeIndex & (Capacity - 1u)] = command;
+        writePos.store(writeIndex + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer, oldest command or nullptr when empty. Stays valid until pop.
+    const AudioCommand *front() const
+    {
+        u32 readIndex = readPos.load(std::memory_order_relaxed);
+        if(readIndex == writePos.load(std::memory_order_acquire))
+            return nullptr;
+        return &commands[readIndex & (Capacity - 1u)];
+    }
+
+    // Consumer, only after front returned a command.
+    void pop()
+    {
+        readPos.store(readPos.load(std::memory_order_relaxed) + 1u, std::memory_order_release);
+    }
+
+    // Has to be power of two, indices wrap around u32.
+    static constexpr u32 Capacity = 256u;
+
+private:
+    AudioCommand commands[Capacity];
+
+    // Own cache lines, so producer and consumer do not keep invalidating each other.
+    alignas(64) std::atomic<u32> writePos {0u};
+    alignas(64) std::atomic<u32> readPos {0u};
+};
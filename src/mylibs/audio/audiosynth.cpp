@@ -0,0 +1,637 @@
+#include "audiosynth.h"
+
+#include <core/general.h>
+
+#include <math/fastmath.h>
+#include <math/simd.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+// 1 uses the polynomial sin, exp and exp2 from fastmath.h instead of libm in evaluateSound,
+// the tuning and the block synthesis in renderNotes. Off by default, builds define it to 1.
+#ifndef AUDIO_FAST_MATH
+    #define AUDIO_FAST_MATH 0
+#endif
+
+// Period of sin for wrapping phases, PI is a float and not accurate enough for long notes.
+static constexpr double TWO_PI_DOUBLE = 6.28318530717958647692;
+
+// Sine based instruments, renderNotes sums the harmonics in blocks, evaluateSound per sample.
+struct SineHarmonic
+{
+    double multiplier;
+    float amplitude;
+};
+
+struct SineInstrument
+{
+    SineHarmonic harmonics[3];
+    u32 harmonicCount;
+    // Amplitude multiplied with exp(-phaseDecay * samp).
+    double phaseDecay;
+    // Amplitude multiplied with exp(-timeDecay * time).
+    double timeDecay;
+};
+
+// Indexed with -instrument, instruments 0 to -3.
+static const SineInstrument sineInstruments[] =
+{
+    { .harmonics = { { 1.0, 1.0f } }, .harmonicCount = 1, .phaseDecay = 0.0, .timeDecay = 0.0 },
+    { .harmonics = { { 1.0, 0.6f }, { 2.0, 0.4f } }, .harmonicCount = 2, .phaseDecay = 0.0005, .timeDecay = 2.0 },
+    { .harmonics = { { 1.0, 0.5f }, { 1.25, 0.3f }, { 1.5, 0.2f } }, .harmonicCount = 3, .phaseDecay = 0.0004, .timeDecay = 6.0 },
+    // 5 / 7 was nice with 2.0
+    { .harmonics = { { 1.0, 0.5f }, { 7.0 / 13.0, 0.3f }, { 2.0, 0.2f } }, .harmonicCount = 3, .phaseDecay = 0.0004, .timeDecay = 6.0 },
+};
+
+double evaluateSound(double time, double freq, i32 instrument)
+{
+    double fqSampPoint = freq * time;
+    double samp = fqSampPoint * 2.0 * PI;
+    double t = Supa::modd(fqSampPoint, 1.0);
+
+#if AUDIO_FAST_MATH
+    // Phase wrapped in double first, the float polynomial loses precision with big arguments on long notes.
+    auto f = [](double m)
+    {
+        double wrapped = m - TWO_PI_DOUBLE * floor(m * (1.0 / TWO_PI_DOUBLE));
+        return double(Supa::fastSinf(float(wrapped)));
+    };
+    auto e = [](double m) { return double(Supa::fastExpf(float(m))); };
+#else
+    auto f = [samp](float m) { return Supa::sind(m) ;};
+    auto e = [](double m) { return Supa::expd(m); };
+#endif
+    //auto f = [samp, t](float m) { return t < 0.5 ? 0.5 : -0.5; };
+
+    switch(instrument)
+    {
+        case -3:
+        {
+            // 5 / 7 was nice with 2.0
+            double pix = f(samp * 1.0) * 0.5 + f(samp * 7.0 / 13.0) * 0.3 + f(samp * 2.0) * 0.2;
+            pix *= e(-0.0004 * samp);
+            pix += pix * pix * pix * pix * pix;
+            pix *= 1.0 + 16.0 * time * e(-6.0 * time);
+            return pix;
+        }
+        case -2:
+        {
+            double pix = f(samp * 1.0) * 0.5 + f(samp * 1.25) * 0.3 + f(samp * 1.5) * 0.2;
+            pix *= e(-0.0004 * samp);
+            pix += pix * pix * pix * pix * pix;
+            pix *= 1.0 + 16.0 * time * e(-6.0 * time);
+            return pix;
+        }
+
+        case -1:
+        {
+            //pix *= pix * pix;
+            double pix = f(samp) * 0.6;
+            pix += f(samp * 2.0) * 0.4;
+
+            pix *= e(-0.0005 * samp);
+            double pix3 = pix * pix * pix;
+            pix += pix3 + pix3 * pix * pix;
+            pix *= 0.25 + 1.0 * time * e(-2.0 * time);
+            return pix;
+            //return pix + sin(Pi * 2.0 / 3.0 + samp);
+
+        }
+        case 0:
+        {
+            double pix = f(samp * 1.0);
+            return pix;
+        }
+        case 1:
+            return t < 0.5 ? 0.5 : -0.5;
+        case 2:
+            return t - 0.5;
+        case 3:
+            t += 0.25;
+            return t < 0.5 ? -0.5 + 2.0 * t : 0.5 - 2.0 * (t - 0.5);
+        default:
+
+        break;
+
+    }
+    return double(rand()) / double(RAND_MAX) * 2.0 - 1.0;
+
+}
+
+static void sStartVoice(AudioVoice &voice, const AudioCommand &command, u64 frame, u32 sampleRate)
+{
+    voice.note = command.note;
+    voice.thread = {};
+    voice.thread.startTime = double(frame) / sampleRate;
+    voice.thread.phase = NotePlayPhase::Attack;
+    voice.startFrame = frame;
+    voice.noteId = command.noteId;
+    voice.released = false;
+}
+
+static AudioVoice *sFindVoice(AudioSynth &synth, u32 noteId)
+{
+    for(AudioVoice &voice : synth.voices)
+    {
+        if(voice.noteId == noteId && voice.thread.phase != NotePlayPhase::Finished)
+            return &voice;
+    }
+    return nullptr;
+}
+
+// Free voice, otherwise the oldest released one, otherwise the oldest one.
+static AudioVoice &sGetVoiceForNewNote(AudioSynth &synth)
+{
+    AudioVoice *result = &synth.voices[0];
+    for(AudioVoice &voice : synth.voices)
+    {
+        if(voice.thread.phase == NotePlayPhase::Finished)
+            return voice;
+        if(voice.released != result->released)
+        {
+            if(voice.released)
+                result = &voice;
+        }
+        else if(voice.startFrame < result->startFrame)
+        {
+            result = &voice;
+        }
+    }
+    return *result;
+}
+
+static void sApplyCommand(AudioSynth &synth, const AudioCommand &command, u64 frame, u32 sampleRate)
+{
+    switch(command.type)
+    {
+        case AudioCommandType::NoteOn:
+        {
+            sStartVoice(sGetVoiceForNewNote(synth), command, frame, sampleRate);
+            break;
+        }
+        case AudioCommandType::NoteOff:
+        {
+            if(AudioVoice *voice = sFindVoice(synth, command.noteId))
+                voice->released = true;
+            break;
+        }
+        case AudioCommandType::SetNote:
+        {
+            if(AudioVoice *voice = sFindVoice(synth, command.noteId))
+                voice->note = command.note;
+            break;
+        }
+    }
+}
+
+// Note frequency tuned by the lfo.
+static double sGetNoteFrequency(const NoteFromMainToThread &noteMain, double timePoint)
+{
+    double value =  timePoint * noteMain.oscLFOHz; //timePoint / duration;
+    value *= double(SAMPLE_POINTS);
+    i32 iValue = int(value) % SAMPLE_POINTS;
+    i32 iValue2 = (iValue + 1) % SAMPLE_POINTS;
+    float lerping = value - iValue;
+    value = noteMain.tuning[iValue] * (1.0f - lerping) + noteMain.tuning[iValue2] * lerping;
+
+#if AUDIO_FAST_MATH
+    value = Supa::fastExp2f(float(value / 12.0));
+#else
+    value = pow(2.0, value / 12.0);
+#endif
+    return double(noteMain.freqHz) * value;
+}
+
+u32 renderNotesPerSample(AudioVoice *voices, u32 voiceCount, u64 startFrame, u32 sampleRate,
+    u32 frameCount, u32 channelCount, float *out)
+{
+    u32 finishedCount = 0u;
+
+    double dur = 1.0 / sampleRate;
+    for(u32 i = 0; i < frameCount; ++i)
+    {
+        double frameValue = 0.0;
+        double time = dur * (startFrame + i);
+        for(u32 j = 0; j < voiceCount; ++j)
+        {
+            NoteThread &noteThread = voices[j].thread;
+            if(noteThread.phase == NotePlayPhase::Finished)
+                continue;
+            const NoteFromMainToThread &noteMain = voices[j].note;
+            bool released = voices[j].released;
+
+            double tmpValue = 0.0;
+            double amplitude = 0.0;
+
+            switch(noteThread.phase)
+            {
+                // NOTE: The fall through is on purpose, so if there is no decrease time or something.
+
+                case NotePlayPhase::Attack:
+                {
+                    float attackTimePos = noteThread.runningTime;
+                    if(attackTimePos < noteMain.attackDuration)
+                    {
+                        float attackPos = attackTimePos / noteMain.attackDuration;
+                        amplitude = attackPos * noteMain.attackAmplitude;
+
+                        break;
+                    }
+                    noteThread.phase = NotePlayPhase::Decay;
+                }
+                case NotePlayPhase::Decay:
+                {
+                    float decayTimePos = noteThread.runningTime - noteMain.attackDuration;
+                    if(decayTimePos < noteMain.decayDuration)
+                    {
+                        float decayPos = decayTimePos / noteMain.decayDuration;
+                        amplitude = decayPos * noteMain.sustainAmplitude + (1.0f - decayPos) * noteMain.attackAmplitude;
+                        break;
+                    }
+                    noteThread.phase = NotePlayPhase::Sustain;
+                }
+                case NotePlayPhase::Sustain:
+                {
+                    if(!released && noteMain.sustainAmplitude > 0.0f)
+                    {
+                        amplitude = noteMain.sustainAmplitude;
+                        break;
+                    }
+                    noteThread.phase = NotePlayPhase::Release;
+                    noteThread.releaseStart = Supa::minf(noteThread.runningTime, noteThread.releaseStart);
+
+                }
+                case NotePlayPhase::Release:
+                {
+                    float releaseTimePos = noteThread.runningTime - noteThread.releaseStart;
+                    if(releaseTimePos < noteMain.releaseDuration && noteMain.sustainAmplitude > 0.0f)
+                    {
+                        float releasePos = releaseTimePos / noteMain.releaseDuration;
+                        amplitude = exp(-8.0 * releasePos / noteMain.releaseDuration) * noteMain.sustainAmplitude;
+                        //amplitude = (1.0f - releasePos) * noteMain.sustainAmplitude;
+                        break;
+                    }
+                    noteThread.phase = NotePlayPhase::Finished;
+                    ++finishedCount;
+                }
+                default:
+                    break;
+            }
+
+            if(noteThread.phase != NotePlayPhase::Finished)
+            {
+                double timePoint = time - noteThread.startTime;
+                tmpValue = evaluateSound(timePoint, sGetNoteFrequency(noteMain, timePoint), noteMain.oscType);
+            }
+            frameValue += tmpValue * amplitude;
+
+            switch(noteThread.phase)
+            {
+                case NotePlayPhase::Attack:
+                case NotePlayPhase::Decay:
+                case NotePlayPhase::Release:
+                    noteThread.runningTime += dur;
+                    break;
+                default:
+                    break;
+            }
+        }
+        frameValue = Supa::clampd(-1.0, 1.0, frameValue);
+        for(u32 j = 0; j < channelCount; ++j)
+            out[i * channelCount + j] = frameValue;
+    }
+    return finishedCount;
+}
+
+// Per note scratch arrays for one block.
+struct NoteBlock
+{
+    alignas(16) float amplitudes[AUDIO_BLOCK_FRAMES];
+    alignas(16) float values[AUDIO_BLOCK_FRAMES];
+    alignas(16) float phases[AUDIO_BLOCK_FRAMES];
+    alignas(16) float phaseDecays[AUDIO_BLOCK_FRAMES];
+    alignas(16) float timeDecays[AUDIO_BLOCK_FRAMES];
+    alignas(16) float times[AUDIO_BLOCK_FRAMES];
+    double timePoints[AUDIO_BLOCK_FRAMES];
+    double freqs[AUDIO_BLOCK_FRAMES];
+    double samps[AUDIO_BLOCK_FRAMES];
+};
+
+// Frames until pos reaches end when advancing by step, at least one.
+static u32 sGetFramesUntil(float pos, float end, float step)
+{
+    float frames = ceilf((end - pos) / step);
+    if(frames < 1.0f)
+        return 1u;
+    return frames < float(AUDIO_BLOCK_FRAMES) ? u32(frames) : AUDIO_BLOCK_FRAMES;
+}
+
+static void sFillRamp(float start, float step, u32 count, float *out)
+{
+    for(u32 i = 0; i < count; ++i)
+        out[i] = start + float(i) * step;
+}
+
+static void sFillGeometric(float start, float ratio, u32 count, float *out)
+{
+    for(u32 i = 0; i < count; ++i)
+    {
+        out[i] = start;
+        start *= ratio;
+    }
+}
+
+// Same phases as in renderNotesPerSample, but every phase fills its frames in block as a ramp.
+// Returns false when the note finished, rest of the amplitudes are zero.
+static bool sFillEnvelope(NoteThread &noteThread, const NoteFromMainToThread &noteMain, bool released,
+    float dur, u32 count, float *amplitudes)
+{
+    u32 i = 0;
+    while(i < count)
+    {
+        u32 frames = count - i;
+        switch(noteThread.phase)
+        {
+            // NOTE: The fall through is on purpose, same as per sample version.
+
+            case NotePlayPhase::Attack:
+            {
+                if(noteThread.runningTime < noteMain.attackDuration)
+                {
+                    frames = Supa::minu32(frames,
+                        sGetFramesUntil(noteThread.runningTime, noteMain.attackDuration, dur));
+                    float step = noteMain.attackAmplitude / noteMain.attackDuration;
+                    sFillRamp(noteThread.runningTime * step, dur * step, frames, amplitudes + i);
+                    noteThread.runningTime += float(frames) * dur;
+                    break;
+                }
+                noteThread.phase = NotePlayPhase::Decay;
+            }
+            [[fallthrough]];
+            case NotePlayPhase::Decay:
+            {
+                float decayTimePos = noteThread.runningTime - noteMain.attackDuration;
+                if(decayTimePos < noteMain.decayDuration)
+                {
+                    frames = Supa::minu32(frames, sGetFramesUntil(decayTimePos, noteMain.decayDuration, dur));
+                    float step = (noteMain.sustainAmplitude - noteMain.attackAmplitude) / noteMain.decayDuration;
+                    sFillRamp(noteMain.attackAmplitude + decayTimePos * step, dur * step, frames, amplitudes + i);
+                    noteThread.runningTime += float(frames) * dur;
+                    break;
+                }
+                noteThread.phase = NotePlayPhase::Sustain;
+            }
+            [[fallthrough]];
+            case NotePlayPhase::Sustain:
+            {
+                if(!released && noteMain.sustainAmplitude > 0.0f)
+                {
+                    sFillRamp(noteMain.sustainAmplitude, 0.0f, frames, amplitudes + i);
+                    break;
+                }
+                noteThread.phase = NotePlayPhase::Release;
+                noteThread.releaseStart = Supa::minf(noteThread.runningTime, noteThread.releaseStart);
+            }
+            [[fallthrough]];
+            case NotePlayPhase::Release:
+            {
+                float releaseTimePos = noteThread.runningTime - noteThread.releaseStart;
+                if(releaseTimePos < noteMain.releaseDuration && noteMain.sustainAmplitude > 0.0f)
+                {
+                    frames = Supa::minu32(frames, sGetFramesUntil(releaseTimePos, noteMain.releaseDuration, dur));
+                    // exp(-8 * pos / duration^2) is multiplied with same ratio every frame.
+                    double decay = -8.0 / (double(noteMain.releaseDuration) * noteMain.releaseDuration);
+                    float start = exp(decay * releaseTimePos) * noteMain.sustainAmplitude;
+                    sFillGeometric(start, exp(decay * dur), frames, amplitudes + i);
+                    noteThread.runningTime += float(frames) * dur;
+                    break;
+                }
+                noteThread.phase = NotePlayPhase::Finished;
+            }
+            [[fallthrough]];
+            default:
+            {
+                sFillRamp(0.0f, 0.0f, frames, amplitudes + i);
+                return false;
+            }
+        }
+        i += frames;
+    }
+    return true;
+}
+
+// values += amplitude * sin(phases)
+static void sAddSinBlock(const float *phases, float amplitude, u32 count, float *values)
+{
+    u32 i = 0;
+#if AUDIO_FAST_MATH
+    #if MATH_SIMD
+    SimdFloat4 amplitude4 = simdSplat(amplitude);
+    for(; i + 4 <= count; i += 4)
+    {
+        SimdFloat4 value = simdMul(simdFastSin(simdLoad(phases + i)), amplitude4);
+        simdStore(values + i, simdAdd(simdLoad(values + i), value));
+    }
+    #endif
+    for(; i < count; ++i)
+        values[i] += Supa::fastSinf(phases[i]) * amplitude;
+#else
+    for(; i < count; ++i)
+        values[i] += Supa::sinf(phases[i]) * amplitude;
+#endif
+}
+
+// values = exp(values)
+static void sExpBlock(u32 count, float *values)
+{
+    u32 i = 0;
+#if AUDIO_FAST_MATH
+    #if MATH_SIMD
+    for(; i + 4 <= count; i += 4)
+        simdStore(values + i, simdFastExp(simdLoad(values + i)));
+    #endif
+    for(; i < count; ++i)
+        values[i] = Supa::fastExpf(values[i]);
+#else
+    for(; i < count; ++i)
+        values[i] = Supa::expf(values[i]);
+#endif
+}
+
+static void sRenderSineInstrument(const SineInstrument &instrument, i32 instrumentIndex, u32 count,
+    NoteBlock &block)
+{
+    for(u32 i = 0; i < count; ++i)
+        block.values[i] = 0.0f;
+
+    for(u32 h = 0; h < instrument.harmonicCount; ++h)
+    {
+        const SineHarmonic &harmonic = instrument.harmonics[h];
+        for(u32 i = 0; i < count; ++i)
+        {
+            double samp = block.samps[i] * harmonic.multiplier;
+            // Time is never negative, truncating is same as floor and does not call libm.
+            block.phases[i] = float(samp - TWO_PI_DOUBLE * double(i64(samp * (1.0 / TWO_PI_DOUBLE))));
+        }
+        sAddSinBlock(block.phases, harmonic.amplitude, count, block.values);
+    }
+    if(instrument.phaseDecay == 0.0)
+        return;
+
+    for(u32 i = 0; i < count; ++i)
+    {
+        block.phaseDecays[i] = float(-instrument.phaseDecay * block.samps[i]);
+        block.timeDecays[i] = float(-instrument.timeDecay) * block.times[i];
+    }
+    sExpBlock(count, block.phaseDecays);
+    sExpBlock(count, block.timeDecays);
+
+    if(instrumentIndex == -1)
+    {
+        for(u32 i = 0; i < count; ++i)
+        {
+            float pix = block.values[i] * block.phaseDecays[i];
+            float pix3 = pix * pix * pix;
+            pix += pix3 + pix3 * pix * pix;
+            block.values[i] = pix * (0.25f + block.times[i] * block.timeDecays[i]);
+        }
+    }
+    else
+    {
+        for(u32 i = 0; i < count; ++i)
+        {
+            float pix = block.values[i] * block.phaseDecays[i];
+            pix += pix * pix * pix * pix * pix;
+            block.values[i] = pix * (1.0f + 16.0f * block.times[i] * block.timeDecays[i]);
+        }
+    }
+}
+
+static void sRenderNoteOscillator(const NoteThread &noteThread, const NoteFromMainToThread &noteMain,
+    u64 startFrame, double dur, u32 count, NoteBlock &block)
+{
+    bool hasTuning = false;
+    for(u32 i = 0; i < SAMPLE_POINTS; ++i)
+        hasTuning |= noteMain.tuning[i] != 0;
+
+    for(u32 i = 0; i < count; ++i)
+    {
+        // Same time point as per sample version, to keep the phase of long notes identical.
+        double timePoint = dur * (startFrame + i) - noteThread.startTime;
+        block.timePoints[i] = timePoint;
+        block.freqs[i] = hasTuning ? sGetNoteFrequency(noteMain, timePoint) : double(noteMain.freqHz);
+        block.samps[i] = block.freqs[i] * timePoint * 2.0 * PI;
+        block.times[i] = float(timePoint);
+    }
+
+    i32 instrument = noteMain.oscType;
+    if(instrument <= 0 && instrument > -i32(ARRAYSIZES(sineInstruments)))
+    {
+        sRenderSineInstrument(sineInstruments[-instrument], instrument, count, block);
+        return;
+    }
+
+    // Same as evaluateSound, t is the position within the wave cycle.
+    switch(instrument)
+    {
+        case 1:
+        case 2:
+        case 3:
+        {
+            for(u32 i = 0; i < count; ++i)
+            {
+                double fqSampPoint = block.freqs[i] * block.timePoints[i];
+                double t = fqSampPoint - double(i64(fqSampPoint));
+                if(instrument == 1)
+                    block.values[i] = t < 0.5 ? 0.5f : -0.5f;
+                else if(instrument == 2)
+                    block.values[i] = float(t - 0.5);
+                else
+                {
+                    t += 0.25;
+                    block.values[i] = float(t < 0.5 ? -0.5 + 2.0 * t : 0.5 - 2.0 * (t - 0.5));
+                }
+            }
+            break;
+        }
+        default:
+        {
+            for(u32 i = 0; i < count; ++i)
+                block.values[i] = float(evaluateSound(block.timePoints[i], block.freqs[i], instrument));
+            break;
+        }
+    }
+}
+
+u32 renderNotes(AudioVoice *voices, u32 voiceCount, u64 startFrame, u32 sampleRate,
+    u32 frameCount, u32 channelCount, float *out)
+{
+    u32 finishedCount = 0u;
+
+    double dur = 1.0 / sampleRate;
+
+    NoteBlock block;
+    alignas(16) float mix[AUDIO_BLOCK_FRAMES];
+    for(u32 blockStart = 0; blockStart < frameCount; blockStart += AUDIO_BLOCK_FRAMES)
+    {
+        u32 count = Supa::minu32(frameCount - blockStart, AUDIO_BLOCK_FRAMES);
+        u64 blockFrame = startFrame + blockStart;
+        for(u32 i = 0; i < count; ++i)
+            mix[i] = 0.0f;
+
+        for(u32 j = 0; j < voiceCount; ++j)
+        {
+            NoteThread &noteThread = voices[j].thread;
+            if(noteThread.phase == NotePlayPhase::Finished)
+                continue;
+            const NoteFromMainToThread &noteMain = voices[j].note;
+
+            if(!sFillEnvelope(noteThread, noteMain, voices[j].released, float(dur), count, block.amplitudes))
+                ++finishedCount;
+            sRenderNoteOscillator(noteThread, noteMain, blockFrame, dur, count, block);
+
+            for(u32 i = 0; i < count; ++i)
+                mix[i] += block.values[i] * block.amplitudes[i];
+        }
+
+        for(u32 i = 0; i < count; ++i)
+        {
+            float frameValue = Supa::clampf(-1.0f, 1.0f, mix[i]);
+            for(u32 j = 0; j < channelCount; ++j)
+                out[(blockStart + i) * channelCount + j] = frameValue;
+        }
+    }
+    return finishedCount;
+}
+
+u32 renderAudio(AudioSynth &synth, AudioCommandQueue &queue, u32 sampleRate, u32 frameCount,
+    u32 channelCount, float *out)
+{
+    u32 framesDone = 0u;
+    while(framesDone < frameCount)
+    {
+        u64 frame = synth.frame + framesDone;
+        const AudioCommand *command = queue.front();
+        while(command && command->frame <= frame)
+        {
+            sApplyCommand(synth, *command, frame, sampleRate);
+            queue.pop();
+            command = queue.front();
+        }
+
+        // Render until the next command, or rest of the frames.
+        u32 count = frameCount - framesDone;
+        if(command && command->frame - frame < count)
+            count = u32(command->frame - frame);
+        renderNotes(synth.voices, AUDIO_VOICE_COUNT, frame, sampleRate, count, channelCount,
+            out + framesDone * channelCount);
+        framesDone += count;
+    }
+    synth.frame += frameCount;
+
+    u32 playingCount = 0u;
+    for(const AudioVoice &voice : synth.voices)
+        playingCount += voice.thread.phase != NotePlayPhase::Finished ? 1u : 0u;
+    return playingCount;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <audio/audiocommandqueue.h>
+#include <audio/myaudio.h>
+
+// Frames processed at a time per note, buffers bigger than this get split.
+static constexpr u32 AUDIO_BLOCK_FRAMES = 256;
+
+// Voices playing at once, note on with every voice busy steals the oldest one.
+static constexpr u32 AUDIO_VOICE_COUNT = 64;
+
+// Voice is free when its phase is finished.
+struct AudioVoice
+{
+    NoteFromMainToThread note;
+    NoteThread thread;
+    // Frame the voice started at, released and then oldest voices get stolen first.
+    u64 startFrame = 0u;
+    u32 noteId = ~0u;
+    bool released = false;
+};
+
+// Audio thread side state, only touched by the thread rendering.
+struct AudioSynth
+{
+    AudioVoice voices[AUDIO_VOICE_COUNT];
+    // Next frame to render.
+    u64 frame = 0u;
+};
+
+// Renders frameCount frames from synth.frame and advances it. Commands in the queue are
+// applied at their frames, the rendering gets split at them so notes start and release
+// on the exact frame. Commands are expected in frame order, a command waiting for its frame
+// keeps the ones after it waiting too.
+// Returns the amount of voices still playing.
+u32 renderAudio(AudioSynth &synth, AudioCommandQueue &queue, u32 sampleRate, u32 frameCount,
+    u32 channelCount, float *out);
+
+// Synthesizes frameCount interleaved frames of all playing voices into out, channels get the same value.
+// Returns the amount of voices that finished during the frames.
+//
+// Envelopes are filled per note as ramps for whole block, oscillators go through the 4 wide
+// fast math functions over the block and are then mixed.
+u32 renderNotes(AudioVoice *voices, u32 voiceCount, u64 startFrame, u32 sampleRate,
+    u32 frameCount, u32 channelCount, float *out);
+
+// Reference, evaluates envelope and evaluateSound for every note on every frame.
+u32 renderNotesPerSample(AudioVoice *voices, u32 voiceCount, u64 startFrame, u32 sampleRate,
+    u32 frameCount, u32 channelCount, float *out);
@@ -43,19 +43,33 @@ struct NoteThread
     NotePlayPhase phase = NotePlayPhase::Finished;
 };
 
-bool initAudio();
+// Time spent synthesizing in the device callback.
+struct AudioCallbackStats
+{
+    u64 callbackCount = 0;
+    u64 frameCount = 0;
+    double totalSeconds = 0.0;
+    double maxSeconds = 0.0;
+};
+
+bool initAudio(bool useNullBackend = false);
 void deinitAudio();
 
+AudioCallbackStats getAudioCallbackStats();
+void resetAudioCallbackStats();
+
 double evaluateSound(double time, double freq, i32 instrument);
 
-AtomicType getRunningNotes();
-AtomicType getReleasedNotes();
-
-//Note fix these
-//void checkNotes(AtomicType channel, AtomicType running, AtomicType released, AtomicType &keysUp, double time);
-void releaseChannel(AtomicType channelToRelease);
-AtomicType addNote(float playFreqHz, const NoteFromMainToThread &currentNote);
-/*
-void addNotes(AtomicType channel, AtomicType running, AtomicType released, AtomicType &keysDown,
-    double time, float baseHz, const NoteFromMainToThread &currentNote);
-*/
\ No newline at end of file
+// Notes are sent to the audio thread through a command queue, ids returned by addNote refer to them.
+// Frame is the device frame the change happens at, 0 or any frame already played means as soon as possible.
+// Returns ~0u when the command queue is full.
+u32 addNote(float playFreqHz, const NoteFromMainToThread &currentNote, u64 frame = 0u);
+// Starts the release of the note, does nothing if it has already finished.
+// Returns false when the command queue is full, the note keeps playing until released.
+bool releaseNote(u32 noteId, u64 frame = 0u);
+// Changes the parameters of a playing note, including the frequency.
+bool setNoteParameters(u32 noteId, const NoteFromMainToThread &note, u64 frame = 0u);
+
+// Frames the audio thread has rendered, for scheduling commands ahead of time.
+u64 getAudioFrame();
+u32 getPlayingNoteCount();
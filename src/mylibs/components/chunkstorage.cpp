@@ -0,0 +1,231 @@
+#include "chunkstorage.h"
+
+#include <core/assert.h>
+#include <core/general.h>
+
+#include <bit>
+
+static u32 sAlignColumn(u32 offset)
+{
+    return (offset + ChunkStorage::ColumnAlignment - 1) & ~(ChunkStorage::ColumnAlignment - 1);
+}
+
+ChunkStorage::ChunkStorage(const u32* sizes, u32 count)
+{
+    ASSERT(count <= MaxComponentCount);
+    componentCount = Supa::minu32(count, MaxComponentCount);
+    for(u32 i = 0; i < componentCount; ++i)
+        componentSizes[i] = sizes[i];
+}
+
+ChunkStorage::~ChunkStorage()
+{
+    for(Archetype &archetype : archetypes)
+    {
+        for(Chunk *chunk : archetype.chunks)
+            delete chunk;
+    }
+}
+
+u32 ChunkStorage::getArchetypeIndex(u64 componentMask)
+{
+    for(u32 i = 0; i < archetypes.size(); ++i)
+    {
+        if(archetypes[i].componentMask == componentMask)
+            return i;
+    }
+
+    Archetype archetype;
+    archetype.componentMask = componentMask;
+
+    // Entity index column + one column per component, every column start aligned.
+    u32 columnCount = 1 + u32(std::popcount(componentMask));
+    u32 rowByteSize = sizeof(u32);
+    for(u32 i = 0; i < componentCount; ++i)
+    {
+        if((componentMask >> i) & 1)
+            rowByteSize += componentSizes[i];
+    }
+    archetype.entitiesPerChunk = (ChunkByteSize - columnCount * ColumnAlignment) / rowByteSize;
+    ASSERT(archetype.entitiesPerChunk > 0);
+
+    u32 offset = sAlignColumn(archetype.entitiesPerChunk * sizeof(u32));
+    for(u32 i = 0; i < MaxComponentCount; ++i)
+    {
+        archetype.columnOffsets[i] = ~0u;
+        if(i >= componentCount || ((componentMask >> i) & 1) == 0)
+            continue;
+        archetype.columnOffsets[i] = offset;
+        offset = sAlignColumn(offset + archetype.entitiesPerChunk * componentSizes[i]);
+    }
+    ASSERT(offset <= ChunkByteSize);
+
+    archetypes.emplace_back(archetype);
+    return archetypes.size() - 1;
+}
+
+u8* ChunkStorage::getRowComponent(u32 archetypeIndex, u32 archetypeRow, u32 componentIndex)
+{
+    Archetype &archetype = archetypes[archetypeIndex];
+    u32 chunkIndex = archetypeRow / archetype.entitiesPerChunk;
+    u32 chunkRow = archetypeRow % archetype.entitiesPerChunk;
+    return archetype.chunks[chunkIndex]->bytes + archetype.columnOffsets[componentIndex]
+        + chunkRow * componentSizes[componentIndex];
+}
+
+u32 ChunkStorage::pushRow(u32 archetypeIndex, u32 entityIndex)
+{
+    Archetype &archetype = archetypes[archetypeIndex];
+    u32 row = archetype.entityCount;
+    u32 chunkIndex = row / archetype.entitiesPerChunk;
+    if(chunkIndex >= archetype.chunks.size())
+        archetype.chunks.emplace_back(new Chunk);
+
+    u32 *entityIndices = (u32 *)archetype.chunks[chunkIndex]->bytes;
+    entityIndices[row % archetype.entitiesPerChunk] = entityIndex;
+    ++archetype.entityCount;
+    return row;
+}
+
+void ChunkStorage::removeRow(u32 archetypeIndex, u32 archetypeRow)
+{
+    Archetype &archetype = archetypes[archetypeIndex];
+    ASSERT(archetypeRow < archetype.entityCount);
+
+    u32 lastRow = archetype.entityCount - 1;
+    if(archetypeRow != lastRow)
+    {
+        for(u32 i = 0; i < componentCount; ++i)
+        {
+            if(archetype.columnOffsets[i] == ~0u)
+                continue;
+            Supa::memcpy(getRowComponent(archetypeIndex, archetypeRow, i),
+                getRowComponent(archetypeIndex, lastRow, i), componentSizes[i]);
+        }
+        u32 *entityIndices = (u32 *)archetype.chunks[archetypeRow / archetype.entitiesPerChunk]->bytes;
+        const u32 *lastEntityIndices = (const u32 *)archetype.chunks[lastRow / archetype.entitiesPerChunk]->bytes;
+        u32 movedEntity = lastEntityIndices[lastRow % archetype.entitiesPerChunk];
+        entityIndices[archetypeRow % archetype.entitiesPerChunk] = movedEntity;
+        entityLocations[movedEntity].archetypeRow = archetypeRow;
+    }
+    --archetype.entityCount;
+}
+
+void ChunkStorage::addEntity(u32 entityIndex)
+{
+    if(entityIndex >= entityLocations.size())
+        entityLocations.resize(entityIndex + 1);
+    ASSERT(entityLocations[entityIndex].archetypeIndex == ~0u);
+
+    u32 archetypeIndex = getArchetypeIndex(0);
+    entityLocations[entityIndex] = EntityLocation{
+        .archetypeIndex = archetypeIndex,
+        .archetypeRow = pushRow(archetypeIndex, entityIndex) };
+}
+
+void ChunkStorage::removeEntity(u32 entityIndex)
+{
+    ASSERT(entityIndex < entityLocations.size());
+    if(entityIndex >= entityLocations.size() || entityLocations[entityIndex].archetypeIndex == ~0u)
+        return;
+
+    EntityLocation location = entityLocations[entityIndex];
+    removeRow(location.archetypeIndex, location.archetypeRow);
+    entityLocations[entityIndex] = EntityLocation{};
+}
+
+bool ChunkStorage::hasEntity(u32 entityIndex) const
+{
+    return entityIndex < entityLocations.size() && entityLocations[entityIndex].archetypeIndex != ~0u;
+}
+
+void ChunkStorage::setComponentMask(u32 entityIndex, u64 componentMask)
+{
+    ASSERT(entityIndex < entityLocations.size() && entityLocations[entityIndex].archetypeIndex != ~0u);
+    if(entityIndex >= entityLocations.size() || entityLocations[entityIndex].archetypeIndex == ~0u)
+        return;
+
+    EntityLocation oldLocation = entityLocations[entityIndex];
+    u64 oldMask = archetypes[oldLocation.archetypeIndex].componentMask;
+    if(oldMask == componentMask)
+        return;
+
+    u32 newArchetypeIndex = getArchetypeIndex(componentMask);
+    u32 newRow = pushRow(newArchetypeIndex, entityIndex);
+    for(u32 i = 0; i < componentCount; ++i)
+    {
+        if(((componentMask >> i) & 1) == 0)
+            continue;
+        u8 *dst = getRowComponent(newArchetypeIndex, newRow, i);
+        if((oldMask >> i) & 1)
+            Supa::memcpy(dst, getRowComponent(oldLocation.archetypeIndex, oldLocation.archetypeRow, i), componentSizes[i]);
+        else
+            Supa::memset(dst, 0, componentSizes[i]);
+    }
+    removeRow(oldLocation.archetypeIndex, oldLocation.archetypeRow);
+    entityLocations[entityIndex] = EntityLocation{ .archetypeIndex = newArchetypeIndex, .archetypeRow = newRow };
+}
+
+u64 ChunkStorage::getComponentMask(u32 entityIndex) const
+{
+    if(entityIndex >= entityLocations.size() || entityLocations[entityIndex].archetypeIndex == ~0u)
+        return 0;
+    return archetypes[entityLocations[entityIndex].archetypeIndex].componentMask;
+}
+
+void* ChunkStorage::getComponent(u32 entityIndex, u32 componentIndex)
+{
+    if(entityIndex >= entityLocations.size() || componentIndex >= componentCount)
+        return nullptr;
+    const EntityLocation &location = entityLocations[entityIndex];
+    if(location.archetypeIndex == ~0u || archetypes[location.archetypeIndex].columnOffsets[componentIndex] == ~0u)
+        return nullptr;
+    return getRowComponent(location.archetypeIndex, location.archetypeRow, componentIndex);
+}
+
+const void* ChunkStorage::getComponent(u32 entityIndex, u32 componentIndex) const
+{
+    return const_cast<ChunkStorage *>(this)->getComponent(entityIndex, componentIndex);
+}
+
+bool ChunkStorage::findNextChunk(u64 componentMask, u32 &inOutArchetypeIndex, u32 &inOutChunkIndex,
+    u32 &outEntityCount) const
+{
+    while(inOutArchetypeIndex < archetypes.size())
+    {
+        const Archetype &archetype = archetypes[inOutArchetypeIndex];
+        if((archetype.componentMask & componentMask) == componentMask)
+        {
+            u32 firstRow = inOutChunkIndex * archetype.entitiesPerChunk;
+            if(firstRow < archetype.entityCount)
+            {
+                outEntityCount = Supa::minu32(archetype.entitiesPerChunk, archetype.entityCount - firstRow);
+                return true;
+            }
+        }
+        ++inOutArchetypeIndex;
+        inOutChunkIndex = 0;
+    }
+    return false;
+}
+
+void* ChunkStorage::getColumn(u32 archetypeIndex, u32 chunkIndex, u32 componentIndex)
+{
+    const Archetype &archetype = archetypes[archetypeIndex];
+    if(componentIndex >= componentCount || archetype.columnOffsets[componentIndex] == ~0u)
+        return nullptr;
+    return archetype.chunks[chunkIndex]->bytes + archetype.columnOffsets[componentIndex];
+}
+
+const u32* ChunkStorage::getEntityIndices(u32 archetypeIndex, u32 chunkIndex) const
+{
+    return (const u32 *)archetypes[archetypeIndex].chunks[chunkIndex]->bytes;
+}
+
+u32 ChunkStorage::getAllocatedChunkCount() const
+{
+    u32 result = 0;
+    for(const Archetype &archetype : archetypes)
+        result += archetype.chunks.size();
+    return result;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <core/mytypes.h>
+
+#include <vector>
+
+// Component storage for generated entity systems using Chunks storage mode. Entities with
+// the same component mask belong to one archetype and are packed into fixed size chunks,
+// each chunk has a column of entity indices and a tightly packed column per component.
+// Changing the mask moves the entity into another archetype. Removing moves the last entity
+// of the archetype into the hole, so only the last chunk of an archetype is partially filled.
+// Components are copied with memcpy, they have to be trivially copyable.
+class ChunkStorage
+{
+public:
+    static constexpr u32 ChunkByteSize = 16u * 1024u;
+    static constexpr u32 ColumnAlignment = 16u;
+    static constexpr u32 MaxComponentCount = 64u;
+
+    ChunkStorage(const u32* componentSizes, u32 componentCount);
+    ~ChunkStorage();
+
+    ChunkStorage(const ChunkStorage &) = delete;
+    ChunkStorage &operator=(const ChunkStorage &) = delete;
+
+    // New entity has no components.
+    void addEntity(u32 entityIndex);
+    void removeEntity(u32 entityIndex);
+    bool hasEntity(u32 entityIndex) const;
+
+    // Components in both masks keep their values, added ones get zeroed.
+    void setComponentMask(u32 entityIndex, u64 componentMask);
+    u64 getComponentMask(u32 entityIndex) const;
+
+    // nullptr if entity does not have the component.
+    void* getComponent(u32 entityIndex, u32 componentIndex);
+    const void* getComponent(u32 entityIndex, u32 componentIndex) const;
+
+    // Finds next chunk with entities, starting from the given archetype and chunk, whose
+    // archetype has every component of componentMask. Caller moves inOutChunkIndex forward after use.
+    bool findNextChunk(u64 componentMask, u32 &inOutArchetypeIndex, u32 &inOutChunkIndex,
+        u32 &outEntityCount) const;
+    void* getColumn(u32 archetypeIndex, u32 chunkIndex, u32 componentIndex);
+    const u32* getEntityIndices(u32 archetypeIndex, u32 chunkIndex) const;
+
+    u32 getArchetypeCount() const { return (u32)archetypes.size(); }
+    u32 getAllocatedChunkCount() const;
+
+private:
+    struct alignas(64) Chunk
+    {
+        u8 bytes[ChunkByteSize];
+    };
+
+    struct Archetype
+    {
+        u64 componentMask = 0;
+        u32 entitiesPerChunk = 0;
+        u32 entityCount = 0;
+        // Byte offset of each column inside a chunk, ~0u when component is not in archetype.
+        u32 columnOffsets[MaxComponentCount];
+        // Chunks are kept allocated when archetype shrinks.
+        std::vector<Chunk*> chunks;
+    };
+
+    struct EntityLocation
+    {
+        u32 archetypeIndex = ~0u;
+        u32 archetypeRow = ~0u;
+    };
+
+    u32 getArchetypeIndex(u64 componentMask);
+    // Adds row to the end of archetype, returns the row.
+    u32 pushRow(u32 archetypeIndex, u32 entityIndex);
+    void removeRow(u32 archetypeIndex, u32 archetypeRow);
+    u8* getRowComponent(u32 archetypeIndex, u32 archetypeRow, u32 componentIndex);
+
+    std::vector<Archetype> archetypes;
+    std::vector<EntityLocation> entityLocations;
+    u32 componentSizes[MaxComponentCount] = {};
+    u32 componentCount = 0;
+};
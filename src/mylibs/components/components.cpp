@@ -8,6 +8,8 @@
 
 #include <imgui.h>
 
+#include <bit>
+
 
 bool serializeField(WriteJson &writeJson,
     const char* const fieldName,
@@ -589,3 +591,79 @@ void imguiPrintField(const char* fieldName,
     }
     ImGui::PopID();
 }
+
+bool findNextEntityBatch(const u64* entityComponents, const u64* aliveEntityBits, u32 entityCount,
+    u64 componentMask, u32 maxBatchCount, u32 &inOutIndex, u32 &outStartIndex, u32 &outCount)
+{
+    u32 index = inOutIndex;
+    while(index < entityCount)
+    {
+        u64 aliveBits = aliveEntityBits[index / 64] >> (index % 64);
+        if(aliveBits == 0)
+        {
+            index = (index / 64 + 1) * 64;
+            continue;
+        }
+        index += u32(std::countr_zero(aliveBits));
+        if(index < entityCount && (entityComponents[index] & componentMask) == componentMask)
+            break;
+        ++index;
+    }
+    if(index >= entityCount || maxBatchCount == 0)
+    {
+        inOutIndex = entityCount;
+        return false;
+    }
+
+    u32 endIndex = index + 1;
+    u32 lastIndex = maxBatchCount < entityCount - index ? index + maxBatchCount : entityCount;
+    while(endIndex < lastIndex
+        && ((aliveEntityBits[endIndex / 64] >> (endIndex % 64)) & 1) == 1
+        && (entityComponents[endIndex] & componentMask) == componentMask)
+    {
+        ++endIndex;
+    }
+
+    inOutIndex = endIndex;
+    outStartIndex = index;
+    outCount = endIndex - index;
+    return true;
+}
+
+void setBitRange(u64* bits, u32 startIndex, u32 count)
+{
+    u32 endIndex = startIndex + count;
+    while(startIndex < endIndex)
+    {
+        u32 bit = startIndex % 64;
+        u32 bitCount = Supa::minu32(64 - bit, endIndex - startIndex);
+        u64 mask = bitCount == 64 ? ~u64(0) : ((u64(1) << bitCount) - 1) << bit;
+        bits[startIndex / 64] |= mask;
+        startIndex += bitCount;
+    }
+}
+
+void writeBinaryBytes(ByteBuffer &buffer, const void* data, u64 byteSize)
+{
+    ASSERT(buffer.getDataSize() == 1);
+    u64 oldSize = buffer.getSize();
+    ASSERT(oldSize + byteSize < u64(~0u));
+    if(byteSize == 0 || buffer.getDataSize() != 1 || oldSize + byteSize >= u64(~0u))
+        return;
+
+    buffer.resize(u32(oldSize + byteSize));
+    if(data)
+        Supa::memcpy(buffer.getBegin() + oldSize, data, byteSize);
+    else
+        Supa::memset(buffer.getBegin() + oldSize, 0, byteSize);
+}
+
+const u8* readBinaryBytes(const ByteBuffer &buffer, u32 &inOutReadOffset, u64 byteSize)
+{
+    if(buffer.getDataSize() != 1 || u64(inOutReadOffset) + byteSize > buffer.getSize())
+        return nullptr;
+
+    const u8* result = buffer.getBegin() + inOutReadOffset;
+    inOutReadOffset += u32(byteSize);
+    return result;
+}
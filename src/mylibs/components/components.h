@@ -1,5 +1,7 @@
 #pragma once
 
+#include <container/bytebuffer.h>
+
 #include <core/json.h>
 #include <core/mytypes.h>
 #include <core/writejson.h>
@@ -35,6 +37,7 @@ enum class EntitySystemType : u16
 {
     EntitySystemTypeNone = 0,
     GameEntitySystemType,
+    GameChunkEntitySystemType,
 
 
 
@@ -60,6 +63,41 @@ struct EntityRWHandle
     EntitySystemType rwHandleTypeId = EntitySystemType::EntitySystemTypeCount;
 };
 
+// Used by generated entity system queries. Finds next run of consecutive alive entities,
+// starting from inOutIndex, that have every component in componentMask. aliveEntityBits
+// has one bit per entity, so 64 dead entities get skipped with one compare.
+// inOutIndex is moved past the run, returns false when no entities are left.
+bool findNextEntityBatch(const u64* entityComponents, const u64* aliveEntityBits, u32 entityCount,
+    u64 componentMask, u32 maxBatchCount, u32 &inOutIndex, u32 &outStartIndex, u32 &outCount);
+
+// Sets count bits starting from bit startIndex, bits has to be large enough.
+void setBitRange(u64* bits, u32 startIndex, u32 count);
+
+// Binary snapshot layout used by generated serializeBinary/deserializeBinary:
+// BinarySnapshotHeader, u16 entity versions, u64 entity component masks, u32 free entity indices,
+// then per component BinaryComponentHeader followed by entityCount raw components.
+struct BinarySnapshotHeader
+{
+    u32 entitySystemId = 0;
+    u32 entityVersion = 0;
+    u32 entityCount = 0;
+    u32 componentCount = 0;
+    u32 freeEntityIndexCount = 0;
+};
+
+struct BinaryComponentHeader
+{
+    u32 componentId = 0;
+    u32 componentVersion = 0;
+    u32 componentSize = 0;
+};
+
+// Buffer has to have data type size of 1. Appends zeroes if data is nullptr.
+void writeBinaryBytes(ByteBuffer &buffer, const void* data, u64 byteSize);
+// Returns pointer to byteSize bytes at inOutReadOffset and moves the offset past them,
+// nullptr if the buffer is too short.
+const u8* readBinaryBytes(const ByteBuffer &buffer, u32 &inOutReadOffset, u64 byteSize);
+
 /*
 struct EnumType
 {
@@ -0,0 +1,141 @@
+#include "entitycommandbuffer.h"
+
+#include <core/assert.h>
+#include <core/general.h>
+
+#include <algorithm>
+
+EntityCommandBuffers::ThreadBuffer &EntityCommandBuffers::getThreadBuffer(u32 &outThreadIndex,
+    std::unique_lock<std::mutex> &outLock)
+{
+    outThreadIndex = jobSystem ? jobSystem->getCurrentThreadIndex() : JobSystem::MaxWorkerCount;
+    ASSERT(outThreadIndex < ThreadBufferCount);
+    if(outThreadIndex == ThreadBufferCount - 1u)
+        outLock = std::unique_lock<std::mutex>(sharedBufferMutex);
+    return threadBuffers[outThreadIndex];
+}
+
+DeferredEntityHandle EntityCommandBuffers::addEntity(u32 sortKey)
+{
+    u32 threadIndex = 0u;
+    std::unique_lock<std::mutex> lock;
+    ThreadBuffer &buffer = getThreadBuffer(threadIndex, lock);
+    DeferredEntityHandle deferred {
+        .threadIndex = threadIndex,
+        .commandIndex = u32(buffer.commands.size()) };
+
+    // AddEntity targets itself, so applying knows where to store the created entity.
+    EntityCommand command;
+    command.target = EntityCommandTarget(deferred);
+    command.sortKey = sortKey;
+    command.commandType = EntityCommandType::AddEntity;
+    buffer.commands.emplace_back(command);
+    return deferred;
+}
+
+void EntityCommandBuffers::removeEntity(const EntityCommandTarget &target, u32 sortKey)
+{
+    u32 threadIndex = 0u;
+    std::unique_lock<std::mutex> lock;
+    ThreadBuffer &buffer = getThreadBuffer(threadIndex, lock);
+
+    EntityCommand command;
+    command.target = target;
+    command.sortKey = sortKey;
+    command.commandType = EntityCommandType::RemoveEntity;
+    buffer.commands.emplace_back(command);
+}
+
+void EntityCommandBuffers::addComponent(const EntityCommandTarget &target, u32 componentIndex,
+    const void *componentData, u32 componentSize, u32 sortKey)
+{
+    u32 threadIndex = 0u;
+    std::unique_lock<std::mutex> lock;
+    ThreadBuffer &buffer = getThreadBuffer(threadIndex, lock);
+
+    EntityCommand command;
+    command.target = target;
+    command.sortKey = sortKey;
+    command.componentIndex = componentIndex;
+    command.dataOffset = u32(buffer.data.size());
+    command.dataSize = componentSize;
+    command.commandType = EntityCommandType::AddComponent;
+    buffer.commands.emplace_back(command);
+
+    buffer.data.resize(buffer.data.size() + componentSize);
+    Supa::memcpy(buffer.data.data() + command.dataOffset, componentData, componentSize);
+}
+
+void EntityCommandBuffers::getSortedCommands(std::vector<const EntityCommand *> &outCommands) const
+{
+    outCommands.clear();
+    for(const ThreadBuffer &buffer : threadBuffers)
+    {
+        for(const EntityCommand &command : buffer.commands)
+            outCommands.emplace_back(&command);
+    }
+    std::stable_sort(outCommands.begin(), outCommands.end(),
+        [](const EntityCommand *a, const EntityCommand *b) { return a->sortKey < b->sortKey; });
+}
+
+const u8 *EntityCommandBuffers::getCommandData(const EntityCommand &command) const
+{
+    // Component data lives in the buffer of the thread that recorded it, which is the one
+    // whose commands array holds the command.
+    for(const ThreadBuffer &buffer : threadBuffers)
+    {
+        if(buffer.commands.empty())
+            continue;
+        if(&command >= buffer.commands.data() && &command < buffer.commands.data() + buffer.commands.size())
+            return buffer.data.data() + command.dataOffset;
+    }
+    return nullptr;
+}
+
+void EntityCommandBuffers::setResolvedEntity(const EntityCommand &command, EntitySystemHandle handle)
+{
+    const DeferredEntityHandle &deferred = command.target.deferred;
+    ASSERT(command.commandType == EntityCommandType::AddEntity && deferred.threadIndex < ThreadBufferCount);
+    if(command.commandType != EntityCommandType::AddEntity || deferred.threadIndex >= ThreadBufferCount)
+        return;
+
+    ThreadBuffer &buffer = threadBuffers[deferred.threadIndex];
+    if(buffer.resolvedEntities.size() < buffer.commands.size())
+        buffer.resolvedEntities.resize(buffer.commands.size());
+    buffer.resolvedEntities[deferred.commandIndex] = handle;
+}
+
+EntitySystemHandle EntityCommandBuffers::resolveTarget(const EntityCommandTarget &target) const
+{
+    const DeferredEntityHandle &deferred = target.deferred;
+    if(deferred.threadIndex == ~0u)
+        return target.handle;
+
+    // Unresolved when the AddEntity command sorted after the command using it.
+    if(deferred.threadIndex >= ThreadBufferCount ||
+        deferred.commandIndex >= threadBuffers[deferred.threadIndex].resolvedEntities.size())
+    {
+        return EntitySystemHandle();
+    }
+    return threadBuffers[deferred.threadIndex].resolvedEntities[deferred.commandIndex];
+}
+
+bool EntityCommandBuffers::hasCommands() const
+{
+    for(const ThreadBuffer &buffer : threadBuffers)
+    {
+        if(!buffer.commands.empty())
+            return true;
+    }
+    return false;
+}
+
+void EntityCommandBuffers::clear()
+{
+    for(ThreadBuffer &buffer : threadBuffers)
+    {
+        buffer.commands.clear();
+        buffer.data.clear();
+        buffer.resolvedEntities.clear();
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <components/components.h>
+#include <core/jobsystem.h>
+#include <core/mytypes.h>
+
+#include <mutex>
+#include <vector>
+
+// Entity created by a deferred command, it gets a real entity when the commands get applied.
+struct DeferredEntityHandle
+{
+    u32 threadIndex = ~0u;
+    u32 commandIndex = ~0u;
+};
+
+// Existing or deferred entity that a deferred command targets.
+struct EntityCommandTarget
+{
+    EntityCommandTarget(EntitySystemHandle entityHandle) : handle(entityHandle) {}
+    EntityCommandTarget(DeferredEntityHandle deferredHandle) : deferred(deferredHandle) {}
+
+    EntitySystemHandle handle;
+    DeferredEntityHandle deferred;
+};
+
+enum class EntityCommandType : u8
+{
+    AddEntity,
+    RemoveEntity,
+    AddComponent,
+};
+
+struct EntityCommand
+{
+    EntityCommandTarget target = EntityCommandTarget(EntitySystemHandle());
+    u32 sortKey = 0u;
+    u32 componentIndex = ~0u;
+    u32 dataOffset = 0u;
+    u32 dataSize = 0u;
+    EntityCommandType commandType = EntityCommandType::AddEntity;
+};
+
+// Commands recorded by generated entity systems from jobs. Every worker of the job system
+// given to setJobSystem records into its own buffer indexed by its getCurrentThreadIndex, so
+// recording needs no locking. Any other thread, workers of other job systems included,
+// records into the last buffer under a mutex.
+class EntityCommandBuffers
+{
+public:
+    static constexpr u32 ThreadBufferCount = JobSystem::MaxWorkerCount + 1u;
+
+    // Only change when nothing is recording.
+    void setJobSystem(const JobSystem *recordingJobSystem) { jobSystem = recordingJobSystem; }
+
+    DeferredEntityHandle addEntity(u32 sortKey);
+    void removeEntity(const EntityCommandTarget &target, u32 sortKey);
+    void addComponent(const EntityCommandTarget &target, u32 componentIndex,
+        const void *componentData, u32 componentSize, u32 sortKey);
+
+    // Commands from every thread ordered by sort key, commands with same key keep their
+    // recording order when they come from the same thread. Only call when nothing is recording.
+    void getSortedCommands(std::vector<const EntityCommand *> &outCommands) const;
+    const u8 *getCommandData(const EntityCommand &command) const;
+
+    // Entity an applied AddEntity command created, resolved handles are cleared with commands.
+    void setResolvedEntity(const EntityCommand &command, EntitySystemHandle handle);
+    EntitySystemHandle resolveTarget(const EntityCommandTarget &target) const;
+
+    bool hasCommands() const;
+    void clear();
+
+private:
+    struct alignas(64) ThreadBuffer
+    {
+        std::vector<EntityCommand> commands;
+        std::vector<u8> data;
+        std::vector<EntitySystemHandle> resolvedEntities;
+    };
+
+    // Locks outLock when current thread records into the shared last buffer.
+    ThreadBuffer &getThreadBuffer(u32 &outThreadIndex, std::unique_lock<std::mutex> &outLock);
+
+    ThreadBuffer threadBuffers[ThreadBufferCount];
+    const JobSystem *jobSystem = nullptr;
+    std::mutex sharedBufferMutex;
+};
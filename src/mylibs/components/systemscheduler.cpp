@@ -0,0 +1,264 @@
+#include "systemscheduler.h"
+
+#include <core/assert.h>
+#include <core/general.h>
+#include <core/log.h>
+
+SystemScheduler::~SystemScheduler()
+{
+    deinit();
+    for(const EntitySystemEntry &entry : entitySystems)
+        entry.setJobSystemFunc(entry.entitySystem, nullptr);
+}
+
+bool SystemScheduler::init(u32 workerCount)
+{
+    return jobSystem.init(workerCount);
+}
+
+void SystemScheduler::deinit()
+{
+    jobSystem.deinit();
+}
+
+bool SystemScheduler::addEntitySystem(EntitySystemType entitySystemType, void *entitySystem, SyncFunc syncFunc,
+    GetArraysFunc getReadArraysFunc, GetArraysFunc getWriteArraysFunc, SetJobSystemFunc setJobSystemFunc)
+{
+    for(const EntitySystemEntry &entry : entitySystems)
+    {
+        ASSERT(entry.entitySystemType != entitySystemType);
+        if(entry.entitySystemType == entitySystemType)
+            return false;
+    }
+    entitySystems.pushBack(EntitySystemEntry{
+        .entitySystemType = entitySystemType,
+        .entitySystem = entitySystem,
+        .syncFunc = syncFunc,
+        .getReadArraysFunc = getReadArraysFunc,
+        .getWriteArraysFunc = getWriteArraysFunc,
+        .setJobSystemFunc = setJobSystemFunc });
+    setJobSystemFunc(entitySystem, &jobSystem);
+    return true;
+}
+
+u32 SystemScheduler::addSystem(const char *systemName, SystemUpdateFunc updateFunc, void *userData)
+{
+    ASSERT(updateFunc);
+    if(!updateFunc)
+        return ~0u;
+
+    systems.pushBack(SystemEntry{
+        .systemName = systemName,
+        .updateFunc = updateFunc,
+        .userData = userData,
+        .enabled = true });
+    return systems.size() - 1;
+}
+
+bool SystemScheduler::addSystemAccess(u32 systemIndex, EntitySystemType entitySystemType, u64 readArrays, u64 writeArrays)
+{
+    ASSERT(systemIndex < systems.size());
+    // Same array cannot be read and written inside one sync point.
+    ASSERT((readArrays & writeArrays) == 0u);
+    if(systemIndex >= systems.size() || (readArrays & writeArrays) != 0u)
+        return false;
+
+    for(SystemComponentAccess &access : accesses)
+    {
+        if(access.systemIndex == systemIndex && access.entitySystemType == entitySystemType)
+        {
+            ASSERT(((access.readArrays | readArrays) & (access.writeArrays | writeArrays)) == 0u);
+            access.readArrays |= readArrays;
+            access.writeArrays |= writeArrays;
+            return true;
+        }
+    }
+    accesses.pushBack(SystemComponentAccess{
+        .systemIndex = systemIndex,
+        .entitySystemType = entitySystemType,
+        .readArrays = readArrays,
+        .writeArrays = writeArrays });
+    return true;
+}
+
+void SystemScheduler::setSystemEnabled(u32 systemIndex, bool enabled)
+{
+    ASSERT(systemIndex < systems.size());
+    if(systemIndex < systems.size())
+        systems[systemIndex].enabled = enabled;
+}
+
+u32 SystemScheduler::getSystemSyncPoint(u32 systemIndex) const
+{
+    if(systemIndex >= systemSyncPoints.size())
+        return ~0u;
+    return systemSyncPoints[systemIndex];
+}
+
+bool SystemScheduler::systemsConflict(u32 systemIndexA, u32 systemIndexB) const
+{
+    for(const SystemComponentAccess &a : accesses)
+    {
+        if(a.systemIndex != systemIndexA)
+            continue;
+        for(const SystemComponentAccess &b : accesses)
+        {
+            if(b.systemIndex != systemIndexB || b.entitySystemType != a.entitySystemType)
+                continue;
+            if((a.writeArrays & (b.readArrays | b.writeArrays)) != 0u || (a.readArrays & b.writeArrays) != 0u)
+                return true;
+        }
+    }
+    return false;
+}
+
+void SystemScheduler::buildSyncPoints()
+{
+    u32 systemCount = systems.size();
+    systemSyncPoints.clear();
+    systemSyncPoints.resize(systemCount, ~0u);
+
+    // Systems only depend on earlier ones, so one pass in registration order is enough.
+    u32 syncPointCount = 0u;
+    for(u32 i = 0; i < systemCount; ++i)
+    {
+        if(!systems[i].enabled)
+            continue;
+        u32 syncPoint = 0u;
+        for(u32 j = 0; j < i; ++j)
+        {
+            if(systemSyncPoints[j] != ~0u && systemSyncPoints[j] >= syncPoint && systemsConflict(i, j))
+                syncPoint = systemSyncPoints[j] + 1;
+        }
+        systemSyncPoints[i] = syncPoint;
+        syncPointCount = Supa::maxu32(syncPointCount, syncPoint + 1);
+    }
+
+    // Counting sort by sync point, keeps registration order inside a sync point.
+    syncPointEnds.clear();
+    syncPointEnds.resize(syncPointCount, 0u);
+    for(u32 syncPoint : systemSyncPoints)
+    {
+        if(syncPoint != ~0u)
+            ++syncPointEnds[syncPoint];
+    }
+
+    u32 start = 0u;
+    for(u32 &syncPointEnd : syncPointEnds)
+    {
+        u32 count = syncPointEnd;
+        stats.widestSyncPoint = Supa::maxu32(stats.widestSyncPoint, count);
+        syncPointEnd = start;
+        start += count;
+    }
+
+    orderedSystems.clear();
+    orderedSystems.uninitializedResize(start);
+    for(u32 i = 0; i < systemCount; ++i)
+    {
+        if(systemSyncPoints[i] != ~0u)
+            orderedSystems[syncPointEnds[systemSyncPoints[i]]++] = i;
+    }
+    // syncPointEnds now holds the end index of each sync point.
+    stats.syncPoints = syncPointCount;
+}
+
+bool SystemScheduler::syncEntitySystems(u32 startIndex, u32 endIndex)
+{
+    bool success = validateAccesses(startIndex, endIndex);
+    for(const EntitySystemEntry &entry : entitySystems)
+        success &= entry.syncFunc(entry.entitySystem);
+    return success;
+}
+
+bool SystemScheduler::validateAccesses(u32 startIndex, u32 endIndex) const
+{
+    bool success = true;
+    for(const EntitySystemEntry &entry : entitySystems)
+    {
+        u64 declaredReads = 0u;
+        u64 declaredWrites = 0u;
+        for(u32 i = startIndex; i < endIndex; ++i)
+        {
+            for(const SystemComponentAccess &access : accesses)
+            {
+                if(access.systemIndex != orderedSystems[i] || access.entitySystemType != entry.entitySystemType)
+                    continue;
+                declaredReads |= access.readArrays;
+                declaredWrites |= access.writeArrays;
+            }
+        }
+        u64 undeclaredReads = entry.getReadArraysFunc(entry.entitySystem) & ~declaredReads;
+        u64 undeclaredWrites = entry.getWriteArraysFunc(entry.entitySystem) & ~declaredWrites;
+        if(undeclaredReads == 0u && undeclaredWrites == 0u)
+            continue;
+
+        // Single system when validateAccess is set, otherwise the first one of the sync point.
+        LOG("System: %s used undeclared arrays, reads: %" PRIx64 ", writes: %" PRIx64 "\n",
+            systems[orderedSystems[startIndex]].systemName, undeclaredReads, undeclaredWrites);
+        ASSERT(undeclaredReads == 0u && undeclaredWrites == 0u);
+        success = false;
+    }
+    return success;
+}
+
+void SystemScheduler::runSystemJob(void *jobData, u32 jobIndex)
+{
+    SystemScheduler &scheduler = *(SystemScheduler *)jobData;
+    u32 systemIndex = scheduler.orderedSystems[scheduler.jobStartIndex + jobIndex];
+    const SystemEntry &system = scheduler.systems[systemIndex];
+    scheduler.systemResults[systemIndex] = system.updateFunc(system.userData, scheduler.jobDt) ? 1u : 0u;
+}
+
+bool SystemScheduler::update(double dt)
+{
+    stats = SystemSchedulerStats();
+    buildSyncPoints();
+
+    // Everything the jobs touch gets allocated here, mymemory is not thread safe.
+    systemResults.clear();
+    systemResults.resize(systems.size(), 1u);
+    jobDt = dt;
+
+    bool success = true;
+    u32 startIndex = 0u;
+    for(u32 endIndex : syncPointEnds)
+    {
+        if(validateAccess)
+        {
+            for(u32 i = startIndex; i < endIndex; ++i)
+            {
+                jobStartIndex = i;
+                runSystemJob(this, 0u);
+                success &= syncEntitySystems(i, i + 1);
+            }
+        }
+        else if(endIndex - startIndex == 1u || jobSystem.getWorkerCount() == 0u)
+        {
+            jobStartIndex = startIndex;
+            for(u32 i = startIndex; i < endIndex; ++i)
+                runSystemJob(this, i - startIndex);
+            success &= syncEntitySystems(startIndex, endIndex);
+        }
+        else
+        {
+            JobCounter counter;
+            jobStartIndex = startIndex;
+            jobSystem.addJobs(runSystemJob, this, endIndex - startIndex, counter);
+            jobSystem.waitForCounter(counter);
+            success &= syncEntitySystems(startIndex, endIndex);
+        }
+        startIndex = endIndex;
+    }
+
+    for(u32 systemIndex : orderedSystems)
+    {
+        ++stats.systemsRun;
+        if(systemResults[systemIndex] == 0u)
+        {
+            ++stats.systemsFailed;
+            success = false;
+        }
+    }
+    return success;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <components/components.h>
+#include <container/podvector.h>
+#include <core/jobsystem.h>
+#include <core/mytypes.h>
+
+using SystemUpdateFunc = bool (*)(void *userData, double dt);
+
+// Component arrays a system reads and writes from one entity system, same bits
+// the ComponentArrayHandleBuilder gives to getRWHandle.
+struct SystemComponentAccess
+{
+    u32 systemIndex = ~0u;
+    EntitySystemType entitySystemType = EntitySystemType::EntitySystemTypeCount;
+    u64 readArrays = 0u;
+    u64 writeArrays = 0u;
+};
+
+struct SystemSchedulerStats
+{
+    u32 systemsRun = 0u;
+    u32 systemsFailed = 0u;
+    u32 syncPoints = 0u;
+    // Most systems running inside the same sync point.
+    u32 widestSyncPoint = 0u;
+};
+
+// Runs registered systems once per update. Every frame a dependency graph is built from
+// the declared component accesses: a system depends on every earlier registered system
+// that writes something it reads or writes, or reads something it writes.
+// Each system goes to the first sync point after all of its dependencies, systems inside
+// one sync point run in parallel on the job system, and the entity systems get synced
+// between sync points, the same way calling syncReadWrites by hand between systems would.
+class SystemScheduler
+{
+public:
+    ~SystemScheduler();
+
+    // workerCount 0 runs everything on the calling thread.
+    bool init(u32 workerCount);
+    void deinit();
+
+    // Systems running on the scheduler's workers record deferred commands into the entity
+    // system without locking, until the scheduler gets destroyed.
+    template <typename EntitySystem>
+    bool addEntitySystem(EntitySystem &entitySystem)
+    {
+        return addEntitySystem(EntitySystem::entitySystemID, &entitySystem,
+            [](void *ptr) { return ((EntitySystem *)ptr)->syncReadWrites(); },
+            [](const void *ptr) { return ((const EntitySystem *)ptr)->getSyncReadArrays(); },
+            [](const void *ptr) { return ((const EntitySystem *)ptr)->getSyncWriteArrays(); },
+            [](void *ptr, const JobSystem *jobSystem) { ((EntitySystem *)ptr)->setCommandJobSystem(jobSystem); });
+    }
+
+    // Systems get ordered by registration when they conflict.
+    u32 addSystem(const char *systemName, SystemUpdateFunc updateFunc, void *userData);
+    bool addSystemAccess(u32 systemIndex, EntitySystemType entitySystemType, u64 readArrays, u64 writeArrays);
+    void setSystemEnabled(u32 systemIndex, bool enabled);
+
+    // Runs one system at a time and syncs after each, asserting if a system requested arrays
+    // it did not declare. Without it undeclared arrays are only caught per sync point.
+    void setValidateAccess(bool validate) { validateAccess = validate; }
+
+    // Returns false if any system update returned false.
+    bool update(double dt);
+
+    // Sync point the system ran in during last update, ~0u if it did not run.
+    u32 getSystemSyncPoint(u32 systemIndex) const;
+    u32 getSystemCount() const { return systems.size(); }
+    const SystemSchedulerStats &getStats() const { return stats; }
+
+private:
+    using SyncFunc = bool (*)(void *entitySystem);
+    using GetArraysFunc = u64 (*)(const void *entitySystem);
+    using SetJobSystemFunc = void (*)(void *entitySystem, const JobSystem *jobSystem);
+
+    struct EntitySystemEntry
+    {
+        EntitySystemType entitySystemType;
+        void *entitySystem;
+        SyncFunc syncFunc;
+        GetArraysFunc getReadArraysFunc;
+        GetArraysFunc getWriteArraysFunc;
+        SetJobSystemFunc setJobSystemFunc;
+    };
+
+    struct SystemEntry
+    {
+        const char *systemName;
+        SystemUpdateFunc updateFunc;
+        void *userData;
+        bool enabled;
+    };
+
+    bool addEntitySystem(EntitySystemType entitySystemType, void *entitySystem, SyncFunc syncFunc,
+        GetArraysFunc getReadArraysFunc, GetArraysFunc getWriteArraysFunc, SetJobSystemFunc setJobSystemFunc);
+
+    bool systemsConflict(u32 systemIndexA, u32 systemIndexB) const;
+    void buildSyncPoints();
+    bool syncEntitySystems(u32 startIndex, u32 endIndex);
+    bool validateAccesses(u32 startIndex, u32 endIndex) const;
+
+    static void runSystemJob(void *jobData, u32 jobIndex);
+
+    PodVector<EntitySystemEntry> entitySystems;
+    PodVector<SystemEntry> systems;
+    PodVector<SystemComponentAccess> accesses;
+
+    // Per frame, indexed by system index.
+    PodVector<u32> systemSyncPoints;
+    PodVector<u8> systemResults;
+
+    // Systems sorted by sync point, syncPointEnds has end index of each sync point.
+    PodVector<u32> orderedSystems;
+    PodVector<u32> syncPointEnds;
+    // Start of the sync point running on job system.
+    u32 jobStartIndex = 0u;
+    double jobDt = 0.0;
+
+    JobSystem jobSystem;
+    SystemSchedulerStats stats;
+    bool validateAccess = false;
+};
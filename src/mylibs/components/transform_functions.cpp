@@ -0,0 +1,242 @@
+#include "transform_functions.h"
+
+#include <math/simd.h>
+
+#include <stddef.h>
+
+#if MATH_SIMD
+
+// Components of 4 transforms, one transform per lane.
+struct TransformLanes
+{
+    SimdFloat4 posX;
+    SimdFloat4 posY;
+    SimdFloat4 posZ;
+
+    SimdFloat4 rotX;
+    SimdFloat4 rotY;
+    SimdFloat4 rotZ;
+    SimdFloat4 rotW;
+
+    SimdFloat4 scaleX;
+    SimdFloat4 scaleY;
+    SimdFloat4 scaleZ;
+};
+
+static FORCE_INLINE void sLoadRotations(const Quat &q0, const Quat &q1, const Quat &q2, const Quat &q3,
+    TransformLanes &lanes)
+{
+    lanes.rotX = simdLoadUnaligned(&q0.v.x);
+    lanes.rotY = simdLoadUnaligned(&q1.v.x);
+    lanes.rotZ = simdLoadUnaligned(&q2.v.x);
+    lanes.rotW = simdLoadUnaligned(&q3.v.x);
+    simdTranspose(lanes.rotX, lanes.rotY, lanes.rotZ, lanes.rotW);
+}
+
+// Transposes the lanes back into one matrix row per transform.
+static FORCE_INLINE void sStoreRows(SimdFloat4 c0, SimdFloat4 c1, SimdFloat4 c2, SimdFloat4 c3,
+    Mat3x4 *const matrices[4], u32 rowIndex)
+{
+    simdTranspose(c0, c1, c2, c3);
+    simdStore(&matrices[0]->_00 + rowIndex * 4, c0);
+    simdStore(&matrices[1]->_00 + rowIndex * 4, c1);
+    simdStore(&matrices[2]->_00 + rowIndex * 4, c2);
+    simdStore(&matrices[3]->_00 + rowIndex * 4, c3);
+}
+
+// Same operations in same order as getMatrixFromTransformScalar, so the results match it exactly.
+static FORCE_INLINE void sWriteMatrices(const TransformLanes &lanes,
+    Mat3x4 *const matrices[4], Mat3x4 *const normalMatrices[4])
+{
+    SimdFloat4 x2 = simdAdd(lanes.rotX, lanes.rotX);
+    SimdFloat4 y2 = simdAdd(lanes.rotY, lanes.rotY);
+    SimdFloat4 z2 = simdAdd(lanes.rotZ, lanes.rotZ);
+    SimdFloat4 w2 = simdAdd(lanes.rotW, lanes.rotW);
+
+    SimdFloat4 xy2 = simdMul(x2, lanes.rotY);
+    SimdFloat4 xz2 = simdMul(x2, lanes.rotZ);
+    SimdFloat4 yz2 = simdMul(y2, lanes.rotZ);
+
+    SimdFloat4 wx2 = simdMul(w2, lanes.rotX);
+    SimdFloat4 wy2 = simdMul(w2, lanes.rotY);
+    SimdFloat4 wz2 = simdMul(w2, lanes.rotZ);
+
+    SimdFloat4 xx2 = simdMul(x2, lanes.rotX);
+    SimdFloat4 yy2 = simdMul(y2, lanes.rotY);
+    SimdFloat4 zz2 = simdMul(z2, lanes.rotZ);
+
+    SimdFloat4 one = simdSplat(1.0f);
+    SimdFloat4 r00 = simdSub(simdSub(one, yy2), zz2);
+    SimdFloat4 r01 = simdSub(xy2, wz2);
+    SimdFloat4 r02 = simdAdd(xz2, wy2);
+
+    SimdFloat4 r10 = simdAdd(xy2, wz2);
+    SimdFloat4 r11 = simdSub(simdSub(one, xx2), zz2);
+    SimdFloat4 r12 = simdSub(yz2, wx2);
+
+    SimdFloat4 r20 = simdSub(xz2, wy2);
+    SimdFloat4 r21 = simdAdd(yz2, wx2);
+    SimdFloat4 r22 = simdSub(simdSub(one, xx2), yy2);
+
+    sStoreRows(simdMul(r00, lanes.scaleX), simdMul(r01, lanes.scaleX), simdMul(r02, lanes.scaleX), lanes.posX,
+        matrices, 0);
+    sStoreRows(simdMul(r10, lanes.scaleY), simdMul(r11, lanes.scaleY), simdMul(r12, lanes.scaleY), lanes.posY,
+        matrices, 1);
+    sStoreRows(simdMul(r20, lanes.scaleZ), simdMul(r21, lanes.scaleZ), simdMul(r22, lanes.scaleZ), lanes.posZ,
+        matrices, 2);
+
+    if(normalMatrices == nullptr)
+        return;
+
+    SimdFloat4 zero = simdSplat(0.0f);
+    SimdFloat4 invScaleX = simdDiv(one, lanes.scaleX);
+    SimdFloat4 invScaleY = simdDiv(one, lanes.scaleY);
+    SimdFloat4 invScaleZ = simdDiv(one, lanes.scaleZ);
+    sStoreRows(simdMul(r00, invScaleX), simdMul(r01, invScaleX), simdMul(r02, invScaleX), zero,
+        normalMatrices, 0);
+    sStoreRows(simdMul(r10, invScaleY), simdMul(r11, invScaleY), simdMul(r12, invScaleY), zero,
+        normalMatrices, 1);
+    sStoreRows(simdMul(r20, invScaleZ), simdMul(r21, invScaleZ), simdMul(r22, invScaleZ), zero,
+        normalMatrices, 2);
+}
+
+#endif
+
+void getModelMatrices(const Transform *transforms, const u32 *indices, u32 count,
+    Mat3x4 *outMatrices, Mat3x4 *outNormalMatrices)
+{
+    u32 i = 0;
+#if MATH_SIMD
+    for(; i + 4 <= count; i += 4)
+    {
+        u32 index[4];
+        for(u32 j = 0; j < 4; ++j)
+            index[j] = indices ? indices[i + j] : i + j;
+
+        const Transform &t0 = transforms[index[0]];
+        const Transform &t1 = transforms[index[1]];
+        const Transform &t2 = transforms[index[2]];
+        const Transform &t3 = transforms[index[3]];
+
+        // Loads 4 floats at a time without reading past the transform, position with rotation x
+        // and rotation w with scale, the extra lanes end up in unused vectors.
+        static_assert(offsetof(Transform, rot) == offsetof(Transform, pos) + sizeof(Vec3));
+        static_assert(offsetof(Transform, scale) == offsetof(Transform, rot) + sizeof(Quat));
+        TransformLanes lanes;
+        SimdFloat4 unused = simdLoadUnaligned(&t3.pos.x);
+        lanes.posX = simdLoadUnaligned(&t0.pos.x);
+        lanes.posY = simdLoadUnaligned(&t1.pos.x);
+        lanes.posZ = simdLoadUnaligned(&t2.pos.x);
+        simdTranspose(lanes.posX, lanes.posY, lanes.posZ, unused);
+
+        sLoadRotations(t0.rot, t1.rot, t2.rot, t3.rot, lanes);
+
+        unused = simdLoadUnaligned(&t0.rot.w);
+        lanes.scaleX = simdLoadUnaligned(&t1.rot.w);
+        lanes.scaleY = simdLoadUnaligned(&t2.rot.w);
+        lanes.scaleZ = simdLoadUnaligned(&t3.rot.w);
+        simdTranspose(unused, lanes.scaleX, lanes.scaleY, lanes.scaleZ);
+
+        Mat3x4 *const matrices[4] = {
+            &outMatrices[index[0]], &outMatrices[index[1]], &outMatrices[index[2]], &outMatrices[index[3]] };
+        if(outNormalMatrices)
+        {
+            Mat3x4 *const normalMatrices[4] = {
+                &outNormalMatrices[index[0]], &outNormalMatrices[index[1]],
+                &outNormalMatrices[index[2]], &outNormalMatrices[index[3]] };
+            sWriteMatrices(lanes, matrices, normalMatrices);
+        }
+        else
+        {
+            sWriteMatrices(lanes, matrices, nullptr);
+        }
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        u32 index = indices ? indices[i] : i;
+        outMatrices[index] = getModelMatrix(transforms[index]);
+        if(outNormalMatrices)
+            outNormalMatrices[index] = getModelNormalMatrix(transforms[index]);
+    }
+}
+
+void getModelMatrices(const Vec3 *positions, const Quat *rotations, const Vec3 *scales, u32 count,
+    Mat3x4 *outMatrices, Mat3x4 *outNormalMatrices)
+{
+    u32 i = 0;
+#if MATH_SIMD
+    for(; i + 4 <= count; i += 4)
+    {
+        const Vec3 *pos = positions + i;
+        const Vec3 *scale = scales + i;
+
+        TransformLanes lanes;
+        lanes.posX = simdSet(pos[0].x, pos[1].x, pos[2].x, pos[3].x);
+        lanes.posY = simdSet(pos[0].y, pos[1].y, pos[2].y, pos[3].y);
+        lanes.posZ = simdSet(pos[0].z, pos[1].z, pos[2].z, pos[3].z);
+        sLoadRotations(rotations[i], rotations[i + 1], rotations[i + 2], rotations[i + 3], lanes);
+        lanes.scaleX = simdSet(scale[0].x, scale[1].x, scale[2].x, scale[3].x);
+        lanes.scaleY = simdSet(scale[0].y, scale[1].y, scale[2].y, scale[3].y);
+        lanes.scaleZ = simdSet(scale[0].z, scale[1].z, scale[2].z, scale[3].z);
+
+        Mat3x4 *const matrices[4] = { &outMatrices[i], &outMatrices[i + 1], &outMatrices[i + 2], &outMatrices[i + 3] };
+        if(outNormalMatrices)
+        {
+            Mat3x4 *const normalMatrices[4] = {
+                &outNormalMatrices[i], &outNormalMatrices[i + 1], &outNormalMatrices[i + 2], &outNormalMatrices[i + 3] };
+            sWriteMatrices(lanes, matrices, normalMatrices);
+        }
+        else
+        {
+            sWriteMatrices(lanes, matrices, nullptr);
+        }
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        Transform transform{ .pos = positions[i], .rot = rotations[i], .scale = scales[i] };
+        outMatrices[i] = getModelMatrix(transform);
+        if(outNormalMatrices)
+            outNormalMatrices[i] = getModelNormalMatrix(transform);
+    }
+}
+
+void getModelMatrices(const TransformComponent *transforms, u32 count,
+    Mat3x4 *outMatrices, u32 outMatrixStride)
+{
+    ASSERT(outMatrixStride % alignof(Mat3x4) == 0);
+    u8 *outBytes = (u8 *)outMatrices;
+    u32 i = 0;
+#if MATH_SIMD
+    for(; i + 4 <= count; i += 4)
+    {
+        const TransformComponent *trans = transforms + i;
+
+        // Position and scale are 4 floats, so they get loaded like rotations, w lanes are not used.
+        TransformLanes lanes;
+        SimdFloat4 posW = simdLoadUnaligned(&trans[3].position.x);
+        lanes.posX = simdLoadUnaligned(&trans[0].position.x);
+        lanes.posY = simdLoadUnaligned(&trans[1].position.x);
+        lanes.posZ = simdLoadUnaligned(&trans[2].position.x);
+        simdTranspose(lanes.posX, lanes.posY, lanes.posZ, posW);
+
+        sLoadRotations(trans[0].rotation, trans[1].rotation, trans[2].rotation, trans[3].rotation, lanes);
+
+        SimdFloat4 scaleW = simdLoadUnaligned(&trans[3].scale.x);
+        lanes.scaleX = simdLoadUnaligned(&trans[0].scale.x);
+        lanes.scaleY = simdLoadUnaligned(&trans[1].scale.x);
+        lanes.scaleZ = simdLoadUnaligned(&trans[2].scale.x);
+        simdTranspose(lanes.scaleX, lanes.scaleY, lanes.scaleZ, scaleW);
+
+        Mat3x4 *const matrices[4] = {
+            (Mat3x4 *)(outBytes + u64(i) * outMatrixStride),
+            (Mat3x4 *)(outBytes + u64(i + 1) * outMatrixStride),
+            (Mat3x4 *)(outBytes + u64(i + 2) * outMatrixStride),
+            (Mat3x4 *)(outBytes + u64(i + 3) * outMatrixStride) };
+        sWriteMatrices(lanes, matrices, nullptr);
+    }
+#endif
+    for(; i < count; ++i)
+        getMatrixFromTransform(transforms[i], *(Mat3x4 *)(outBytes + u64(i) * outMatrixStride));
+}
@@ -3,7 +3,18 @@
 #include <components/transform.h>
 #include <math/matrix_inline_functions.h>
 
-static Mat3x4 getModelMatrix(const Transform &trans)
+// Bulk versions converting 4 transforms at a time with SIMD, results are the same as with
+// getModelMatrix and getModelNormalMatrix. outNormalMatrices can be nullptr.
+// With indices, transforms[indices[i]] gets written into outMatrices[indices[i]].
+void getModelMatrices(const Transform *transforms, const u32 *indices, u32 count,
+    Mat3x4 *outMatrices, Mat3x4 *outNormalMatrices);
+void getModelMatrices(const Vec3 *positions, const Quat *rotations, const Vec3 *scales, u32 count,
+    Mat3x4 *outMatrices, Mat3x4 *outNormalMatrices);
+// Matrices are outMatrixStride bytes apart, to write straight into components holding a matrix.
+void getModelMatrices(const TransformComponent *transforms, u32 count,
+    Mat3x4 *outMatrices, u32 outMatrixStride = sizeof(Mat3x4));
+
+static FORCE_INLINE Mat3x4 getModelMatrix(const Transform &trans)
 {
     //Mat3x4 posMat = getMatrixFromTranslation(trans.pos);
     //Mat3x4 scaleMat = getMatrixFromScale(trans.scale);
@@ -13,7 +24,7 @@ static Mat3x4 getModelMatrix(const Transform &trans)
     return getMatrixFromTransform(trans);
 }
 
-static Mat3x4 getModelMatrixInverse(const Transform &trans)
+static FORCE_INLINE Mat3x4 getModelMatrixInverse(const Transform &trans)
 {
     /*
     Vec3 scale = trans.scale;
@@ -32,7 +43,7 @@ static Mat3x4 getModelMatrixInverse(const Transform &trans)
     return getInverseMatrixFromTransform(trans);
 }
 
-static Mat3x4 getModelNormalMatrix(const Transform &trans)
+static FORCE_INLINE Mat3x4 getModelNormalMatrix(const Transform &trans)
 {
     Vec3 scale = trans.scale;
     scale.x = 1.0f / scale.x;
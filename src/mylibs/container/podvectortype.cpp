@@ -3,6 +3,7 @@
 #include "podvectortypedefine.h"
 #include "podvector.h"
 
+#include <components/systemscheduler.h>
 #include <components/transform.h>
 
 #include <container/stackstring.h>
@@ -25,6 +26,8 @@
 #include <render/linerendersystem.h>
 #include <render/meshrendersystem.h>
 
+#include <scene/dynamicbvh.h>
+#include <scene/entitystore.h>
 #include <scene/gameentity.h>
 
 template void isPodType<char>();
@@ -70,9 +73,17 @@ template void isPodType<MediumStackString>();
 template void isPodType<LongStackString>();
 
 template void isPodType<GameEntity>();
+template void isPodType<EntityType>();
+template void isPodType<EntityHandle>();
+template void isPodType<BvhNode>();
+template void isPodType<BvhRayCandidate>();
 
 template void isPodType<AnimationState>();
 
+template void isPodType<SystemComponentAccess>();
+template void isPodType<SystemScheduler::EntitySystemEntry>();
+template void isPodType<SystemScheduler::SystemEntry>();
+
 template void isPodType<VkDescriptorPoolSize>();
 template void isPodType<VkWriteDescriptorSet>();
 template void isPodType<VkDescriptorBufferInfo>();
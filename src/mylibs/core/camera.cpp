@@ -63,7 +63,7 @@ void Camera::checkCameraKeypresses()
     Vec3 forwardDir;
 
     // camera forward = -forward.
-    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir);
+    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir, m_useFastMath);
 
 
     if (InputApp::isDown(GLFW_KEY_W))
@@ -145,7 +145,7 @@ void Camera::calculateOrtographicPosition(const Vec3 &targetPos)
     Vector3 upDir;
     Vector3 forwardDir;
     // Invert the camera rotations
-    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir);
+    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir, m_useFastMath);
 
     m_position = targetPos + forwardDir * 100.0f;
 }
@@ -156,7 +156,7 @@ Matrix Camera::getCameraMatrix() const
     Vector3 upDir;
     Vector3 forwardDir;
     // Invert the camera rotations
-    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir);
+    getDirectionsFromPitchYawRoll(m_pitch, m_yaw, m_roll, rightDir, upDir, forwardDir, m_useFastMath);
     return createMatrixFromLookAt(m_position, m_position - forwardDir, upDir);
 }
 
@@ -185,7 +185,7 @@ Vec2 Camera::renderCameraInfo(Vec2 camInfoPosition, const Vec2& fontSize) const
     Vec3 cameraRightdDir;
     Vec3 cameraUpDir;
     Vec3 cameraForwardDir;
-    getDirectionsFromPitchYawRoll(-m_pitch, -m_yaw, -m_roll, cameraRightdDir, cameraUpDir, cameraForwardDir);
+    getDirectionsFromPitchYawRoll(-m_pitch, -m_yaw, -m_roll, cameraRightdDir, cameraUpDir, cameraForwardDir, m_useFastMath);
 
     camInfoPosition.y += fontSize.y + 2.0f;
 
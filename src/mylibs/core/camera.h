@@ -51,6 +51,9 @@ struct Camera
     float m_zNear = 0.1f;
     float m_zFar = 200.0f;
 
+    // Builds the camera rotation with the polynomial sin and cos from fastmath.h.
+    bool m_useFastMath = false;
+
     CameraType m_cameraType = CameraType::PERSPECTIVE;
 };
 
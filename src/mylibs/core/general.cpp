@@ -70,7 +70,7 @@ namespace Supa
     float maxf(float a, float b) { return (a > b) ? a : b; }
     float clampf(float a, float b, float value) { return maxf(a, minf(b, value)); }
     float powf(float a, float b) { return ::powf(a, b); }
-    float expd(float a) { return ::expf(a); }
+    float expf(float a) { return ::expf(a); }
 
     double atan2d(double a, double b) { return ::atan2(a, b); }
     double sqrtd(double a) { return ::sqrt(a); }
@@ -0,0 +1,190 @@
+#include "jobsystem.h"
+
+#include <core/assert.h>
+#include <core/general.h>
+
+// Job system and queue of the worker running on current thread, null and ~0u for threads
+// outside every pool. Queue index only means something to the job system owning the thread.
+static thread_local const JobSystem *sThreadJobSystem = nullptr;
+static thread_local u32 sThreadQueueIndex = ~0u;
+
+JobSystem::~JobSystem()
+{
+    deinit();
+}
+
+bool JobSystem::init(u32 newWorkerCount)
+{
+    ASSERT(!running.load());
+    if(running.load())
+        return false;
+
+    workerCount = Supa::minu32(newWorkerCount, MaxWorkerCount);
+    running.store(true);
+    for(u32 i = 0; i < workerCount; ++i)
+        workers[i] = std::thread(&JobSystem::workerLoop, this, i);
+    return true;
+}
+
+void JobSystem::deinit()
+{
+    if(!running.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running.store(false);
+    }
+    sleepCondition.notify_all();
+    for(u32 i = 0; i < workerCount; ++i)
+        workers[i].join();
+    workerCount = 0u;
+}
+
+u32 JobSystem::getHardwareThreadCount()
+{
+    u32 count = std::thread::hardware_concurrency();
+    return count > 0u ? count : 1u;
+}
+
+u32 JobSystem::getCurrentThreadIndex() const
+{
+    u32 queueIndex = getThreadQueueIndex();
+    return queueIndex < MaxWorkerCount ? queueIndex : MaxWorkerCount;
+}
+
+u32 JobSystem::getThreadQueueIndex() const
+{
+    return sThreadJobSystem == this ? sThreadQueueIndex : ~0u;
+}
+
+JobSystemStats JobSystem::getStats() const
+{
+    return JobSystemStats{ .jobsRun = jobsRun.load(), .jobsStolen = jobsStolen.load() };
+}
+
+bool JobSystem::pushJob(u32 queueIndex, const Job &job)
+{
+    JobQueue &queue = queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.tail - queue.head >= MaxQueueJobCount)
+        return false;
+    queue.jobs[queue.tail % MaxQueueJobCount] = job;
+    ++queue.tail;
+    queuedJobCount.fetch_add(1u);
+    return true;
+}
+
+bool JobSystem::popJob(u32 queueIndex, Job &outJob)
+{
+    JobQueue &queue = queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.head == queue.tail)
+        return false;
+    --queue.tail;
+    outJob = queue.jobs[queue.tail % MaxQueueJobCount];
+    queuedJobCount.fetch_sub(1u);
+    return true;
+}
+
+bool JobSystem::stealJob(u32 queueIndex, Job &outJob)
+{
+    JobQueue &queue = queues[queueIndex];
+    // Do not wait behind the owner, try next queue instead.
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if(!lock.owns_lock() || queue.head == queue.tail)
+        return false;
+    outJob = queue.jobs[queue.head % MaxQueueJobCount];
+    ++queue.head;
+    queuedJobCount.fetch_sub(1u);
+    jobsStolen.fetch_add(1u);
+    return true;
+}
+
+bool JobSystem::findJob(u32 queueIndex, Job &outJob)
+{
+    if(queuedJobCount.load() == 0u)
+        return false;
+    if(popJob(queueIndex, outJob))
+        return true;
+
+    u32 queueCount = workerCount + 1;
+    for(u32 i = 1; i < queueCount; ++i)
+    {
+        if(stealJob((queueIndex + i) % queueCount, outJob))
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::runJob(const Job &job)
+{
+    job.func(job.jobData, job.jobIndex);
+    jobsRun.fetch_add(1u);
+    job.counter->jobsLeft.fetch_sub(1u);
+}
+
+void JobSystem::addJobs(JobFunc func, void *jobData, u32 jobCount, JobCounter &counter)
+{
+    ASSERT(func);
+    if(!func || jobCount == 0u)
+        return;
+
+    counter.jobsLeft.fetch_add(jobCount);
+    u32 queueCount = workerCount + 1;
+    u32 threadQueueIndex = getThreadQueueIndex();
+    for(u32 i = 0; i < jobCount; ++i)
+    {
+        Job job{ .func = func, .jobData = jobData, .counter = &counter, .jobIndex = i };
+
+        // Jobs added from a worker stay in its queue, others get spread so workers
+        // do not all start by stealing from the same queue.
+        u32 queueIndex = threadQueueIndex != ~0u
+            ? threadQueueIndex
+            : nextQueueIndex.fetch_add(1u) % queueCount;
+
+        // Full queue, run it right away instead.
+        if(!pushJob(queueIndex, job))
+            runJob(job);
+    }
+    {
+        // Worker might be between checking the queues and going to sleep.
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_all();
+}
+
+void JobSystem::waitForCounter(JobCounter &counter)
+{
+    // Workers of other job systems wait like threads outside the pool.
+    u32 queueIndex = getThreadQueueIndex();
+    if(queueIndex == ~0u)
+        queueIndex = workerCount;
+    Job job;
+    while(counter.jobsLeft.load() > 0u)
+    {
+        if(findJob(queueIndex, job))
+            runJob(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(u32 queueIndex)
+{
+    sThreadJobSystem = this;
+    sThreadQueueIndex = queueIndex;
+    Job job;
+    while(running.load())
+    {
+        if(findJob(queueIndex, job))
+        {
+            runJob(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]() { return queuedJobCount.load() > 0u || !running.load(); });
+    }
+    sThreadJobSystem = nullptr;
+    sThreadQueueIndex = ~0u;
+}
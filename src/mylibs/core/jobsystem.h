@@ -0,0 +1,91 @@
+#pragma once
+
+#include <core/mytypes.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// jobIndex goes from 0 to jobCount - 1 given to addJobs.
+using JobFunc = void (*)(void *jobData, u32 jobIndex);
+
+struct JobCounter
+{
+    std::atomic<u32> jobsLeft {0};
+};
+
+struct JobSystemStats
+{
+    u64 jobsRun = 0u;
+    u64 jobsStolen = 0u;
+};
+
+// Fixed amount of worker threads, each with its own job queue. Owner takes the newest
+// job from its own queue, idle threads steal the oldest jobs from the others.
+// The thread waiting for a counter helps by running jobs too.
+// Jobs must not use the mymemory allocator, it is not thread safe.
+class JobSystem
+{
+public:
+    ~JobSystem();
+
+    // workerCount 0 runs every job on the thread calling waitForCounter.
+    bool init(u32 workerCount);
+    void deinit();
+
+    void addJobs(JobFunc func, void *jobData, u32 jobCount, JobCounter &counter);
+    void waitForCounter(JobCounter &counter);
+
+    u32 getWorkerCount() const { return workerCount; }
+    // 0 to MaxWorkerCount - 1 for workers of this job system, MaxWorkerCount for any other
+    // thread, workers of other job systems included.
+    u32 getCurrentThreadIndex() const;
+    JobSystemStats getStats() const;
+    static u32 getHardwareThreadCount();
+
+    static constexpr u32 MaxWorkerCount = 31u;
+    static constexpr u32 MaxQueueJobCount = 256u;
+
+private:
+    struct Job
+    {
+        JobFunc func = nullptr;
+        void *jobData = nullptr;
+        JobCounter *counter = nullptr;
+        u32 jobIndex = 0u;
+    };
+
+    // Ring buffer, owner pops from the tail, thieves from the head.
+    struct JobQueue
+    {
+        std::mutex mutex;
+        Job jobs[MaxQueueJobCount];
+        u32 head = 0u;
+        u32 tail = 0u;
+    };
+
+    // Queue of current thread when it is a worker of this job system, otherwise ~0u.
+    u32 getThreadQueueIndex() const;
+    bool pushJob(u32 queueIndex, const Job &job);
+    bool popJob(u32 queueIndex, Job &outJob);
+    bool stealJob(u32 queueIndex, Job &outJob);
+    bool findJob(u32 queueIndex, Job &outJob);
+    void runJob(const Job &job);
+    void workerLoop(u32 queueIndex);
+
+    // Last queue belongs to the threads outside of the pool.
+    JobQueue queues[MaxWorkerCount + 1];
+    std::thread workers[MaxWorkerCount];
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+
+    std::atomic<u32> queuedJobCount {0};
+    std::atomic<u32> nextQueueIndex {0};
+    std::atomic<u64> jobsRun {0};
+    std::atomic<u64> jobsStolen {0};
+    std::atomic<bool> running {false};
+
+    u32 workerCount = 0u;
+};
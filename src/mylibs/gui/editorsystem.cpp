@@ -145,18 +145,19 @@ static bool drawDockspace(ImTextureID viewportImage, Viewport &outViewport, bool
 
 
 
-static bool drawEntities(ArraySliceView<GameEntity> gameEntitites, u32 &inOutSelectedEntityIndex)
+static bool drawEntities(const EntityStore &entities, EntityHandle &inOutSelectedEntity)
 {
     ImGui::Begin("Entities");
     if(ImGui::BeginListBox("Entities", ImVec2(-FLT_MIN, 0.0f)))
     {
-        for(const auto &entity : gameEntitites)
+        for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
         {
             char s[256];
-            snprintf(s, 256, "Name: %s, Type: %s, index: %u", entity.name.getStr(), getStringFromEntityType(entity.entityType), entity.index);
-            const bool isSelected = (inOutSelectedEntityIndex == entity.index);
+            snprintf(s, 256, "Name: %s, Type: %s, index: %u", entities.names[entityIndex].getStr(),
+                getStringFromEntityType(entities.entityTypes[entityIndex]), entityIndex);
+            const bool isSelected = (inOutSelectedEntity == entities.getHandle(entityIndex));
             if(ImGui::Selectable(s, isSelected))
-                inOutSelectedEntityIndex = entity.index;
+                inOutSelectedEntity = entities.getHandle(entityIndex);
 
             if(isSelected)
                 ImGui::SetItemDefaultFocus();
@@ -315,13 +316,13 @@ bool EditorSystem::logicUpdate(const VulkanApp &app)
             mouseState.x < editorWindowViewport.pos.x + editorWindowViewport.size.x &&
             mouseState.y < editorWindowViewport.pos.y + editorWindowViewport.size.y)
         {
-            selectedEntityIndex = ~0u;
+            selectedEntity = EntityHandle();
             Vec2 coord = Vec2(mouseState.x, mouseState.y) - editorWindowViewport.pos;
             Ray ray = app.getActiveCamera().getRayFromScreenPixelCoordinates(coord, editorWindowViewport.size);
 
             HitPoint hitpoint{ Uninit };
-            selectedEntityIndex = scene.castRay(ray, hitpoint);
-            if(selectedEntityIndex != ~0u)
+            selectedEntity = scene.castRay(ray, hitpoint);
+            if(scene.isValidEntity(selectedEntity))
             {
                 //lineFrom = ray.pos;
                 //lineTo = hitpoint.point;
@@ -347,12 +348,14 @@ bool EditorSystem::renderUpdateViewport()
     static const u32 selectedBlueColor = getColor(Vec4(1.0f, 1.0f, 1.0f, 1.0f) * Vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
 
-    for(const auto &entity : scene.getEntities())
+    const EntityStore &entities = scene.getEntities();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
     {
         Vec4 linePoints4[8];
         Vec3 linePoints[8];
-        Mat3x4 m = getModelMatrix(entity.transform);
-        const auto &bounds = scene.getBounds(entity.index);
+        EntityHandle entityHandle = entities.getHandle(entityIndex);
+        const Mat3x4 &m = scene.getWorldMatrix(entityHandle);
+        const auto &bounds = scene.getBounds(entityHandle);
         const auto &bmin = bounds.min;
         const auto &bmax = bounds.max;
 
@@ -369,7 +372,7 @@ bool EditorSystem::renderUpdateViewport()
             linePoints[i] = Vec3(linePoints4[i].x, linePoints4[i].y, linePoints4[i].z);
 
         Vec4 multip(0.5f, 0.5f, 0.5f, 1.0f);
-        u32 drawColor = selectedEntityIndex == entity.index ? selectedColor : grayColor;
+        u32 drawColor = selectedEntity == entityHandle ? selectedColor : grayColor;
         lineRenderSystem.addLine(linePoints[1], linePoints[3], drawColor);
         lineRenderSystem.addLine(linePoints[2], linePoints[3], drawColor);
         lineRenderSystem.addLine(linePoints[1], linePoints[5], drawColor);
@@ -380,16 +383,16 @@ bool EditorSystem::renderUpdateViewport()
         lineRenderSystem.addLine(linePoints[5], linePoints[7], drawColor);
         lineRenderSystem.addLine(linePoints[6], linePoints[7], drawColor);
 
-        u32 redColor = selectedEntityIndex == entity.index ? selectedRedColor : unSelectedRedColor;
-        u32 greenColor = selectedEntityIndex == entity.index ? selectedGreenColor : unSelectedGreenColor;
-        u32 blueColor = selectedEntityIndex == entity.index ? selectedBlueColor : unSelectedBlueColor;
+        u32 redColor = selectedEntity == entityHandle ? selectedRedColor : unSelectedRedColor;
+        u32 greenColor = selectedEntity == entityHandle ? selectedGreenColor : unSelectedGreenColor;
+        u32 blueColor = selectedEntity == entityHandle ? selectedBlueColor : unSelectedBlueColor;
 
         lineRenderSystem.addLine(linePoints[0], linePoints[1], redColor);
         lineRenderSystem.addLine(linePoints[0], linePoints[2], greenColor);
         lineRenderSystem.addLine(linePoints[0], linePoints[4], blueColor);
 
-        if(entity.entityType == EntityType::NUM_OF_ENTITY_TYPES ||
-            entity.entityType == EntityType::FLOOR)
+        if(entities.entityTypes[entityIndex] == EntityType::NUM_OF_ENTITY_TYPES ||
+            entities.entityTypes[entityIndex] == EntityType::FLOOR)
             continue;
     }
     //lineRenderSystem.addLine(lineFrom, lineTo, getColor(0.0f, 1.0f, 0.0f, 1.0f));
@@ -404,11 +407,11 @@ bool EditorSystem::renderUpdateGui()
     focusOnViewport = drawDockspace(viewportImageHandle, editorWindowViewport, showSaveDialog);
 
 
-    drawEntities(sliceFromPodVector(scene.getEntities()), selectedEntityIndex);
+    drawEntities(scene.getEntities(), selectedEntity);
     if(drawEntityAddTypes(entityToAdd))
     {
         focusOnViewport = false;
-        selectedEntityIndex = scene.addGameEntity(entityToAdd);
+        selectedEntity = scene.addGameEntity(entityToAdd);
     }
 
     bool saved = false;
@@ -422,8 +425,17 @@ bool EditorSystem::renderUpdateGui()
     {
         ImGui::SetNextWindowSize(ImVec2(400, 200), ImGuiCond_FirstUseEver);
         ImGui::Begin("Properties");
-        if(selectedEntityIndex != ~0u)
-            drawEntityContents(scene.getEntity(selectedEntityIndex));
+        if(scene.isValidEntity(selectedEntity))
+        {
+            GameEntity entity = scene.getEntity(selectedEntity);
+            drawEntityContents(entity);
+            scene.setEntity(selectedEntity, entity);
+            if(ImGui::Button("Remove"))
+            {
+                scene.removeEntity(selectedEntity);
+                selectedEntity = EntityHandle();
+            }
+        }
         ImGui::End();
     }
 
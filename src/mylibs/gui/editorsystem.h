@@ -3,6 +3,7 @@
 #include <container/stackstring.h>
 #include <math/vector3.h>
 
+#include <scene/entitystore.h>
 #include <scene/gameentity.h>
 #include <render/myimguirenderer.h>
 #include <render/viewport.h>
@@ -59,7 +60,7 @@ private:
     //Vec3 lineFrom;
     //Vec3 lineTo;
 
-    u32 selectedEntityIndex = ~0u;
+    EntityHandle selectedEntity;
 
     bool showSaveDialog = false;
     bool focusOnViewport = false;
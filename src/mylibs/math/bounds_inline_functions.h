@@ -0,0 +1,92 @@
+#pragma once
+
+#include <components/transform.h>
+#include <math/bounds.h>
+#include <math/matrix.h>
+#include <math/matrix_inline_functions.h>
+#include <math/ray.h>
+#include <math/vector3_inline_functions.h>
+
+static FORCE_INLINE Bounds boundsUnion(const Bounds &a, const Bounds &b)
+{
+    return Bounds{ .min = minVec(a.min, b.min), .max = maxVec(a.max, b.max) };
+}
+
+static FORCE_INLINE Bounds boundsExpand(const Bounds &a, float amount)
+{
+    return Bounds{ .min = a.min - amount, .max = a.max + amount };
+}
+
+static FORCE_INLINE bool boundsOverlap(const Bounds &a, const Bounds &b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Is inner completely inside outer
+static FORCE_INLINE bool boundsContains(const Bounds &outer, const Bounds &inner)
+{
+    return outer.min.x <= inner.min.x && outer.max.x >= inner.max.x
+        && outer.min.y <= inner.min.y && outer.max.y >= inner.max.y
+        && outer.min.z <= inner.min.z && outer.max.z >= inner.max.z;
+}
+
+static FORCE_INLINE float boundsSurfaceArea(const Bounds &a)
+{
+    Vec3 d = a.max - a.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static FORCE_INLINE float sqrDistanceToBounds(const Vec3 &point, const Bounds &a)
+{
+    Vec3 d = maxVec(maxVec(a.min - point, point - a.max), Vec3(0.0f));
+    return sqrLen(d);
+}
+
+// World space axis aligned bounds of local bounds transformed by model matrix.
+static FORCE_INLINE Bounds getWorldBounds(const Bounds &localBounds, const Mat3x4 &m)
+{
+    Vec3 center = (localBounds.max + localBounds.min) * 0.5f;
+    Vec3 extent = (localBounds.max - localBounds.min) * 0.5f;
+
+    Vec3 worldCenter{ Uninit };
+    worldCenter.x = m._00 * center.x + m._01 * center.y + m._02 * center.z + m._03;
+    worldCenter.y = m._10 * center.x + m._11 * center.y + m._12 * center.z + m._13;
+    worldCenter.z = m._20 * center.x + m._21 * center.y + m._22 * center.z + m._23;
+
+    Vec3 worldExtent{ Uninit };
+    worldExtent.x = fabsf(m._00) * extent.x + fabsf(m._01) * extent.y + fabsf(m._02) * extent.z;
+    worldExtent.y = fabsf(m._10) * extent.x + fabsf(m._11) * extent.y + fabsf(m._12) * extent.z;
+    worldExtent.z = fabsf(m._20) * extent.x + fabsf(m._21) * extent.y + fabsf(m._22) * extent.z;
+
+    return Bounds{ .min = worldCenter - worldExtent, .max = worldCenter + worldExtent };
+}
+
+// Same space as rayOOBBBoundsIntersect uses: scale in local space, then rotate and translate.
+static FORCE_INLINE Bounds getWorldBounds(const Bounds &localBounds, const Transform &transform)
+{
+    Vec3 scaledMin = localBounds.min * transform.scale;
+    Vec3 scaledMax = localBounds.max * transform.scale;
+    Bounds scaledBounds{ .min = minVec(scaledMin, scaledMax), .max = maxVec(scaledMin, scaledMax) };
+
+    Mat3x4 m = getMatrixFromQuaternion(transform.rot);
+    m._03 = transform.pos.x;
+    m._13 = transform.pos.y;
+    m._23 = transform.pos.z;
+    return getWorldBounds(scaledBounds, m);
+}
+
+// Slab test, inverseRayDir = 1.0f / ray.dir. Returns the entry distance in outDistance, 0 if ray starts inside.
+static FORCE_INLINE bool rayBoundsIntersect(const Ray &ray, const Vec3 &inverseRayDir, const Bounds &bounds,
+    float maxDistance, float &outDistance)
+{
+    Vec3 tMin = (bounds.min - ray.pos) * inverseRayDir;
+    Vec3 tMax = (bounds.max - ray.pos) * inverseRayDir;
+
+    float tMind = maxVec(minVec(tMin, tMax));
+    float tMaxd = minVec(maxVec(tMin, tMax));
+
+    outDistance = tMind >= 0.0f ? tMind : 0.0f;
+    return tMaxd >= tMind && tMaxd >= 0.0f && outDistance <= maxDistance;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <core/general.h>
+#include <math/simd.h>
+
+#include <bit>
+
+// Polynomial approximations of sin, cos, exp2 and log2 for hot loops that can trade a few
+// ulps for speed, like audio synthesis. Supa::sinf and the rest stay the accurate libm versions.
+// Polynomials are minimax fits, errors are measured against libm in fastmathtest.cpp:
+//   fastSinf, fastCosf: absolute error < 2e-7 for |x| < 8192, grows slowly past that.
+//   fastExp2f:          relative error < 3e-7, input clamped to [-126, 127].
+//   fastExpf:           relative error < 3e-7 + 1e-7 * |x|, from rounding x * log2(e).
+//   fastLog2f:          absolute error < 2e-7 + 6e-8 * |log2(x)|, positive normal inputs only.
+//   fastPowf:           relative error < 3e-7 + 2e-7 * |b * log2(a)|, positive a only.
+// No 8 wide versions, the build does not target AVX, loop the 4 wide ones twice instead.
+// Scalar and 4 wide versions do the same operations in the same order, so they return
+// the same results.
+
+// Pi in three parts, first two have few enough bits that multiplying them with
+// a whole number below 4096 is exact.
+static constexpr float FastMathPiA = 3.140625f;
+static constexpr float FastMathPiB = 9.67502593994140625e-4f;
+static constexpr float FastMathPiC = 1.509957990978376432e-7f;
+static constexpr float FastMathInvPi = 0.318309886183790671f;
+
+// Adding and subtracting 1.5 * 2^23 rounds to nearest, ties to even, for |v| < 2^22.
+static constexpr float FastMathRoundMagic = 12582912.0f;
+
+static constexpr float FastMathSqrtHalf = std::bit_cast<float>(0x3f3504f3);
+
+// Polynomial coefficients from the highest power down, shared by the scalar and 4 wide versions.
+static constexpr float FastMathSinCoefs[] = { 2.6000547681e-6f, -1.9806615201e-4f, 8.3330172916e-3f, -1.6666657097e-1f };
+static constexpr float FastMathExp2Coefs[] = { 1.3264727218e-3f, 9.6715126396e-3f, 5.5507337432e-2f, 2.4022242085e-1f,
+    6.9314697760e-1f, 1.0f };
+static constexpr float FastMathLog2Coefs[] = { -1.4574450107e-1f, 2.3689038932e-1f, -2.5006903640e-1f, 2.8670745367e-1f,
+    -3.6008721622e-1f, 4.8093944490e-1f, -7.2135714891e-1f, 1.4426947724f };
+
+static FORCE_INLINE float fastMathReducePi(float x, float halfTurns)
+{
+    float r = x - halfTurns * FastMathPiA;
+    r = r - halfTurns * FastMathPiB;
+    return r - halfTurns * FastMathPiC;
+}
+
+// sin(r) for r in [-pi/2, pi/2], max error 4.7e-9 before rounding.
+static FORCE_INLINE float fastMathSinPoly(float r)
+{
+    float r2 = r * r;
+    float p = FastMathSinCoefs[0];
+    for(u32 i = 1; i < ARRAYSIZES(FastMathSinCoefs); ++i)
+        p = p * r2 + FastMathSinCoefs[i];
+    return r + r * r2 * p;
+}
+
+// 2^f for f in [-0.5, 0.5], max relative error 9.2e-8 before rounding. Constant term is
+// exactly 1, so whole powers of two come out exact.
+static FORCE_INLINE float fastMathExp2Poly(float f)
+{
+    float p = FastMathExp2Coefs[0];
+    for(u32 i = 1; i < ARRAYSIZES(FastMathExp2Coefs); ++i)
+        p = p * f + FastMathExp2Coefs[i];
+    return p;
+}
+
+// log2(1 + x) for 1 + x in [sqrt(0.5), sqrt(2)], max error 4.8e-8 before rounding.
+static FORCE_INLINE float fastMathLog2Poly(float x)
+{
+    float p = FastMathLog2Coefs[0];
+    for(u32 i = 1; i < ARRAYSIZES(FastMathLog2Coefs); ++i)
+        p = p * x + FastMathLog2Coefs[i];
+    return x * p;
+}
+
+namespace Supa
+{
+    static FORCE_INLINE float fastSinf(float x)
+    {
+        float halfTurns = (x * FastMathInvPi + FastMathRoundMagic) - FastMathRoundMagic;
+        float s = fastMathSinPoly(fastMathReducePi(x, halfTurns));
+        u32 sign = u32(i32(halfTurns)) << 31;
+        return std::bit_cast<float>(std::bit_cast<u32>(s) ^ sign);
+    }
+
+    // cos(x) = -sin(x - (h + 0.5) * pi) * (-1)^h, reducing directly around cos zeros keeps
+    // the error absolute instead of adding pi / 2 to x first.
+    static FORCE_INLINE float fastCosf(float x)
+    {
+        float halfTurns = ((x * FastMathInvPi - 0.5f) + FastMathRoundMagic) - FastMathRoundMagic;
+        float s = fastMathSinPoly(fastMathReducePi(x, halfTurns + 0.5f));
+        u32 sign = (u32(i32(halfTurns)) << 31) ^ 0x8000'0000u;
+        return std::bit_cast<float>(std::bit_cast<u32>(s) ^ sign);
+    }
+
+    static FORCE_INLINE float fastExp2f(float x)
+    {
+        x = x > -126.0f ? x : -126.0f;
+        x = x < 127.0f ? x : 127.0f;
+        float whole = (x + FastMathRoundMagic) - FastMathRoundMagic;
+        float p = fastMathExp2Poly(x - whole);
+        u32 scaleBits = u32(i32(whole) + 127) << 23;
+        return p * std::bit_cast<float>(scaleBits);
+    }
+
+    static FORCE_INLINE float fastLog2f(float x)
+    {
+        // Splits x into 2^e * m with m in [sqrt(0.5), sqrt(2)).
+        i32 bits = std::bit_cast<i32>(x);
+        i32 exponent = (bits - std::bit_cast<i32>(FastMathSqrtHalf)) >> 23;
+        float m = std::bit_cast<float>(bits - (exponent << 23));
+        return float(exponent) + fastMathLog2Poly(m - 1.0f);
+    }
+
+    static FORCE_INLINE float fastExpf(float x)
+    {
+        return fastExp2f(x * 1.44269504088896341f);
+    }
+
+    static FORCE_INLINE float fastPowf(float a, float b)
+    {
+        return fastExp2f(b * fastLog2f(a));
+    }
+}
+
+#if MATH_SIMD
+
+static FORCE_INLINE SimdFloat4 simdFastMathReducePi(SimdFloat4 x, SimdFloat4 halfTurns)
+{
+    SimdFloat4 r = simdSub(x, simdMul(halfTurns, simdSplat(FastMathPiA)));
+    r = simdSub(r, simdMul(halfTurns, simdSplat(FastMathPiB)));
+    return simdSub(r, simdMul(halfTurns, simdSplat(FastMathPiC)));
+}
+
+static FORCE_INLINE SimdFloat4 simdFastMathSinPoly(SimdFloat4 r)
+{
+    SimdFloat4 r2 = simdMul(r, r);
+    SimdFloat4 p = simdSplat(FastMathSinCoefs[0]);
+    for(u32 i = 1; i < ARRAYSIZES(FastMathSinCoefs); ++i)
+        p = simdAdd(simdMul(p, r2), simdSplat(FastMathSinCoefs[i]));
+    return simdAdd(r, simdMul(simdMul(r, r2), p));
+}
+
+static FORCE_INLINE SimdFloat4 simdFastSin(SimdFloat4 x)
+{
+    SimdInt4 halfTurns = simdRoundToInt(simdMul(x, simdSplat(FastMathInvPi)));
+    SimdFloat4 s = simdFastMathSinPoly(simdFastMathReducePi(x, simdIntToFloat(halfTurns)));
+    return simdXor(s, simdCastToFloat(simdShiftLeftInt<31>(halfTurns)));
+}
+
+static FORCE_INLINE SimdFloat4 simdFastCos(SimdFloat4 x)
+{
+    SimdInt4 halfTurns = simdRoundToInt(simdSub(simdMul(x, simdSplat(FastMathInvPi)), simdSplat(0.5f)));
+    SimdFloat4 h = simdAdd(simdIntToFloat(halfTurns), simdSplat(0.5f));
+    SimdFloat4 s = simdFastMathSinPoly(simdFastMathReducePi(x, h));
+    SimdFloat4 sign = simdCastToFloat(simdShiftLeftInt<31>(simdAddInt(halfTurns, simdSplatInt(1))));
+    return simdXor(s, sign);
+}
+
+static FORCE_INLINE SimdFloat4 simdFastExp2(SimdFloat4 x)
+{
+    x = simdMin(simdMax(x, simdSplat(-126.0f)), simdSplat(127.0f));
+    SimdInt4 whole = simdRoundToInt(x);
+    SimdFloat4 f = simdSub(x, simdIntToFloat(whole));
+
+    SimdFloat4 p = simdSplat(FastMathExp2Coefs[0]);
+    for(u32 i = 1; i < ARRAYSIZES(FastMathExp2Coefs); ++i)
+        p = simdAdd(simdMul(p, f), simdSplat(FastMathExp2Coefs[i]));
+
+    SimdInt4 scaleBits = simdShiftLeftInt<23>(simdAddInt(whole, simdSplatInt(127)));
+    return simdMul(p, simdCastToFloat(scaleBits));
+}
+
+static FORCE_INLINE SimdFloat4 simdFastLog2(SimdFloat4 x)
+{
+    SimdInt4 bits = simdCastToInt(x);
+    SimdInt4 exponent = simdShiftRightInt<23>(
+        simdSubInt(bits, simdSplatInt(std::bit_cast<i32>(FastMathSqrtHalf))));
+    SimdFloat4 m = simdCastToFloat(simdSubInt(bits, simdShiftLeftInt<23>(exponent)));
+    SimdFloat4 t = simdSub(m, simdSplat(1.0f));
+
+    SimdFloat4 p = simdSplat(FastMathLog2Coefs[0]);
+    for(u32 i = 1; i < ARRAYSIZES(FastMathLog2Coefs); ++i)
+        p = simdAdd(simdMul(p, t), simdSplat(FastMathLog2Coefs[i]));
+    return simdAdd(simdIntToFloat(exponent), simdMul(t, p));
+}
+
+static FORCE_INLINE SimdFloat4 simdFastExp(SimdFloat4 x)
+{
+    return simdFastExp2(simdMul(x, simdSplat(1.44269504088896341f)));
+}
+
+#endif
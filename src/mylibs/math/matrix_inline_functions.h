@@ -10,8 +10,7 @@
 #include <math/quaternion.h>
 #include <math/vector3_inline_functions.h>
 
-#include <xmmintrin.h>
-//#include <immintrin.h>
+#include <math/simd.h>
 
 static FORCE_INLINE Mat3x4 getMatrixFromQuaternion(const Quaternion &quat)
 {
@@ -70,7 +69,8 @@ static FORCE_INLINE Mat3x4 getMatrixFromTranslation(const Vector3 &pos)
 }
 
 
-static FORCE_INLINE Mat3x4 getMatrixFromTransform(const Transform &trans)
+// Scalar reference versions are kept for platforms without SIMD and for testing the SIMD ones.
+static FORCE_INLINE Mat3x4 getMatrixFromTransformScalar(const Transform &trans)
 {
     Mat3x4 result{ Uninit };
     float xy2 = 2.0f * trans.rot.v.x * trans.rot.v.y;
@@ -148,7 +148,7 @@ static FORCE_INLINE Mat3x4 getInverseMatrixFromTransform(const Transform &trans)
 
 
 
-static FORCE_INLINE Mat3x4 getMatrixFromTransform(const TransformComponent &trans)
+static FORCE_INLINE Mat3x4 getMatrixFromTransformScalar(const TransformComponent &trans)
 {
     Mat3x4 result{ Uninit };
     float xy2 = 2.0f * trans.rotation.v.x * trans.rotation.v.y;
@@ -183,39 +183,79 @@ static FORCE_INLINE Mat3x4 getMatrixFromTransform(const TransformComponent &tran
 }
 
 
-static FORCE_INLINE void getMatrixFromTransform(const TransformComponent &trans, Mat3x4 &outMat)
+#if MATH_SIMD
+// Same operations as the scalar version in the same order, so results match it exactly.
+// rot is quaternion as x, y, z, w.
+static FORCE_INLINE void getMatrixFromTransformSimd(SimdFloat4 rot, float scaleX, float scaleY, float scaleZ,
+    float posX, float posY, float posZ, Mat3x4 &outMat)
 {
-    float xy2 = 2.0f * trans.rotation.v.x * trans.rotation.v.y;
-    float xz2 = 2.0f * trans.rotation.v.x * trans.rotation.v.z;
-    float yz2 = 2.0f * trans.rotation.v.y * trans.rotation.v.z;
-
-    float wx2 = 2.0f * trans.rotation.w * trans.rotation.v.x;
-    float wy2 = 2.0f * trans.rotation.w * trans.rotation.v.y;
-    float wz2 = 2.0f * trans.rotation.w * trans.rotation.v.z;
-
-    float xx2 = 2.0f * trans.rotation.v.x * trans.rotation.v.x;
-    float yy2 = 2.0f * trans.rotation.v.y * trans.rotation.v.y;
-    float zz2 = 2.0f * trans.rotation.v.z * trans.rotation.v.z;
-
-    outMat._00 = (1.0f - yy2 - zz2) * trans.scale.x;
-    outMat._01 = (xy2 - wz2) * trans.scale.x;
-    outMat._02 = (xz2 + wy2) * trans.scale.x;
-
-    outMat._10 = (xy2 + wz2) * trans.scale.y;
-    outMat._11 = (1.0f - xx2 - zz2) * trans.scale.y;
-    outMat._12 = (yz2 - wx2) * trans.scale.y;
-
-    outMat._20 = (xz2 - wy2) * trans.scale.z;
-    outMat._21 = (yz2 + wx2) * trans.scale.z;
-    outMat._22 = (1.0f - xx2 - yy2) * trans.scale.z;
+    SimdFloat4 rot2 = simdAdd(rot, rot);
+    SimdFloat4 x2 = simdSplatLane<0>(rot2);
+    SimdFloat4 y2 = simdSplatLane<1>(rot2);
+    SimdFloat4 z2 = simdSplatLane<2>(rot2);
+
+    // Rotation permutes, the signs zero the last lane.
+    SimdFloat4 yxww = simdPermute<1, 0, 3, 3>(rot);
+    SimdFloat4 zwxw = simdPermute<2, 3, 0, 3>(rot);
+    SimdFloat4 wzyw = simdPermute<3, 2, 1, 3>(rot);
+
+    // row0 = (1 - yy2 - zz2, xy2 - wz2, xz2 + wy2)
+    SimdFloat4 row0 = simdAdd(
+        simdAdd(simdSet(1.0f, 0.0f, 0.0f, 0.0f), simdMul(simdMul(yxww, simdSet(-1.0f, 1.0f, 1.0f, 0.0f)), y2)),
+        simdMul(simdMul(zwxw, simdSet(-1.0f, -1.0f, 1.0f, 0.0f)), z2));
+    // row1 = (xy2 + wz2, 1 - xx2 - zz2, yz2 - wx2)
+    SimdFloat4 row1 = simdAdd(
+        simdAdd(simdSet(0.0f, 1.0f, 0.0f, 0.0f), simdMul(simdMul(yxww, simdSet(1.0f, -1.0f, -1.0f, 0.0f)), x2)),
+        simdMul(simdMul(wzyw, simdSet(1.0f, -1.0f, 1.0f, 0.0f)), z2));
+    // row2 = (xz2 - wy2, yz2 + wx2, 1 - xx2 - yy2)
+    SimdFloat4 row2 = simdAdd(
+        simdAdd(simdSet(0.0f, 0.0f, 1.0f, 0.0f), simdMul(simdMul(zwxw, simdSet(1.0f, 1.0f, -1.0f, 0.0f)), x2)),
+        simdMul(simdMul(wzyw, simdSet(-1.0f, 1.0f, -1.0f, 0.0f)), y2));
+
+    simdStore(&outMat._00, simdAdd(simdMul(row0, simdSplat(scaleX)), simdSet(0.0f, 0.0f, 0.0f, posX)));
+    simdStore(&outMat._10, simdAdd(simdMul(row1, simdSplat(scaleY)), simdSet(0.0f, 0.0f, 0.0f, posY)));
+    simdStore(&outMat._20, simdAdd(simdMul(row2, simdSplat(scaleZ)), simdSet(0.0f, 0.0f, 0.0f, posZ)));
+}
 
-    outMat._03 = trans.position.x;
-    outMat._13 = trans.position.y;
-    outMat._23 = trans.position.z;
+// out = ((c0 * v.x + c1 * v.y) + c2 * v.z) + c3 * v.w, same order as the scalar dot products.
+static FORCE_INLINE SimdFloat4 mulRowsSimd(SimdFloat4 c0, SimdFloat4 c1, SimdFloat4 c2, SimdFloat4 c3, SimdFloat4 v)
+{
+    SimdFloat4 result = simdMul(c0, simdSplatLane<0>(v));
+    result = simdAdd(result, simdMul(c1, simdSplatLane<1>(v)));
+    result = simdAdd(result, simdMul(c2, simdSplatLane<2>(v)));
+    return simdAdd(result, simdMul(c3, simdSplatLane<3>(v)));
 }
+#endif
 
+static FORCE_INLINE Mat3x4 getMatrixFromTransform(const Transform &trans)
+{
+#if MATH_SIMD
+    static_assert(sizeof(Quaternion) == sizeof(float) * 4, "Quaternion loaded as 4 floats!");
+    Mat3x4 result{ Uninit };
+    getMatrixFromTransformSimd(simdLoadUnaligned(&trans.rot.v.x), trans.scale.x, trans.scale.y, trans.scale.z,
+        trans.pos.x, trans.pos.y, trans.pos.z, result);
+    return result;
+#else
+    return getMatrixFromTransformScalar(trans);
+#endif
+}
 
+static FORCE_INLINE void getMatrixFromTransform(const TransformComponent &trans, Mat3x4 &outMat)
+{
+#if MATH_SIMD
+    getMatrixFromTransformSimd(simdLoadUnaligned(&trans.rotation.v.x), trans.scale.x, trans.scale.y, trans.scale.z,
+        trans.position.x, trans.position.y, trans.position.z, outMat);
+#else
+    outMat = getMatrixFromTransformScalar(trans);
+#endif
+}
 
+static FORCE_INLINE Mat3x4 getMatrixFromTransform(const TransformComponent &trans)
+{
+    Mat3x4 result{ Uninit };
+    getMatrixFromTransform(trans, result);
+    return result;
+}
 
 
 static FORCE_INLINE Matrix transpose(const Matrix &m)
@@ -245,7 +285,7 @@ static FORCE_INLINE Matrix transpose(const Matrix &m)
 }
 
 
-static FORCE_INLINE Vec4 mul(const Matrix &m, const Vec4 &v)
+static FORCE_INLINE Vec4 mulScalar(const Matrix &m, const Vec4 &v)
 {
     Vec4 result{ Uninit };
     result.x = v.x * m._00 + v.y * m._01 + v.z * m._02 + v.w * m._03;
@@ -254,7 +294,7 @@ static FORCE_INLINE Vec4 mul(const Matrix &m, const Vec4 &v)
     result.w = v.x * m._30 + v.y * m._31 + v.z * m._32 + v.w * m._33;
     return result;
 }
-static FORCE_INLINE Vec4 mul(const Vec4 &v, const Matrix &m)
+static FORCE_INLINE Vec4 mulScalar(const Vec4 &v, const Matrix &m)
 {
     Vec4 result{ Uninit };
     result.x = v.x * m._00 + v.y * m._10 + v.z * m._20 + v.w * m._30;
@@ -264,7 +304,7 @@ static FORCE_INLINE Vec4 mul(const Vec4 &v, const Matrix &m)
     return result;
 }
 
-static FORCE_INLINE Vec4 mul(const Mat3x4 &m, const Vec4 &v)
+static FORCE_INLINE Vec4 mulScalar(const Mat3x4 &m, const Vec4 &v)
 {
     Vec4 result{ Uninit };
     result.x = v.x * m._00 + v.y * m._01 + v.z * m._02 + v.w * m._03;
@@ -273,7 +313,7 @@ static FORCE_INLINE Vec4 mul(const Mat3x4 &m, const Vec4 &v)
     result.w = v.w;
     return result;
 }
-static FORCE_INLINE Vec4 mul(const Vec4 &v, const Mat3x4 &m)
+static FORCE_INLINE Vec4 mulScalar(const Vec4 &v, const Mat3x4 &m)
 {
     Vec4 result{ Uninit };
     result.x = v.x * m._00 + v.y * m._10 + v.z * m._20;
@@ -285,55 +325,10 @@ static FORCE_INLINE Vec4 mul(const Vec4 &v, const Mat3x4 &m)
 
 
 
-static FORCE_INLINE Matrix operator*(const Matrix &a, const Matrix &b)
+static FORCE_INLINE Matrix mulScalar(const Matrix &a, const Matrix &b)
 {
     Matrix result{ Uninit };
 
-#if (__AVX__ || __SSE__ || __SSE2__ || __SSE3__ || __SSE4_1__ || _M_AMD64 || _M_X64) && 1
-
-    const __m128 aRows0 = _mm_load_ps(&a._00);
-    const __m128 aRows1 = _mm_load_ps(&a._10);
-    const __m128 aRows2 = _mm_load_ps(&a._20);
-    const __m128 aRows3 = _mm_load_ps(&a._30);
-
-    const __m128 bR0 = _mm_load_ps(&b._00);
-    const __m128 bR1 = _mm_load_ps(&b._10);
-    const __m128 bR2 = _mm_load_ps(&b._20);
-    const __m128 bR3 = _mm_load_ps(&b._30);
-    {
-        const __m128 r00 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r01 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r02 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r03 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r0Res = _mm_add_ps(_mm_add_ps(r00, r01), _mm_add_ps(r02, r03));
-        _mm_store_ps(&result._00, r0Res);
-    }
-    {
-        const __m128 r10 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r11 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r12 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r13 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r1Res = _mm_add_ps(_mm_add_ps(r10, r11), _mm_add_ps(r12, r13));
-        _mm_store_ps(&result._10, r1Res);
-    }
-    {
-        const __m128 r20 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r21 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r22 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r23 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r2Res = _mm_add_ps(_mm_add_ps(r20, r21), _mm_add_ps(r22, r23));
-        _mm_store_ps(&result._20, r2Res);
-    }
-    {
-        const __m128 r30 = _mm_mul_ps(_mm_shuffle_ps(aRows3, aRows3, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r31 = _mm_mul_ps(_mm_shuffle_ps(aRows3, aRows3, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r32 = _mm_mul_ps(_mm_shuffle_ps(aRows3, aRows3, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r33 = _mm_mul_ps(_mm_shuffle_ps(aRows3, aRows3, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r3Res = _mm_add_ps(_mm_add_ps(r30, r31), _mm_add_ps(r32, r33));
-        _mm_store_ps(&result._30, r3Res);
-    }
-#else
-
 #define MATRIX_ADD_ROW_MULT(row, col) (\
         a._##row##0 * b._0##col + \
         a._##row##1 * b._1##col + \
@@ -364,52 +359,14 @@ static FORCE_INLINE Matrix operator*(const Matrix &a, const Matrix &b)
 #undef MATRIX_ADD_ROW_MULT
 #undef MATRIX_SET
 
-#endif
     return result;
 }
 
 
-static FORCE_INLINE Mat3x4 operator*(const Mat3x4 &a, const Mat3x4 &b)
+static FORCE_INLINE Mat3x4 mulScalar(const Mat3x4 &a, const Mat3x4 &b)
 {
     Mat3x4 result{ Uninit };
 
-#if (__AVX__ || __SSE__ || __SSE2__ || __SSE3__ || __SSE4_1__ || _M_AMD64 || _M_X64) && 1
-
-    const __m128 aRows0 = _mm_load_ps(&a._00);
-    const __m128 aRows1 = _mm_load_ps(&a._10);
-    const __m128 aRows2 = _mm_load_ps(&a._20);
-
-    const __m128 bR0 = _mm_load_ps(&b._00);
-    const __m128 bR1 = _mm_load_ps(&b._10);
-    const __m128 bR2 = _mm_load_ps(&b._20);
-    const __m128 bR3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
-    {
-        const __m128 r00 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r01 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r02 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r03 = _mm_mul_ps(_mm_shuffle_ps(aRows0, aRows0, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r0Res = _mm_add_ps(_mm_add_ps(r00, r01), _mm_add_ps(r02, r03));
-        _mm_store_ps(&result._00, r0Res);
-    }
-    {
-        const __m128 r10 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r11 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r12 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r13 = _mm_mul_ps(_mm_shuffle_ps(aRows1, aRows1, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r1Res = _mm_add_ps(_mm_add_ps(r10, r11), _mm_add_ps(r12, r13));
-        _mm_store_ps(&result._10, r1Res);
-    }
-    {
-        const __m128 r20 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(0, 0, 0, 0)), bR0);
-        const __m128 r21 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(1, 1, 1, 1)), bR1);
-        const __m128 r22 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(2, 2, 2, 2)), bR2);
-        const __m128 r23 = _mm_mul_ps(_mm_shuffle_ps(aRows2, aRows2, _MM_SHUFFLE(3, 3, 3, 3)), bR3);
-        const __m128 r2Res = _mm_add_ps(_mm_add_ps(r20, r21), _mm_add_ps(r22, r23));
-        _mm_store_ps(&result._20, r2Res);
-    }
-
-#else
-
 #define MATRIX_ADD_ROW_MULT0(row, col) (\
         a._##row##0 * b._0##col + \
         a._##row##1 * b._1##col + \
@@ -443,7 +400,98 @@ static FORCE_INLINE Mat3x4 operator*(const Mat3x4 &a, const Mat3x4 &b)
 #undef MATRIX_SET0
 #undef MATRIX_SET1
 
+    return result;
+}
+
+static FORCE_INLINE Vec4 mul(const Matrix &m, const Vec4 &v)
+{
+#if MATH_SIMD
+    SimdFloat4 c0 = simdSet(m._00, m._10, m._20, m._30);
+    SimdFloat4 c1 = simdSet(m._01, m._11, m._21, m._31);
+    SimdFloat4 c2 = simdSet(m._02, m._12, m._22, m._32);
+    SimdFloat4 c3 = simdSet(m._03, m._13, m._23, m._33);
+    Vec4 result{ Uninit };
+    simdStoreUnaligned(&result.x, mulRowsSimd(c0, c1, c2, c3, simdLoadUnaligned(&v.x)));
+    return result;
+#else
+    return mulScalar(m, v);
 #endif
+}
+
+static FORCE_INLINE Vec4 mul(const Vec4 &v, const Matrix &m)
+{
+#if MATH_SIMD
+    Vec4 result{ Uninit };
+    simdStoreUnaligned(&result.x, mulRowsSimd(simdLoad(&m._00), simdLoad(&m._10), simdLoad(&m._20), simdLoad(&m._30),
+        simdLoadUnaligned(&v.x)));
     return result;
+#else
+    return mulScalar(v, m);
+#endif
+}
+
+static FORCE_INLINE Vec4 mul(const Mat3x4 &m, const Vec4 &v)
+{
+#if MATH_SIMD
+    // Last column gives v.w unchanged.
+    SimdFloat4 c0 = simdSet(m._00, m._10, m._20, 0.0f);
+    SimdFloat4 c1 = simdSet(m._01, m._11, m._21, 0.0f);
+    SimdFloat4 c2 = simdSet(m._02, m._12, m._22, 0.0f);
+    SimdFloat4 c3 = simdSet(m._03, m._13, m._23, 1.0f);
+    Vec4 result{ Uninit };
+    simdStoreUnaligned(&result.x, mulRowsSimd(c0, c1, c2, c3, simdLoadUnaligned(&v.x)));
+    return result;
+#else
+    return mulScalar(m, v);
+#endif
+}
+
+static FORCE_INLINE Vec4 mul(const Vec4 &v, const Mat3x4 &m)
+{
+#if MATH_SIMD
+    Vec4 result{ Uninit };
+    simdStoreUnaligned(&result.x, mulRowsSimd(simdLoad(&m._00), simdLoad(&m._10), simdLoad(&m._20),
+        simdSet(0.0f, 0.0f, 0.0f, 1.0f), simdLoadUnaligned(&v.x)));
+    return result;
+#else
+    return mulScalar(v, m);
+#endif
+}
+
+static FORCE_INLINE Matrix operator*(const Matrix &a, const Matrix &b)
+{
+#if MATH_SIMD
+    SimdFloat4 b0 = simdLoad(&b._00);
+    SimdFloat4 b1 = simdLoad(&b._10);
+    SimdFloat4 b2 = simdLoad(&b._20);
+    SimdFloat4 b3 = simdLoad(&b._30);
+
+    Matrix result{ Uninit };
+    simdStore(&result._00, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._00)));
+    simdStore(&result._10, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._10)));
+    simdStore(&result._20, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._20)));
+    simdStore(&result._30, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._30)));
+    return result;
+#else
+    return mulScalar(a, b);
+#endif
+}
+
+static FORCE_INLINE Mat3x4 operator*(const Mat3x4 &a, const Mat3x4 &b)
+{
+#if MATH_SIMD
+    SimdFloat4 b0 = simdLoad(&b._00);
+    SimdFloat4 b1 = simdLoad(&b._10);
+    SimdFloat4 b2 = simdLoad(&b._20);
+    SimdFloat4 b3 = simdSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+    Mat3x4 result{ Uninit };
+    simdStore(&result._00, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._00)));
+    simdStore(&result._10, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._10)));
+    simdStore(&result._20, mulRowsSimd(b0, b1, b2, b3, simdLoad(&a._20)));
+    return result;
+#else
+    return mulScalar(a, b);
+#endif
 }
 
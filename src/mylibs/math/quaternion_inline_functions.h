@@ -1,6 +1,8 @@
 #pragma once
 
+#include <math/fastmath.h>
 #include <math/quaternion.h>
+#include <math/simd.h>
 #include <math/vector3_inline_functions.h>
 
 
@@ -28,7 +30,8 @@ static FORCE_INLINE Quaternion operator *(const Quaternion &a, const Quaternion
     );
 }
 
-static FORCE_INLINE Quaternion normalize(const Quaternion &q)
+// Scalar reference version, the SIMD one sums the squares in different order.
+static FORCE_INLINE Quaternion normalizeScalar(const Quaternion &q)
 {
     if(q.v.x == 0.0f && q.v.y == 0.0f && q.v.z == 0.0f && q.w == 0.0f)
     {
@@ -45,6 +48,25 @@ static FORCE_INLINE Quaternion normalize(const Quaternion &q)
     return result;
 }
 
+static FORCE_INLINE Quaternion normalize(const Quaternion &q)
+{
+#if MATH_SIMD
+    if(q.v.x == 0.0f && q.v.y == 0.0f && q.v.z == 0.0f && q.w == 0.0f)
+    {
+        ASSERT(false && "Quaternion 0 on normalize");
+        return Quaternion();
+    }
+    static_assert(sizeof(Quaternion) == sizeof(float) * 4, "Quaternion loaded as 4 floats!");
+    SimdFloat4 quat = simdLoadUnaligned(&q.v.x);
+    SimdFloat4 length = simdDiv(simdSplat(1.0f), simdSqrt(simdDot4(quat, quat)));
+    Quaternion result{ Uninit };
+    simdStoreUnaligned(&result.v.x, simdMul(quat, length));
+    return result;
+#else
+    return normalizeScalar(q);
+#endif
+}
+
 static FORCE_INLINE Quaternion conjugate(const Quaternion &q)
 {
     return Quaternion(-q.v, q.w);
@@ -87,6 +109,18 @@ static FORCE_INLINE Quaternion getQuaternionFromAxisAngle(const Vector3 &v, floa
     return result;
 }
 
+// Polynomial sin and cos, see fastmath.h for the error.
+static FORCE_INLINE Quaternion getQuaternionFromAxisAngleFast(const Vector3 &v, float angle)
+{
+    float s = Supa::fastSinf(angle * 0.5f);
+
+    Quaternion result;
+    result.v = normalize(v) * s;
+
+    result.w = Supa::fastCosf(angle * 0.5f);
+    return result;
+}
+
 static FORCE_INLINE Quaternion getQuaternionFromNormalizedVectors(const Vector3 &from, const Vector3 &toVector)
 {
     Quaternion result;
@@ -123,7 +157,7 @@ static FORCE_INLINE Quaternion operator*(float t, const Quaternion &q)
     return q * t;
 }
 
-static FORCE_INLINE Quaternion lerp(Quaternion const &q1, Quaternion const &q2, float t)
+static FORCE_INLINE Quaternion lerpScalar(Quaternion const &q1, Quaternion const &q2, float t)
 {
     float dotAngle = dot(q1, q2);
     Quaternion result{ Uninit };
@@ -144,6 +178,20 @@ static FORCE_INLINE Quaternion lerp(Quaternion const &q1, Quaternion const &q2,
     return result;
 }
 
+static FORCE_INLINE Quaternion lerp(Quaternion const &q1, Quaternion const &q2, float t)
+{
+#if MATH_SIMD
+    // Negating q2 is exact, so this matches the scalar version.
+    SimdFloat4 quat1 = simdLoadUnaligned(&q1.v.x);
+    SimdFloat4 quat2 = simdMul(simdLoadUnaligned(&q2.v.x), simdSplat(dot(q1, q2) < 0.0f ? -1.0f : 1.0f));
+    Quaternion result{ Uninit };
+    simdStoreUnaligned(&result.v.x, simdSub(quat1, simdMul(simdSplat(t), simdSub(quat1, quat2))));
+    return result;
+#else
+    return lerpScalar(q1, q2, t);
+#endif
+}
+
 static FORCE_INLINE Quaternion slerp(Quaternion const &q1, Quaternion const &q2, float t)
 {
     float dotAngle = dot(q1, q2);
@@ -179,11 +227,13 @@ static FORCE_INLINE Quaternion slerp(Quaternion const &q1, Quaternion const &q2,
     return normalize(result);
 }
 
-static FORCE_INLINE void getDirectionsFromPitchYawRoll(float pitch, float yaw, float roll, Vector3 &rightDir, Vector3 &upDir, Vector3 &forwardDir)
+static FORCE_INLINE void getDirectionsFromPitchYawRoll(float pitch, float yaw, float roll, Vector3 &rightDir, Vector3 &upDir, Vector3 &forwardDir,
+    bool useFastMath = false)
 {
-    Quat rotation = getQuaternionFromAxisAngle(Vector3(0.0f, 0.0f, 1.0f), roll);
-    rotation = getQuaternionFromAxisAngle(Vector3(1.0f, 0.0f, 0.0f), pitch) * rotation;
-    rotation = getQuaternionFromAxisAngle(Vector3(0.0f, 1.0f, 0.0f), yaw) * rotation;
+    auto fromAxisAngle = useFastMath ? getQuaternionFromAxisAngleFast : getQuaternionFromAxisAngle;
+    Quat rotation = fromAxisAngle(Vector3(0.0f, 0.0f, 1.0f), roll);
+    rotation = fromAxisAngle(Vector3(1.0f, 0.0f, 0.0f), pitch) * rotation;
+    rotation = fromAxisAngle(Vector3(0.0f, 1.0f, 0.0f), yaw) * rotation;
 
     rightDir = rotateVector(Vector3(1.0f, 0.0, 0.0f), rotation);
     upDir = rotateVector(Vector3(0.0, 1.0, 0.0f), rotation);
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <core/general.h>
+
+// Compile time math backend, SSE2 on x64, NEON on arm64, scalar code otherwise.
+// Defining MATH_SCALAR_ONLY forces the scalar reference functions everywhere.
+#if !defined(MATH_SCALAR_ONLY) && (__SSE2__ || _M_AMD64 || _M_X64)
+    #define MATH_SIMD_SSE 1
+    #include <emmintrin.h>
+#elif !defined(MATH_SCALAR_ONLY) && (__ARM_NEON && __aarch64__)
+    #define MATH_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#if MATH_SIMD_SSE || MATH_SIMD_NEON
+    #define MATH_SIMD 1
+#else
+    #define MATH_SIMD 0
+#endif
+
+#if MATH_SIMD_SSE
+
+using SimdFloat4 = __m128;
+using SimdInt4 = __m128i;
+
+// Loads and stores need 16 byte alignment, unaligned ones for Quaternion and Vector4 members.
+static FORCE_INLINE SimdFloat4 simdLoad(const float *values) { return _mm_load_ps(values); }
+static FORCE_INLINE SimdFloat4 simdLoadUnaligned(const float *values) { return _mm_loadu_ps(values); }
+static FORCE_INLINE void simdStore(float *values, SimdFloat4 v) { _mm_store_ps(values, v); }
+static FORCE_INLINE void simdStoreUnaligned(float *values, SimdFloat4 v) { _mm_storeu_ps(values, v); }
+
+static FORCE_INLINE SimdFloat4 simdSet(float x, float y, float z, float w) { return _mm_set_ps(w, z, y, x); }
+static FORCE_INLINE SimdFloat4 simdSplat(float value) { return _mm_set1_ps(value); }
+
+static FORCE_INLINE SimdFloat4 simdAdd(SimdFloat4 a, SimdFloat4 b) { return _mm_add_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdSub(SimdFloat4 a, SimdFloat4 b) { return _mm_sub_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdMul(SimdFloat4 a, SimdFloat4 b) { return _mm_mul_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdDiv(SimdFloat4 a, SimdFloat4 b) { return _mm_div_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdSqrt(SimdFloat4 a) { return _mm_sqrt_ps(a); }
+static FORCE_INLINE SimdFloat4 simdMin(SimdFloat4 a, SimdFloat4 b) { return _mm_min_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdMax(SimdFloat4 a, SimdFloat4 b) { return _mm_max_ps(a, b); }
+static FORCE_INLINE SimdFloat4 simdXor(SimdFloat4 a, SimdFloat4 b) { return _mm_xor_ps(a, b); }
+
+// Rounds to nearest, ties to even with the default rounding mode.
+static FORCE_INLINE SimdInt4 simdRoundToInt(SimdFloat4 v) { return _mm_cvtps_epi32(v); }
+static FORCE_INLINE SimdFloat4 simdIntToFloat(SimdInt4 v) { return _mm_cvtepi32_ps(v); }
+static FORCE_INLINE SimdInt4 simdCastToInt(SimdFloat4 v) { return _mm_castps_si128(v); }
+static FORCE_INLINE SimdFloat4 simdCastToFloat(SimdInt4 v) { return _mm_castsi128_ps(v); }
+
+static FORCE_INLINE SimdInt4 simdSplatInt(i32 value) { return _mm_set1_epi32(value); }
+static FORCE_INLINE SimdInt4 simdAddInt(SimdInt4 a, SimdInt4 b) { return _mm_add_epi32(a, b); }
+static FORCE_INLINE SimdInt4 simdSubInt(SimdInt4 a, SimdInt4 b) { return _mm_sub_epi32(a, b); }
+template <i32 Bits>
+static FORCE_INLINE SimdInt4 simdShiftLeftInt(SimdInt4 v) { return _mm_slli_epi32(v, Bits); }
+// Arithmetic shift, keeps the sign.
+template <i32 Bits>
+static FORCE_INLINE SimdInt4 simdShiftRightInt(SimdInt4 v) { return _mm_srai_epi32(v, Bits); }
+
+// Result lane i is lane Xi of v.
+template <u32 X, u32 Y, u32 Z, u32 W>
+static FORCE_INLINE SimdFloat4 simdPermute(SimdFloat4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X)); }
+
+static FORCE_INLINE float simdGetX(SimdFloat4 v) { return _mm_cvtss_f32(v); }
+
+// Rows into columns.
+static FORCE_INLINE void simdTranspose(SimdFloat4 &r0, SimdFloat4 &r1, SimdFloat4 &r2, SimdFloat4 &r3)
+{
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+
+#elif MATH_SIMD_NEON
+
+using SimdFloat4 = float32x4_t;
+using SimdInt4 = int32x4_t;
+
+static FORCE_INLINE SimdFloat4 simdLoad(const float *values) { return vld1q_f32(values); }
+static FORCE_INLINE SimdFloat4 simdLoadUnaligned(const float *values) { return vld1q_f32(values); }
+static FORCE_INLINE void simdStore(float *values, SimdFloat4 v) { vst1q_f32(values, v); }
+static FORCE_INLINE void simdStoreUnaligned(float *values, SimdFloat4 v) { vst1q_f32(values, v); }
+
+static FORCE_INLINE SimdFloat4 simdSet(float x, float y, float z, float w)
+{
+    alignas(16) float values[4] = { x, y, z, w };
+    return vld1q_f32(values);
+}
+static FORCE_INLINE SimdFloat4 simdSplat(float value) { return vdupq_n_f32(value); }
+
+static FORCE_INLINE SimdFloat4 simdAdd(SimdFloat4 a, SimdFloat4 b) { return vaddq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdSub(SimdFloat4 a, SimdFloat4 b) { return vsubq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdMul(SimdFloat4 a, SimdFloat4 b) { return vmulq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdDiv(SimdFloat4 a, SimdFloat4 b) { return vdivq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdSqrt(SimdFloat4 a) { return vsqrtq_f32(a); }
+static FORCE_INLINE SimdFloat4 simdMin(SimdFloat4 a, SimdFloat4 b) { return vminq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdMax(SimdFloat4 a, SimdFloat4 b) { return vmaxq_f32(a, b); }
+static FORCE_INLINE SimdFloat4 simdXor(SimdFloat4 a, SimdFloat4 b)
+{
+    return vreinterpretq_f32_s32(veorq_s32(vreinterpretq_s32_f32(a), vreinterpretq_s32_f32(b)));
+}
+
+static FORCE_INLINE SimdInt4 simdRoundToInt(SimdFloat4 v) { return vcvtnq_s32_f32(v); }
+static FORCE_INLINE SimdFloat4 simdIntToFloat(SimdInt4 v) { return vcvtq_f32_s32(v); }
+static FORCE_INLINE SimdInt4 simdCastToInt(SimdFloat4 v) { return vreinterpretq_s32_f32(v); }
+static FORCE_INLINE SimdFloat4 simdCastToFloat(SimdInt4 v) { return vreinterpretq_f32_s32(v); }
+
+static FORCE_INLINE SimdInt4 simdSplatInt(i32 value) { return vdupq_n_s32(value); }
+static FORCE_INLINE SimdInt4 simdAddInt(SimdInt4 a, SimdInt4 b) { return vaddq_s32(a, b); }
+static FORCE_INLINE SimdInt4 simdSubInt(SimdInt4 a, SimdInt4 b) { return vsubq_s32(a, b); }
+template <i32 Bits>
+static FORCE_INLINE SimdInt4 simdShiftLeftInt(SimdInt4 v) { return vshlq_n_s32(v, Bits); }
+template <i32 Bits>
+static FORCE_INLINE SimdInt4 simdShiftRightInt(SimdInt4 v) { return vshrq_n_s32(v, Bits); }
+
+template <u32 X, u32 Y, u32 Z, u32 W>
+static FORCE_INLINE SimdFloat4 simdPermute(SimdFloat4 v) { return __builtin_shufflevector(v, v, X, Y, Z, W); }
+
+static FORCE_INLINE float simdGetX(SimdFloat4 v) { return vgetq_lane_f32(v, 0); }
+
+static FORCE_INLINE void simdTranspose(SimdFloat4 &r0, SimdFloat4 &r1, SimdFloat4 &r2, SimdFloat4 &r3)
+{
+    SimdFloat4 t0 = vzip1q_f32(r0, r2);
+    SimdFloat4 t1 = vzip1q_f32(r1, r3);
+    SimdFloat4 t2 = vzip2q_f32(r0, r2);
+    SimdFloat4 t3 = vzip2q_f32(r1, r3);
+    r0 = vzip1q_f32(t0, t1);
+    r1 = vzip2q_f32(t0, t1);
+    r2 = vzip1q_f32(t2, t3);
+    r3 = vzip2q_f32(t2, t3);
+}
+
+#endif
+
+#if MATH_SIMD
+
+template <u32 Lane>
+static FORCE_INLINE SimdFloat4 simdSplatLane(SimdFloat4 v) { return simdPermute<Lane, Lane, Lane, Lane>(v); }
+
+// Dot product of all 4 lanes in every lane.
+static FORCE_INLINE SimdFloat4 simdDot4(SimdFloat4 a, SimdFloat4 b)
+{
+    SimdFloat4 mul = simdMul(a, b);
+    SimdFloat4 sum = simdAdd(mul, simdPermute<1, 0, 3, 2>(mul));
+    return simdAdd(sum, simdPermute<2, 3, 0, 1>(sum));
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include "buffercopybatch.h"
+
+#include <container/podvector.h>
+#include <core/assert.h>
+
+#include <algorithm>
+
+static bool sPieceLess(const BufferCopyCommand &a, const BufferCopyCommand &b)
+{
+    if(a.dstBuffer != b.dstBuffer)
+        return a.dstBuffer < b.dstBuffer;
+    if(a.srcBuffer != b.srcBuffer)
+        return a.srcBuffer < b.srcBuffer;
+    return a.dstOffset < b.dstOffset;
+}
+
+static bool sRangeLess(const BufferCopyRange &a, const BufferCopyRange &b)
+{
+    if(a.dstBuffer != b.dstBuffer)
+        return a.dstBuffer < b.dstBuffer;
+    return a.offset < b.offset;
+}
+
+// Adds the parts of copy not in covered to pieces, covered is sorted and non overlapping.
+static void sAddUncoveredPieces(const BufferCopyCommand &copy, const PodVector<BufferCopyRange> &covered,
+    PodVector<BufferCopyCommand> &pieces)
+{
+    u64 start = copy.dstOffset;
+    u64 end = copy.dstOffset + copy.size;
+    for(const BufferCopyRange &range : covered)
+    {
+        if(start >= end || range.offset >= end)
+            break;
+        u64 rangeEnd = range.offset + range.size;
+        if(rangeEnd <= start)
+            continue;
+        if(range.offset > start)
+        {
+            BufferCopyCommand piece = copy;
+            piece.srcOffset = copy.srcOffset + (start - copy.dstOffset);
+            piece.dstOffset = start;
+            piece.size = range.offset - start;
+            pieces.pushBack(piece);
+        }
+        start = rangeEnd;
+    }
+    if(start < end)
+    {
+        BufferCopyCommand piece = copy;
+        piece.srcOffset = copy.srcOffset + (start - copy.dstOffset);
+        piece.dstOffset = start;
+        piece.size = end - start;
+        pieces.pushBack(piece);
+    }
+}
+
+// Inserts the range keeping covered sorted, merging it with the ranges it touches.
+static void sAddCovered(u64 offset, u64 size, PodVector<BufferCopyRange> &covered)
+{
+    u64 start = offset;
+    u64 end = offset + size;
+    u32 insertIndex = 0u;
+    u32 keep = 0u;
+    for(u32 i = 0; i < covered.size(); ++i)
+    {
+        BufferCopyRange range = covered[i];
+        u64 rangeEnd = range.offset + range.size;
+        if(rangeEnd < start)
+        {
+            covered[keep++] = range;
+            insertIndex = keep;
+        }
+        else if(range.offset > end)
+        {
+            covered[keep++] = range;
+        }
+        else
+        {
+            start = range.offset < start ? range.offset : start;
+            end = rangeEnd > end ? rangeEnd : end;
+        }
+    }
+    covered.resize(keep);
+    covered.insertIndex(insertIndex, BufferCopyRange{ .dstBuffer = 0u, .offset = start, .size = end - start });
+}
+
+void batchBufferCopies(const BufferCopyCommand *copies, u32 copyCount, BufferCopyBatches &outBatches)
+{
+    outBatches.batches.clear();
+    outBatches.regions.clear();
+    outBatches.ranges.clear();
+    PodVector<BufferCopyCommand> &pieces = outBatches.pieces;
+    pieces.clear();
+
+    // Per destination, latest copy first, so the parts later copies overwrite can be cut
+    // from the earlier ones.
+    PodVector<u32> &order = outBatches.order;
+    order.clear();
+    for(u32 i = 0; i < copyCount; ++i)
+    {
+        ASSERT(copies[i].size > 0u);
+        if(copies[i].size > 0u)
+            order.pushBack(i);
+    }
+    std::sort(order.begin(), order.end(), [copies](u32 a, u32 b)
+    {
+        if(copies[a].dstBuffer != copies[b].dstBuffer)
+            return copies[a].dstBuffer < copies[b].dstBuffer;
+        return a > b;
+    });
+
+    PodVector<BufferCopyRange> &covered = outBatches.covered;
+    covered.clear();
+    for(u32 i = 0; i < order.size(); ++i)
+    {
+        const BufferCopyCommand &copy = copies[order[i]];
+        if(i > 0u && copies[order[i - 1u]].dstBuffer != copy.dstBuffer)
+            covered.clear();
+        sAddUncoveredPieces(copy, covered, pieces);
+        sAddCovered(copy.dstOffset, copy.size, covered);
+    }
+    if(pieces.size() == 0u)
+        return;
+
+    std::sort(pieces.begin(), pieces.end(), sPieceLess);
+
+    for(const BufferCopyCommand &piece : pieces)
+    {
+        BufferCopyBatch *batch = outBatches.batches.size() > 0u ? &outBatches.batches.back() : nullptr;
+        if(batch && batch->srcBuffer == piece.srcBuffer && batch->dstBuffer == piece.dstBuffer)
+        {
+            BufferCopyRegion &last = outBatches.regions.back();
+            if(last.srcOffset + last.size == piece.srcOffset && last.dstOffset + last.size == piece.dstOffset)
+            {
+                last.size += piece.size;
+                continue;
+            }
+            ++batch->regionCount;
+        }
+        else
+        {
+            outBatches.batches.pushBack(BufferCopyBatch{ .srcBuffer = piece.srcBuffer, .dstBuffer = piece.dstBuffer,
+                .firstRegion = outBatches.regions.size(), .regionCount = 1u });
+        }
+        outBatches.regions.pushBack(BufferCopyRegion{ .srcOffset = piece.srcOffset, .dstOffset = piece.dstOffset,
+            .size = piece.size });
+    }
+
+    // Destination ranges touching each other share a barrier, whichever source they came from.
+    for(const BufferCopyCommand &piece : pieces)
+        outBatches.ranges.pushBack(BufferCopyRange{ .dstBuffer = piece.dstBuffer, .offset = piece.dstOffset,
+            .size = piece.size });
+    std::sort(outBatches.ranges.begin(), outBatches.ranges.end(), sRangeLess);
+    u32 rangeCount = 0u;
+    for(u32 i = 0; i < outBatches.ranges.size(); ++i)
+    {
+        BufferCopyRange range = outBatches.ranges[i];
+        if(rangeCount > 0u)
+        {
+            BufferCopyRange &last = outBatches.ranges[rangeCount - 1u];
+            if(last.dstBuffer == range.dstBuffer && last.offset + last.size >= range.offset)
+            {
+                u64 rangeEnd = range.offset + range.size;
+                if(rangeEnd > last.offset + last.size)
+                    last.size = rangeEnd - last.offset;
+                continue;
+            }
+        }
+        outBatches.ranges[rangeCount++] = range;
+    }
+    outBatches.ranges.resize(rangeCount);
+}
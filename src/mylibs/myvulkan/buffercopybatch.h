@@ -0,0 +1,58 @@
+#pragma once
+
+#include <container/podvectorsbase.h>
+#include <core/mytypes.h>
+
+// Groups the buffer copies recorded during a frame into as few copy commands and barriers
+// as possible. Buffers are plain handles so the batching runs without a gpu.
+
+struct BufferCopyCommand
+{
+    u64 srcBuffer = 0u;
+    u64 dstBuffer = 0u;
+    u64 srcOffset = 0u;
+    u64 dstOffset = 0u;
+    u64 size = 0u;
+};
+
+// Same layout as VkBufferCopy.
+struct BufferCopyRegion
+{
+    u64 srcOffset = 0u;
+    u64 dstOffset = 0u;
+    u64 size = 0u;
+};
+
+// One copy command, regions[firstRegion] to regions[firstRegion + regionCount - 1].
+struct BufferCopyBatch
+{
+    u64 srcBuffer = 0u;
+    u64 dstBuffer = 0u;
+    u32 firstRegion = 0u;
+    u32 regionCount = 0u;
+};
+
+// Written range of a destination buffer, one barrier each.
+struct BufferCopyRange
+{
+    u64 dstBuffer = 0u;
+    u64 offset = 0u;
+    u64 size = 0u;
+};
+
+struct BufferCopyBatches
+{
+    PodVector<BufferCopyBatch> batches;
+    PodVector<BufferCopyRegion> regions;
+    PodVector<BufferCopyRange> ranges;
+
+    // Scratch, kept between calls to not allocate every frame.
+    PodVector<BufferCopyCommand> pieces;
+    PodVector<BufferCopyRange> covered;
+    PodVector<u32> order;
+};
+
+// Copies are given in recording order. Where destinations overlap the later copy wins and
+// the covered part of the earlier one is dropped. Regions continuing each other in both
+// source and destination are merged. Batches are sorted by destination, then source buffer.
+void batchBufferCopies(const BufferCopyCommand *copies, u32 copyCount, BufferCopyBatches &outBatches);
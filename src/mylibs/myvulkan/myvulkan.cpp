@@ -10,7 +10,9 @@
 #include <container/podvectortypedefine.h>
 #include <container/string.h>
 
+#include <core/file.h>
 #include <core/mytypes.h>
+#include <core/timer.h>
 
 #include <math/vector3.h>
 
@@ -80,6 +82,7 @@ static PFN_vkCmdDebugMarkerInsertEXT pfnCmdDebugMarkerInsert = nullptr;
 struct VulkanDeviceOptionals
 {
     bool canUseVulkanRenderdocExtensionMarker = false;
+    bool canUseMultiDrawIndirect = false;
 };
 
 static const VkValidationFeatureEnableEXT sEnabledValidationFeatures[] =
@@ -124,11 +127,16 @@ static const char* sAddCheckDeviceExtensions[] =
 
 static PodVector<const char*> sGetRequiredInstanceExtensions()
 {
-    u32 glfwExtensionCount = 0u;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    PodVector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    PodVector<const char*> extensions;
+    // Headless has no surface, so no window system extensions either.
+    if(!VulkanInitializationParameters::get().headless)
+    {
+        u32 glfwExtensionCount = 0u;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        for(u32 i = 0; i < glfwExtensionCount; ++i)
+            extensions.pushBack(glfwExtensions[i]);
+    }
 
     extensions.pushBack(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 #if NDEBUG
@@ -220,6 +228,11 @@ static VulkanDeviceOptionals sGetDeviceOptionals(VkPhysicalDevice physicalDevice
             result.canUseVulkanRenderdocExtensionMarker = true;
     }
 
+    // Indirect draws with several commands and first instance set, otherwise each command gets drawn directly.
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    result.canUseMultiDrawIndirect = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
     return result;
 }
 
@@ -262,6 +275,13 @@ static QueueFamilyIndices sFindQueueFamilies(VkPhysicalDevice physicalDevice, Vk
             continue;
         indices.graphicsFamily = indices.transferFamily = indices.computeFamily = i;
 
+        // Headless "presents" by copying on the graphics queue.
+        if(surface == VK_NULL_HANDLE)
+        {
+            indices.presentFamily = i;
+            break;
+        }
+
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
 
@@ -443,6 +463,197 @@ static bool sCreateSwapchain(VSyncType vsyncMode)
 }
 
 
+// Headless swapchain, the offscreen images stand in for swapchain images one per frame in flight.
+static bool sCreateHeadlessImages()
+{
+    const WindowApp &windowApp = VulkanApp::getWindowApp();
+    u32 width = u32(windowApp.windowWidth);
+    u32 height = u32(windowApp.windowHeight);
+    bool dumpFrames = VulkanInitializationParameters::get().headlessFrameDumpPath != nullptr;
+
+    vulk->swapchain.images.clear();
+    for(u32 i = 0; i < VulkanGlobal::FramesInFlight; ++i)
+    {
+        // Sampled only because image views need some view usage.
+        if(!VulkanResources::createImage(width, height, vulk->presentColorFormat,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Headless present image", vulk->headlessImages[i]))
+        {
+            return false;
+        }
+        vulk->swapchain.images.pushBack(vulk->headlessImages[i].image);
+
+        if(dumpFrames)
+        {
+            vulk->headlessReadbackBuffers[i] = VulkanResources::createBuffer(width * height * 4u,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "Headless readback buffer");
+            if(!vulk->headlessReadbackBuffers[i].data)
+                return false;
+        }
+        vulk->headlessReadbackPending[i] = false;
+    }
+    vulk->swapchain.swapchainCount = VulkanGlobal::FramesInFlight;
+    vulk->swapchain.width = width;
+    vulk->swapchain.height = height;
+    return true;
+}
+
+// Writes the frame copied into the readback buffer as binary ppm, once its fence has passed.
+static void sWriteHeadlessFrame(u32 index)
+{
+    if(!vulk->headlessReadbackPending[index])
+        return;
+    vulk->headlessReadbackPending[index] = false;
+
+    Buffer &buffer = vulk->headlessReadbackBuffers[index];
+    VulkanResources::invalidateBuffer(buffer);
+
+    u32 width = vulk->swapchain.width;
+    u32 height = vulk->swapchain.height;
+    bool isBgra = vulk->presentColorFormat == VK_FORMAT_B8G8R8A8_UNORM;
+
+    char header[64];
+    i32 headerSize = snprintf(header, ARRAYSIZES(header), "P6\n%u %u\n255\n", width, height);
+    ASSERT(headerSize > 0);
+
+    PodVector<u8> fileData;
+    fileData.resize(u32(headerSize) + width * height * 3u);
+    Supa::memcpy(fileData.data(), header, headerSize);
+
+    const u8 *pixels = (const u8 *)buffer.data;
+    u8 *rgb = fileData.data() + headerSize;
+    for(u32 i = 0; i < width * height; ++i)
+    {
+        rgb[i * 3 + 0] = pixels[i * 4 + (isBgra ? 2 : 0)];
+        rgb[i * 3 + 1] = pixels[i * 4 + 1];
+        rgb[i * 3 + 2] = pixels[i * 4 + (isBgra ? 0 : 2)];
+    }
+
+    String filename = VulkanInitializationParameters::get().headlessFrameDumpPath;
+    filename.append(vulk->headlessReadbackFrames[index]);
+    filename.append(".ppm");
+    if(!writeBytes(filename.getStr(), fileData.getBuffer()))
+        printf("Failed to write headless frame: %s\n", filename.getStr());
+}
+
+static void sDestroyHeadlessImages()
+{
+    for(u32 i = 0; i < VulkanGlobal::FramesInFlight; ++i)
+    {
+        sWriteHeadlessFrame(i);
+        VulkanResources::destroyImage(vulk->headlessImages[i]);
+        if(vulk->headlessReadbackBuffers[i].buffer)
+            VulkanResources::destroyBuffer(vulk->headlessReadbackBuffers[i]);
+    }
+    vulk->swapchain.images.clear();
+    vulk->swapchain.swapchainCount = 0u;
+}
+
+
+// Written in front of the driver cache data. Drivers check their own header too, but not all
+// of them survive data from another driver version, so anything not matching gets dropped here.
+struct PipelineCacheFileHeader
+{
+    static constexpr u32 Magic = 0x4850'4331u;
+
+    u32 magic = Magic;
+    u32 dataSize = 0u;
+    u32 vendorId = 0u;
+    u32 deviceId = 0u;
+    u32 driverVersion = 0u;
+    u8 pipelineCacheUUID[VK_UUID_SIZE] = {};
+};
+
+static PipelineCacheFileHeader sGetPipelineCacheHeader(u32 dataSize)
+{
+    VkPhysicalDeviceProperties prop;
+    vkGetPhysicalDeviceProperties(vulk->physicalDevice, &prop);
+
+    PipelineCacheFileHeader header;
+    header.dataSize = dataSize;
+    header.vendorId = prop.vendorID;
+    header.deviceId = prop.deviceID;
+    header.driverVersion = prop.driverVersion;
+    Supa::memcpy(header.pipelineCacheUUID, prop.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+static bool sCreatePipelineCache()
+{
+    const char *cachePath = VulkanInitializationParameters::get().pipelineCachePath;
+
+    ByteBuffer fileData(1, BufferType::PODVECTOR);
+    const u8 *initialData = nullptr;
+    u32 initialDataSize = 0u;
+    if(cachePath && loadBytes(cachePath, fileData)
+        && fileData.getSize() >= sizeof(PipelineCacheFileHeader))
+    {
+        PipelineCacheFileHeader fileHeader;
+        Supa::memcpy(&fileHeader, fileData.getBegin(), sizeof(PipelineCacheFileHeader));
+        u32 dataSize = fileData.getSize() - u32(sizeof(PipelineCacheFileHeader));
+
+        PipelineCacheFileHeader deviceHeader = sGetPipelineCacheHeader(dataSize);
+        if(Supa::memcmp(&fileHeader, &deviceHeader, sizeof(PipelineCacheFileHeader)) == 0)
+        {
+            initialData = fileData.getBegin() + sizeof(PipelineCacheFileHeader);
+            initialDataSize = dataSize;
+        }
+        else
+        {
+            printf("Pipeline cache %s is for another device or driver, starting cold\n", cachePath);
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    createInfo.initialDataSize = initialDataSize;
+    createInfo.pInitialData = initialData;
+
+    VkResult res = vkCreatePipelineCache(vulk->device, &createInfo, nullptr, &vulk->pipelineCache);
+    if(res != VK_SUCCESS && initialData)
+    {
+        // Driver refused the data, empty cache still works.
+        initialDataSize = 0u;
+        createInfo.initialDataSize = 0u;
+        createInfo.pInitialData = nullptr;
+        res = vkCreatePipelineCache(vulk->device, &createInfo, nullptr, &vulk->pipelineCache);
+    }
+    VK_CHECK(res);
+    vulk->pipelineCacheLoadedSize = initialDataSize;
+    return vulk->pipelineCache != VK_NULL_HANDLE;
+}
+
+static void sSaveAndDestroyPipelineCache()
+{
+    if(!vulk->pipelineCache)
+        return;
+
+    printf("Pipeline cache %s: %u pipelines created in %f ms, %u bytes loaded\n",
+        vulk->pipelineCacheLoadedSize > 0u ? "warm" : "cold",
+        vulk->pipelineCreateCount, vulk->pipelineCreateSeconds * 1000.0, vulk->pipelineCacheLoadedSize);
+
+    const char *cachePath = VulkanInitializationParameters::get().pipelineCachePath;
+    size_t dataSize = 0u;
+    if(cachePath && vkGetPipelineCacheData(vulk->device, vulk->pipelineCache, &dataSize, nullptr) == VK_SUCCESS
+        && dataSize > 0u)
+    {
+        PipelineCacheFileHeader header = sGetPipelineCacheHeader(u32(dataSize));
+        ByteBuffer fileData(1, BufferType::PODVECTOR);
+        fileData.resize(u32(sizeof(PipelineCacheFileHeader) + dataSize));
+        Supa::memcpy(fileData.getBegin(), &header, sizeof(PipelineCacheFileHeader));
+        if(vkGetPipelineCacheData(vulk->device, vulk->pipelineCache, &dataSize,
+            fileData.getBegin() + sizeof(PipelineCacheFileHeader)) == VK_SUCCESS)
+        {
+            if(!writeBytes(cachePath, fileData))
+                printf("Failed to write pipeline cache: %s\n", cachePath);
+        }
+    }
+
+    vkDestroyPipelineCache(vulk->device, vulk->pipelineCache, nullptr);
+    vulk->pipelineCache = VK_NULL_HANDLE;
+}
+
+
 
 
 
@@ -520,11 +731,13 @@ static bool sCreatePhysicalDevice(VkPhysicalDeviceType wantedDeviceType)
 
     VkPhysicalDevice primary = nullptr;
     VkPhysicalDevice secondary = nullptr;
+    VkPhysicalDevice tertiary = nullptr;
 
 
+    bool headless = VulkanInitializationParameters::get().headless;
     PodVector<const char*> requiredExtensions;
     for(const char *str : sDeviceExtensions)
-        if(!requiredExtensions.find(str))
+        if(!headless && !requiredExtensions.find(str))
             requiredExtensions.pushBack(str);
     for(const char *str : sAddCheckDeviceExtensions)
     {
@@ -549,12 +762,15 @@ static bool sCreatePhysicalDevice(VkPhysicalDeviceType wantedDeviceType)
             printf("No timestamp and queries for %s\n", prop.deviceName);
             continue;
         }
-        SwapChainSupportDetails swapChainSupport = sQuerySwapChainSupport(physicalDevice, vulk->surface);
-        bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-        if(!swapChainAdequate)
+        if(!headless)
         {
-            printf("No swapchain for: %s\n", prop.deviceName);
-            continue;
+            SwapChainSupportDetails swapChainSupport = sQuerySwapChainSupport(physicalDevice, vulk->surface);
+            bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+            if(!swapChainAdequate)
+            {
+                printf("No swapchain for: %s\n", prop.deviceName);
+                continue;
+            }
         }
         u32 formatIndex = ~0u;
 
@@ -605,10 +821,12 @@ static bool sCreatePhysicalDevice(VkPhysicalDeviceType wantedDeviceType)
             for (const auto& extension : availableExtensions)
             {
                 //printf("available extension: %s\n", extension.extensionName);
-                for(u32 k = 0; k < requiredExtensionsTemp.size(); ++i)
+                for(u32 k = 0; k < requiredExtensionsTemp.size();)
                 {
                     if(Supa::strcmp(requiredExtensionsTemp[k], extension.extensionName) == 0)
                         requiredExtensionsTemp.removeIndex(k);
+                    else
+                        ++k;
                 }
             }
 
@@ -632,19 +850,25 @@ static bool sCreatePhysicalDevice(VkPhysicalDeviceType wantedDeviceType)
         {
             secondary = devices[i];
         }
+        // Software rasterizers for running headless on machines without gpu.
+        else if(!secondary && !tertiary && headless && prop.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+        {
+            tertiary = devices[i];
+        }
     }
-    if(!primary && !secondary)
+    if(!primary && !secondary && !tertiary)
     {
         printf("Didn't find any gpus\n");
         return false;
     }
 
-    vulk->physicalDevice = primary ? primary : secondary;
+    vulk->physicalDevice = primary ? primary : (secondary ? secondary : tertiary);
 
     VkPhysicalDeviceProperties prop;
     vkGetPhysicalDeviceProperties(vulk->physicalDevice, &prop);
 
-    const char *typeText = prop.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? "discrete" : "integrated";
+    const char *typeText = prop.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? "discrete"
+        : (prop.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? "cpu" : "integrated");
     printf("Picking %s device: %s\n", typeText, prop.deviceName);
     return true;
 }
@@ -656,10 +880,15 @@ static bool sCreateDeviceWithQueues()
     vulk->queueFamilyIndices = sFindQueueFamilies(vulk->physicalDevice, vulk->surface);
     ASSERT(vulk->queueFamilyIndices.isValid());
 
-    SwapChainSupportDetails swapChainSupport = sQuerySwapChainSupport(vulk->physicalDevice, vulk->surface);
-    bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-    if(!swapChainAdequate)
-        return false;
+    bool headless = VulkanInitializationParameters::get().headless;
+    SwapChainSupportDetails swapChainSupport;
+    if(!headless)
+    {
+        swapChainSupport = sQuerySwapChainSupport(vulk->physicalDevice, vulk->surface);
+        bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        if(!swapChainAdequate)
+            return false;
+    }
 
     vulk->presentColorFormat = VK_FORMAT_UNDEFINED;
     vulk->depthFormat = defaultPresent[0].depth;
@@ -690,7 +919,6 @@ static bool sCreateDeviceWithQueues()
         vulk->colorSpace = defaultPresent[0].colorSpace;
         vulk->depthFormat = defaultPresent[0].depth;
     }
-    ASSERT(vulk->presentColorFormat != VK_FORMAT_UNDEFINED);
 
     for (const auto &format : defaultFormats)
     {
@@ -705,6 +933,11 @@ static bool sCreateDeviceWithQueues()
 
     ASSERT(vulk->defaultColorFormat != VK_FORMAT_UNDEFINED);
 
+    // Offscreen present images can be any format that can be rendered and copied.
+    if(headless)
+        vulk->presentColorFormat = vulk->defaultColorFormat;
+    ASSERT(vulk->presentColorFormat != VK_FORMAT_UNDEFINED);
+
     PodVector<VkDeviceQueueCreateInfo> queueCreateInfos;
     PodVector<u32> uniqueQueueFamilies;
     uniqueQueueFamilies.pushBack(vulk->queueFamilyIndices.graphicsFamily);
@@ -725,7 +958,9 @@ static bool sCreateDeviceWithQueues()
     VulkanDeviceOptionals optionals = sGetDeviceOptionals(vulk->physicalDevice);
     // createdeviceinfo
     {
-        static constexpr VkPhysicalDeviceFeatures deviceFeatures = {
+        const VkPhysicalDeviceFeatures deviceFeatures = {
+            .multiDrawIndirect = optionals.canUseMultiDrawIndirect ? VK_TRUE : VK_FALSE,
+            .drawIndirectFirstInstance = optionals.canUseMultiDrawIndirect ? VK_TRUE : VK_FALSE,
             //.fillModeNonSolid = VK_TRUE,
             .samplerAnisotropy = VK_FALSE,
         };
@@ -734,7 +969,7 @@ static bool sCreateDeviceWithQueues()
             .dynamicRendering = VK_TRUE,
         };
 
-        static constexpr  VkPhysicalDeviceFeatures2 physicalDeviceFeatures2{
+        const VkPhysicalDeviceFeatures2 physicalDeviceFeatures2{
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
             .pNext = VulkanApiVersion >= VK_API_VERSION_1_3 ? (void*)&deviceFeatures13 : nullptr,
             .features = deviceFeatures,
@@ -751,9 +986,12 @@ static bool sCreateDeviceWithQueues()
 
         createInfo.pEnabledFeatures = nullptr;
 
-        PodVector<const char*> deviceExts(
-            sDeviceExtensions,
-            sDeviceExtensions + ARRAYSIZES(sDeviceExtensions));
+        PodVector<const char*> deviceExts;
+        if(!headless)
+        {
+            for(const char *str : sDeviceExtensions)
+                deviceExts.push_back(str);
+        }
         if (optionals.canUseVulkanRenderdocExtensionMarker)
         {
             deviceExts.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
@@ -800,6 +1038,7 @@ static bool sCreateDeviceWithQueues()
 
     if(optionals.canUseVulkanRenderdocExtensionMarker)
         sAcquireDeviceDebugRenderdocFunctions(vulk->device);
+    vulk->multiDrawIndirect = optionals.canUseMultiDrawIndirect;
     return true;
 }
 
@@ -859,6 +1098,33 @@ static VkCommandPool sCreateCommandPool()
     return commandPool;
 }
 
+static bool sCreateSecondaryCommandBuffers()
+{
+    vulk->recordThreadCount = (vulk->jobSystem ? vulk->jobSystem->getWorkerCount() : 0u) + 1u;
+    ASSERT(vulk->recordThreadCount <= VulkanGlobal::MaxRecordThreadCount);
+
+    for (u32 frame = 0; frame < VulkanGlobal::FramesInFlight; ++frame)
+    {
+        for (u32 thread = 0; thread < vulk->recordThreadCount; ++thread)
+        {
+            VkCommandPool commandPool = sCreateCommandPool();
+            if (!commandPool)
+                return false;
+            vulk->secondaryCommandPools[frame][thread] = commandPool;
+
+            VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+            allocateInfo.commandPool = commandPool;
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocateInfo.commandBufferCount = VulkanGlobal::MaxSecondaryCommandBuffersPerThread;
+            VK_CHECK(vkAllocateCommandBuffers(vulk->device, &allocateInfo,
+                vulk->secondaryCommandBuffers[frame][thread]));
+            if (!vulk->secondaryCommandBuffers[frame][thread][0])
+                return false;
+        }
+    }
+    return true;
+}
+
 
 
 static VkQueryPool sCreateQueryPool(u32 queryCount)
@@ -908,19 +1174,22 @@ static PodVector<DescriptorSetLayout> sParseShaderLayouts(const PodVector<Shader
 
 
 
-bool MyVulkan::init()
+bool MyVulkan::init(JobSystem *jobSystem)
 {
     auto &initParams = VulkanInitializationParameters::get();
     vulk = new VulkanGlobal();
 
     GLFWwindow* window = VulkanApp::getWindowRef();
 
-    ASSERT(VulkanApp::getWindowApp().inited);
-    ASSERT(VulkanApp::getWindow());
-    if(window == nullptr)
+    if(!initParams.headless)
     {
-        printf("Empty window!\n");
-        return false;
+        ASSERT(VulkanApp::getWindowApp().inited);
+        ASSERT(VulkanApp::getWindow());
+        if(window == nullptr)
+        {
+            printf("Empty window!\n");
+            return false;
+        }
     }
 
     if(!sCreateInstance())
@@ -931,12 +1200,15 @@ bool MyVulkan::init()
 
     vulk->debugCallBack = sRegisterDebugCB();
 
-    VK_CHECK(glfwCreateWindowSurface(vulk->instance, window, nullptr, &vulk->surface));
-    ASSERT(vulk->surface);
-    if(!vulk->surface)
+    if(!initParams.headless)
     {
-        printf("Failed to create vulkan surface!\n");
-        return false;
+        VK_CHECK(glfwCreateWindowSurface(vulk->instance, window, nullptr, &vulk->surface));
+        ASSERT(vulk->surface);
+        if(!vulk->surface)
+        {
+            printf("Failed to create vulkan surface!\n");
+            return false;
+        }
     }
 
     if(!sCreatePhysicalDevice(initParams.useIntegratedGpu ?
@@ -975,7 +1247,7 @@ bool MyVulkan::init()
 
     }
 
-    bool scSuccess = sCreateSwapchain(initParams.vsync);
+    bool scSuccess = initParams.headless ? sCreateHeadlessImages() : sCreateSwapchain(initParams.vsync);
     ASSERT(scSuccess);
     if(!scSuccess)
     {
@@ -1050,13 +1322,21 @@ bool MyVulkan::init()
     }
     vulk->commandBuffer = vulk->commandBuffers[0];
 
+    vulk->jobSystem = jobSystem;
+    if (!sCreateSecondaryCommandBuffers())
+    {
+        printf("Failed to create secondary command buffers!\n");
+        return false;
+    }
 
     {
-        vulk->scratchBuffer = VulkanResources::createBuffer(VulkanGlobal::VulkanMaxScratchBufferSize,
+        vulk->scratchBuffer = VulkanResources::createBuffer(VulkanGlobal::VulkanScratchBufferStartSize,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "Scratch buffer");
             //VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "Scratch buffer");
 
+        vulk->stagingRing.init(VulkanGlobal::VulkanScratchBufferStartSize);
+
         vulk->uniformBuffer = VulkanResources::createBuffer(64u * 1024u * 1024u,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Frame render uniform buffer");
@@ -1066,7 +1346,13 @@ bool MyVulkan::init()
             vulk->renderFrameBufferHandle[i] = vulk->uniformBufferManager.reserveHandle();
     }
 
-    if(!VulkanShader::loadShaders())
+    if(!sCreatePipelineCache())
+    {
+        printf("Failed to create pipeline cache\n");
+        return false;
+    }
+
+    if(!VulkanShader::loadShaders(jobSystem))
     {
         printf("Failed to load shaders\n");
         return false;
@@ -1097,17 +1383,39 @@ void MyVulkan::deinit()
         VulkanResources::destroySampler(vulk->globalTextureSampler);
         vulk->globalTextureSampler = VK_NULL_HANDLE;
         VulkanResources::destroyBuffer(vulk->scratchBuffer);
+        for (RetiringStagingBuffer &retiring : vulk->retiringStagingBuffers)
+            VulkanResources::destroyBuffer(retiring.buffer);
+        vulk->retiringStagingBuffers.clear();
         VulkanResources::destroyBuffer(vulk->uniformBuffer);
 
         vkDestroyCommandPool(vulk->device, vulk->commandPool, nullptr);
+        for (u32 frame = 0; frame < VulkanGlobal::FramesInFlight; ++frame)
+        {
+            for (u32 thread = 0; thread < VulkanGlobal::MaxRecordThreadCount; ++thread)
+            {
+                if (vulk->secondaryCommandPools[frame][thread])
+                    vkDestroyCommandPool(vulk->device, vulk->secondaryCommandPools[frame][thread], nullptr);
+            }
+        }
+        if (vulk->secondaryRecordBatchCount > 0u)
+        {
+            printf("Recorded secondary command buffers %u times, %f ms on average with %u threads\n",
+                vulk->secondaryRecordBatchCount,
+                vulk->secondaryRecordSeconds * 1000.0 / vulk->secondaryRecordBatchCount,
+                vulk->recordThreadCount);
+        }
 
 
         for(u32 i = 0; i < VulkanGlobal::FramesInFlight; ++i)
             vkDestroyQueryPool(vulk->device, vulk->queryPools[i], nullptr);
 
-        sDestroySwapchain(vulk->swapchain);
+        if(VulkanInitializationParameters::get().headless)
+            sDestroyHeadlessImages();
+        else
+            sDestroySwapchain(vulk->swapchain);
 
         VulkanShader::deleteLoadedShaders();
+        sSaveAndDestroyPipelineCache();
         for(u32 i = 0; i < VulkanGlobal::FramesInFlight; ++i)
         {
             vkDestroyFence(vulk->device, vulk->fences[i], nullptr);
@@ -1117,7 +1425,8 @@ void MyVulkan::deinit()
         VulkanResources::deinit();
         vkDestroyDevice(vulk->device, nullptr);
     }
-    vkDestroySurfaceKHR(vulk->instance, vulk->surface, nullptr);
+    if(vulk->surface)
+        vkDestroySurfaceKHR(vulk->instance, vulk->surface, nullptr);
 #if NDEBUG
 #else
     auto &initParams = VulkanInitializationParameters::get();
@@ -1200,6 +1509,15 @@ VkRenderPass MyVulkan::createRenderPass(const PodVector<RenderTarget>& colorTarg
 
 bool MyVulkan::resizeSwapchain()
 {
+    // Offscreen images keep the size given at init.
+    if(VulkanInitializationParameters::get().headless)
+    {
+        vulk->needToResize = false;
+        if(sVulkanFrameResizedCBFunc)
+            sVulkanFrameResizedCBFunc(i32(vulk->swapchain.width), i32(vulk->swapchain.height));
+        return true;
+    }
+
     GLFWwindow* window = VulkanApp::getWindowRef();
     ASSERT(window);
     i32 width = 0;
@@ -1313,7 +1631,16 @@ void MyVulkan::endSingleTimeCommands()
     VK_CHECK(vkQueueWaitIdle(queue));
 }
 
-void MyVulkan::beginRenderPass(const Pipeline& pipeline, const PodVector< VkClearValue >& clearValues)
+static void sSetViewportAndScissor(VkCommandBuffer commandBuffer, const Pipeline& pipeline)
+{
+    VkViewport viewPort = { 0.0f, float(pipeline.framebufferHeight), float(pipeline.framebufferWidth), -float(pipeline.framebufferHeight), 0.0f, 1.0f };
+    VkRect2D scissors = { { 0, 0 }, { pipeline.framebufferWidth, pipeline.framebufferHeight } };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewPort);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
+}
+
+void MyVulkan::beginRenderPass(const Pipeline& pipeline, const PodVector< VkClearValue >& clearValues,
+    VkSubpassContents contents)
 {
     VulkanResources::flushBarriers(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
 
@@ -1325,13 +1652,83 @@ void MyVulkan::beginRenderPass(const Pipeline& pipeline, const PodVector< VkClea
     passBeginInfo.clearValueCount = clearValues.size();
     passBeginInfo.pClearValues = clearValues.empty() ? nullptr : clearValues.data();
 
-    vkCmdBeginRenderPass(vulk->commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(vulk->commandBuffer, &passBeginInfo, contents);
 
-    VkRect2D renderArea = { .extent = {.width = pipeline.framebufferWidth, .height = pipeline.framebufferHeight } };
-    VkViewport viewPort = { 0.0f, float(pipeline.framebufferHeight), float(pipeline.framebufferWidth), -float(pipeline.framebufferHeight), 0.0f, 1.0f };
-    VkRect2D scissors = { { 0, 0 }, { pipeline.framebufferWidth, pipeline.framebufferHeight } };
-    vkCmdSetViewport(vulk->commandBuffer, 0, 1, &viewPort);
-    vkCmdSetScissor(vulk->commandBuffer, 0, 1, &scissors);
+    // Secondary command buffers set their own.
+    if (contents == VK_SUBPASS_CONTENTS_INLINE)
+        sSetViewportAndScissor(vulk->commandBuffer, pipeline);
+}
+
+// Set while the thread records a secondary command buffer.
+static thread_local VkCommandBuffer sRecordingCommandBuffer = VK_NULL_HANDLE;
+
+// Job per record, each thread takes buffers from its own pool.
+static void sRecordSecondaryCommandBufferJob(void *jobData, u32 jobIndex)
+{
+    SecondaryCommandRecord &record = ((SecondaryCommandRecord *)jobData)[jobIndex];
+    record.commandBuffer = VK_NULL_HANDLE;
+    if (!record.recordFunc || !record.pipeline)
+        return;
+
+    // Workers use 1 to recordThreadCount - 1, the thread waiting for the jobs 0.
+    u32 threadIndex = vulk->jobSystem ? vulk->jobSystem->getCurrentThreadIndex() : JobSystem::MaxWorkerCount;
+    u32 recordThread = threadIndex < vulk->recordThreadCount - 1u ? threadIndex + 1u : 0u;
+    u32 &bufferCount = vulk->secondaryCommandBufferCounts[recordThread];
+    ASSERT(bufferCount < VulkanGlobal::MaxSecondaryCommandBuffersPerThread);
+    if (bufferCount >= VulkanGlobal::MaxSecondaryCommandBuffersPerThread)
+        return;
+    VkCommandBuffer commandBuffer = vulk->secondaryCommandBuffers[vulk->frameIndex][recordThread][bufferCount++];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritanceInfo.renderPass = record.pipeline->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = record.pipeline->framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    sSetViewportAndScissor(commandBuffer, *record.pipeline);
+    // Thread can pick up another record while waiting for jobs of this one.
+    VkCommandBuffer outerCommandBuffer = sRecordingCommandBuffer;
+    sRecordingCommandBuffer = commandBuffer;
+    record.recordFunc(record.recordData);
+    sRecordingCommandBuffer = outerCommandBuffer;
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    record.commandBuffer = commandBuffer;
+}
+
+void MyVulkan::recordSecondaryCommandBuffers(SecondaryCommandRecord *records, u32 recordCount)
+{
+    Timer::TimePoint startTime = Timer::getTime(Timer::ClockId);
+
+    if (vulk->recordThreadCount > 1u)
+    {
+        JobCounter counter;
+        vulk->jobSystem->addJobs(sRecordSecondaryCommandBufferJob, records, recordCount, counter);
+        vulk->jobSystem->waitForCounter(counter);
+    }
+    else
+    {
+        for (u32 i = 0; i < recordCount; ++i)
+            sRecordSecondaryCommandBufferJob(records, i);
+    }
+
+    vulk->secondaryRecordSeconds += Timer::getTimeDifferenceInNanos(startTime, Timer::getTime(Timer::ClockId));
+    ++vulk->secondaryRecordBatchCount;
+}
+
+void MyVulkan::executeSecondaryCommandBuffer(const SecondaryCommandRecord &record)
+{
+    if (record.commandBuffer)
+        vkCmdExecuteCommands(vulk->commandBuffer, 1, &record.commandBuffer);
+}
+
+VkCommandBuffer MyVulkan::getCommandBuffer()
+{
+    return sRecordingCommandBuffer ? sRecordingCommandBuffer : vulk->commandBuffer;
 }
 
 void MyVulkan::beginRendering(const PodVector<RenderImage> &renderColorImages, RenderImage depthImage)
@@ -1429,16 +1826,32 @@ bool MyVulkan::frameStart()
         //ScopedTimer aq("Acquire");
         VK_CHECK(vkWaitForFences(vulk->device, 1, &vulk->fences[vulk->frameIndex], VK_TRUE, UINT64_MAX));
     }
+    for (u32 i = 0; i < vulk->recordThreadCount; ++i)
+    {
+        VK_CHECK(vkResetCommandPool(vulk->device, vulk->secondaryCommandPools[vulk->frameIndex][i], 0));
+        vulk->secondaryCommandBufferCounts[i] = 0u;
+    }
     if (vulk->acquireSemaphores[vulk->frameIndex] == VK_NULL_HANDLE)
     {
         return false;
     }
+
+    // Fence belongs to the frame FramesInFlight back, its copies are done.
+    ++vulk->frameNumber;
+    if (vulk->frameNumber > VulkanGlobal::FramesInFlight)
+        VulkanResources::retireStagingFrames(vulk->frameNumber - VulkanGlobal::FramesInFlight);
+
+    // Nothing to acquire, the frame goes to its own offscreen image. Fence has passed, so the
+    // readback from the last time this image was used is complete.
+    if(VulkanInitializationParameters::get().headless)
+    {
+        sWriteHeadlessFrame(vulk->frameIndex);
+        vulk->imageIndex = vulk->frameIndex;
+        return true;
+    }
+
     VkResult res = ( vkAcquireNextImageKHR(vulk->device, vulk->swapchain.swapchain, UINT64_MAX,
         vulk->acquireSemaphores[vulk->frameIndex], VK_NULL_HANDLE, &vulk->imageIndex));
-
-    vulk->scratchBufferOffset = vulk->frameIndex * 32u * 1024u * 1024u;
-    vulk->scratchBufferLastFlush = vulk->scratchBufferOffset;
-    vulk->scratchBufferMaxOffset = (vulk->frameIndex + 1) * 32u * 1024u * 1024u;
     if (res == VK_ERROR_OUT_OF_DATE_KHR)
     {
         if (resizeSwapchain())
@@ -1456,8 +1869,59 @@ bool MyVulkan::frameStart()
     return true;
 }
 
+// Copies the presented image to the readback buffer when frames are dumped to disk.
+static void sCopyHeadlessImageForReadback()
+{
+    u32 index = vulk->imageIndex;
+    u64 frameNumber = vulk->headlessFrameNumber++;
+    if(!vulk->headlessReadbackBuffers[index].buffer)
+        return;
+
+    VkImageMemoryBarrier copyBarrier = VulkanResources::imageBarrier(vulk->swapchain.images[index],
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    vkCmdPipelineBarrier(vulk->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &copyBarrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { vulk->swapchain.width, vulk->swapchain.height, 1 };
+    vkCmdCopyImageToBuffer(vulk->commandBuffer, vulk->swapchain.images[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        vulk->headlessReadbackBuffers[index].buffer, 1, &region);
+
+    VkBufferMemoryBarrier hostBarrier = VulkanResources::bufferBarrier(vulk->headlessReadbackBuffers[index],
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    vkCmdPipelineBarrier(vulk->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    vulk->headlessReadbackFrames[index] = frameNumber;
+    vulk->headlessReadbackPending[index] = true;
+}
+
+// Same submit as with swapchain, but without semaphores and present.
+static void sSubmitHeadless()
+{
+    VK_CHECK(vkEndCommandBuffer(vulk->commandBuffer));
+
+    vkResetFences(vulk->device, 1, &vulk->fences[vulk->frameIndex]);
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &vulk->commandBuffer;
+    VK_CHECK(vkQueueSubmit(vulk->graphicsQueue, 1, &submitInfo, vulk->fences[vulk->frameIndex]));
+
+    if(vulk->needToResize)
+    {
+        MyVulkan::resizeSwapchain();
+        vulk->needToResize = false;
+    }
+}
+
 void MyVulkan::present(Image & imageToPresent)
 {
+    VulkanResources::endStagingFrame();
+
     // Copy final image to swap chain target
     {
         beginDebugRegion("Copy to swapchain", Vec4(1.0f, 1.0f, 0.0f, 1.0f));
@@ -1495,6 +1959,13 @@ void MyVulkan::present(Image & imageToPresent)
 
 
     // Prepare image for presenting.
+        if(VulkanInitializationParameters::get().headless)
+        {
+            sCopyHeadlessImageForReadback();
+            endDebugRegion();
+            sSubmitHeadless();
+            return;
+        }
 
         VkImageMemoryBarrier presentBarrier =
             VulkanResources::imageBarrier(vulk->swapchain.images[ vulk->imageIndex ],
@@ -1691,8 +2162,11 @@ bool MyVulkan::createGraphicsPipeline(const Shader &vertShader, const Shader &fr
     */
 
     VkPipeline pipeline = 0;
-    VK_CHECK(vkCreateGraphicsPipelines(vulk->device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline));
+    Timer::TimePoint createStartTime = Timer::getTime(Timer::ClockId);
+    VK_CHECK(vkCreateGraphicsPipelines(vulk->device, vulk->pipelineCache, 1, &createInfo, nullptr, &pipeline));
     ASSERT(pipeline);
+    vulk->pipelineCreateSeconds += Timer::getTimeDifferenceInNanos(createStartTime, Timer::getTime(Timer::ClockId));
+    ++vulk->pipelineCreateCount;
 
     outPipeline.pipeline = pipeline;
 
@@ -1729,8 +2203,11 @@ bool MyVulkan::createComputePipeline(const Shader &csShader, Pipeline &outPipeli
     createInfo.layout = outPipeline.pipelineLayout;
 
     VkPipeline pipeline = 0;
-    VK_CHECK(vkCreateComputePipelines(vulk->device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline));
+    Timer::TimePoint createStartTime = Timer::getTime(Timer::ClockId);
+    VK_CHECK(vkCreateComputePipelines(vulk->device, vulk->pipelineCache, 1, &createInfo, nullptr, &pipeline));
     ASSERT(pipeline);
+    vulk->pipelineCreateSeconds += Timer::getTimeDifferenceInNanos(createStartTime, Timer::getTime(Timer::ClockId));
+    ++vulk->pipelineCreateCount;
 
     outPipeline.pipeline = pipeline;
 
@@ -1840,7 +2317,7 @@ void MyVulkan::beginDebugRegion(const char *pMarkerName, Vec4 color)
         markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
         Supa::memcpy(markerInfo.color, &color[0], sizeof(float) * 4);
         markerInfo.pMarkerName = pMarkerName;
-        pfnCmdDebugMarkerBegin(vulk->commandBuffer, &markerInfo);
+        pfnCmdDebugMarkerBegin(getCommandBuffer(), &markerInfo);
     }
 }
 
@@ -1854,7 +2331,7 @@ void MyVulkan::insertDebugRegion(const char *markerName, Vec4 color)
         markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
         Supa::memcpy(markerInfo.color, &color[0], sizeof(float) * 4);
         markerInfo.pMarkerName = markerName;
-        pfnCmdDebugMarkerInsert(vulk->commandBuffer, &markerInfo);
+        pfnCmdDebugMarkerInsert(getCommandBuffer(), &markerInfo);
     }
 }
 
@@ -1864,7 +2341,7 @@ void MyVulkan::endDebugRegion()
     // Check for valid function (may not be present if not runnin in a debugging application)
     if (pfnCmdDebugMarkerEnd)
     {
-        pfnCmdDebugMarkerEnd(vulk->commandBuffer);
+        pfnCmdDebugMarkerEnd(getCommandBuffer());
     }
 }
 
@@ -1872,8 +2349,9 @@ void MyVulkan::endDebugRegion()
 void MyVulkan::bindGraphicsPipelineWithDescriptors(const Pipeline &pipelineWithDescriptor, u32 index)
 {
     VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    vkCmdBindPipeline(vulk->commandBuffer, bindPoint, pipelineWithDescriptor.pipeline);
-    vkCmdBindDescriptorSets(vulk->commandBuffer, bindPoint, pipelineWithDescriptor.pipelineLayout,
+    VkCommandBuffer commandBuffer = getCommandBuffer();
+    vkCmdBindPipeline(commandBuffer, bindPoint, pipelineWithDescriptor.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineWithDescriptor.pipelineLayout,
         0, 1, &pipelineWithDescriptor.descriptor.descriptorSets[index], 0, NULL);
 }
 
@@ -10,6 +10,7 @@
 static constexpr u32 QUERY_COUNT = 128u;
 static constexpr u32 VulkanApiVersion = VK_API_VERSION_1_1;
 
+class JobSystem;
 struct Shader;
 
 struct RenderTarget
@@ -36,10 +37,26 @@ struct RenderImage
     VkClearValue clearValue{};
 };
 
+// Render pass contents recorded into a secondary command buffer by
+// MyVulkan::recordSecondaryCommandBuffers. recordFunc runs on a worker thread, so it must
+// not use the mymemory allocator. Commands go to MyVulkan::getCommandBuffer.
+struct SecondaryCommandRecord
+{
+    // Render pass and framebuffer the commands get executed in.
+    const Pipeline *pipeline = nullptr;
+    // Nothing gets recorded when null.
+    void (*recordFunc)(void *recordData) = nullptr;
+    void *recordData = nullptr;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+};
+
 class MyVulkan
 {
 public:
-    static bool init();
+    // Shaders get loaded and secondary command buffers recorded on the workers of jobSystem,
+    // nullptr does both on this thread. jobSystem has to outlive the frames recorded with it.
+    static bool init(JobSystem *jobSystem = nullptr);
     static void deinit();
 
     static void setVulkanFrameResizedCBFunc(void (*fn)(i32 width, i32 height));
@@ -68,7 +85,15 @@ public:
         const RenderTarget& depthFormat);
 
     static void beginRenderPass(
-        const Pipeline& pipeline, const PodVector< VkClearValue >& clearValues);
+        const Pipeline& pipeline, const PodVector< VkClearValue >& clearValues,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+    // Records every record in parallel, then waits for all of them.
+    static void recordSecondaryCommandBuffers(SecondaryCommandRecord *records, u32 recordCount);
+    // Inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    static void executeSecondaryCommandBuffer(const SecondaryCommandRecord &record);
+    // Secondary buffer the calling thread is recording, otherwise the frame's command buffer.
+    static VkCommandBuffer getCommandBuffer();
     static void beginRendering(
         const PodVector<RenderImage>& renderColorImages, RenderImage depthImage);
     static void dispatchCompute(
@@ -9,7 +9,9 @@
 #include <container/vector.h>
 #include <core/file.h>
 #include <core/general.h>
+#include <core/jobsystem.h>
 #include <core/mytypes.h>
+#include <core/timer.h>
 
 #include <myvulkan/myvulkan.h>
 #include <myvulkan/vulkanglobal.h>
@@ -24,8 +26,39 @@ struct GlobalShaders
 };
 static GlobalShaders *globalShaders = nullptr;
 
+struct ShaderParseOp
+{
+    u32 opCode;
+    u32 typeId;
+    u32 storageClass;
+    u32 binding;
+    u32 set;
+};
+
+// One shader permutation read from disk, code and parse scratch are slices of shared buffers
+// so the loading jobs do not allocate.
+struct ShaderLoadEntry
+{
+    const char *filename = nullptr;
+    ShaderType shaderType = ShaderType::NumShaders;
+    u32 codeOffset = 0u;
+    u32 codeSize = 0u;
+    u32 opsOffset = 0u;
+    bool success = false;
+};
+
+struct ShaderLoadJobData
+{
+    const u8 *code = nullptr;
+    ShaderParseOp *ops = nullptr;
+    ShaderLoadEntry *entries = nullptr;
+    Shader *shaders = nullptr;
+};
+
 // spir-v specs, 1.6 https://www.khronos.org/registry/SPIR-V/specs/unified1/SPIRV.pdf
-static bool parseShaderCode(const VkShaderModuleCreateInfo &info, StringView filename, Shader& inOutShader)
+// ops has to have room for code[3] zeroed entries.
+static bool parseShaderCode(const VkShaderModuleCreateInfo &info, StringView filename, ShaderParseOp *ops,
+    Shader& inOutShader)
 {
     ASSERT(info.pCode);
     ASSERT(info.codeSize > 0);
@@ -39,25 +72,12 @@ static bool parseShaderCode(const VkShaderModuleCreateInfo &info, StringView fil
     if (code[0] != SpvMagicNumber)
         return false;
 
-    struct Ops
-    {
-        u32 opCode;
-        u32 typeId;
-        u32 storageClass;
-        u32 binding;
-        u32 set;
-    };
     u32 bounds = code[3];
-    PodVector<Ops> ops;
-    ops.resize(bounds, Ops{});
 
-    u32 lineNumber = 0u;
     const u32* codePtr = code + 5;
-    PodVector<const u32*> codeStarts;
 
     while (codePtr < code + codeSize)
     {
-        codeStarts.push_back(codePtr);
         u16 words = u16(*codePtr >> 16);
         u16 opCode = u16(*codePtr & 0xffff);
         ASSERT(words);
@@ -152,8 +172,9 @@ static bool parseShaderCode(const VkShaderModuleCreateInfo &info, StringView fil
     }
     ASSERT(code + codeSize == codePtr);
 
-    for (const auto& op : ops)
+    for (u32 opIndex = 0; opIndex < bounds; ++opIndex)
     {
+        const ShaderParseOp &op = ops[opIndex];
         if (op.opCode != SpvOpVariable)
             continue;
 
@@ -200,7 +221,9 @@ static bool parseShaderCode(const VkShaderModuleCreateInfo &info, StringView fil
     return true;
 }
 
-static bool sLoadShader(const char *filename, ShaderType shaderType)
+// Reads every permutation of the shader, runs on the main thread since it allocates.
+static bool sReadShaderFiles(const char *filename, ShaderType shaderType, PodVector<ShaderLoadEntry> &entries,
+    PodVector<u8> &code, u32 &opsCount)
 {
     if (u32(shaderType) >= u32(ShaderType::NumShaders))
         return false;
@@ -222,26 +245,21 @@ static bool sLoadShader(const char *filename, ShaderType shaderType)
             return false;
 
         ASSERT(buffer.size() % 4 == 0);
-        if (buffer.size() % 4 != 0)
+        ASSERT(buffer.size() >= 5 * sizeof(u32));
+        if (buffer.size() % 4 != 0 || buffer.size() < 5 * sizeof(u32))
             return false;
 
-        Shader shader;
+        ShaderLoadEntry entry;
+        entry.filename = filename;
+        entry.shaderType = shaderType;
+        entry.codeOffset = code.size();
+        entry.codeSize = buffer.size();
+        entry.opsOffset = opsCount;
+        entries.push_back(entry);
 
-        VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-        createInfo.codeSize = buffer.size();
-        createInfo.pCode = reinterpret_cast<u32*>(buffer.data());
-        VK_CHECK(vkCreateShaderModule(vulk->device, &createInfo, nullptr, &shader.module));
-        ASSERT(shader.module);
-        if (!shader.module)
-            return false;
-
-
-        bool parseSuccess = parseShaderCode(createInfo, filename, shader);
-        ASSERT(parseSuccess);
-        if (!parseSuccess)
-            return false;
-
-        globalShaders->shaders[u32(shaderType)].push_back(shader);
+        // Id bounds of the module.
+        opsCount += reinterpret_cast<const u32 *>(buffer.data())[3];
+        code.pushBack(buffer);
 
         ++permutationIndex;
     }
@@ -253,6 +271,26 @@ static bool sLoadShader(const char *filename, ShaderType shaderType)
     return loadSuccess;
 }
 
+// Job per permutation, vkCreateShaderModule is free threaded and parsing only touches the entry's slices.
+static void sCreateShaderJob(void *jobData, u32 jobIndex)
+{
+    ShaderLoadJobData &data = *(ShaderLoadJobData *)jobData;
+    ShaderLoadEntry &entry = data.entries[jobIndex];
+    Shader &shader = data.shaders[jobIndex];
+
+    VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+    createInfo.codeSize = entry.codeSize;
+    createInfo.pCode = reinterpret_cast<const u32*>(data.code + entry.codeOffset);
+    VK_CHECK(vkCreateShaderModule(vulk->device, &createInfo, nullptr, &shader.module));
+    ASSERT(shader.module);
+    if (!shader.module)
+        return;
+
+    bool parseSuccess = parseShaderCode(createInfo, entry.filename, data.ops + entry.opsOffset, shader);
+    ASSERT(parseSuccess);
+    entry.success = parseSuccess;
+}
+
 void sDestroyShader(Shader& shader)
 {
     if (shader.module)
@@ -269,41 +307,94 @@ const Shader& VulkanShader::getShader(ShaderType shaderType, u32 permutationInde
     return globalShaders->shaders[u32(shaderType)][permutationIndex];
 }
 
-bool VulkanShader::loadShaders()
+bool VulkanShader::loadShaders(JobSystem *jobSystem)
 {
-    ASSERT(globalShaders == nullptr);
-    globalShaders = new GlobalShaders();
-    globalShaders->shaders.resize(u8(ShaderType::NumShaders));
-    if (!sLoadShader("basic3d.frag", ShaderType::Basic3DFrag)) return false;
-    if (!sLoadShader("basic3d.vert", ShaderType::Basic3DVert)) return false;
-
-    if (!sLoadShader("line.vert", ShaderType::LineVert)) return false;
-
-    if (!sLoadShader("coloredquad.frag", ShaderType::ColoredQuadFrag)) return false;
-    if (!sLoadShader("coloredquad.vert", ShaderType::ColoredQuadVert)) return false;
+    struct ShaderFile
+    {
+        const char *filename;
+        ShaderType shaderType;
+    };
+    static constexpr ShaderFile shaderFiles[] =
+    {
+        { "basic3d.frag", ShaderType::Basic3DFrag },
+        { "basic3d.vert", ShaderType::Basic3DVert },
 
-    if (!sLoadShader("space_ship_2d_model.frag", ShaderType::SpaceShip2DModelFrag)) return false;
-    if (!sLoadShader("space_ship_2d_model.vert", ShaderType::SpaceShip2DModelVert)) return false;
+        { "line.vert", ShaderType::LineVert },
 
-    if (!sLoadShader("texturedquad.frag", ShaderType::TexturedQuadFrag)) return false;
-    if (!sLoadShader("texturedquad.vert", ShaderType::TexturedQuadVert)) return false;
+        { "coloredquad.frag", ShaderType::ColoredQuadFrag },
+        { "coloredquad.vert", ShaderType::ColoredQuadVert },
 
+        { "space_ship_2d_model.frag", ShaderType::SpaceShip2DModelFrag },
+        { "space_ship_2d_model.vert", ShaderType::SpaceShip2DModelVert },
 
+        { "texturedquad.frag", ShaderType::TexturedQuadFrag },
+        { "texturedquad.vert", ShaderType::TexturedQuadVert },
 
-    if (!sLoadShader("compute_test.comp", ShaderType::ComputeTestComp)) return false;
+        { "compute_test.comp", ShaderType::ComputeTestComp },
 
+        { "lighting.comp", ShaderType::LightingShader },
+        { "tonemap.comp", ShaderType::TonemapShader },
 
-    if (!sLoadShader("lighting.comp", ShaderType::LightingShader)) return false;
-    if (!sLoadShader("tonemap.comp", ShaderType::TonemapShader)) return false;
+        { "convertrgbas16.comp", ShaderType::ConvertFromRGBAS16 },
+    };
 
+    ASSERT(globalShaders == nullptr);
+    globalShaders = new GlobalShaders();
+    globalShaders->shaders.resize(u8(ShaderType::NumShaders));
 
+    Timer::TimePoint startTime = Timer::getTime(Timer::ClockId);
 
+    PodVector<ShaderLoadEntry> entries;
+    PodVector<u8> code;
+    u32 opsCount = 0u;
+    for (const ShaderFile &file : shaderFiles)
+    {
+        if (!sReadShaderFiles(file.filename, file.shaderType, entries, code, opsCount))
+            return false;
+    }
 
-    if (!sLoadShader("convertrgbas16.comp", ShaderType::ConvertFromRGBAS16)) return false;
+    // Everything the jobs touch is allocated up front, mymemory is not thread safe.
+    PodVector<ShaderParseOp> ops;
+    ops.resize(opsCount, ShaderParseOp{});
+    PodVector<Shader> shaders;
+    shaders.resize(entries.size());
+
+    ShaderLoadJobData jobData{
+        .code = code.data(),
+        .ops = ops.data(),
+        .entries = entries.data(),
+        .shaders = shaders.data(),
+    };
 
+    u32 workerCount = jobSystem ? jobSystem->getWorkerCount() : 0u;
+    if (workerCount > 0u)
+    {
+        JobCounter counter;
+        jobSystem->addJobs(sCreateShaderJob, &jobData, entries.size(), counter);
+        jobSystem->waitForCounter(counter);
+    }
+    else
+    {
+        for (u32 i = 0; i < entries.size(); ++i)
+            sCreateShaderJob(&jobData, i);
+    }
 
+    // Stored in file and permutation order whichever thread finished first.
+    bool success = true;
+    for (u32 i = 0; i < entries.size(); ++i)
+    {
+        if (!entries[i].success)
+        {
+            printf("Failed to create shader: %s\n", entries[i].filename);
+            success = false;
+        }
+        globalShaders->shaders[u32(entries[i].shaderType)].push_back(shaders[i]);
+    }
 
-    return true;
+    double loadTime = Timer::getTimeDifferenceInNanos(startTime, Timer::getTime(Timer::ClockId));
+    printf("Loaded %u shader permutations in %f ms with %u workers\n", entries.size(), loadTime * 1000.0,
+        workerCount);
+    return success;
 }
 
 void VulkanShader::deleteLoadedShaders()
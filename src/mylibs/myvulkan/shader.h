@@ -4,6 +4,8 @@
 
 #include <myvulkan/vulkanglobal.h>
 
+class JobSystem;
+
 struct Shader
 {
     VkShaderModule module = VK_NULL_HANDLE;
@@ -44,7 +46,8 @@ class VulkanShader
 public:
 
     static const Shader& getShader(ShaderType shaderType, u32 permutationIndex = 0u);
-    static bool loadShaders();
+    // Shader modules get created on the workers of jobSystem, without workers on this thread.
+    static bool loadShaders(JobSystem *jobSystem);
     static void deleteLoadedShaders();
 
     static bool createDescriptor(Pipeline &pipeline);
@@ -0,0 +1,93 @@
+#include "stagingring.h"
+
+#include <core/assert.h>
+
+void StagingRing::init(u64 newCapacity)
+{
+    ASSERT(newCapacity > 0u && (newCapacity % MaxAlignment) == 0u);
+    *this = StagingRing{};
+    capacity = newCapacity;
+}
+
+u64 StagingRing::allocate(u64 size, u64 alignment)
+{
+    ASSERT(size > 0u);
+    ASSERT(alignment > 0u && alignment <= MaxAlignment && (alignment & (alignment - 1u)) == 0u);
+    if(size == 0u || size > capacity)
+        return InvalidOffset;
+
+    // Nothing in use, start from the beginning so the whole buffer is available. Retired
+    // allocations have been copied already, so anything unflushed can be dropped too.
+    if(headPos == tailPos)
+    {
+        headPos = (headPos + capacity - 1u) / capacity * capacity;
+        tailPos = headPos;
+        flushedPos = headPos;
+    }
+
+    // Capacity is a multiple of alignment, so aligned position is aligned offset too.
+    u64 startPos = (headPos + alignment - 1u) & ~(alignment - 1u);
+    u64 offset = startPos % capacity;
+    if(offset + size > capacity)
+    {
+        startPos += capacity - offset;
+        offset = 0u;
+    }
+    if(startPos + size - tailPos > capacity)
+        return InvalidOffset;
+
+    headPos = startPos + size;
+    frameBytes += size;
+    return offset;
+}
+
+void StagingRing::endFrame(u64 frameNumber)
+{
+    ASSERT(pendingFrameCount < MaxPendingFrames);
+    if(pendingFrameCount >= MaxPendingFrames)
+        return;
+
+    PendingFrame &frame = pendingFrames[(pendingFrameStart + pendingFrameCount) % MaxPendingFrames];
+    frame.frameNumber = frameNumber;
+    frame.endPos = headPos;
+    ++pendingFrameCount;
+    frameBytes = 0u;
+}
+
+void StagingRing::retireFrames(u64 frameNumber)
+{
+    while(pendingFrameCount > 0u && pendingFrames[pendingFrameStart].frameNumber <= frameNumber)
+    {
+        tailPos = pendingFrames[pendingFrameStart].endPos;
+        pendingFrameStart = (pendingFrameStart + 1u) % MaxPendingFrames;
+        --pendingFrameCount;
+    }
+}
+
+u32 StagingRing::takeUnflushedRanges(u64 outOffsets[2], u64 outSizes[2])
+{
+    if(flushedPos == headPos)
+        return 0u;
+
+    u64 size = headPos - flushedPos;
+    u64 offset = flushedPos % capacity;
+    flushedPos = headPos;
+
+    if(size >= capacity)
+    {
+        outOffsets[0] = 0u;
+        outSizes[0] = capacity;
+        return 1u;
+    }
+    if(offset + size <= capacity)
+    {
+        outOffsets[0] = offset;
+        outSizes[0] = size;
+        return 1u;
+    }
+    outOffsets[0] = offset;
+    outSizes[0] = capacity - offset;
+    outOffsets[1] = 0u;
+    outSizes[1] = size - outSizes[0];
+    return 2u;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <core/mytypes.h>
+
+// Sub allocation bookkeeping of the staging buffer shared by the frames in flight. Only offsets,
+// no vulkan calls, the buffer itself lives in VulkanGlobal.
+// Allocations go after each other and wrap around, space gets back once the fence of
+// the frame that allocated it has passed. Positions grow forever, offset in buffer is
+// position % capacity.
+class StagingRing
+{
+public:
+    // Capacity has to be a multiple of MaxAlignment.
+    void init(u64 newCapacity);
+
+    // Offset into the buffer, InvalidOffset when frames in flight do not leave room.
+    // Allocation never wraps in the middle, the end of the buffer gets skipped instead.
+    // Alignment has to be power of two, at most MaxAlignment.
+    u64 allocate(u64 size, u64 alignment);
+
+    // Allocations since previous endFrame belong to frameNumber.
+    void endFrame(u64 frameNumber);
+    // Frees allocations of frames up to and including frameNumber, after their fence has passed.
+    void retireFrames(u64 frameNumber);
+
+    // Ranges allocated since last call, 2 when the allocations wrapped around. Returns range count.
+    u32 takeUnflushedRanges(u64 outOffsets[2], u64 outSizes[2]);
+
+    u64 getCapacity() const { return capacity; }
+    // Bytes in use by frames not yet retired, including alignment padding.
+    u64 getUsedSize() const { return headPos - tailPos; }
+    // Bytes asked since the last endFrame, without padding.
+    u64 getFrameBytes() const { return frameBytes; }
+
+    static constexpr u64 InvalidOffset = ~u64(0);
+    static constexpr u64 MaxAlignment = 256u;
+    static constexpr u32 MaxPendingFrames = 8u;
+
+private:
+    struct PendingFrame
+    {
+        u64 frameNumber = 0u;
+        u64 endPos = 0u;
+    };
+    PendingFrame pendingFrames[MaxPendingFrames];
+    u32 pendingFrameStart = 0u;
+    u32 pendingFrameCount = 0u;
+
+    u64 capacity = 0u;
+    u64 headPos = 0u;
+    u64 tailPos = 0u;
+    u64 flushedPos = 0u;
+    u64 frameBytes = 0u;
+};
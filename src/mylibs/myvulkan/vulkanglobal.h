@@ -5,7 +5,10 @@
 #include <container/podvectorsbase.h>
 #include <container/vectorsbase.h>
 #include <core/general.h>
+#include <core/jobsystem.h>
 #include <core/mytypes.h>
+#include <myvulkan/buffercopybatch.h>
+#include <myvulkan/stagingring.h>
 #include <myvulkan/uniformbuffermanager.h>
 
 #include <vulkan/vulkan_core.h>
@@ -87,17 +90,32 @@ struct SwapChain
     u32 swapchainCount = 0;
 };
 
-struct BufferBarrierInfo
+// Staging buffer no longer written to, destroyed once frameNumber has retired.
+struct RetiringStagingBuffer
 {
-    VkBuffer buffer = VK_NULL_HANDLE;
-    VkBufferCopy copyRegion{};
+    Buffer buffer;
+    u64 frameNumber = 0u;
+};
+
+struct StagingStats
+{
+    u64 uploadedBytes = 0u;
+    // Part of uploaded bytes that did not fit into the ring.
+    u64 spilledBytes = 0u;
+    u64 ringCapacity = 0u;
+    u32 copyCount = 0u;
+    u32 spillCount = 0u;
+    // Copy commands and barriers flushBarriers did not need after batching the copies.
+    u32 copyCommandsSaved = 0u;
+    u32 barriersSaved = 0u;
 };
 
 struct VulkanGlobal
 {
     static constexpr u32 FramesInFlight = 2;
-    static constexpr u32 VulkanMaxScratchBufferFrameSize = 32u * 1024u * 1024u;
-    static constexpr u32 VulkanMaxScratchBufferSize = VulkanMaxScratchBufferFrameSize * FramesInFlight;
+    static constexpr u64 VulkanScratchBufferStartSize = 64u * 1024u * 1024u;
+    // Ring stops growing here, bigger frames keep spilling into their own staging buffers.
+    static constexpr u64 VulkanMaxScratchBufferSize = 1024u * 1024u * 1024u;
 
     QueueFamilyIndices queueFamilyIndices;
 
@@ -115,9 +133,13 @@ struct VulkanGlobal
 
     Buffer scratchBuffer;
     Buffer uniformBuffer;
-    u32 scratchBufferOffset = 0u;
-    u32 scratchBufferLastFlush = 0u;
-    u32 scratchBufferMaxOffset = VulkanMaxScratchBufferSize;
+    // Sub allocates scratchBuffer for the copies of all frames in flight.
+    StagingRing stagingRing;
+    PodVector<RetiringStagingBuffer> retiringStagingBuffers;
+    StagingStats stagingStats;
+    StagingStats lastStagingStats;
+    // Counts frameStart calls, first frame is 1.
+    u64 frameNumber = 0u;
     UniformBufferManager uniformBufferManager;
     UniformBufferHandle renderFrameBufferHandle[FramesInFlight];
 
@@ -134,12 +156,34 @@ struct VulkanGlobal
     VkCommandBuffer commandBuffers[FramesInFlight] = {};
     VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // current commandbuffer
 
+    // Render passes recorded on worker threads go into secondary command buffers. Pool per
+    // frame in flight and recording thread, the main thread records with index 0 and workers
+    // of jobSystem with their thread index + 1.
+    static constexpr u32 MaxRecordThreadCount = JobSystem::MaxWorkerCount + 1u;
+    static constexpr u32 MaxSecondaryCommandBuffersPerThread = 8u;
+    VkCommandPool secondaryCommandPools[FramesInFlight][MaxRecordThreadCount] = {};
+    VkCommandBuffer secondaryCommandBuffers[FramesInFlight][MaxRecordThreadCount][MaxSecondaryCommandBuffersPerThread] = {};
+    // Secondary buffers used this frame per recording thread.
+    u32 secondaryCommandBufferCounts[MaxRecordThreadCount] = {};
+    u32 recordThreadCount = 1u;
+    // Shared with the app, given to MyVulkan::init.
+    JobSystem *jobSystem = nullptr;
+    u32 secondaryRecordBatchCount = 0u;
+    double secondaryRecordSeconds = 0.0;
+
 
     VmaAllocator_T *allocator = VK_NULL_HANDLE;
 
 
     VkSampler globalTextureSampler = VK_NULL_HANDLE;
 
+    // Shared by every pipeline creation, including imgui.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    // Bytes of cache data loaded from disk, 0 means cold start.
+    u32 pipelineCacheLoadedSize = 0u;
+    u32 pipelineCreateCount = 0u;
+    double pipelineCreateSeconds = 0.0;
+
     VkFormat defaultColorFormat = VkFormat::VK_FORMAT_UNDEFINED;
     VkFormat presentColorFormat = VkFormat::VK_FORMAT_UNDEFINED;
     VkFormat depthFormat = VkFormat::VK_FORMAT_UNDEFINED;
@@ -147,10 +191,20 @@ struct VulkanGlobal
 
     SwapChain swapchain;
 
+    // Headless mode presents into these, swapchain.images refer to them.
+    Image headlessImages[FramesInFlight];
+    // Frames get copied here when they are dumped to disk, written after the frame fence.
+    Buffer headlessReadbackBuffers[FramesInFlight];
+    u64 headlessReadbackFrames[FramesInFlight] = {};
+    bool headlessReadbackPending[FramesInFlight] = {};
+    u64 headlessFrameNumber = 0u;
+
     u32 imageIndex = 0u;
 
     VulkanApp* vulkanApp = nullptr;
-    PodVector< BufferBarrierInfo > bufferMemoryBarriers;
+    // Source is the scratch buffer or a spilled staging buffer.
+    PodVector< BufferCopyCommand > bufferMemoryBarriers;
+    BufferCopyBatches bufferCopyBatches;
     PodVector< VkBufferMemoryBarrier > bufferMemoryBarriersCopy;
     PodVector< VkImageMemoryBarrier > imageMemoryGraphicsBarriers;
     PodVector< VkImageMemoryBarrier > imageMemoryComputeBarriers;
@@ -159,6 +213,8 @@ struct VulkanGlobal
 
     bool needToResize = false;
     bool waitForFence = true;
+    // multiDrawIndirect and drawIndirectFirstInstance are enabled.
+    bool multiDrawIndirect = false;
 };
 
 extern VulkanGlobal *vulk;
@@ -1,5 +1,9 @@
 #include "vulkaninitparameters.h"
 
+#include <core/general.h>
+
+#include <stdlib.h>
+
 static VulkanInitializationParameters vulkanInitParams;
 
 const VulkanInitializationParameters &VulkanInitializationParameters::get()
@@ -12,3 +16,26 @@ VulkanInitializationParameters &VulkanInitializationParameters::getRef()
     return vulkanInitParams;
 }
 
+
+void VulkanInitializationParameters::parseCommandLine(i32 argCount, char **argv)
+{
+    for(i32 i = 1; i < argCount; ++i)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argCount;
+        if(Supa::strcmp(arg, "--headless") == 0)
+        {
+            vulkanInitParams.headless = true;
+        }
+        else if(Supa::strcmp(arg, "--headless-frames") == 0 && hasValue)
+        {
+            vulkanInitParams.headless = true;
+            vulkanInitParams.headlessFrameCount = u32(strtoul(argv[++i], nullptr, 10));
+        }
+        else if(Supa::strcmp(arg, "--headless-dump") == 0 && hasValue)
+        {
+            vulkanInitParams.headless = true;
+            vulkanInitParams.headlessFrameDumpPath = argv[++i];
+        }
+    }
+}
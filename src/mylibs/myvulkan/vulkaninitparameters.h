@@ -1,5 +1,7 @@
 #pragma once
 
+#include <core/mytypes.h>
+
 enum class VSyncType : unsigned char
 {
     FIFO_VSYNC,
@@ -12,10 +14,26 @@ struct VulkanInitializationParameters
     static const VulkanInitializationParameters& get();
     static VulkanInitializationParameters& getRef();
 
+    // Reads the options apps take from the command line: --headless, --headless-frames <count>
+    // and --headless-dump <path>. Unknown arguments are left for the app.
+    static void parseCommandLine(i32 argCount, char **argv);
+
     bool showInfoMessages = false;
     bool useHDR = false;
     bool useIntegratedGpu = false;
     bool useValidationLayers = true;
     bool useVulkanDebugMarkersRenderDoc = false;
     VSyncType vsync = VSyncType::FIFO_VSYNC;
+
+    // No window, surface or swapchain, present blits into offscreen images of the size given
+    // to VulkanApp::initApp. Allows cpu devices like lavapipe.
+    bool headless = false;
+    // Headless app quits after this many frames, 0 runs until closed otherwise.
+    u32 headlessFrameCount = 0u;
+    // Headless frames get read back and written as <path><frame number>.ppm when set.
+    const char *headlessFrameDumpPath = nullptr;
+
+    // Pipeline cache gets loaded from here at init and saved back at deinit, nullptr keeps
+    // the cache only in memory.
+    const char *pipelineCachePath = "pipelinecache.bin";
 };
@@ -14,6 +14,9 @@
 
 static std::vector<Image*> sRenderTargetImages;
 
+// Keeps copied structs aligned in the staging ring.
+static constexpr u64 StagingCopyAlignment = 16u;
+
 static VkImageAspectFlags sGetAspectMaskFromFormat(VkFormat format)
 {
     VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -176,7 +179,8 @@ void VulkanResources::destroyFramebuffer(VkFramebuffer framebuffer)
 }
 
 bool VulkanResources::createImage(u32 width, u32 height, VkFormat format,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags memoryFlags, const char* imageName, Image &outImage)
+    VkImageUsageFlags usage, VkMemoryPropertyFlags memoryFlags, const char* imageName, Image &outImage,
+    bool allocateMemory)
 {
     if (outImage.image)
         destroyImage(outImage);
@@ -196,17 +200,26 @@ bool VulkanResources::createImage(u32 width, u32 height, VkFormat format,
     createInfo.queueFamilyIndexCount = 1;
     createInfo.pQueueFamilyIndices = &vulk->queueFamilyIndices.graphicsFamily;
 
-    VmaAllocationCreateInfo allocInfo = {};
-    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    if (allocateMemory)
+    {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
 
-    VK_CHECK(vmaCreateImage(vulk->allocator, &createInfo, &allocInfo, &outImage.image, &outImage.allocation, nullptr));
-    if (!outImage.image || !outImage.allocation)
-        return false;
+        VK_CHECK(vmaCreateImage(vulk->allocator, &createInfo, &allocInfo, &outImage.image, &outImage.allocation, nullptr));
+        if (!outImage.image || !outImage.allocation)
+            return false;
 
-    outImage.imageView = sCreateImageView(outImage.image, format);
-    ASSERT(outImage.imageView);
-    if (!outImage.imageView)
-        return false;
+        outImage.imageView = sCreateImageView(outImage.image, format);
+        ASSERT(outImage.imageView);
+        if (!outImage.imageView)
+            return false;
+    }
+    else
+    {
+        VK_CHECK(vkCreateImage(vulk->device, &createInfo, nullptr, &outImage.image));
+        if (!outImage.image)
+            return false;
+    }
 
     MyVulkan::setObjectName((u64)outImage.image, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, imageName);
     outImage.imageName = imageName;
@@ -219,10 +232,11 @@ bool VulkanResources::createImage(u32 width, u32 height, VkFormat format,
 
 bool VulkanResources::createRenderTargetImage(
     u32 width, u32 height, VkFormat format, VkImageUsageFlags usage,
-    const char* imageName, Image& outImage)
+    const char* imageName, Image& outImage, bool transient)
 {
     outImage.imageName = imageName;
-    if(width == outImage.width && height == outImage.height && format == outImage.format)
+    // Memory of an image cannot be rebound, transient ones always get a new image.
+    if(!transient && width == outImage.width && height == outImage.height && format == outImage.format)
         return true;
     VkImageAspectFlags aspect = sGetAspectMaskFromFormat(format);
 
@@ -237,7 +251,8 @@ bool VulkanResources::createRenderTargetImage(
         return false;
     }
 
-    bool success = createImage(width, height, format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageName, outImage);
+    bool success = createImage(width, height, format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageName, outImage,
+        !transient);
     if (!success)
     {
         ASSERT(!"Failed to create render target image!\n");
@@ -252,6 +267,43 @@ bool VulkanResources::createRenderTargetImage(
     return success;
 }
 
+VkMemoryRequirements VulkanResources::getImageMemoryRequirements(const Image &image)
+{
+    VkMemoryRequirements requirements = {};
+    ASSERT(image.image);
+    if (image.image)
+        vkGetImageMemoryRequirements(vulk->device, image.image, &requirements);
+    return requirements;
+}
+
+VmaAllocation_T *VulkanResources::allocateImageMemory(const VkMemoryRequirements &requirements)
+{
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    VmaAllocation allocation = nullptr;
+    VK_CHECK(vmaAllocateMemory(vulk->allocator, &requirements, &allocInfo, &allocation, nullptr));
+    ASSERT(allocation);
+    return allocation;
+}
+
+void VulkanResources::freeImageMemory(VmaAllocation_T *memory)
+{
+    if (memory)
+        vmaFreeMemory(vulk->allocator, memory);
+}
+
+bool VulkanResources::bindImageMemory(Image &image, VmaAllocation_T *memory)
+{
+    ASSERT(image.image && !image.allocation && !image.imageView && memory);
+    if (!image.image || image.allocation || image.imageView || !memory)
+        return false;
+
+    VK_CHECK(vmaBindImageMemory(vulk->allocator, memory, image.image));
+    image.imageView = sCreateImageView(image.image, image.format);
+    ASSERT(image.imageView);
+    return image.imageView != VK_NULL_HANDLE;
+}
 
 Buffer VulkanResources::createBuffer(size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags, const char* bufferName)
 {
@@ -263,7 +315,10 @@ Buffer VulkanResources::createBuffer(size_t size, VkBufferUsageFlags usage, VkMe
 
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    if(memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    // Cached host memory is for reading back from gpu, rest is written by cpu.
+    if(memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+        allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    else if(memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
         allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
     VmaAllocation allocation;
@@ -410,6 +465,12 @@ void VulkanResources::uploadScratchBufferToGpuBuffer(Buffer& gpuBuffer, size_t s
 
 }
 
+void VulkanResources::invalidateBuffer(const Buffer& buffer)
+{
+    ASSERT(buffer.data);
+    VK_CHECK(vmaInvalidateAllocation(vulk->allocator, buffer.allocation, 0, VK_WHOLE_SIZE));
+}
+
 void VulkanResources::destroyBuffer(Buffer& buffer)
 {
     if(!vulk)
@@ -530,23 +591,103 @@ bool VulkanResources::addToCopylist(const void* objectToCopy, VkDeviceSize objec
     ASSERT(objectToCopy);
     ASSERT(objectSize);
     ASSERT(targetBuffer);
-    ASSERT(vulk->scratchBufferOffset + objectSize < vulk->scratchBufferMaxOffset);
-    if (objectToCopy == nullptr || objectSize == 0 || targetBuffer == VK_NULL_HANDLE ||
-        vulk->scratchBufferOffset + objectSize >= vulk->scratchBufferMaxOffset)
+    if (objectToCopy == nullptr || objectSize == 0 || targetBuffer == VK_NULL_HANDLE)
         return false;
 
+    VkBuffer srcBuffer = vulk->scratchBuffer.buffer;
+    u64 srcOffset = vulk->stagingRing.allocate(objectSize, StagingCopyAlignment);
+    if (srcOffset != StagingRing::InvalidOffset)
+    {
+        Supa::memcpy(((u8*)vulk->scratchBuffer.data) + srcOffset, objectToCopy, objectSize);
+    }
+    else
+    {
+        // Frames in flight fill the ring, this copy gets its own buffer and the ring grows
+        // at next frame start.
+        Buffer spillBuffer = createBuffer(objectSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "Staging spill buffer");
+        ASSERT(spillBuffer.data);
+        if (!spillBuffer.data)
+            return false;
+
+        Supa::memcpy(spillBuffer.data, objectToCopy, objectSize);
+        VK_CHECK(vmaFlushAllocation(vulk->allocator, spillBuffer.allocation, 0, VK_WHOLE_SIZE));
+        vulk->retiringStagingBuffers.push_back({ spillBuffer, vulk->frameNumber });
+
+        srcBuffer = spillBuffer.buffer;
+        srcOffset = 0u;
+        vulk->stagingStats.spilledBytes += objectSize;
+        ++vulk->stagingStats.spillCount;
+    }
+
     if (vulk->imageMemoryGraphicsBarriers.size() == 0 && vulk->imageMemoryComputeBarriers.size() == 0 && vulk->bufferMemoryBarriers.size() == 0)
         MyVulkan::beginDebugRegion("Barriers and copies", { 1.0f, 0.0f, 1.0f, 1.0f });
 
-    Supa::memcpy(((u8*)vulk->scratchBuffer.data) + vulk->scratchBufferOffset, objectToCopy, objectSize);
+    vulk->bufferMemoryBarriers.pushBack(BufferCopyCommand{ .srcBuffer = (u64)srcBuffer, .dstBuffer = (u64)targetBuffer,
+        .srcOffset = srcOffset, .dstOffset = targetOffset, .size = objectSize });
+    vulk->stagingStats.uploadedBytes += objectSize;
+    ++vulk->stagingStats.copyCount;
 
-    VkBufferCopy region = { vulk->scratchBufferOffset, targetOffset, objectSize };
+    return true;
+}
 
-    vulk->bufferMemoryBarriers.pushBack({ targetBuffer, region });
-    vulk->scratchBufferOffset += objectSize;
+void VulkanResources::endStagingFrame()
+{
+    vulk->stagingRing.endFrame(vulk->frameNumber);
+    vulk->stagingStats.ringCapacity = vulk->stagingRing.getCapacity();
+    vulk->lastStagingStats = vulk->stagingStats;
+    vulk->stagingStats = StagingStats{};
+}
 
+static void sGrowStagingRing(u64 neededSize)
+{
+    u64 newCapacity = vulk->stagingRing.getCapacity();
+    while (newCapacity < neededSize && newCapacity < VulkanGlobal::VulkanMaxScratchBufferSize)
+        newCapacity *= 2u;
+    if (newCapacity == vulk->stagingRing.getCapacity())
+        return;
 
-    return true;
+    Buffer newBuffer = VulkanResources::createBuffer(newCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "Scratch buffer");
+    if (!newBuffer.data)
+        return;
+
+    // Frames in flight and copies not yet recorded can still read the old one.
+    vulk->retiringStagingBuffers.push_back({ vulk->scratchBuffer, vulk->frameNumber });
+    vulk->scratchBuffer = newBuffer;
+    vulk->stagingRing.init(newCapacity);
+    printf("Staging ring grew to %u MiB\n", u32(newCapacity / (1024u * 1024u)));
+}
+
+void VulkanResources::retireStagingFrames(u64 frameNumber)
+{
+    vulk->stagingRing.retireFrames(frameNumber);
+
+    for (u32 i = 0; i < vulk->retiringStagingBuffers.size();)
+    {
+        RetiringStagingBuffer &retiring = vulk->retiringStagingBuffers[i];
+        if (retiring.frameNumber <= frameNumber)
+        {
+            destroyBuffer(retiring.buffer);
+            retiring = vulk->retiringStagingBuffers.back();
+            vulk->retiringStagingBuffers.resize(vulk->retiringStagingBuffers.size() - 1u);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Room for every frame in flight to upload as much as the last one did.
+    const StagingStats &lastStats = vulk->lastStagingStats;
+    if (lastStats.spillCount > 0u)
+        sGrowStagingRing((lastStats.uploadedBytes + lastStats.copyCount * StagingCopyAlignment)
+            * VulkanGlobal::FramesInFlight);
+}
+
+const StagingStats &VulkanResources::getStagingStats()
+{
+    return vulk->lastStagingStats;
 }
 
 bool VulkanResources::addImageGraphicsBarrier(VkImageMemoryBarrier barrier)
@@ -595,23 +736,29 @@ bool VulkanResources::flushBarriers(VkPipelineStageFlagBits dstStageMask)
    // vkFlushMappedMemoryRanges?????
     //PodVector< VkBufferMemoryBarrier > bufferBarriers;
 
-    // for flushing
-    VkDeviceSize size = vulk->scratchBufferOffset - vulk->scratchBufferLastFlush;
-    size = ((size + 255) / 256) * 256;
-
-    VK_CHECK(vmaFlushAllocation(vulk->allocator, vulk->scratchBuffer.allocation, vulk->scratchBufferLastFlush, size));
-    // set the scratchBufferLastFlush to be divisable by 256 and round it down
-    vulk->scratchBufferLastFlush = vulk->scratchBufferOffset & (~u32(255));
-
-    for (const auto& barrier : vulk->bufferMemoryBarriers)
+    // VMA rounds the ranges to nonCoherentAtomSize.
+    u64 flushOffsets[2];
+    u64 flushSizes[2];
+    u32 flushRangeCount = vulk->stagingRing.takeUnflushedRanges(flushOffsets, flushSizes);
+    for (u32 i = 0; i < flushRangeCount; ++i)
+        VK_CHECK(vmaFlushAllocation(vulk->allocator, vulk->scratchBuffer.allocation, flushOffsets[i], flushSizes[i]));
+
+    // One copy command per source and destination pair, one barrier per written range.
+    static_assert(sizeof(BufferCopyRegion) == sizeof(VkBufferCopy));
+    BufferCopyBatches &copyBatches = vulk->bufferCopyBatches;
+    batchBufferCopies(vulk->bufferMemoryBarriers.data(), vulk->bufferMemoryBarriers.size(), copyBatches);
+    for (const BufferCopyBatch &batch : copyBatches.batches)
     {
-        if (barrier.buffer)
-        {
-            vkCmdCopyBuffer(vulk->commandBuffer, vulk->scratchBuffer.buffer, barrier.buffer, 1, &barrier.copyRegion);
-            vulk->bufferMemoryBarriersCopy.push_back(bufferBarrier(barrier.buffer, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                barrier.copyRegion.size, barrier.copyRegion.dstOffset));
-        }
+        vkCmdCopyBuffer(vulk->commandBuffer, (VkBuffer)batch.srcBuffer, (VkBuffer)batch.dstBuffer, batch.regionCount,
+            (const VkBufferCopy *)(copyBatches.regions.data() + batch.firstRegion));
+    }
+    for (const BufferCopyRange &range : copyBatches.ranges)
+    {
+        vulk->bufferMemoryBarriersCopy.push_back(bufferBarrier((VkBuffer)range.dstBuffer, VK_ACCESS_MEMORY_WRITE_BIT,
+            VK_ACCESS_MEMORY_READ_BIT, range.size, range.offset));
     }
+    vulk->stagingStats.copyCommandsSaved += vulk->bufferMemoryBarriers.size() - copyBatches.batches.size();
+    vulk->stagingStats.barriersSaved += vulk->bufferMemoryBarriers.size() - copyBatches.ranges.size();
 
     const VkBufferMemoryBarrier* bufferBarrier = vulk->bufferMemoryBarriersCopy.size() > 0 ? vulk->bufferMemoryBarriersCopy.data() : nullptr;
 
@@ -20,11 +20,22 @@ public:
     static void update();
     static bool deinit();
 
+    // Without allocateMemory the image gets no memory and no image view until bindImageMemory.
     static bool createImage(u32 width, u32 height, VkFormat format, VkImageUsageFlags usage,
-        VkMemoryPropertyFlags memoryFlags, const char* imageName, Image &outImage);
+        VkMemoryPropertyFlags memoryFlags, const char* imageName, Image &outImage, bool allocateMemory = true);
 
+    // Transient render targets get recreated on every call and created without memory, so they
+    // can be bound to memory allocated by the caller, see bindImageMemory.
     static bool createRenderTargetImage(u32 width, u32 height, VkFormat format, VkImageUsageFlags usage,
-        const char* imageName, Image& outImage);
+        const char* imageName, Image& outImage, bool transient = false);
+
+    static VkMemoryRequirements getImageMemoryRequirements(const Image &image);
+    // Device local memory images can be bound to. Free it with freeImageMemory once no image bound
+    // to it is in use.
+    static VmaAllocation_T *allocateImageMemory(const VkMemoryRequirements &requirements);
+    static void freeImageMemory(VmaAllocation_T *memory);
+    // Binds image created without memory at the start of memory and creates its image view.
+    static bool bindImageMemory(Image &image, VmaAllocation_T *memory);
 
     static void updateImageWithData(u32 width, u32 height, u32 pixelSize,
         Image& targetImage, u32 dataSize, void* data);
@@ -36,6 +47,16 @@ public:
 
     static Buffer createBuffer(size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags, const char* bufferName);
     static void destroyBuffer(Buffer& buffer);
+    // Makes gpu writes visible to cpu reading the mapped data of non coherent memory.
+    static void invalidateBuffer(const Buffer& buffer);
+
+    // Copies made since frameStart belong to the current frame from here on.
+    static void endStagingFrame();
+    // Frees staging of frames up to frameNumber, called after their fence. Grows the ring if
+    // the last frame spilled.
+    static void retireStagingFrames(u64 frameNumber);
+    // Stats of the last submitted frame.
+    static const StagingStats &getStagingStats();
 
     static size_t uploadToScratchbuffer(void* data, size_t size, size_t offset);
     static void uploadScratchBufferToGpuBuffer(Buffer& gpuBuffer, size_t sizes);
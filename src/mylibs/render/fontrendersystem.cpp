@@ -253,14 +253,9 @@ void FontRenderSystem::reset()
     s_FontRenderSystemData.get()->m_vertData.clear();
 }
 
-void FontRenderSystem::render()
+static void sFontRenderSystemRecord(void *)
 {
-    VkCommandBuffer commandBuffer = vulk->commandBuffer;
-    if (s_FontRenderSystemData.get()->m_vertData.size() == 0 || !commandBuffer)
-        return;
-    MyVulkan::beginDebugRegion("Font rendering", Vec4(0.0f, 0.0f, 1.0f, 1.0f));
-    MyVulkan::beginRenderPass(s_FontRenderSystemData.get()->m_pipeline, {});
-
+    VkCommandBuffer commandBuffer = MyVulkan::getCommandBuffer();
     MyVulkan::bindGraphicsPipelineWithDescriptors(s_FontRenderSystemData.get()->m_pipeline, vulk->frameIndex);
     vkCmdBindIndexBuffer(
         commandBuffer,
@@ -268,6 +263,28 @@ void FontRenderSystem::render()
         0,
         VkIndexType::VK_INDEX_TYPE_UINT32);
     vkCmdDrawIndexed(commandBuffer, u32(s_FontRenderSystemData.get()->m_vertData.size() * 6), 1, 0, 0, 0);
+}
+
+SecondaryCommandRecord FontRenderSystem::getRenderRecord()
+{
+    if (s_FontRenderSystemData.get()->m_vertData.size() == 0)
+        return SecondaryCommandRecord{};
+    return SecondaryCommandRecord{ .pipeline = &s_FontRenderSystemData.get()->m_pipeline,
+        .recordFunc = sFontRenderSystemRecord };
+}
+
+void FontRenderSystem::render(const SecondaryCommandRecord *record)
+{
+    if (s_FontRenderSystemData.get()->m_vertData.size() == 0 || !vulk->commandBuffer)
+        return;
+    MyVulkan::beginDebugRegion("Font rendering", Vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    MyVulkan::beginRenderPass(s_FontRenderSystemData.get()->m_pipeline, {},
+        record ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+    if (record)
+        MyVulkan::executeSecondaryCommandBuffer(*record);
+    else
+        sFontRenderSystemRecord(nullptr);
 
     vkCmdEndRenderPass(vulk->commandBuffer);
     s_FontRenderSystemData.get()->m_vertData.clear();
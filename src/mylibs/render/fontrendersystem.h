@@ -4,6 +4,7 @@
 #include <math/vector3.h>
 
 struct Image;
+struct SecondaryCommandRecord;
 
 static constexpr u32 MAX_LETTERS = 10000 * 4;
 
@@ -45,7 +46,10 @@ public:
     //static // return offset to scratch buffer
     static void update();
     static void reset();
-    static void render();
+    // Draws of render for MyVulkan::recordSecondaryCommandBuffers, empty when there is no text.
+    static SecondaryCommandRecord getRenderRecord();
+    // Executes the recorded secondary command buffer when given, otherwise records the draws inline.
+    static void render(const SecondaryCommandRecord *record = nullptr);
     static void setRenderTarget(Image& image);
     static void addText(const char *text, Vector2 pos,
         Vector2 charSize = Vector2(8.0f, 12.0f), const Vector4 &color = Vector4(1.0f, 1.0f, 1.0f, 1.0f));
@@ -7,18 +7,18 @@ LightingRenderTargets::~LightingRenderTargets()
     VulkanResources::destroyImage(lightingTargetImage);
 }
 
-bool LightingRenderTargets::resizeLightingTargets()
+bool LightingRenderTargets::resizeLightingTargets(bool transient)
 {
     uint32_t width = vulk->swapchain.width;
     uint32_t height = vulk->swapchain.height;
-    return resizeLightingTargets(width, height);
+    return resizeLightingTargets(width, height, transient);
 }
 
-bool LightingRenderTargets::resizeLightingTargets(uint32_t width, uint32_t height)
+bool LightingRenderTargets::resizeLightingTargets(uint32_t width, uint32_t height, bool transient)
 {
     if (!VulkanResources::createRenderTargetImage(width, height, VK_FORMAT_R16G16B16A16_SFLOAT,
         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        "Light HDR color target", lightingTargetImage))
+        "Light HDR color target", lightingTargetImage, transient))
     {
         printf("Failed to create %s\n", lightingTargetImage.imageName);
         return false;
@@ -5,8 +5,9 @@
 struct LightingRenderTargets
 {
     ~LightingRenderTargets();
-    bool resizeLightingTargets();
-    bool resizeLightingTargets(uint32_t width, uint32_t height);
+    // Transient creates the lighting target without memory, see VulkanResources::createRenderTargetImage.
+    bool resizeLightingTargets(bool transient = false);
+    bool resizeLightingTargets(uint32_t width, uint32_t height, bool transient = false);
 
     void prepareTargetsForLightingComputeWriting();
     void prepareForTonemapSampling();
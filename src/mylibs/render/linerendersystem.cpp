@@ -116,23 +116,40 @@ bool LineRenderSystem::prepareToRender()
     return true;
 }
 
-void LineRenderSystem::render(const Image &colorImage, const Image &depthImage)
+static void sLineRenderSystemRecord(void *)
+{
+    MyVulkan::bindGraphicsPipelineWithDescriptors(s_lineRenderSystemData.get()->m_lineRenderPipeline,
+        vulk->frameIndex);
+    vkCmdDraw(MyVulkan::getCommandBuffer(), s_lineRenderSystemData.get()->m_lines.size() * 2, 1, 0, 0);
+}
+
+SecondaryCommandRecord LineRenderSystem::getRenderRecord()
+{
+    if(s_lineRenderSystemData.get()->m_lines.size() == 0)
+        return SecondaryCommandRecord{};
+    return SecondaryCommandRecord{ .pipeline = &s_lineRenderSystemData.get()->m_lineRenderPipeline,
+        .recordFunc = sLineRenderSystemRecord };
+}
+
+void LineRenderSystem::render(const Image &colorImage, const Image &depthImage,
+    const SecondaryCommandRecord *record)
 {
     if(s_lineRenderSystemData.get()->m_lines.size() == 0)
         return;
 
     MyVulkan::beginDebugRegion("Line rendering", Vec4(1.0f, 0.0f, 0.0f, 1.0f));
-    MyVulkan::beginRenderPass(s_lineRenderSystemData.get()->m_lineRenderPipeline, {});
+    MyVulkan::beginRenderPass(s_lineRenderSystemData.get()->m_lineRenderPipeline, {},
+        record ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
     /*
     beginRendering({
         RenderImage{.image = &colorImage, .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD }},
         {.image = &depthImage, .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD });
         */
-    MyVulkan::bindGraphicsPipelineWithDescriptors(s_lineRenderSystemData.get()->m_lineRenderPipeline,
-        vulk->frameIndex);
-    vkCmdDraw(vulk->commandBuffer, s_lineRenderSystemData.get()->m_lines.size() * 2, 1, 0, 0);
-
+    if(record)
+        MyVulkan::executeSecondaryCommandBuffer(*record);
+    else
+        sLineRenderSystemRecord(nullptr);
 
     //vkCmdEndRendering(vulk->commandBuffer);
     vkCmdEndRenderPass(vulk->commandBuffer);
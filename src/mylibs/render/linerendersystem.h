@@ -3,6 +3,7 @@
 #include <math/vector3.h>
 
 struct Image;
+struct SecondaryCommandRecord;
 
 class LineRenderSystem
 {
@@ -14,6 +15,10 @@ public:
     static void clear();
     static bool prepareToRender();
 
-    static void render(const Image &colorImage, const Image &depthImage);
+    // Draws of render for MyVulkan::recordSecondaryCommandBuffers, empty when there are no lines.
+    static SecondaryCommandRecord getRenderRecord();
+    // Executes the recorded secondary command buffer when given, otherwise records the draws inline.
+    static void render(const Image &colorImage, const Image &depthImage,
+        const SecondaryCommandRecord *record = nullptr);
     static void setRendertargets(const Image &colorImage, const Image &depthImage);
 };
\ No newline at end of file
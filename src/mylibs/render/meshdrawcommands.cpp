@@ -0,0 +1,25 @@
+#include "meshdrawcommands.h"
+
+#include <container/podvector.h>
+
+u32 appendMeshDrawCommands(const MeshDrawRange *meshes, const u32 *instanceCounts, u32 meshCount,
+    u32 firstInstance, PodVector<DrawIndexedIndirectCommand> &outCommands)
+{
+    for(u32 i = 0; i < meshCount; ++i)
+    {
+        const MeshDrawRange &mesh = meshes[i];
+        u32 instances = instanceCounts[i];
+        if(instances > 0u && mesh.indexCount > 0u)
+        {
+            outCommands.push_back(DrawIndexedIndirectCommand{
+                .indexCount = mesh.indexCount,
+                .instanceCount = instances,
+                .firstIndex = mesh.indexStart,
+                .vertexOffset = i32(mesh.vertexStart),
+                .firstInstance = firstInstance,
+            });
+        }
+        firstInstance += instances;
+    }
+    return firstInstance;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <container/podvectorsbase.h>
+#include <core/mytypes.h>
+
+// Builds the indirect draw commands for mesh rendering. Runs without a gpu, the commands get
+// copied as is into an indirect buffer.
+
+// Same layout as VkDrawIndexedIndirectCommand.
+struct DrawIndexedIndirectCommand
+{
+    u32 indexCount = 0u;
+    u32 instanceCount = 0u;
+    u32 firstIndex = 0u;
+    i32 vertexOffset = 0;
+    u32 firstInstance = 0u;
+};
+
+// Where a mesh is in the shared index and vertex buffers.
+struct MeshDrawRange
+{
+    u32 indexStart = 0u;
+    u32 indexCount = 0u;
+    u32 vertexStart = 0u;
+};
+
+// Appends a command for each mesh with instances and indices, in mesh order. Instances are
+// expected packed in the same mesh order starting from firstInstance, meshes without indices
+// still skip over their instances.
+// Returns the instance after the last one of these meshes.
+u32 appendMeshDrawCommands(const MeshDrawRange *meshes, const u32 *instanceCounts, u32 meshCount,
+    u32 firstInstance, PodVector<DrawIndexedIndirectCommand> &outCommands);
@@ -0,0 +1,164 @@
+#include "meshinstancetable.h"
+
+#include <container/podvector.h>
+#include <core/general.h>
+
+bool MeshInstanceTable::init(u32 maxSlots, u32 bufferCount)
+{
+    ASSERT(bufferCount > 0u && bufferCount <= MaxBufferCount);
+    if(bufferCount == 0u || bufferCount > MaxBufferCount)
+        return false;
+
+    slots.clear();
+    slotMatrices.clear();
+    freeSlots.clear();
+    instanceSlots.clear();
+    dirtyRanges.clear();
+    drawSlots.clear();
+    animatedInstanceCounts.clear();
+    staticInstanceCounts.clear();
+
+    maxSlotCount = maxSlots;
+    allBuffersMask = (1u << bufferCount) - 1u;
+    drawSlotsDirtyMask = 0u;
+    instanceCount = 0u;
+    drawModelCount = 0u;
+    drawOrderChanged = false;
+    drawSlotsDirty = false;
+    return true;
+}
+
+void MeshInstanceTable::beginFrame()
+{
+    for(Slot &slot : slots)
+        slot.seen = false;
+}
+
+u32 MeshInstanceTable::setInstance(u32 instanceId, u32 modelIndex, bool animated,
+    const Mat3x4 &renderMatrix, const Mat3x4 &normalMatrix)
+{
+    ASSERT(instanceId != ~0u);
+    if(instanceId >= instanceSlots.size())
+        instanceSlots.resize(instanceId + 1u, ~0u);
+
+    u32 slotIndex = instanceSlots[instanceId];
+    if(slotIndex == ~0u)
+    {
+        if(freeSlots.size() > 0u)
+        {
+            slotIndex = freeSlots.popBack();
+        }
+        else
+        {
+            if(slots.size() >= maxSlotCount)
+                return ~0u;
+            slotIndex = slots.size();
+            slots.push_back(Slot{});
+            slotMatrices.push_back(renderMatrix);
+            slotMatrices.push_back(normalMatrix);
+        }
+        instanceSlots[instanceId] = slotIndex;
+        slots[slotIndex].instanceId = instanceId;
+        slots[slotIndex].dirtyBufferMask = allBuffersMask;
+        drawOrderChanged = true;
+        ++instanceCount;
+    }
+
+    Slot &slot = slots[slotIndex];
+    if(slot.modelIndex != modelIndex || slot.animated != animated)
+    {
+        slot.modelIndex = modelIndex;
+        slot.animated = animated;
+        drawOrderChanged = true;
+    }
+    slot.seen = true;
+
+    Mat3x4 *matrices = &slotMatrices[slotIndex * 2u];
+    if(Supa::memcmp(&matrices[0], &renderMatrix, sizeof(Mat3x4)) != 0
+        || Supa::memcmp(&matrices[1], &normalMatrix, sizeof(Mat3x4)) != 0)
+    {
+        matrices[0] = renderMatrix;
+        matrices[1] = normalMatrix;
+        slot.dirtyBufferMask = allBuffersMask;
+    }
+    return slotIndex;
+}
+
+void MeshInstanceTable::endFrame(u32 modelCount, u32 bufferIndex)
+{
+    ASSERT(bufferIndex < MaxBufferCount && ((1u << bufferIndex) & allBuffersMask) != 0u);
+
+    for(u32 slotIndex = 0; slotIndex < slots.size(); ++slotIndex)
+    {
+        Slot &slot = slots[slotIndex];
+        if(slot.instanceId == ~0u || slot.seen)
+            continue;
+        instanceSlots[slot.instanceId] = ~0u;
+        slot = Slot{};
+        freeSlots.push_back(slotIndex);
+        --instanceCount;
+        drawOrderChanged = true;
+    }
+
+    if(drawOrderChanged || modelCount != drawModelCount)
+    {
+        // Counting sort by animated first, then model, then slot.
+        drawModelCount = modelCount;
+        drawOffsets.clear();
+        drawOffsets.resize(modelCount * 2u + 1u, 0u);
+        for(const Slot &slot : slots)
+        {
+            if(slot.instanceId == ~0u || slot.modelIndex >= modelCount)
+                continue;
+            ++drawOffsets[(slot.animated ? 0u : modelCount) + slot.modelIndex + 1u];
+        }
+        animatedInstanceCounts.resize(modelCount);
+        staticInstanceCounts.resize(modelCount);
+        for(u32 i = 0; i < modelCount; ++i)
+        {
+            animatedInstanceCounts[i] = drawOffsets[i + 1u];
+            staticInstanceCounts[i] = drawOffsets[modelCount + i + 1u];
+        }
+        for(u32 i = 1; i < drawOffsets.size(); ++i)
+            drawOffsets[i] += drawOffsets[i - 1u];
+
+        drawSlots.resize(drawOffsets[modelCount * 2u]);
+        for(u32 slotIndex = 0; slotIndex < slots.size(); ++slotIndex)
+        {
+            const Slot &slot = slots[slotIndex];
+            if(slot.instanceId == ~0u || slot.modelIndex >= modelCount)
+                continue;
+            drawSlots[drawOffsets[(slot.animated ? 0u : modelCount) + slot.modelIndex]++] = slotIndex;
+        }
+        drawSlotsDirtyMask = allBuffersMask;
+        drawOrderChanged = false;
+    }
+
+    u32 bufferBit = 1u << bufferIndex;
+    drawSlotsDirty = (drawSlotsDirtyMask & bufferBit) != 0u;
+    drawSlotsDirtyMask &= ~bufferBit;
+
+    dirtyRanges.clear();
+    for(u32 slotIndex = 0; slotIndex < slots.size(); ++slotIndex)
+    {
+        Slot &slot = slots[slotIndex];
+        if((slot.dirtyBufferMask & bufferBit) == 0u)
+            continue;
+        slot.dirtyBufferMask &= ~bufferBit;
+        // Freed slots are not drawn, no need to upload them.
+        if(slot.instanceId == ~0u)
+            continue;
+        if(dirtyRanges.size() > 0u && dirtyRanges.back().first + dirtyRanges.back().count == slotIndex)
+            ++dirtyRanges.back().count;
+        else
+            dirtyRanges.push_back(MeshInstanceRange{ .first = slotIndex, .count = 1u });
+    }
+}
+
+u64 MeshInstanceTable::getUploadBytes() const
+{
+    u64 result = drawSlotsDirty ? u64(drawSlots.size()) * sizeof(u32) : 0u;
+    for(const MeshInstanceRange &range : dirtyRanges)
+        result += u64(range.count) * 2u * sizeof(Mat3x4);
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <container/podvectorsbase.h>
+#include <core/mytypes.h>
+#include <math/matrix.h>
+
+// Persistent instance data for mesh rendering. Every entity keeps its slot as long as it gets
+// set every frame, and only slots whose matrices changed get uploaded. Gpu buffers are per
+// frame in flight, so a change stays dirty until each of them has been written once.
+// Runs without a gpu, callers upload the ranges it reports.
+
+// Slots first to first + count - 1.
+struct MeshInstanceRange
+{
+    u32 first = 0u;
+    u32 count = 0u;
+};
+
+class MeshInstanceTable
+{
+public:
+    // bufferCount is the amount of gpu copies, at most 8.
+    bool init(u32 maxSlotCount, u32 bufferCount);
+
+    // Instances not set again before endFrame get removed.
+    void beginFrame();
+    // instanceId is stable per entity, like a scene graph handle index.
+    // Returns the slot, ~0u when out of slots.
+    u32 setInstance(u32 instanceId, u32 modelIndex, bool animated,
+        const Mat3x4 &renderMatrix, const Mat3x4 &normalMatrix);
+    // Removes the unseen instances, rebuilds the draw order when instances were added, removed or
+    // changed model, and collects what gpu buffer bufferIndex is missing.
+    void endFrame(u32 modelCount, u32 bufferIndex);
+
+    // Render matrix then normal matrix per slot.
+    const PodVector<Mat3x4> &getSlotMatrices() const { return slotMatrices; }
+    // Slots to copy from getSlotMatrices into the buffer given to endFrame, sorted and merged.
+    const PodVector<MeshInstanceRange> &getDirtyRanges() const { return dirtyRanges; }
+
+    // Slot per drawn instance. Animated instances first then static ones, both in model order,
+    // instances of a model in slot order.
+    const PodVector<u32> &getDrawSlots() const { return drawSlots; }
+    // Draw slots of the buffer given to endFrame are out of date.
+    bool getDrawSlotsDirty() const { return drawSlotsDirty; }
+    const PodVector<u32> &getAnimatedInstanceCounts() const { return animatedInstanceCounts; }
+    const PodVector<u32> &getStaticInstanceCounts() const { return staticInstanceCounts; }
+
+    // Bytes the dirty ranges and draw slots of the last endFrame add up to.
+    u64 getUploadBytes() const;
+    u32 getInstanceCount() const { return instanceCount; }
+    u32 getSlotCount() const { return slots.size(); }
+
+    static constexpr u32 MaxBufferCount = 8u;
+
+private:
+    struct Slot
+    {
+        u32 instanceId = ~0u;
+        u32 modelIndex = ~0u;
+        // Bit per gpu buffer still missing the matrices.
+        u32 dirtyBufferMask = 0u;
+        bool animated = false;
+        bool seen = false;
+    };
+
+    PodVector<Slot> slots;
+    PodVector<Mat3x4> slotMatrices;
+    PodVector<u32> freeSlots;
+    PodVector<u32> instanceSlots;
+
+    PodVector<MeshInstanceRange> dirtyRanges;
+    PodVector<u32> drawSlots;
+    PodVector<u32> animatedInstanceCounts;
+    PodVector<u32> staticInstanceCounts;
+    PodVector<u32> drawOffsets;
+
+    u32 maxSlotCount = 0u;
+    u32 allBuffersMask = 0u;
+    u32 drawSlotsDirtyMask = 0u;
+    u32 instanceCount = 0u;
+    u32 drawModelCount = 0u;
+    bool drawOrderChanged = false;
+    bool drawSlotsDirty = false;
+};
@@ -7,6 +7,7 @@
 #include <container/vector.h>
 
 #include <core/general.h>
+#include <core/jobsystem.h>
 #include <core/nullable.h>
 #include <core/timer.h>
 
@@ -14,6 +15,8 @@
 #include <myvulkan/myvulkan.h>
 #include <myvulkan/shader.h>
 
+#include <render/meshdrawcommands.h>
+#include <render/meshinstancetable.h>
 
 #include <scene/scene.h>
 
@@ -21,6 +24,9 @@
 
 static void sMeshRenderSystemRender(bool isShadowOnly);
 
+// Render and normal matrix per instance have to fit the matrices buffer.
+static constexpr u32 MeshRenderMaxInstances = 32768u;
+
 
 struct MeshRenderSystemData
 {
@@ -41,6 +47,8 @@ struct MeshRenderSystemData
     Buffer m_modelRenderMatricesBuffer[VulkanGlobal::FramesInFlight];
     Buffer m_modelBoneRenderMatricesBuffer[VulkanGlobal::FramesInFlight];
     Buffer m_modelRenderBoneStartIndexBuffer[VulkanGlobal::FramesInFlight];
+    Buffer m_drawCommandsBuffer[VulkanGlobal::FramesInFlight];
+    Buffer m_instanceSlotsBuffer[VulkanGlobal::FramesInFlight];
 
     Image m_paletteImage;
 
@@ -48,13 +56,21 @@ struct MeshRenderSystemData
 
     PodVector<ModelData> m_models;
 
-    // these 3 probably should belong somewhere else, since they depend on scenedata, if wanting to have render to texture...
+    // these probably should belong somewhere else, since they depend on scenedata, if wanting to have render to texture...
     // maybe MeshRenderScene
-    Vector<PodVector< uint32_t >> m_modelRenderBoneStartIndices;
-    Vector<PodVector< Mat3x4 >> m_modelRenderMatrices;
-    Vector<PodVector< Mat3x4 >> m_animatedModelRenderMatrices;
+    MeshInstanceTable m_instanceTable;
+    // Bone matrices get written every frame, start index per instance slot.
+    PodVector< uint32_t > m_slotBoneStartIndices;
     PodVector< Mat3x4 > m_boneAnimatedModelRenderMatrices;
 
+    // Animated draws first then the static ones, same order as the instance slots.
+    PodVector<DrawIndexedIndirectCommand> m_drawCommands;
+    u32 m_staticDrawCommandStart = 0u;
+    // Bit per frame in flight whose draw commands buffer is out of date.
+    u32 m_drawCommandsDirtyMask = 0u;
+
+    u64 m_instanceUploadBytes = 0u;
+
     uint32_t m_indicesCount = 0u;
     uint32_t m_verticesCount = 0u;
     uint32_t m_animatedVerticesCount = 0u;
@@ -80,6 +96,8 @@ void MeshRenderSystem::deinit()
             VulkanResources::destroyBuffer(s_meshRenderSystemData.get()->m_modelRenderMatricesBuffer[i]);
             VulkanResources::destroyBuffer(s_meshRenderSystemData.get()->m_modelBoneRenderMatricesBuffer[i]);
             VulkanResources::destroyBuffer(s_meshRenderSystemData.get()->m_modelRenderBoneStartIndexBuffer[i]);
+            VulkanResources::destroyBuffer(s_meshRenderSystemData.get()->m_drawCommandsBuffer[i]);
+            VulkanResources::destroyBuffer(s_meshRenderSystemData.get()->m_instanceSlotsBuffer[i]);
         }
         s_meshRenderSystemData.destroy();
     }
@@ -144,12 +162,22 @@ bool MeshRenderSystem::init()
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Render bone matrices buffer");
 
+        // Command per entity type for both animated and static meshes at most.
+        s_meshRenderSystemData.get()->m_drawCommandsBuffer[i] = VulkanResources::createBuffer(
+            2u * u32(EntityType::NUM_OF_ENTITY_TYPES) * sizeof(DrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Mesh draw commands buffer");
+
+        s_meshRenderSystemData.get()->m_instanceSlotsBuffer[i] = VulkanResources::createBuffer(
+            MeshRenderMaxInstances * sizeof(u32),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Mesh instance slots buffer");
 
     }
 
-    s_meshRenderSystemData.get()->m_modelRenderMatrices.resize(u32(EntityType::NUM_OF_ENTITY_TYPES));
-    s_meshRenderSystemData.get()->m_animatedModelRenderMatrices.resize(u32(EntityType::NUM_OF_ENTITY_TYPES));
-    s_meshRenderSystemData.get()->m_modelRenderBoneStartIndices.resize(u32(EntityType::NUM_OF_ENTITY_TYPES));
+    static_assert(MeshRenderMaxInstances * 2u * sizeof(Mat3x4) <= 4u * 1024u * 1024u);
+    if(!s_meshRenderSystemData.get()->m_instanceTable.init(MeshRenderMaxInstances, VulkanGlobal::FramesInFlight))
+        return false;
     s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices.reserve(65536);
     s_meshRenderSystemData.get()->m_models.resize(u32(EntityType::NUM_OF_ENTITY_TYPES));
 
@@ -223,6 +251,7 @@ bool MeshRenderSystem::init()
                 DescriptorInfo(s_meshRenderSystemData.get()->m_vertexBuffer),
                 DescriptorInfo(s_meshRenderSystemData.get()->m_animationVertexBuffer),
                 DescriptorInfo(s_meshRenderSystemData.get()->m_modelRenderBoneStartIndexBuffer[i]),
+                DescriptorInfo(s_meshRenderSystemData.get()->m_instanceSlotsBuffer[i]),
 
             };
             if(!depthOnlyRender)
@@ -238,204 +267,340 @@ bool MeshRenderSystem::init()
     return true;
 }
 
-bool MeshRenderSystem::addModel(const GltfModel& model, EntityType entityType)
+// Could be packed better
+struct RenderModel
 {
-    // Could be packed better
-    struct RenderModel
-    {
-        Vec3 position;
-        u32 color = ~0u;
+    Vec3 position;
+    u32 color = ~0u;
 
-        Vec2 uv;
+    Vec2 uv;
 
-        u16 normal[3];
-        // 1, use vertexcolor, 2, use uvs
-        u16 attributes = 0u;
-    };
-    struct AnimatedRenderModel
-    {
-        RenderModel model;
-        u16 boneWeights[4];
-        u32 boneIndices = 0;
-        u32 padding;
-    };
-
-    for(u32 j = 0; j < model.modelMeshes.size(); ++j)
-    {
-        const auto &mesh = model.modelMeshes[j];
-        bool isAnimated = mesh.animationVertices.size() > 0;
+    u16 normal[3];
+    // 1, use vertexcolor, 2, use uvs
+    u16 attributes = 0u;
+};
+struct AnimatedRenderModel
+{
+    RenderModel model;
+    u16 boneWeights[4];
+    u32 boneIndices = 0;
+    u32 padding;
+};
 
-        u32 newVertices = mesh.vertices.size();
-        u32 newIndices = mesh.indices.size();
+struct MeshPackEntry
+{
+    const GltfModel::ModelMesh *mesh = nullptr;
+    // Into vertices or animatedVertices depending on the mesh.
+    u32 vertexOffset = 0u;
+};
 
+struct MeshPackJobData
+{
+    const MeshPackEntry *entries = nullptr;
+    RenderModel *vertices = nullptr;
+    AnimatedRenderModel *animatedVertices = nullptr;
+};
 
-        PodVector<RenderModel> renderModel;
-        PodVector<AnimatedRenderModel> animatedRenderModel;
+// Job per mesh, writes only the mesh's own slice of the vertex arrays.
+static void sPackMeshJob(void *jobData, u32 jobIndex)
+{
+    const MeshPackJobData &data = *(const MeshPackJobData *)jobData;
+    const MeshPackEntry &entry = data.entries[jobIndex];
+    const GltfModel::ModelMesh &mesh = *entry.mesh;
+    bool isAnimated = mesh.animationVertices.size() > 0;
 
+    for(u32 i = 0; i < mesh.vertices.size(); ++i)
+    {
+        AnimatedRenderModel *animatedModel = nullptr;
+        RenderModel *rendModelPtr = nullptr;
         if(isAnimated)
-            animatedRenderModel.resize(newVertices);
+        {
+            animatedModel = &data.animatedVertices[entry.vertexOffset + i];
+            *animatedModel = AnimatedRenderModel{};
+            rendModelPtr = &animatedModel->model;
+        }
         else
-            renderModel.resize(newVertices);
+        {
+            rendModelPtr = &data.vertices[entry.vertexOffset + i];
+            *rendModelPtr = RenderModel{};
+        }
+        RenderModel &rendModel = *rendModelPtr;
 
-        for(u32 i = 0; i < newVertices; ++i)
+        rendModel.position = mesh.vertices[i].pos;
+        Vec3 norm = (mesh.vertices[i].norm + Vec3(1.0f, 1.0f, 1.0f)) * 0.5f * 65535.0f;
+        rendModel.normal[0] = u16(norm.x);
+        rendModel.normal[1] = u16(norm.y);
+        rendModel.normal[2] = u16(norm.z);
+
+        if(i < mesh.vertexColors.size())
         {
-            RenderModel &rendModel = isAnimated ? animatedRenderModel[i].model : renderModel[i];
+            rendModel.color = getColor(mesh.vertexColors[i]);
+            rendModel.attributes |= 1;
+        }
 
-            rendModel.position = mesh.vertices[i].pos;
-            Vec3 norm = (mesh.vertices[i].norm + Vec3(1.0f, 1.0f, 1.0f)) * 0.5f * 65535.0f;
-            rendModel.normal[0] = u16(norm.x);
-            rendModel.normal[1] = u16(norm.y);
-            rendModel.normal[2] = u16(norm.z);
+        if(i < mesh.vertexUvs.size())
+        {
+            rendModel.uv = mesh.vertexUvs[i];
+            rendModel.attributes |= 2;
+        }
 
-            if(i < mesh.vertexColors.size())
-            {
-                rendModel.color = getColor(mesh.vertexColors[i]);
-                rendModel.attributes |= 1;
-            }
+        if(isAnimated)
+        {
+            const auto &animationVertex = mesh.animationVertices[i];
+            Vec4 weights = (animationVertex.weights) * 65535.0f;
+            animatedModel->boneWeights[0] = u16(weights.x);
+            animatedModel->boneWeights[1] = u16(weights.y);
+            animatedModel->boneWeights[2] = u16(weights.z);
+            animatedModel->boneWeights[3] = u16(weights.w);
+
+            animatedModel->boneIndices =
+                (animationVertex.boneIndices[0] << 0) |
+                (animationVertex.boneIndices[1] << 8) |
+                (animationVertex.boneIndices[2] << 16) |
+                (animationVertex.boneIndices[3] << 24);
+        }
+    }
+}
 
-            if(i < mesh.vertexUvs.size())
-            {
-                rendModel.uv = mesh.vertexUvs[i];
-                rendModel.attributes |= 2;
-            }
+// Model i goes to entity type firstEntityType + i. Every mesh of every model gets packed
+// into one vertex array per buffer and uploaded with a single submit.
+static bool sAddModels(const GltfModel *models, u32 modelCount, u32 firstEntityType, JobSystem *jobSystem)
+{
+    MeshRenderSystemData &renderData = *s_meshRenderSystemData.get();
+    ASSERT(firstEntityType + modelCount <= renderData.m_models.size());
+    if(firstEntityType + modelCount > renderData.m_models.size())
+        return false;
+
+    Timer::TimePoint startTime = Timer::getTime(Timer::ClockId);
+
+    PodVector<MeshPackEntry> entries;
+    u32 vertexCount = 0u;
+    u32 animatedVertexCount = 0u;
+    u32 indexCount = 0u;
+    for(u32 modelIndex = 0; modelIndex < modelCount; ++modelIndex)
+    {
+        const GltfModel &model = models[modelIndex];
+        for(u32 j = 0; j < model.modelMeshes.size(); ++j)
+        {
+            const auto &mesh = model.modelMeshes[j];
+            bool isAnimated = mesh.animationVertices.size() > 0;
+            u32 newVertices = mesh.vertices.size();
+            u32 newIndices = mesh.indices.size();
+
+            MeshPackEntry entry;
+            entry.mesh = &mesh;
+            entry.vertexOffset = isAnimated ? animatedVertexCount : vertexCount;
+            entries.push_back(entry);
+
+            renderData.m_models[firstEntityType + modelIndex] = MeshRenderSystemData::ModelData{
+                .m_indiceStart = renderData.m_indicesCount + indexCount, .m_indices = newIndices,
+                .m_vertexStart = isAnimated
+                    ? renderData.m_animatedVerticesCount + animatedVertexCount
+                    : renderData.m_verticesCount + vertexCount, .m_vertices = newVertices,
+            };
 
             if(isAnimated)
-            {
-                AnimatedRenderModel &animatedModel = animatedRenderModel[i];
-                const auto &animationVertex = mesh.animationVertices[i];
-                Vec4 weights = (animationVertex.weights) * 65535.0f;
-                animatedModel.boneWeights[0] = u16(weights.x);
-                animatedModel.boneWeights[1] = u16(weights.y);
-                animatedModel.boneWeights[2] = u16(weights.z);
-                animatedModel.boneWeights[3] = u16(weights.w);
-
-                //printf("[%u, %u, %u, %u]\n", animationVertex.boneIndices[0], animationVertex.boneIndices[1], animationVertex.boneIndices[2], animationVertex.boneIndices[3]);
-
-                animatedModel.boneIndices =
-                    (animationVertex.boneIndices[0] << 0) |
-                    (animationVertex.boneIndices[1] << 8) |
-                    (animationVertex.boneIndices[2] << 16) |
-                    (animationVertex.boneIndices[3] << 24);
-            }
+                animatedVertexCount += newVertices;
+            else
+                vertexCount += newVertices;
+            indexCount += newIndices;
         }
+    }
+    if(entries.size() == 0u)
+        return true;
+
+    // Everything the jobs touch is allocated up front, mymemory is not thread safe.
+    PodVector<RenderModel> vertices;
+    vertices.resize(vertexCount);
+    PodVector<AnimatedRenderModel> animatedVertices;
+    animatedVertices.resize(animatedVertexCount);
+
+    MeshPackJobData jobData{
+        .entries = entries.data(),
+        .vertices = vertices.data(),
+        .animatedVertices = animatedVertices.data(),
+    };
+
+    // Without workers the jobs would run on this thread anyway.
+    u32 workerCount = jobSystem ? jobSystem->getWorkerCount() : 0u;
+    if(workerCount > 0u && entries.size() > 1u)
+    {
+        JobCounter counter;
+        jobSystem->addJobs(sPackMeshJob, &jobData, entries.size(), counter);
+        jobSystem->waitForCounter(counter);
+    }
+    else
+    {
+        workerCount = 0u;
+        for(u32 i = 0; i < entries.size(); ++i)
+            sPackMeshJob(&jobData, i);
+    }
 
-        MyVulkan::beginSingleTimeCommands();
+    // Indices get copied straight from the meshes, vertices as one copy per buffer.
+    MyVulkan::beginSingleTimeCommands();
 
+    u32 indexOffset = renderData.m_indicesCount;
+    for(const MeshPackEntry &entry : entries)
+    {
+        if(entry.mesh->indices.size() == 0u)
+            continue;
         VulkanResources::addToCopylist(
-            sliceFromPodVectorBytes(mesh.indices),
-            s_meshRenderSystemData.get()->m_indexDataBuffer,
-            s_meshRenderSystemData.get()->m_indicesCount * sizeof(u32));
-        if(isAnimated)
-            VulkanResources::addToCopylist(
-                sliceFromPodVectorBytes(animatedRenderModel),
-                s_meshRenderSystemData.get()->m_animationVertexBuffer,
-                s_meshRenderSystemData.get()->m_animatedVerticesCount * sizeof(AnimatedRenderModel));
-        else
-            VulkanResources::addToCopylist(
-                sliceFromPodVectorBytes(renderModel),
-                s_meshRenderSystemData.get()->m_vertexBuffer,
-                s_meshRenderSystemData.get()->m_verticesCount * sizeof(RenderModel));
-        VulkanResources::flushBarriers(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+            sliceFromPodVectorBytes(entry.mesh->indices),
+            renderData.m_indexDataBuffer,
+            indexOffset * sizeof(u32));
+        indexOffset += entry.mesh->indices.size();
+    }
+    if(vertexCount > 0u)
+        VulkanResources::addToCopylist(
+            sliceFromPodVectorBytes(vertices),
+            renderData.m_vertexBuffer,
+            renderData.m_verticesCount * sizeof(RenderModel));
+    if(animatedVertexCount > 0u)
+        VulkanResources::addToCopylist(
+            sliceFromPodVectorBytes(animatedVertices),
+            renderData.m_animationVertexBuffer,
+            renderData.m_animatedVerticesCount * sizeof(AnimatedRenderModel));
+    VulkanResources::flushBarriers(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 
-        MyVulkan::endSingleTimeCommands();
+    MyVulkan::endSingleTimeCommands();
 
+    renderData.m_verticesCount += vertexCount;
+    renderData.m_animatedVerticesCount += animatedVertexCount;
+    renderData.m_indicesCount += indexCount;
+    renderData.m_drawCommandsDirtyMask = (1u << VulkanGlobal::FramesInFlight) - 1u;
 
-        s_meshRenderSystemData.get()->m_models[u32(entityType)] = MeshRenderSystemData::ModelData{
-            .m_indiceStart = s_meshRenderSystemData.get()->m_indicesCount, .m_indices = newIndices,
-            .m_vertexStart = isAnimated
-                ? s_meshRenderSystemData.get()->m_animatedVerticesCount
-                : s_meshRenderSystemData.get()->m_verticesCount, .m_vertices = newVertices,
-        };
+    double uploadTime = Timer::getTimeDifferenceInNanos(startTime, Timer::getTime(Timer::ClockId));
+    printf("Uploaded %u meshes in %f ms with %u workers\n", entries.size(), uploadTime * 1000.0, workerCount);
+    return true;
+}
 
+bool MeshRenderSystem::addModel(const GltfModel& model, EntityType entityType)
+{
+    return sAddModels(&model, 1u, u32(entityType), nullptr);
+}
 
-        if(isAnimated)
-            s_meshRenderSystemData.get()->m_animatedVerticesCount += newVertices;
-        else
-            s_meshRenderSystemData.get()->m_verticesCount += newVertices;
-        s_meshRenderSystemData.get()->m_indicesCount += newIndices;
-    }
-    return true;
+bool MeshRenderSystem::addModels(const GltfModel *models, u32 modelCount, JobSystem *jobSystem)
+{
+    return sAddModels(models, modelCount, 0u, jobSystem);
 }
 
 void MeshRenderSystem::clear()
 {
-    for (auto& matrices : s_meshRenderSystemData.get()->m_modelRenderMatrices)
-        matrices.clear();
-    for (auto& matrices : s_meshRenderSystemData.get()->m_animatedModelRenderMatrices)
-        matrices.clear();
-    for(auto &boneAmounts : s_meshRenderSystemData.get()->m_modelRenderBoneStartIndices)
-        boneAmounts.clear();
+    s_meshRenderSystemData.get()->m_instanceTable.beginFrame();
     s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices.clear();
 }
 
-bool MeshRenderSystem::addModelToRender(u32 modelIndex, const Mat3x4& renderMatrix, const Mat3x4 &renderNormalMatrix,
-    const PodVector<Mat3x4>& boneAndBoneNormalMatrices)
+bool MeshRenderSystem::addModelToRender(u32 instanceId, u32 modelIndex, const Mat3x4& renderMatrix,
+    const Mat3x4 &renderNormalMatrix, const PodVector<Mat3x4>& boneAndBoneNormalMatrices)
 {
-    if (modelIndex >= s_meshRenderSystemData.get()->m_models.size())
+    MeshRenderSystemData &renderData = *s_meshRenderSystemData.get();
+    if (modelIndex >= renderData.m_models.size())
         return false;
 
-    if (boneAndBoneNormalMatrices.size() > 0u)
-    {
-        s_meshRenderSystemData.get()->m_animatedModelRenderMatrices[modelIndex].pushBack(renderMatrix);
-        s_meshRenderSystemData.get()->m_animatedModelRenderMatrices[modelIndex].pushBack(renderNormalMatrix);
+    bool animated = boneAndBoneNormalMatrices.size() > 0u;
+    u32 slotIndex = renderData.m_instanceTable.setInstance(instanceId, modelIndex, animated,
+        renderMatrix, renderNormalMatrix);
+    if (slotIndex == ~0u)
+        return false;
 
-        s_meshRenderSystemData.get()->m_modelRenderBoneStartIndices[modelIndex].pushBack(
-            s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices.size());
-        s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices.pushBack(boneAndBoneNormalMatrices);
-    }
-    else
+    if (animated)
     {
-        s_meshRenderSystemData.get()->m_modelRenderMatrices[modelIndex].push_back(renderMatrix);
-        s_meshRenderSystemData.get()->m_modelRenderMatrices[modelIndex].push_back(renderNormalMatrix);
+        if (slotIndex >= renderData.m_slotBoneStartIndices.size())
+            renderData.m_slotBoneStartIndices.resize(slotIndex + 1u, 0u);
+        renderData.m_slotBoneStartIndices[slotIndex] = renderData.m_boneAnimatedModelRenderMatrices.size();
+        renderData.m_boneAnimatedModelRenderMatrices.pushBack(boneAndBoneNormalMatrices);
     }
-
     return true;
 }
 
+u64 MeshRenderSystem::getInstanceUploadBytes()
+{
+    return s_meshRenderSystemData.get()->m_instanceUploadBytes;
+}
+
 bool MeshRenderSystem::prepareToRender()
 {
     //ScopedTimer sc("MeshRenderSystem::prepareToRender");
+    MeshRenderSystemData &renderData = *s_meshRenderSystemData.get();
+    MeshInstanceTable &instanceTable = renderData.m_instanceTable;
+    u32 modelCount = renderData.m_models.size();
+    instanceTable.endFrame(modelCount, vulk->frameIndex);
+    const PodVector<u32> &drawSlots = instanceTable.getDrawSlots();
+    u64 uploadBytes = instanceTable.getUploadBytes();
+
+    // Only moved and new instances, every frame in flight buffer gets them once.
+    for (const MeshInstanceRange &range : instanceTable.getDirtyRanges())
+    {
+        VulkanResources::addToCopylist(
+            ArraySliceViewBytes(&instanceTable.getSlotMatrices()[range.first * 2u], range.count * 2u),
+            renderData.m_modelRenderMatricesBuffer[vulk->frameIndex],
+            range.first * 2u * sizeof(Mat3x4));
+    }
+    if (instanceTable.getDrawSlotsDirty() && drawSlots.size() > 0)
+        VulkanResources::addToCopylist(
+            sliceFromPodVectorBytes(drawSlots),
+            renderData.m_instanceSlotsBuffer[vulk->frameIndex]);
+
+    // Animated instances are first in the draw slots.
+    u32 animatedInstanceCount = 0u;
+    for (u32 instances : instanceTable.getAnimatedInstanceCounts())
+        animatedInstanceCount += instances;
+    if (animatedInstanceCount > 0u)
     {
         PodVector<u32> startIndices;
-        startIndices.reserve(65536);
-        PodVector<Mat3x4> allModelRenderMatrices;
-        allModelRenderMatrices.reserve(65536);
-        for (const auto& vec : s_meshRenderSystemData.get()->m_animatedModelRenderMatrices)
-            allModelRenderMatrices.pushBack(vec);
-
-
-        for (const auto& vec : s_meshRenderSystemData.get()->m_modelRenderMatrices)
-            allModelRenderMatrices.pushBack(vec);
+        startIndices.resize(animatedInstanceCount);
+        for (u32 i = 0; i < animatedInstanceCount; ++i)
+            startIndices[i] = renderData.m_slotBoneStartIndices[drawSlots[i]];
+        VulkanResources::addToCopylist(
+            sliceFromPodVectorBytes(startIndices),
+            renderData.m_modelRenderBoneStartIndexBuffer[vulk->frameIndex]);
+        uploadBytes += startIndices.size() * sizeof(u32);
+    }
+    if (renderData.m_boneAnimatedModelRenderMatrices.size() > 0)
+    {
+        VulkanResources::addToCopylist(
+            sliceFromPodVectorBytes(renderData.m_boneAnimatedModelRenderMatrices),
+            renderData.m_modelBoneRenderMatricesBuffer[vulk->frameIndex]);
+        uploadBytes += renderData.m_boneAnimatedModelRenderMatrices.size() * sizeof(Mat3x4);
+    }
 
-        for(const auto & boneAmounts : s_meshRenderSystemData.get()->m_modelRenderBoneStartIndices)
+    u32 frameBit = 1u << vulk->frameIndex;
+    if (instanceTable.getDrawSlotsDirty() || (renderData.m_drawCommandsDirtyMask & frameBit) != 0u)
+    {
+        renderData.m_drawCommandsDirtyMask &= ~frameBit;
+        PodVector<MeshDrawRange> meshes;
+        meshes.resize(modelCount);
+        for (u32 modelIndex = 0u; modelIndex < modelCount; ++modelIndex)
         {
-            for(u32 boneStartIndex : boneAmounts)
-            {
-                startIndices.push_back(boneStartIndex);
-            }
+            const MeshRenderSystemData::ModelData &modelData = renderData.m_models[modelIndex];
+            meshes[modelIndex] = MeshDrawRange{ .indexStart = modelData.m_indiceStart,
+                .indexCount = modelData.m_vertices > 0u ? modelData.m_indices : 0u,
+                .vertexStart = modelData.m_vertexStart };
         }
-        if(startIndices.size() > 0)
-            VulkanResources::addToCopylist(
-                sliceFromPodVectorBytes(startIndices),
-                s_meshRenderSystemData.get()->m_modelRenderBoneStartIndexBuffer[vulk->frameIndex]);
 
-        if(allModelRenderMatrices.size() > 0)
-            VulkanResources::addToCopylist(
-                sliceFromPodVectorBytes(allModelRenderMatrices),
-                s_meshRenderSystemData.get()->m_modelRenderMatricesBuffer[vulk->frameIndex]);
-    }
-    {
-        if (s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices.size() > 0)
+        renderData.m_drawCommands.clear();
+        u32 instance = appendMeshDrawCommands(meshes.data(), instanceTable.getAnimatedInstanceCounts().data(),
+            modelCount, 0u, renderData.m_drawCommands);
+        renderData.m_staticDrawCommandStart = renderData.m_drawCommands.size();
+        appendMeshDrawCommands(meshes.data(), instanceTable.getStaticInstanceCounts().data(),
+            modelCount, instance, renderData.m_drawCommands);
+
+        if (renderData.m_drawCommands.size() > 0)
+        {
             VulkanResources::addToCopylist(
-                sliceFromPodVectorBytes(s_meshRenderSystemData.get()->m_boneAnimatedModelRenderMatrices),
-                s_meshRenderSystemData.get()->m_modelBoneRenderMatricesBuffer[vulk->frameIndex]);
+                sliceFromPodVectorBytes(renderData.m_drawCommands),
+                renderData.m_drawCommandsBuffer[vulk->frameIndex]);
+            uploadBytes += renderData.m_drawCommands.size() * sizeof(DrawIndexedIndirectCommand);
+        }
     }
+    renderData.m_instanceUploadBytes = uploadBytes;
     return true;
 }
 
 void sMeshRenderSystemRender(bool isShadowOnly)
 {
-    u32 instanceStartIndex = 0u;
+    const MeshRenderSystemData &renderData = *s_meshRenderSystemData.get();
+    VkCommandBuffer commandBuffer = MyVulkan::getCommandBuffer();
     u32 passIndex = isShadowOnly ? 1u : 0u;
     // draw calls here
     // Render
@@ -449,34 +614,62 @@ void sMeshRenderSystemRender(bool isShadowOnly)
     for (; passIndex < 4; passIndex += 2)
     {
         const char* debugName = debugNames[passIndex];
+        bool animationRender = (passIndex & 2) == 0;
+        u32 firstCommand = animationRender ? 0u : renderData.m_staticDrawCommandStart;
+        u32 commandCount = animationRender
+            ? renderData.m_staticDrawCommandStart
+            : renderData.m_drawCommands.size() - renderData.m_staticDrawCommandStart;
 
         MyVulkan::beginDebugRegion(debugName, Vec4(1.0f, 1.0f, 0.0f, 1.0f));
         MyVulkan::bindGraphicsPipelineWithDescriptors(
-            s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[passIndex], vulk->frameIndex);
-        for (u32 modelIndex = 0u; modelIndex < s_meshRenderSystemData.get()->m_models.size(); ++modelIndex)
+            renderData.m_meshRenderGraphicsPipeline[passIndex], vulk->frameIndex);
+        if (commandCount > 0)
         {
-            const MeshRenderSystemData::ModelData &modelData = s_meshRenderSystemData.get()->m_models[modelIndex];
-            if(modelData.m_vertices == 0)
-                continue;
-            bool animationRender = (passIndex & 2) == 0;
-            u32 instances = animationRender
-                ? s_meshRenderSystemData.get()->m_animatedModelRenderMatrices[modelIndex].size() / 2
-                : s_meshRenderSystemData.get()->m_modelRenderMatrices[modelIndex].size() / 2;
-            if (instances)
+            vkCmdBindIndexBuffer(commandBuffer,
+                renderData.m_indexDataBuffer.buffer, 0, VkIndexType::VK_INDEX_TYPE_UINT32);
+            if (vulk->multiDrawIndirect)
             {
-
-                vkCmdBindIndexBuffer(vulk->commandBuffer,
-                    s_meshRenderSystemData.get()->m_indexDataBuffer.buffer, 0, VkIndexType::VK_INDEX_TYPE_UINT32);
-                vkCmdDrawIndexed(vulk->commandBuffer, modelData.m_indices, instances,
-                    modelData.m_indiceStart, modelData.m_vertexStart, instanceStartIndex);
-                instanceStartIndex += instances;
+                vkCmdDrawIndexedIndirect(commandBuffer, renderData.m_drawCommandsBuffer[vulk->frameIndex].buffer,
+                    firstCommand * sizeof(DrawIndexedIndirectCommand), commandCount, sizeof(DrawIndexedIndirectCommand));
+            }
+            else
+            {
+                // Indirect draws cannot set the first instance without drawIndirectFirstInstance.
+                for (u32 i = firstCommand; i < firstCommand + commandCount; ++i)
+                {
+                    const DrawIndexedIndirectCommand &command = renderData.m_drawCommands[i];
+                    vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount,
+                        command.firstIndex, command.vertexOffset, command.firstInstance);
+                }
             }
         }
         MyVulkan::endDebugRegion();
     }
 }
 
-void MeshRenderSystem::render(const MeshRenderTargets& meshRenderTargets)
+static void sMeshRenderSystemRecordColors(void *)
+{
+    sMeshRenderSystemRender(false);
+}
+
+static void sMeshRenderSystemRecordShadows(void *)
+{
+    sMeshRenderSystemRender(true);
+}
+
+SecondaryCommandRecord MeshRenderSystem::getRenderRecord()
+{
+    return SecondaryCommandRecord{ .pipeline = &s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[0],
+        .recordFunc = sMeshRenderSystemRecordColors };
+}
+
+SecondaryCommandRecord MeshRenderSystem::getShadowRenderRecord()
+{
+    return SecondaryCommandRecord{ .pipeline = &s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[1],
+        .recordFunc = sMeshRenderSystemRecordShadows };
+}
+
+void MeshRenderSystem::render(const MeshRenderTargets& meshRenderTargets, const SecondaryCommandRecord *record)
 {
     MyVulkan::beginDebugRegion("Mesh rendering colors", Vec4(1.0f, 0.0f, 0.0f, 1.0f));
 
@@ -490,8 +683,12 @@ void MeshRenderSystem::render(const MeshRenderTargets& meshRenderTargets)
         {.image = &meshRenderTargets.depthImage, .clearValue = depthClear });
      */
     MyVulkan::beginRenderPass(
-        s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[0], { colorClear, normlClear, depthClear });
-    sMeshRenderSystemRender(false);
+        s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[0], { colorClear, normlClear, depthClear },
+        record ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+    if (record)
+        MyVulkan::executeSecondaryCommandBuffer(*record);
+    else
+        sMeshRenderSystemRender(false);
 
     //vkCmdEndRendering(vulk->commandBuffer);
     vkCmdEndRenderPass(vulk->commandBuffer);
@@ -501,16 +698,20 @@ void MeshRenderSystem::render(const MeshRenderTargets& meshRenderTargets)
 }
 
 
-void MeshRenderSystem::renderShadows(const MeshRenderTargets& meshRenderTargets)
+void MeshRenderSystem::renderShadows(const MeshRenderTargets& meshRenderTargets, const SecondaryCommandRecord *record)
 {
     static constexpr VkClearValue depthClear = { .depthStencil = { 1.0f, 0 } };
     MyVulkan::beginDebugRegion("Mesh rendering depth only", Vec4(1.0f, 0.0f, 0.0f, 1.0f));
 
-    MyVulkan::beginRenderPass(s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[1], { depthClear });
+    MyVulkan::beginRenderPass(s_meshRenderSystemData.get()->m_meshRenderGraphicsPipeline[1], { depthClear },
+        record ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
 
 //    beginRendering({}, { .image = &meshRenderTargets.shadowDepthImage, .clearValue = depthClear });
-    sMeshRenderSystemRender(true);
+    if (record)
+        MyVulkan::executeSecondaryCommandBuffer(*record);
+    else
+        sMeshRenderSystemRender(true);
 //    vkCmdEndRendering(vulk->commandBuffer);
     vkCmdEndRenderPass(vulk->commandBuffer);
 
@@ -2,12 +2,15 @@
 
 #include <model/gltf.h>
 
+#include <myvulkan/myvulkan.h>
 #include <myvulkan/shader.h>
 #include <myvulkan/vulkanresources.h>
 
 #include <render/meshrendertargets.h>
 #include <scene/gameentity.h>
 
+class JobSystem;
+
 // Very unoptimized stuff... no culling or anything
 class MeshRenderSystem
 {
@@ -15,18 +18,31 @@ public:
     static bool init();
     static void deinit();
     static bool addModel(const GltfModel& renderModel, EntityType entityType);
+    // Model index is the entity type. Vertices of all meshes get packed on the workers of
+    // jobSystem, or on the calling thread without one, and uploaded with one submit instead
+    // of a submit and wait per mesh.
+    static bool addModels(const GltfModel *models, u32 modelCount, JobSystem *jobSystem = nullptr);
 
 
     static void clear();
 
-    static bool addModelToRender(uint32_t modelIndex,
+    // Entities have to be added again every frame after clear, instanceId has to stay the same
+    // for an entity. Only instances whose matrices changed get uploaded.
+    static bool addModelToRender(uint32_t instanceId, uint32_t modelIndex,
         const Mat3x4 &renderMatrix, const Mat3x4 &renderNormalMatrix,
         const PodVector<Mat3x4>& boneAndBoneNormalMatrices);
 
     static bool prepareToRender();
+    // Instance data bytes the last prepareToRender uploaded.
+    static u64 getInstanceUploadBytes();
+
+    // Draws of render and renderShadows, for MyVulkan::recordSecondaryCommandBuffers.
+    static SecondaryCommandRecord getRenderRecord();
+    static SecondaryCommandRecord getShadowRenderRecord();
 
-    static void render(const MeshRenderTargets &meshRenderTargets);
-    static void renderShadows(const MeshRenderTargets &meshRenderTargets);
+    // Executes the recorded secondary command buffer when given, otherwise records the draws inline.
+    static void render(const MeshRenderTargets &meshRenderTargets, const SecondaryCommandRecord *record = nullptr);
+    static void renderShadows(const MeshRenderTargets &meshRenderTargets, const SecondaryCommandRecord *record = nullptr);
 
     static void setRenderTargets(const MeshRenderTargets &meshRenderTargets);
 };
\ No newline at end of file
@@ -10,14 +10,14 @@ MeshRenderTargets::~MeshRenderTargets()
     VulkanResources::destroyImage(shadowDepthImage);
 }
 
-bool MeshRenderTargets::resizeMeshTargets()
+bool MeshRenderTargets::resizeMeshTargets(bool transient)
 {
     uint32_t width = vulk->swapchain.width;
     uint32_t height = vulk->swapchain.height;
-    return resizeMeshTargets(width, height);
+    return resizeMeshTargets(width, height, transient);
 }
 
-bool MeshRenderTargets::resizeMeshTargets(uint32_t width, uint32_t height)
+bool MeshRenderTargets::resizeMeshTargets(uint32_t width, uint32_t height, bool transient)
 {
     // create color and depth images
     if (!VulkanResources::createRenderTargetImage(width, height, vulk->defaultColorFormat,
@@ -30,7 +30,7 @@ bool MeshRenderTargets::resizeMeshTargets(uint32_t width, uint32_t height)
 
     if (!VulkanResources::createRenderTargetImage(width, height, VK_FORMAT_R16G16B16A16_SNORM,
         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, //VK_IMAGE_USAGE_STORAGE_BIT,
-        "Normal map target image", normalMapImage))
+        "Normal map target image", normalMapImage, transient))
     {
         printf("Failed to create %s\n", normalMapImage.imageName);
         return false;
@@ -38,7 +38,7 @@ bool MeshRenderTargets::resizeMeshTargets(uint32_t width, uint32_t height)
 
     if (!VulkanResources::createRenderTargetImage(width, height, vulk->depthFormat,
         VK_IMAGE_USAGE_SAMPLED_BIT,
-        "Depth target image", depthImage))
+        "Depth target image", depthImage, transient))
     {
         printf("Failed to create %s\n", depthImage.imageName);
         return false;
@@ -47,11 +47,11 @@ bool MeshRenderTargets::resizeMeshTargets(uint32_t width, uint32_t height)
     return true;
 }
 
-bool MeshRenderTargets::resizeShadowTarget(int width, int height)
+bool MeshRenderTargets::resizeShadowTarget(int width, int height, bool transient)
 {
     if (!VulkanResources::createRenderTargetImage(width, height, vulk->depthFormat,
         VK_IMAGE_USAGE_SAMPLED_BIT,
-        "Main shadow target", shadowDepthImage))
+        "Main shadow target", shadowDepthImage, transient))
     {
         printf("Failed to create shadow target image\n");
         return false;
@@ -5,9 +5,11 @@
 struct MeshRenderTargets
 {
     ~MeshRenderTargets();
-    bool resizeMeshTargets();
-    bool resizeMeshTargets(uint32_t width, uint32_t height);
-    bool resizeShadowTarget(int width, int height);
+    // Transient creates the normal map, depth and shadow targets without memory, see
+    // VulkanResources::createRenderTargetImage.
+    bool resizeMeshTargets(bool transient = false);
+    bool resizeMeshTargets(uint32_t width, uint32_t height, bool transient = false);
+    bool resizeShadowTarget(int width, int height, bool transient = false);
 
     void prepareTargetsForMeshRendering();
     void prepareTargetsForShadowRendering();
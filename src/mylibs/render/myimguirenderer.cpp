@@ -6,6 +6,7 @@
 
 #include <myvulkan/myvulkan.h>
 #include <myvulkan/vulkanglobal.h>
+#include <myvulkan/vulkaninitparameters.h>
 
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
@@ -30,7 +31,8 @@ MyImguiRenderer::~MyImguiRenderer()
     //if(renderPass && descriptorPool && frameBuffer)
     {
         ImGui_ImplVulkan_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
+        if(glfwBackend)
+            ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
     }
     if(renderPass)
@@ -93,14 +95,17 @@ bool MyImguiRenderer::init(GLFWwindow *window)
 
 
     // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForVulkan(window, true);
+    // Headless has no window, renderBegin feeds the display size and time instead.
+    glfwBackend = !VulkanInitializationParameters::get().headless;
+    if(glfwBackend)
+        ImGui_ImplGlfw_InitForVulkan(window, true);
     ImGui_ImplVulkan_InitInfo init_info = {};
     init_info.Instance = vulk->instance;
     init_info.PhysicalDevice = vulk->physicalDevice;
     init_info.Device = vulk->device;
     init_info.QueueFamily = vulk->queueFamilyIndices.graphicsFamily;
     init_info.Queue = vulk->graphicsQueue;
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = vulk->pipelineCache;
     init_info.DescriptorPool = descriptorPool;
     init_info.Subpass = 0;
     init_info.MinImageCount = vulk->swapchain.images.size();
@@ -228,7 +233,17 @@ void MyImguiRenderer::renderBegin()
 
     // Start the Dear ImGui frame
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if(glfwBackend)
+    {
+        ImGui_ImplGlfw_NewFrame();
+    }
+    else
+    {
+        const WindowApp &app = VulkanApp::getWindowApp();
+        ImGuiIO &io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(app.windowWidth), float(app.windowHeight));
+        io.DeltaTime = app.frameDt > 0.0 ? float(app.frameDt) : 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 }
 
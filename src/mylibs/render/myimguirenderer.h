@@ -24,4 +24,5 @@ private:
 
     uint32_t frameBufferWidth = 0u;
     uint32_t frameBufferHeight = 0u;
+    bool glfwBackend = false;
 };
\ No newline at end of file
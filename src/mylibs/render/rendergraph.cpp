@@ -0,0 +1,366 @@
+#include "rendergraph.h"
+
+#include <container/podvector.h>
+#include <core/general.h>
+
+#include <algorithm>
+
+void RenderGraph::clear()
+{
+    images.clear();
+    passes.clear();
+    accesses.clear();
+    compiledPasses.clear();
+    barriers.clear();
+    memorySlots.clear();
+}
+
+u32 RenderGraph::addImage(const char *name, void *imageData)
+{
+    GraphImage image;
+    image.name = name;
+    image.imageData = imageData;
+    images.push_back(image);
+    return images.size() - 1u;
+}
+
+u32 RenderGraph::addTransientImage(const char *name, void *imageData, u64 size, u64 alignment, u32 memoryTypeBits)
+{
+    GraphImage image;
+    image.name = name;
+    image.imageData = imageData;
+    image.size = size;
+    image.alignment = alignment > 0u ? alignment : 1u;
+    image.memoryTypeBits = memoryTypeBits;
+    image.transient = true;
+    images.push_back(image);
+    return images.size() - 1u;
+}
+
+u32 RenderGraph::addPass(const char *name, void (*execute)(void *passData), void *passData, bool sideEffects)
+{
+    GraphPass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.passData = passData;
+    pass.firstAccess = accesses.size();
+    pass.sideEffects = sideEffects;
+    passes.push_back(pass);
+    return passes.size() - 1u;
+}
+
+bool RenderGraph::read(u32 imageIndex, RenderGraphUsage usage)
+{
+    return addAccess(imageIndex, usage, true, false);
+}
+
+bool RenderGraph::write(u32 imageIndex, RenderGraphUsage usage)
+{
+    return addAccess(imageIndex, usage, false, true);
+}
+
+bool RenderGraph::readWrite(u32 imageIndex, RenderGraphUsage usage)
+{
+    return addAccess(imageIndex, usage, true, true);
+}
+
+bool RenderGraph::addAccess(u32 imageIndex, RenderGraphUsage usage, bool reads, bool writes)
+{
+    ASSERT(passes.size() > 0u && imageIndex < images.size() && usage != RenderGraphUsage::None);
+    if(passes.size() == 0u || imageIndex >= images.size() || usage == RenderGraphUsage::None)
+        return false;
+
+    GraphPass &pass = passes.back();
+    for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+    {
+        GraphAccess &access = accesses[i];
+        if(access.imageIndex != imageIndex)
+            continue;
+        ASSERT(access.usage == usage);
+        if(access.usage != usage)
+            return false;
+        access.reads |= reads;
+        access.writes |= writes;
+        return true;
+    }
+
+    GraphAccess access;
+    access.imageIndex = imageIndex;
+    access.usage = usage;
+    access.reads = reads;
+    access.writes = writes;
+    accesses.push_back(access);
+    ++pass.accessCount;
+    return true;
+}
+
+bool RenderGraph::compile()
+{
+    compiledPasses.clear();
+    barriers.clear();
+    memorySlots.clear();
+
+    cullPasses();
+    // Barriers wait for the previous image in the same memory, so memory gets planned first.
+    planMemory();
+    if(!findBarriers())
+    {
+        compiledPasses.clear();
+        barriers.clear();
+        memorySlots.clear();
+        for(GraphImage &image : images)
+            image.memorySlot = ~0u;
+        return false;
+    }
+    return true;
+}
+
+// Walks the passes backwards keeping track of which images still have their contents used by
+// a later pass. Pass is alive when it writes such an image or has side effects.
+void RenderGraph::cullPasses()
+{
+    imageNeeded.resize(images.size(), false);
+    for(u32 i = 0; i < images.size(); ++i)
+        imageNeeded[i] = !images[i].transient;
+
+    for(u32 passIndex = passes.size(); passIndex-- > 0u;)
+    {
+        GraphPass &pass = passes[passIndex];
+        bool alive = pass.sideEffects;
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            const GraphAccess &access = accesses[i];
+            if(access.writes && imageNeeded[access.imageIndex])
+                alive = true;
+        }
+        pass.culled = !alive;
+        if(!alive)
+            continue;
+
+        // Whole image writes end the use of earlier contents, reads start it again.
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            const GraphAccess &access = accesses[i];
+            if(access.writes && !access.reads)
+                imageNeeded[access.imageIndex] = false;
+        }
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            const GraphAccess &access = accesses[i];
+            if(access.reads)
+                imageNeeded[access.imageIndex] = true;
+        }
+    }
+}
+
+// Usages the passes left end the frame with, per image and per memory slot.
+void RenderGraph::findEndUsages()
+{
+    imageEndUsages.resize(images.size(), RenderGraphUsage::None);
+    for(u32 i = 0; i < images.size(); ++i)
+        imageEndUsages[i] = RenderGraphUsage::None;
+    slotEndUsages.resize(memorySlots.size(), RenderGraphUsage::None);
+    for(u32 i = 0; i < memorySlots.size(); ++i)
+        slotEndUsages[i] = RenderGraphUsage::None;
+
+    for(const GraphPass &pass : passes)
+    {
+        if(pass.culled)
+            continue;
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            const GraphAccess &access = accesses[i];
+            imageEndUsages[access.imageIndex] = access.usage;
+            u32 slotIndex = images[access.imageIndex].memorySlot;
+            if(slotIndex != ~0u)
+                slotEndUsages[slotIndex] = access.usage;
+        }
+    }
+}
+
+// Barrier whenever the usage of an image changes between the passes left. Same usage back to back
+// gets none, same as VulkanResources::imageBarrier skipping unchanged layouts and accesses.
+bool RenderGraph::findBarriers()
+{
+    findEndUsages();
+    imageUsages.resize(images.size(), RenderGraphUsage::None);
+    for(u32 i = 0; i < images.size(); ++i)
+        imageUsages[i] = RenderGraphUsage::None;
+    slotUsages.resize(memorySlots.size(), RenderGraphUsage::None);
+    for(u32 i = 0; i < memorySlots.size(); ++i)
+        slotUsages[i] = RenderGraphUsage::None;
+
+    for(u32 passIndex = 0; passIndex < passes.size(); ++passIndex)
+    {
+        const GraphPass &pass = passes[passIndex];
+        if(pass.culled)
+            continue;
+
+        RenderGraphCompiledPass compiledPass;
+        compiledPass.passIndex = passIndex;
+        compiledPass.firstBarrier = barriers.size();
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            const GraphAccess &access = accesses[i];
+            const GraphImage &image = images[access.imageIndex];
+            RenderGraphUsage &currentUsage = imageUsages[access.imageIndex];
+            RenderGraphUsage waitUsage = RenderGraphUsage::None;
+            if(currentUsage == RenderGraphUsage::None)
+            {
+                if(image.transient)
+                {
+                    // Nothing wrote the transient image this frame.
+                    if(access.reads)
+                        return false;
+                    // Lifetimes in a slot do not overlap, the previous image in it is done.
+                    RenderGraphUsage slotUsage = slotUsages[image.memorySlot];
+                    waitUsage = slotUsage != RenderGraphUsage::None ? slotUsage : slotEndUsages[image.memorySlot];
+                }
+                else if(access.reads)
+                    currentUsage = imageEndUsages[access.imageIndex];
+                else
+                    waitUsage = imageEndUsages[access.imageIndex];
+            }
+            if(image.memorySlot != ~0u)
+                slotUsages[image.memorySlot] = access.usage;
+
+            if(currentUsage == access.usage)
+                continue;
+
+            RenderGraphBarrier barrier;
+            barrier.imageIndex = access.imageIndex;
+            barrier.srcUsage = currentUsage;
+            barrier.dstUsage = access.usage;
+            barrier.waitUsage = waitUsage;
+            barriers.push_back(barrier);
+            currentUsage = access.usage;
+        }
+        compiledPass.barrierCount = barriers.size() - compiledPass.firstBarrier;
+        compiledPasses.push_back(compiledPass);
+    }
+    return true;
+}
+
+// Biggest images first, each goes to the first slot with compatible memory types where no image
+// is alive during its passes, otherwise to a new slot.
+void RenderGraph::planMemory()
+{
+    for(GraphImage &image : images)
+    {
+        image.memorySlot = ~0u;
+        image.firstPass = ~0u;
+        image.lastPass = ~0u;
+    }
+    for(u32 passIndex = 0; passIndex < passes.size(); ++passIndex)
+    {
+        const GraphPass &pass = passes[passIndex];
+        for(u32 i = pass.firstAccess; i < pass.firstAccess + pass.accessCount; ++i)
+        {
+            GraphImage &image = images[accesses[i].imageIndex];
+            if(image.firstPass == ~0u)
+                image.firstPass = passIndex;
+            image.lastPass = passIndex;
+        }
+    }
+
+    transientOrder.clear();
+    for(u32 i = 0; i < images.size(); ++i)
+    {
+        if(images[i].transient && images[i].firstPass != ~0u)
+            transientOrder.push_back(i);
+    }
+    std::stable_sort(transientOrder.begin(), transientOrder.end(), [this](u32 a, u32 b)
+    {
+        return images[a].size > images[b].size;
+    });
+
+    for(u32 orderIndex = 0; orderIndex < transientOrder.size(); ++orderIndex)
+    {
+        GraphImage &image = images[transientOrder[orderIndex]];
+        u32 slotIndex = 0u;
+        for(; slotIndex < memorySlots.size(); ++slotIndex)
+        {
+            if((memorySlots[slotIndex].memoryTypeBits & image.memoryTypeBits) == 0u)
+                continue;
+
+            bool overlaps = false;
+            for(u32 placedIndex = 0; placedIndex < orderIndex && !overlaps; ++placedIndex)
+            {
+                const GraphImage &placed = images[transientOrder[placedIndex]];
+                overlaps = placed.memorySlot == slotIndex
+                    && placed.firstPass <= image.lastPass && image.firstPass <= placed.lastPass;
+            }
+            if(!overlaps)
+                break;
+        }
+        if(slotIndex == memorySlots.size())
+            memorySlots.push_back(RenderGraphMemorySlot{});
+
+        RenderGraphMemorySlot &slot = memorySlots[slotIndex];
+        slot.size = image.size > slot.size ? image.size : slot.size;
+        slot.alignment = image.alignment > slot.alignment ? image.alignment : slot.alignment;
+        slot.memoryTypeBits &= image.memoryTypeBits;
+        image.memorySlot = slotIndex;
+    }
+}
+
+void RenderGraph::execute(void (*applyBarrier)(void *imageData, const RenderGraphBarrier &barrier),
+    void (*flushBarriers)()) const
+{
+    for(const RenderGraphCompiledPass &compiledPass : compiledPasses)
+    {
+        for(u32 i = compiledPass.firstBarrier; i < compiledPass.firstBarrier + compiledPass.barrierCount; ++i)
+        {
+            const RenderGraphBarrier &barrier = barriers[i];
+            applyBarrier(images[barrier.imageIndex].imageData, barrier);
+        }
+        if(compiledPass.barrierCount > 0u)
+            flushBarriers();
+        const GraphPass &pass = passes[compiledPass.passIndex];
+        if(pass.execute)
+            pass.execute(pass.passData);
+    }
+}
+
+bool RenderGraph::isPassCulled(u32 passIndex) const
+{
+    ASSERT(passIndex < passes.size());
+    return passIndex >= passes.size() || passes[passIndex].culled;
+}
+
+void *RenderGraph::getPassData(u32 passIndex) const
+{
+    ASSERT(passIndex < passes.size());
+    return passIndex < passes.size() ? passes[passIndex].passData : nullptr;
+}
+
+u32 RenderGraph::getMemorySlot(u32 imageIndex) const
+{
+    ASSERT(imageIndex < images.size());
+    return imageIndex < images.size() ? images[imageIndex].memorySlot : ~0u;
+}
+
+u64 RenderGraph::getMemorySlotBytes() const
+{
+    u64 result = 0u;
+    for(const RenderGraphMemorySlot &slot : memorySlots)
+        result += slot.size;
+    return result;
+}
+
+u64 RenderGraph::getTransientImageBytes() const
+{
+    u64 result = 0u;
+    for(const GraphImage &image : images)
+    {
+        if(image.memorySlot != ~0u)
+            result += image.size;
+    }
+    return result;
+}
+
+void *RenderGraph::getImageData(u32 imageIndex) const
+{
+    ASSERT(imageIndex < images.size());
+    return imageIndex < images.size() ? images[imageIndex].imageData : nullptr;
+}
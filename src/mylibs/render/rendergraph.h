@@ -0,0 +1,160 @@
+#pragma once
+
+#include <container/podvectorsbase.h>
+#include <core/mytypes.h>
+
+// Frame described as passes reading and writing images. compile culls passes whose results
+// nothing uses, finds the barriers needed between the passes and plans memory for the
+// transient images. Two transient images only share memory when no pass uses both of them
+// or anything in between, so a frame where every transient image is alive in one pass gets a
+// slot per image. Runs without a gpu, the caller applies the barriers through execute.
+
+// How a pass uses an image, every usage has its own layout and access.
+enum class RenderGraphUsage : u32
+{
+    // Before the first use in a frame, contents are undefined.
+    None,
+    ColorAttachment,
+    DepthAttachment,
+    GraphicsSampleRead,
+    ComputeSampleRead,
+    ComputeImageRead,
+    ComputeImageWrite,
+    Present,
+};
+
+// Image goes from srcUsage to dstUsage before the pass. srcUsage None discards the contents,
+// waitUsage is then the last usage of the same memory that has to finish first: the previous
+// image in the memory slot, otherwise the usage the previous frame ended with, as it ran the
+// same passes.
+struct RenderGraphBarrier
+{
+    u32 imageIndex = ~0u;
+    RenderGraphUsage srcUsage = RenderGraphUsage::None;
+    RenderGraphUsage dstUsage = RenderGraphUsage::None;
+    RenderGraphUsage waitUsage = RenderGraphUsage::None;
+};
+
+// Pass left after culling, with the barriers to apply before running it.
+struct RenderGraphCompiledPass
+{
+    u32 passIndex = ~0u;
+    u32 firstBarrier = 0u;
+    u32 barrierCount = 0u;
+};
+
+// Memory for one transient image, or for several whose pass ranges do not overlap.
+struct RenderGraphMemorySlot
+{
+    u64 size = 0u;
+    u64 alignment = 1u;
+    u32 memoryTypeBits = ~0u;
+};
+
+class RenderGraph
+{
+public:
+    // Drops the passes and images, keeps the allocations.
+    void clear();
+
+    // Image living outside the frame, like the one getting presented. Its last contents count as
+    // used and it never shares memory. When its first pass reads it, it is still in the usage
+    // the previous frame ended with.
+    u32 addImage(const char *name, void *imageData);
+    // Image only used within the frame, every frame starts with its contents undefined. Size,
+    // alignment and memory type bits are the memory requirements of the gpu image.
+    u32 addTransientImage(const char *name, void *imageData, u64 size, u64 alignment, u32 memoryTypeBits);
+
+    // Passes run in the order they are added. Passes with side effects, like presenting, never
+    // get culled.
+    u32 addPass(const char *name, void (*execute)(void *passData), void *passData, bool sideEffects = false);
+    // Reads, writes and readWrites go to the last added pass. One pass uses an image with one usage.
+    // Pass uses the contents written before it.
+    bool read(u32 imageIndex, RenderGraphUsage usage);
+    // Pass overwrites the whole image, earlier writes nobody read are dead.
+    bool write(u32 imageIndex, RenderGraphUsage usage);
+    // Pass adds to the earlier contents, like attachments loaded before drawing.
+    bool readWrite(u32 imageIndex, RenderGraphUsage usage);
+
+    // Returns false when a pass reads a transient image before anything wrote it.
+    bool compile();
+
+    // Runs the compiled passes in order. applyBarrier gets called for the barriers before each
+    // pass, then flushBarriers once if the pass had any.
+    void execute(void (*applyBarrier)(void *imageData, const RenderGraphBarrier &barrier),
+        void (*flushBarriers)()) const;
+
+    const PodVector<RenderGraphCompiledPass> &getCompiledPasses() const { return compiledPasses; }
+    const PodVector<RenderGraphBarrier> &getBarriers() const { return barriers; }
+    bool isPassCulled(u32 passIndex) const;
+    void *getPassData(u32 passIndex) const;
+    u32 getPassCount() const { return passes.size(); }
+
+    // Slots get planned over every added pass, culled or not, so memory allocated for a graph
+    // stays valid for the same graph with any of its passes left out.
+    const PodVector<RenderGraphMemorySlot> &getMemorySlots() const { return memorySlots; }
+    // ~0u for images that are not transient or that no pass uses.
+    u32 getMemorySlot(u32 imageIndex) const;
+    u64 getMemorySlotBytes() const;
+    // Bytes the used transient images would take without sharing.
+    u64 getTransientImageBytes() const;
+
+    void *getImageData(u32 imageIndex) const;
+    u32 getImageCount() const { return images.size(); }
+
+private:
+    struct GraphImage
+    {
+        const char *name = nullptr;
+        void *imageData = nullptr;
+        u64 size = 0u;
+        u64 alignment = 1u;
+        u32 memoryTypeBits = ~0u;
+        u32 memorySlot = ~0u;
+        // Passes using the image first and last, culled ones included.
+        u32 firstPass = ~0u;
+        u32 lastPass = ~0u;
+        bool transient = false;
+    };
+
+    struct GraphAccess
+    {
+        u32 imageIndex = ~0u;
+        RenderGraphUsage usage = RenderGraphUsage::None;
+        bool reads = false;
+        bool writes = false;
+    };
+
+    struct GraphPass
+    {
+        const char *name = nullptr;
+        void (*execute)(void *passData) = nullptr;
+        void *passData = nullptr;
+        u32 firstAccess = 0u;
+        u32 accessCount = 0u;
+        bool sideEffects = false;
+        bool culled = false;
+    };
+
+    bool addAccess(u32 imageIndex, RenderGraphUsage usage, bool reads, bool writes);
+    void cullPasses();
+    void findEndUsages();
+    bool findBarriers();
+    void planMemory();
+
+    PodVector<GraphImage> images;
+    PodVector<GraphPass> passes;
+    PodVector<GraphAccess> accesses;
+
+    PodVector<RenderGraphCompiledPass> compiledPasses;
+    PodVector<RenderGraphBarrier> barriers;
+    PodVector<RenderGraphMemorySlot> memorySlots;
+
+    // Scratch for compile.
+    PodVector<bool> imageNeeded;
+    PodVector<RenderGraphUsage> imageUsages;
+    PodVector<RenderGraphUsage> imageEndUsages;
+    PodVector<RenderGraphUsage> slotUsages;
+    PodVector<RenderGraphUsage> slotEndUsages;
+    PodVector<u32> transientOrder;
+};
@@ -0,0 +1,545 @@
+#include "dynamicbvh.h"
+
+#include <core/assert.h>
+#include <core/general.h>
+
+#include <math/bounds_inline_functions.h>
+#include <math/ray.h>
+#include <math/vector3_inline_functions.h>
+
+#include <algorithm>
+
+// Traversal stack only grows to tree height + 1, avl balanced tree with 100k leaves is ~25 high.
+static constexpr u32 BvhMaxStackSize = 256u;
+
+struct BvhNearestItem
+{
+    float sqrDistance;
+    u32 nodeIndex;
+};
+
+static bool sNearestItemGreater(const BvhNearestItem &a, const BvhNearestItem &b)
+{
+    return a.sqrDistance > b.sqrDistance;
+}
+
+static bool sRayCandidateLess(const BvhRayCandidate &a, const BvhRayCandidate &b)
+{
+    return a.distance < b.distance;
+}
+
+// Area increase of descending into child with new leaf.
+static float sGetDescendCost(const BvhNode &child, const Bounds &leafBounds)
+{
+    float newArea = boundsSurfaceArea(boundsUnion(leafBounds, child.bounds));
+    if(child.isLeaf())
+        return newArea;
+    return newArea - boundsSurfaceArea(child.bounds);
+}
+
+static float sGetNearestKey(const Vec3 &point, const BvhNode &node)
+{
+    return sqrDistanceToBounds(point, node.isLeaf() ? node.leafBounds : node.bounds);
+}
+
+u32 DynamicBvh::allocateNode()
+{
+    u32 result = freeListIndex;
+    if(result != ~0u)
+    {
+        freeListIndex = nodes[result].parent;
+    }
+    else
+    {
+        result = nodes.size();
+        nodes.pushBack(BvhNode());
+    }
+    BvhNode &node = nodes[result];
+    node = BvhNode();
+    node.height = 0;
+    return result;
+}
+
+void DynamicBvh::freeNode(u32 nodeIndex)
+{
+    ASSERT(nodeIndex < nodes.size());
+    BvhNode &node = nodes[nodeIndex];
+    node.parent = freeListIndex;
+    node.height = -1;
+    freeListIndex = nodeIndex;
+}
+
+u32 DynamicBvh::insertProxy(const Bounds &bounds, u32 userIndex)
+{
+    u32 leafIndex = allocateNode();
+    BvhNode &leaf = nodes[leafIndex];
+    leaf.bounds = boundsExpand(bounds, FatBoundsMargin);
+    leaf.leafBounds = bounds;
+    leaf.userIndex = userIndex;
+    leaf.height = 0;
+
+    insertLeaf(leafIndex);
+    ++proxyCount;
+    return leafIndex;
+}
+
+void DynamicBvh::removeProxy(u32 proxyIndex)
+{
+    ASSERT(proxyIndex < nodes.size());
+    ASSERT(nodes[proxyIndex].isLeaf() && nodes[proxyIndex].height == 0);
+    if(proxyIndex >= nodes.size() || nodes[proxyIndex].height != 0)
+        return;
+
+    removeLeaf(proxyIndex);
+    freeNode(proxyIndex);
+    --proxyCount;
+}
+
+bool DynamicBvh::moveProxy(u32 proxyIndex, const Bounds &bounds)
+{
+    ASSERT(proxyIndex < nodes.size());
+    ASSERT(nodes[proxyIndex].isLeaf() && nodes[proxyIndex].height == 0);
+    if(proxyIndex >= nodes.size() || nodes[proxyIndex].height != 0)
+        return false;
+
+    BvhNode &leaf = nodes[proxyIndex];
+    leaf.leafBounds = bounds;
+    if(boundsContains(leaf.bounds, bounds))
+        return false;
+
+    removeLeaf(proxyIndex);
+    nodes[proxyIndex].bounds = boundsExpand(bounds, FatBoundsMargin);
+    insertLeaf(proxyIndex);
+    return true;
+}
+
+void DynamicBvh::clear()
+{
+    nodes.clear();
+    rootIndex = ~0u;
+    freeListIndex = ~0u;
+    proxyCount = 0u;
+}
+
+u32 DynamicBvh::getUserIndex(u32 proxyIndex) const
+{
+    ASSERT(proxyIndex < nodes.size());
+    if(proxyIndex >= nodes.size())
+        return ~0u;
+    return nodes[proxyIndex].userIndex;
+}
+
+const Bounds &DynamicBvh::getFatBounds(u32 proxyIndex) const
+{
+    ASSERT(proxyIndex < nodes.size());
+    return nodes[proxyIndex].bounds;
+}
+
+i32 DynamicBvh::getHeight() const
+{
+    if(rootIndex == ~0u)
+        return 0;
+    return nodes[rootIndex].height;
+}
+
+void DynamicBvh::insertLeaf(u32 leafIndex)
+{
+    if(rootIndex == ~0u)
+    {
+        rootIndex = leafIndex;
+        nodes[leafIndex].parent = ~0u;
+        return;
+    }
+
+    // Find the best sibling by surface area heuristic
+    const Bounds leafBounds = nodes[leafIndex].bounds;
+    u32 index = rootIndex;
+    while(!nodes[index].isLeaf())
+    {
+        const BvhNode &node = nodes[index];
+        u32 child1 = node.child1;
+        u32 child2 = node.child2;
+
+        float area = boundsSurfaceArea(node.bounds);
+        float combinedArea = boundsSurfaceArea(boundsUnion(node.bounds, leafBounds));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float cost1 = sGetDescendCost(nodes[child1], leafBounds) + inheritanceCost;
+        float cost2 = sGetDescendCost(nodes[child2], leafBounds) + inheritanceCost;
+
+        if(cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    u32 siblingIndex = index;
+
+    // Create a new parent, allocation can move the nodes so no references before this.
+    u32 oldParentIndex = nodes[siblingIndex].parent;
+    u32 newParentIndex = allocateNode();
+    {
+        BvhNode &newParent = nodes[newParentIndex];
+        newParent.parent = oldParentIndex;
+        newParent.userIndex = ~0u;
+        newParent.bounds = boundsUnion(leafBounds, nodes[siblingIndex].bounds);
+        newParent.height = nodes[siblingIndex].height + 1;
+        newParent.child1 = siblingIndex;
+        newParent.child2 = leafIndex;
+    }
+
+    if(oldParentIndex != ~0u)
+    {
+        BvhNode &oldParent = nodes[oldParentIndex];
+        if(oldParent.child1 == siblingIndex)
+            oldParent.child1 = newParentIndex;
+        else
+            oldParent.child2 = newParentIndex;
+    }
+    else
+    {
+        rootIndex = newParentIndex;
+    }
+    nodes[siblingIndex].parent = newParentIndex;
+    nodes[leafIndex].parent = newParentIndex;
+
+    // Walk back up the tree fixing heights and bounds
+    index = nodes[leafIndex].parent;
+    while(index != ~0u)
+    {
+        index = balance(index);
+
+        BvhNode &node = nodes[index];
+        const BvhNode &child1 = nodes[node.child1];
+        const BvhNode &child2 = nodes[node.child2];
+
+        node.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+        node.bounds = boundsUnion(child1.bounds, child2.bounds);
+
+        index = node.parent;
+    }
+}
+
+void DynamicBvh::removeLeaf(u32 leafIndex)
+{
+    if(leafIndex == rootIndex)
+    {
+        rootIndex = ~0u;
+        return;
+    }
+
+    u32 parentIndex = nodes[leafIndex].parent;
+    u32 grandParentIndex = nodes[parentIndex].parent;
+    u32 siblingIndex = nodes[parentIndex].child1 == leafIndex
+        ? nodes[parentIndex].child2
+        : nodes[parentIndex].child1;
+
+    if(grandParentIndex != ~0u)
+    {
+        // Destroy parent and connect sibling to grandparent
+        BvhNode &grandParent = nodes[grandParentIndex];
+        if(grandParent.child1 == parentIndex)
+            grandParent.child1 = siblingIndex;
+        else
+            grandParent.child2 = siblingIndex;
+        nodes[siblingIndex].parent = grandParentIndex;
+        freeNode(parentIndex);
+
+        u32 index = grandParentIndex;
+        while(index != ~0u)
+        {
+            index = balance(index);
+
+            BvhNode &node = nodes[index];
+            const BvhNode &child1 = nodes[node.child1];
+            const BvhNode &child2 = nodes[node.child2];
+
+            node.bounds = boundsUnion(child1.bounds, child2.bounds);
+            node.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+
+            index = node.parent;
+        }
+    }
+    else
+    {
+        rootIndex = siblingIndex;
+        nodes[siblingIndex].parent = ~0u;
+        freeNode(parentIndex);
+    }
+}
+
+// Rotates the taller child up if the node is imbalanced. Returns the new root of the subtree.
+u32 DynamicBvh::balance(u32 indexA)
+{
+    BvhNode &a = nodes[indexA];
+    if(a.isLeaf() || a.height < 2)
+        return indexA;
+
+    u32 indexB = a.child1;
+    u32 indexC = a.child2;
+    BvhNode &b = nodes[indexB];
+    BvhNode &c = nodes[indexC];
+
+    i32 balanceValue = c.height - b.height;
+
+    // Rotate C up
+    if(balanceValue > 1)
+    {
+        u32 indexF = c.child1;
+        u32 indexG = c.child2;
+        BvhNode &f = nodes[indexF];
+        BvhNode &g = nodes[indexG];
+
+        // Swap A and C
+        c.child1 = indexA;
+        c.parent = a.parent;
+        a.parent = indexC;
+
+        // A's old parent should point to C
+        if(c.parent != ~0u)
+        {
+            if(nodes[c.parent].child1 == indexA)
+                nodes[c.parent].child1 = indexC;
+            else
+                nodes[c.parent].child2 = indexC;
+        }
+        else
+        {
+            rootIndex = indexC;
+        }
+
+        if(f.height > g.height)
+        {
+            c.child2 = indexF;
+            a.child2 = indexG;
+            g.parent = indexA;
+            a.bounds = boundsUnion(b.bounds, g.bounds);
+            c.bounds = boundsUnion(a.bounds, f.bounds);
+
+            a.height = 1 + (b.height > g.height ? b.height : g.height);
+            c.height = 1 + (a.height > f.height ? a.height : f.height);
+        }
+        else
+        {
+            c.child2 = indexG;
+            a.child2 = indexF;
+            f.parent = indexA;
+            a.bounds = boundsUnion(b.bounds, f.bounds);
+            c.bounds = boundsUnion(a.bounds, g.bounds);
+
+            a.height = 1 + (b.height > f.height ? b.height : f.height);
+            c.height = 1 + (a.height > g.height ? a.height : g.height);
+        }
+
+        return indexC;
+    }
+
+    // Rotate B up
+    if(balanceValue < -1)
+    {
+        u32 indexD = b.child1;
+        u32 indexE = b.child2;
+        BvhNode &d = nodes[indexD];
+        BvhNode &e = nodes[indexE];
+
+        // Swap A and B
+        b.child1 = indexA;
+        b.parent = a.parent;
+        a.parent = indexB;
+
+        // A's old parent should point to B
+        if(b.parent != ~0u)
+        {
+            if(nodes[b.parent].child1 == indexA)
+                nodes[b.parent].child1 = indexB;
+            else
+                nodes[b.parent].child2 = indexB;
+        }
+        else
+        {
+            rootIndex = indexB;
+        }
+
+        if(d.height > e.height)
+        {
+            b.child2 = indexD;
+            a.child1 = indexE;
+            e.parent = indexA;
+            a.bounds = boundsUnion(c.bounds, e.bounds);
+            b.bounds = boundsUnion(a.bounds, d.bounds);
+
+            a.height = 1 + (c.height > e.height ? c.height : e.height);
+            b.height = 1 + (a.height > d.height ? a.height : d.height);
+        }
+        else
+        {
+            b.child2 = indexE;
+            a.child1 = indexD;
+            d.parent = indexA;
+            a.bounds = boundsUnion(c.bounds, d.bounds);
+            b.bounds = boundsUnion(a.bounds, e.bounds);
+
+            a.height = 1 + (c.height > d.height ? c.height : d.height);
+            b.height = 1 + (a.height > e.height ? a.height : e.height);
+        }
+
+        return indexB;
+    }
+
+    return indexA;
+}
+
+void DynamicBvh::rayQuery(const Ray &ray, float maxDistance, PodVector<BvhRayCandidate> &outCandidates) const
+{
+    outCandidates.clear();
+    if(rootIndex == ~0u)
+        return;
+
+    const BvhNode *nodeData = nodes.data();
+    const Vec3 inverseRayDir = 1.0f / ray.dir;
+
+    u32 stack[BvhMaxStackSize];
+    u32 stackSize = 0u;
+    stack[stackSize++] = rootIndex;
+
+    while(stackSize > 0)
+    {
+        const BvhNode &node = nodeData[stack[--stackSize]];
+
+        float distance = 0.0f;
+        if(!rayBoundsIntersect(ray, inverseRayDir, node.bounds, maxDistance, distance))
+            continue;
+
+        if(node.isLeaf())
+        {
+            if(rayBoundsIntersect(ray, inverseRayDir, node.leafBounds, maxDistance, distance))
+                outCandidates.pushBack(BvhRayCandidate{ .userIndex = node.userIndex, .distance = distance });
+            continue;
+        }
+
+        ASSERT(stackSize + 2 <= BvhMaxStackSize);
+        stack[stackSize++] = node.child1;
+        stack[stackSize++] = node.child2;
+    }
+    std::sort(outCandidates.begin(), outCandidates.end(), sRayCandidateLess);
+}
+
+void DynamicBvh::overlapQuery(const Bounds &bounds, PodVector<u32> &outUserIndices) const
+{
+    outUserIndices.clear();
+    if(rootIndex == ~0u)
+        return;
+
+    const BvhNode *nodeData = nodes.data();
+
+    u32 stack[BvhMaxStackSize];
+    u32 stackSize = 0u;
+    stack[stackSize++] = rootIndex;
+
+    while(stackSize > 0)
+    {
+        const BvhNode &node = nodeData[stack[--stackSize]];
+        if(!boundsOverlap(node.bounds, bounds))
+            continue;
+
+        if(node.isLeaf())
+        {
+            if(boundsOverlap(node.leafBounds, bounds))
+                outUserIndices.pushBack(node.userIndex);
+            continue;
+        }
+
+        ASSERT(stackSize + 2 <= BvhMaxStackSize);
+        stack[stackSize++] = node.child1;
+        stack[stackSize++] = node.child2;
+    }
+}
+
+void DynamicBvh::nearestQuery(const Vec3 &point, u32 count, PodVector<u32> &outUserIndices) const
+{
+    outUserIndices.clear();
+    if(rootIndex == ~0u || count == 0)
+        return;
+
+    const BvhNode *nodeData = nodes.data();
+
+    // Best first search: inner nodes are keyed with distance to their bounds, which is a lower bound
+    // for every leaf under them, leaves with their exact bounds, so leaves come out sorted.
+    PodVector<BvhNearestItem> heap;
+    heap.reserve(64);
+    heap.pushBack(BvhNearestItem{ .sqrDistance = sGetNearestKey(point, nodeData[rootIndex]), .nodeIndex = rootIndex });
+
+    while(heap.size() > 0 && outUserIndices.size() < count)
+    {
+        std::pop_heap(heap.begin(), heap.end(), sNearestItemGreater);
+        BvhNearestItem item = heap.popBack();
+
+        const BvhNode &node = nodeData[item.nodeIndex];
+        if(node.isLeaf())
+        {
+            outUserIndices.pushBack(node.userIndex);
+            continue;
+        }
+
+        heap.pushBack(BvhNearestItem{ .sqrDistance = sGetNearestKey(point, nodeData[node.child1]), .nodeIndex = node.child1 });
+        std::push_heap(heap.begin(), heap.end(), sNearestItemGreater);
+        heap.pushBack(BvhNearestItem{ .sqrDistance = sGetNearestKey(point, nodeData[node.child2]), .nodeIndex = node.child2 });
+        std::push_heap(heap.begin(), heap.end(), sNearestItemGreater);
+    }
+}
+
+bool DynamicBvh::validateNode(u32 nodeIndex) const
+{
+    const BvhNode &node = nodes[nodeIndex];
+    if(node.isLeaf())
+        return node.height == 0 && node.child2 == ~0u && boundsContains(node.bounds, node.leafBounds);
+
+    if(node.child1 >= nodes.size() || node.child2 >= nodes.size())
+        return false;
+
+    const BvhNode &child1 = nodes[node.child1];
+    const BvhNode &child2 = nodes[node.child2];
+    if(child1.parent != nodeIndex || child2.parent != nodeIndex)
+        return false;
+
+    i32 height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+    if(node.height != height)
+        return false;
+
+    i32 balanceValue = child2.height - child1.height;
+    if(balanceValue > 1 || balanceValue < -1)
+        return false;
+
+    if(!boundsContains(node.bounds, child1.bounds) || !boundsContains(node.bounds, child2.bounds))
+        return false;
+
+    return validateNode(node.child1) && validateNode(node.child2);
+}
+
+bool DynamicBvh::validate() const
+{
+    if(rootIndex == ~0u)
+        return proxyCount == 0;
+    if(nodes[rootIndex].parent != ~0u)
+        return false;
+
+    u32 freeCount = 0u;
+    u32 freeIndex = freeListIndex;
+    while(freeIndex != ~0u)
+    {
+        if(nodes[freeIndex].height != -1)
+            return false;
+        freeIndex = nodes[freeIndex].parent;
+        ++freeCount;
+    }
+    // Binary tree has leaves - 1 inner nodes
+    if(proxyCount * 2 - 1 + freeCount != nodes.size())
+        return false;
+
+    return validateNode(rootIndex);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <container/podvector.h>
+#include <core/mytypes.h>
+#include <math/bounds.h>
+#include <math/vector3.h>
+
+struct Ray;
+
+struct BvhNode
+{
+    // Fattened bounds for leaves, union of children for inner nodes.
+    Bounds bounds;
+    // Exact bounds, only valid for leaves.
+    Bounds leafBounds;
+
+    // Doubles as next free index when node is in free list.
+    u32 parent = ~0u;
+    u32 child1 = ~0u;
+    u32 child2 = ~0u;
+    u32 userIndex = ~0u;
+    // leaf = 0, free node = -1
+    i32 height = -1;
+
+    bool isLeaf() const { return child1 == ~0u; }
+};
+
+struct BvhRayCandidate
+{
+    u32 userIndex;
+    // Distance where the ray enters the leaf bounds.
+    float distance;
+};
+
+// Dynamic aabb tree. Leaves store slightly fattened bounds, so that small movements
+// do not need any changes to the tree. Tree is kept balanced with rotations.
+class DynamicBvh
+{
+public:
+    static constexpr float FatBoundsMargin = 0.1f;
+
+    u32 insertProxy(const Bounds &bounds, u32 userIndex);
+    void removeProxy(u32 proxyIndex);
+    // Returns true if the proxy had to be reinserted into tree.
+    bool moveProxy(u32 proxyIndex, const Bounds &bounds);
+    void clear();
+
+    u32 getUserIndex(u32 proxyIndex) const;
+    const Bounds &getFatBounds(u32 proxyIndex) const;
+    u32 getProxyCount() const { return proxyCount; }
+    i32 getHeight() const;
+
+    // Candidates are sorted by distance, narrow phase can stop once candidate distance is past the closest hit.
+    void rayQuery(const Ray &ray, float maxDistance, PodVector<BvhRayCandidate> &outCandidates) const;
+    void overlapQuery(const Bounds &bounds, PodVector<u32> &outUserIndices) const;
+    // Closest count proxies to point, measured to the exact leaf bounds, sorted from closest.
+    void nearestQuery(const Vec3 &point, u32 count, PodVector<u32> &outUserIndices) const;
+
+    bool validate() const;
+
+private:
+    u32 allocateNode();
+    void freeNode(u32 nodeIndex);
+
+    void insertLeaf(u32 leafIndex);
+    void removeLeaf(u32 leafIndex);
+    u32 balance(u32 nodeIndex);
+    bool validateNode(u32 nodeIndex) const;
+
+    PodVector<BvhNode> nodes;
+    u32 rootIndex = ~0u;
+    u32 freeListIndex = ~0u;
+    u32 proxyCount = 0u;
+};
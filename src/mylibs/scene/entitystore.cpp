@@ -0,0 +1,157 @@
+#include "entitystore.h"
+
+#include <core/assert.h>
+
+EntityHandle EntityStore::addEntity(const GameEntity &entity)
+{
+    EntityHandle result;
+    if(freeHandleIndices.size() > 0)
+    {
+        result.entityIndex = freeHandleIndices.popBack();
+    }
+    else
+    {
+        result.entityIndex = denseIndices.size();
+        denseIndices.pushBack(~0u);
+        handleVersions.pushBack(0u);
+    }
+    result.entityIndexVersion = handleVersions[result.entityIndex];
+
+    // Resize rather than pushBack, pushBack grows the buffer already when filling the last reserved slot.
+    u32 entityIndex = transforms.size();
+    names.resize(entityIndex + 1);
+    transforms.resize(entityIndex + 1);
+    entityTypes.resize(entityIndex + 1);
+    meshIndices.resize(entityIndex + 1);
+    animationIndices.resize(entityIndex + 1);
+    animationTimes.resize(entityIndex + 1);
+    animationStates.resize(entityIndex + 1);
+    handleIndices.resize(entityIndex + 1);
+
+    setEntity(entityIndex, entity);
+    animationStates[entityIndex] = AnimationState();
+    animationStates[entityIndex].entityType = entity.entityType;
+    handleIndices[entityIndex] = result.entityIndex;
+    denseIndices[result.entityIndex] = entityIndex;
+    return result;
+}
+
+bool EntityStore::removeEntity(EntityHandle handle)
+{
+    u32 entityIndex = getDenseIndex(handle);
+    if(entityIndex == ~0u)
+        return false;
+
+    // Raw pointers, operator[] goes through the byte buffer for every access.
+    u32 lastIndex = transforms.size() - 1;
+    if(entityIndex != lastIndex)
+    {
+        names.data()[entityIndex] = names.data()[lastIndex];
+        transforms.data()[entityIndex] = transforms.data()[lastIndex];
+        entityTypes.data()[entityIndex] = entityTypes.data()[lastIndex];
+        meshIndices.data()[entityIndex] = meshIndices.data()[lastIndex];
+        animationIndices.data()[entityIndex] = animationIndices.data()[lastIndex];
+        animationTimes.data()[entityIndex] = animationTimes.data()[lastIndex];
+        animationStates.data()[entityIndex] = animationStates.data()[lastIndex];
+        handleIndices.data()[entityIndex] = handleIndices.data()[lastIndex];
+        denseIndices.data()[handleIndices.data()[entityIndex]] = entityIndex;
+    }
+    names.uninitializedResize(lastIndex);
+    transforms.uninitializedResize(lastIndex);
+    entityTypes.uninitializedResize(lastIndex);
+    meshIndices.uninitializedResize(lastIndex);
+    animationIndices.uninitializedResize(lastIndex);
+    animationTimes.uninitializedResize(lastIndex);
+    animationStates.uninitializedResize(lastIndex);
+    handleIndices.uninitializedResize(lastIndex);
+
+    denseIndices[handle.entityIndex] = ~0u;
+    ++handleVersions[handle.entityIndex];
+    freeHandleIndices.pushBack(handle.entityIndex);
+    return true;
+}
+
+bool EntityStore::isValidHandle(EntityHandle handle) const
+{
+    return handle.entityIndex < denseIndices.size()
+        && handleVersions[handle.entityIndex] == handle.entityIndexVersion
+        && denseIndices[handle.entityIndex] != ~0u;
+}
+
+u32 EntityStore::getDenseIndex(EntityHandle handle) const
+{
+    if(!isValidHandle(handle))
+        return ~0u;
+    return denseIndices[handle.entityIndex];
+}
+
+EntityHandle EntityStore::getHandle(u32 entityIndex) const
+{
+    ASSERT(entityIndex < transforms.size());
+    EntityHandle result;
+    if(entityIndex >= transforms.size())
+        return result;
+
+    result.entityIndex = handleIndices[entityIndex];
+    result.entityIndexVersion = handleVersions[result.entityIndex];
+    return result;
+}
+
+void EntityStore::setEntity(u32 entityIndex, const GameEntity &entity)
+{
+    ASSERT(entityIndex < transforms.size());
+    if(entityIndex >= transforms.size())
+        return;
+
+    names[entityIndex] = entity.name;
+    transforms[entityIndex] = entity.transform;
+    entityTypes[entityIndex] = entity.entityType;
+    meshIndices[entityIndex] = entity.meshIndex;
+    animationIndices[entityIndex] = entity.animationIndex;
+    animationTimes[entityIndex] = entity.animationTime;
+}
+
+GameEntity EntityStore::getEntity(u32 entityIndex) const
+{
+    ASSERT(entityIndex < transforms.size());
+    GameEntity result{ .name = "Name", .transform = Transform{}, .entityType = EntityType::NUM_OF_ENTITY_TYPES };
+    if(entityIndex >= transforms.size())
+        return result;
+
+    result.name = names[entityIndex];
+    result.transform = transforms[entityIndex];
+    result.animationTime = animationTimes[entityIndex];
+    result.animationIndex = animationIndices[entityIndex];
+    result.meshIndex = meshIndices[entityIndex];
+    result.entityType = entityTypes[entityIndex];
+    result.index = entityIndex;
+    return result;
+}
+
+void EntityStore::reserve(u32 entityCount)
+{
+    names.reserve(entityCount);
+    transforms.reserve(entityCount);
+    entityTypes.reserve(entityCount);
+    meshIndices.reserve(entityCount);
+    animationIndices.reserve(entityCount);
+    animationTimes.reserve(entityCount);
+    animationStates.reserve(entityCount);
+    handleIndices.reserve(entityCount);
+}
+
+void EntityStore::clear()
+{
+    names.clear();
+    transforms.clear();
+    entityTypes.clear();
+    meshIndices.clear();
+    animationIndices.clear();
+    animationTimes.clear();
+    animationStates.clear();
+    handleIndices.clear();
+
+    denseIndices.clear();
+    handleVersions.clear();
+    freeHandleIndices.clear();
+}
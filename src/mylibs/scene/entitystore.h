@@ -0,0 +1,63 @@
+#pragma once
+
+#include <components/transform.h>
+#include <container/podvector.h>
+#include <container/stackstring.h>
+#include <core/mytypes.h>
+#include <model/animation.h>
+#include <scene/gameentity.h>
+
+// Index into the handle table and its version, version changes when the entity is removed,
+// so old handles stop resolving instead of pointing to a new entity.
+struct EntityHandle
+{
+    u32 entityIndex = ~u32(0);
+    u16 entityIndexVersion = ~(u16(0u));
+
+    bool operator==(const EntityHandle &other) const
+    {
+        return entityIndex == other.entityIndex && entityIndexVersion == other.entityIndexVersion;
+    }
+    bool operator!=(const EntityHandle &other) const { return !(*this == other); }
+};
+
+// Scene entities split into columns, same dense index in every array. Hot loops only touch
+// the columns they need, so names and animation data stay out of the cache for
+// transform loops. Removing swaps the last entity into the hole, so columns only
+// ever contain live entities. Handles go through remap table to find the dense index.
+struct EntityStore
+{
+    EntityHandle addEntity(const GameEntity &entity);
+    bool removeEntity(EntityHandle handle);
+
+    bool isValidHandle(EntityHandle handle) const;
+    // ~0u if handle is not valid.
+    u32 getDenseIndex(EntityHandle handle) const;
+    EntityHandle getHandle(u32 entityIndex) const;
+
+    void setEntity(u32 entityIndex, const GameEntity &entity);
+    // Gathers the columns back into a single entity, for editor and serialization.
+    GameEntity getEntity(u32 entityIndex) const;
+    void reserve(u32 entityCount);
+    void clear();
+
+    u32 getEntityCount() const { return transforms.size(); }
+    bool isValidIndex(u32 entityIndex) const { return entityIndex < transforms.size(); }
+    // Handle indices are stable while entity lives, used for indexing things outside of the store.
+    u32 getHandleCount() const { return denseIndices.size(); }
+
+    // Dense columns.
+    PodVector<SmallStackString> names;
+    PodVector<Transform> transforms;
+    PodVector<EntityType> entityTypes;
+    PodVector<u32> meshIndices;
+    PodVector<u32> animationIndices;
+    PodVector<double> animationTimes;
+    PodVector<AnimationState> animationStates;
+    PodVector<u32> handleIndices;
+
+    // Remap table, indexed with handle index.
+    PodVector<u32> denseIndices;
+    PodVector<u16> handleVersions;
+    PodVector<u32> freeHandleIndices;
+};
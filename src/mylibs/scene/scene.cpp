@@ -10,6 +10,7 @@
 #include <core/timer.h>
 #include <core/writejson.h>
 
+#include <math/bounds_inline_functions.h>
 #include <math/hitpoint.h>
 #include <math/ray.h>
 #include <math/vector3_inline_functions.h>
@@ -20,41 +21,82 @@
 // FLT_MAX
 #include <float.h>
 
-static GameEntity ConstEntity{ .entityType = EntityType::NUM_OF_ENTITY_TYPES };
+static Transform ConstTransform;
+static const Mat3x4 ConstMatrix;
 
-static u32 getAnimationIndexFromName(const char *animationName, ArraySliceView<GameEntity> entities, u32 entityIndex)
+static u32 getAnimationIndexFromName(const char *animationName, const EntityStore &entities, u32 entityIndex)
 {
     u32 result = ~0u;
     if(!globalResources)
         return result;
 
-    if(entityIndex >= entities.size())
+    if(!entities.isValidIndex(entityIndex))
         return result;
 
-    const auto &entity = entities[entityIndex];
-    if(u32(entity.entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
+    EntityType entityType = entities.entityTypes[entityIndex];
+    if(u32(entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
         return result;
 
-    const auto &model = globalResources->models[(u32)entity.entityType];
+    const auto &model = globalResources->models[(u32)entityType];
     result = model.animNames.find(animationName);
     return result;
 }
 
+static Bounds getEntityWorldBounds(EntityType entityType, u32 meshIndex, const Transform &worldTransform)
+{
+    Bounds localBounds;
+    if(u32(entityType) < globalResources->models.size())
+    {
+        const auto &model = globalResources->models[u32(entityType)];
+        if(meshIndex < model.modelMeshes.size())
+            localBounds = model.modelMeshes[meshIndex].bounds;
+    }
+    return getWorldBounds(localBounds, worldTransform);
+}
+
+// Only entities that moved, or whose parent moved, need bounds refit.
+static void refitUpdatedBounds(SceneData &sceneData)
+{
+    const EntityStore &entities = sceneData.entities;
+    for(u32 handleIndex : sceneData.sceneGraph.getUpdatedNodes())
+    {
+        // Removed entity can still be in the dirty list.
+        u32 entityIndex = entities.denseIndices[handleIndex];
+        if(entityIndex == ~0u)
+            continue;
+        sceneData.bvh.moveProxy(sceneData.bvhProxyIndices[handleIndex],
+            getEntityWorldBounds(entities.entityTypes[entityIndex], entities.meshIndices[entityIndex],
+                sceneData.sceneGraph.getWorldTransform(handleIndex)));
+    }
+}
+
+static void updateSceneGraph(SceneData &sceneData)
+{
+    const EntityStore &entities = sceneData.entities;
+    const Transform *transforms = entities.transforms.data();
+    const u32 *handleIndices = entities.handleIndices.data();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
+        sceneData.sceneGraph.setLocalTransform(handleIndices[entityIndex], transforms[entityIndex]);
+
+    sceneData.sceneGraph.update(sceneData.jobSystem);
+    refitUpdatedBounds(sceneData);
+}
+
 
-bool Scene::init()
+bool Scene::init(JobSystem *jobSystem)
 {
     ScopedTimer timer("Scene init");
 
     ASSERT(globalResources);
     ASSERT(globalResources->models.size() != u32(EntityType::NUM_OF_ENTITY_TYPES));
 
-    for(u32 i = 0; i < u32(EntityType::NUM_OF_ENTITY_TYPES); ++i)
+    sceneData.jobSystem = jobSystem;
+
+    if(!MeshRenderSystem::addModels(&globalResources->models[0], u32(EntityType::NUM_OF_ENTITY_TYPES),
+        sceneData.jobSystem))
     {
-        if(!MeshRenderSystem::addModel(globalResources->models[i], EntityType(i)))
-        {
-            defragMemory();
-            return false;
-        }
+        defragMemory();
+        return false;
     }
 
     return true;
@@ -67,33 +109,39 @@ bool Scene::update(double deltaTime)
 
     //ScopedTimer timer("anim update");
     // better pattern for memory when other array gets constantly resized, no need to recreate same temporary array.
+    updateSceneGraph(sceneData);
+
     PodVector<Mat3x4> matrices;
     matrices.reserve(256);
-    u32 entityIndex = 0u;
-    for (auto& entity : sceneData.entities)
+    EntityStore &entities = sceneData.entities;
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
     {
         matrices.clear();
-        u32 renderMeshIndex = u32(entity.entityType);
-        if (entity.entityType >= EntityType::NUM_OF_ENTITY_TYPES)
+
+        EntityType entityType = entities.entityTypes[entityIndex];
+        u32 renderMeshIndex = u32(entityType);
+        if (entityType >= EntityType::NUM_OF_ENTITY_TYPES)
             continue;
         if (renderMeshIndex >= globalResources->models.size())
             continue;
 
         const auto &model = globalResources->models[renderMeshIndex];
-        if(entity.meshIndex >= model.modelMeshes.size())
+        u32 meshIndex = entities.meshIndices[entityIndex];
+        if(meshIndex >= model.modelMeshes.size())
             continue;
 
-        const auto &mesh = model.modelMeshes[entity.meshIndex];
+        const auto &mesh = model.modelMeshes[meshIndex];
 
         if(mesh.vertices.size() == 0 && mesh.animationVertices.size() == 0)
             continue;
         if(mesh.animationVertices.size() > 0)
         {
-            auto &state = sceneData.animationStates[entityIndex];
+            auto &state = entities.animationStates[entityIndex];
             if(state.activeIndices == 0)
             {
-                entity.animationTime += deltaTime;
-                if(!evaluateAnimation(model, entity.animationIndex, entity.animationTime, matrices))
+                double &animationTime = entities.animationTimes[entityIndex];
+                animationTime += deltaTime;
+                if(!evaluateAnimation(model, entities.animationIndices[entityIndex], animationTime, matrices))
                     continue;
             }
             else
@@ -104,18 +152,18 @@ bool Scene::update(double deltaTime)
             }
         }
 
-        Mat3x4 renderMatrix = getModelMatrix(entity.transform);
-        Mat3x4 normalMatrix = getModelNormalMatrix(entity.transform);
-        MeshRenderSystem::addModelToRender(renderMeshIndex, renderMatrix, normalMatrix, matrices);
-        ++entityIndex;
+        u32 handleIndex = entities.handleIndices[entityIndex];
+        const Mat3x4 &renderMatrix = sceneData.sceneGraph.getWorldMatrix(handleIndex);
+        const Mat3x4 &normalMatrix = sceneData.sceneGraph.getWorldNormalMatrix(handleIndex);
+        MeshRenderSystem::addModelToRender(handleIndex, renderMeshIndex, renderMatrix, normalMatrix, matrices);
     }
     return true;
 }
 
 
-u32 Scene::addGameEntity(const GameEntity& entity, const SmallStackString &str)
+EntityHandle Scene::addGameEntity(const GameEntity& entity, const SmallStackString &str)
 {
-    u32 result = ~0u;
+    EntityHandle result;
     if(!globalResources)
         return result;
 
@@ -141,50 +189,104 @@ u32 Scene::addGameEntity(const GameEntity& entity, const SmallStackString &str)
             return result;
     }
 
-    if(sceneData.freeEnityIndices.size() > 0)
-    {
-        result = sceneData.freeEnityIndices.popBack();
-        sceneData.entities[result] = entity;
-    }
-    else
-    {
-        result = sceneData.entities.size();
-        sceneData.entities.push_back(entity);
-        sceneData.animationStates.pushBack(AnimationState());
-    }
-    sceneData.entities[result].index = result;
-    sceneData.animationStates[result] = AnimationState();
-    sceneData.animationStates[result].entityType = entity.entityType;
+    result = sceneData.entities.addEntity(entity);
+    u32 entityIndex = sceneData.entities.getDenseIndex(result);
+    if(str.getSize() > 0)
+        sceneData.entities.meshIndices[entityIndex] = meshIndex;
+
+    // Scene graph and bvh are indexed with the handle index, it stays same while entity lives.
+    u32 handleIndex = result.entityIndex;
+    sceneData.sceneGraph.resize(sceneData.entities.getHandleCount());
+    sceneData.sceneGraph.setParent(handleIndex, ~0u);
+    sceneData.sceneGraph.setLocalTransform(handleIndex, entity.transform);
+    sceneData.sceneGraph.markDirty(handleIndex);
+
+    // Root entity, so world transform is the entity transform.
+    Bounds worldBounds = getEntityWorldBounds(entity.entityType, sceneData.entities.meshIndices[entityIndex], entity.transform);
+    if(handleIndex >= sceneData.bvhProxyIndices.size())
+        sceneData.bvhProxyIndices.resize(handleIndex + 1, ~0u);
+    ASSERT(sceneData.bvhProxyIndices[handleIndex] == ~0u);
+    sceneData.bvhProxyIndices[handleIndex] = sceneData.bvh.insertProxy(worldBounds, handleIndex);
 
     return result;
 }
 
-GameEntity &Scene::getEntity(u32 index) const
+bool Scene::removeEntity(EntityHandle handle)
+{
+    if(!sceneData.entities.removeEntity(handle))
+        return false;
+
+    u32 handleIndex = handle.entityIndex;
+    sceneData.sceneGraph.detachNode(handleIndex);
+    sceneData.bvh.removeProxy(sceneData.bvhProxyIndices[handleIndex]);
+    sceneData.bvhProxyIndices[handleIndex] = ~0u;
+    return true;
+}
+
+bool Scene::isValidEntity(EntityHandle handle) const
+{
+    return sceneData.entities.isValidHandle(handle);
+}
+
+GameEntity Scene::getEntity(EntityHandle handle) const
+{
+    u32 entityIndex = sceneData.entities.getDenseIndex(handle);
+    ASSERT(entityIndex != ~0u);
+    return sceneData.entities.getEntity(entityIndex);
+}
+
+void Scene::setEntity(EntityHandle handle, const GameEntity &entity)
 {
-    ASSERT(index < sceneData.entities.size());
-    if (index >= sceneData.entities.size())
-        return ConstEntity;
+    u32 index = sceneData.entities.getDenseIndex(handle);
+    ASSERT(index != ~0u);
+    if(index == ~0u)
+        return;
+
+    EntityStore &entities = sceneData.entities;
+    bool boundsChanged = entities.entityTypes[index] != entity.entityType || entities.meshIndices[index] != entity.meshIndex;
+    if(entities.entityTypes[index] != entity.entityType)
+    {
+        entities.animationStates[index] = AnimationState();
+        entities.animationStates[index].entityType = entity.entityType;
+    }
+    entities.setEntity(index, entity);
+
+    // Transform changes get noticed in update, type or mesh changes the local bounds.
+    if(boundsChanged)
+        sceneData.sceneGraph.markDirty(handle.entityIndex);
+}
 
-    return sceneData.entities[index];
+Transform &Scene::getTransform(EntityHandle handle)
+{
+    u32 index = sceneData.entities.getDenseIndex(handle);
+    ASSERT(index != ~0u);
+    if(index == ~0u)
+    {
+        ConstTransform = Transform();
+        return ConstTransform;
+    }
+    return sceneData.entities.transforms[index];
 }
 
-u32 Scene::addAnimation(u32 entityIndex, const char *animName, PlayMode playMode)
+u32 Scene::addAnimation(EntityHandle handle, const char *animName, PlayMode playMode)
 {
-    u32 animationIndex = getAnimationIndexFromName(animName, sliceFromPodVector(sceneData.entities), entityIndex);
+    u32 entityIndex = sceneData.entities.getDenseIndex(handle);
+    u32 animationIndex = getAnimationIndexFromName(animName, sceneData.entities, entityIndex);
     if(animationIndex != ~0u)
     {
-        auto &animState = sceneData.animationStates[entityIndex];
+        auto &animState = sceneData.entities.animationStates[entityIndex];
         return blendNewAnimation(animState, animationIndex, playMode, 1.0f);
     }
     return ~0u;
 }
 
-u32 Scene::replaceAnimation(u32 entityIndex, const char *animName, u32 playingAnimatinIndex)
+u32 Scene::replaceAnimation(EntityHandle handle, const char *animName, u32 playingAnimatinIndex)
 {
-    u32 animationIndex = getAnimationIndexFromName(animName, sliceFromPodVector(sceneData.entities), entityIndex);
+    u32 entityIndex = sceneData.entities.getDenseIndex(handle);
+    u32 animationIndex = getAnimationIndexFromName(animName, sceneData.entities, entityIndex);
     if(animationIndex != ~0u)
     {
-        auto &animState = sceneData.animationStates[entityIndex];
+        auto &animState = sceneData.entities.animationStates[entityIndex];
         return ::replaceAnimation(animState, animationIndex, playingAnimatinIndex, 1.0f);
     }
     return ~0u;
@@ -192,36 +294,38 @@ u32 Scene::replaceAnimation(u32 entityIndex, const char *animName, u32 playingAn
 
 
 // TODO need to actually separate some entity systems from scene...
-u32 Scene::addAnimation(u32 entityIndex, u32 animationIndex, PlayMode playMode)
+u32 Scene::addAnimation(EntityHandle handle, u32 animationIndex, PlayMode playMode)
 {
+    u32 entityIndex = sceneData.entities.getDenseIndex(handle);
     u32 result = ~0u;
-    if(entityIndex >= sceneData.entities.size())
+    if(!sceneData.entities.isValidIndex(entityIndex))
         return result;
 
-    const auto &entity = sceneData.entities[entityIndex];
-    if(u32(entity.entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
+    EntityType entityType = sceneData.entities.entityTypes[entityIndex];
+    if(u32(entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
         return result;
 
-    const auto &model = globalResources->models[(u32)entity.entityType];
+    const auto &model = globalResources->models[(u32)entityType];
     if(animationIndex >= model.animNames.size())
         return result;
 
-    auto &animState = sceneData.animationStates[entityIndex];
+    auto &animState = sceneData.entities.animationStates[entityIndex];
     return blendNewAnimation(animState, animationIndex, playMode, 1.0f);
 
 }
 
-Bounds Scene::getBounds(u32 entityIndex) const
+Bounds Scene::getBounds(EntityHandle handle) const
 {
+    u32 entityIndex = sceneData.entities.getDenseIndex(handle);
     Bounds result;
-    if(entityIndex >= sceneData.entities.size())
+    if(!sceneData.entities.isValidIndex(entityIndex))
         return result;
 
-    const auto &entity = sceneData.entities[entityIndex];
-    if(u32(entity.entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
+    EntityType entityType = sceneData.entities.entityTypes[entityIndex];
+    if(u32(entityType) > u32(EntityType::NUM_OF_ENTITY_TYPES))
         return result;
 
-    const auto &model = globalResources->models[u32(entity.entityType)];
+    const auto &model = globalResources->models[u32(entityType)];
     if(model.modelMeshes.size() > 0)
         return model.modelMeshes[0].bounds;
     return Bounds();
@@ -268,21 +372,51 @@ bool Scene::readLevel(const char *levelName)
 
     StringView objTypeName;
 
-    PodVector<AnimationState> newAnimationStates;
-    PodVector<GameEntity> newEntities;
+    EntityStore newEntities;
     for(const auto &obj : json.getChild("objects"))
     {
         GameEntity ent;
         if(!loadGameObject(obj, ent))
             return false;
 
-        ent.index = newEntities.size();
-        newEntities.push_back(ent);
-        newAnimationStates.push_back(AnimationState());
-        newAnimationStates[newAnimationStates.size() - 1].entityType = ent.entityType;
+        newEntities.addEntity(ent);
+    }
+    // Optional, levels without parents have only root entities.
+    PodVector<i32> newParents;
+    newParents.resize(newEntities.getEntityCount(), -1);
+    const JsonBlock &parentsBlock = json.getChild("parents");
+    if(parentsBlock.isArray())
+    {
+        if(parentsBlock.getChildCount() != i32(newParents.size()) ||
+            !parentsBlock.parseIntegerArray(newParents.data(), newParents.size()))
+            return false;
     }
+
+    // Fresh store has no removed entities, so handle indices are same as dense indices.
     sceneData.entities = newEntities;
-    sceneData.animationStates = newAnimationStates;
+    const EntityStore &entities = sceneData.entities;
+
+    sceneData.sceneGraph.clear();
+    sceneData.sceneGraph.resize(entities.getEntityCount());
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
+    {
+        sceneData.sceneGraph.setLocalTransform(entityIndex, entities.transforms[entityIndex]);
+        i32 parentIndex = newParents[entityIndex];
+        if(parentIndex < 0)
+            continue;
+        if(u32(parentIndex) >= entities.getEntityCount() || !sceneData.sceneGraph.setParent(entityIndex, u32(parentIndex)))
+            printf("Failed to set parent: %i for entity: %u\n", parentIndex, entityIndex);
+    }
+    sceneData.sceneGraph.update(sceneData.jobSystem);
+
+    sceneData.bvh.clear();
+    sceneData.bvhProxyIndices.clear();
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
+    {
+        Bounds worldBounds = getEntityWorldBounds(entities.entityTypes[entityIndex], entities.meshIndices[entityIndex],
+            sceneData.sceneGraph.getWorldTransform(entityIndex));
+        sceneData.bvhProxyIndices.pushBack(sceneData.bvh.insertProxy(worldBounds, entityIndex));
+    }
     return true;
 }
 
@@ -291,54 +425,145 @@ bool Scene::writeLevel(const char *filename) const
     WriteJson writeJson(Scene::MagicNumber, Scene::VersionNumber);
     writeJson.addString("levelName", sceneName.getStr());
     writeJson.addArray("objects");
-    for(const auto &entity : sceneData.entities)
-        writeGameObject(entity, writeJson);
+    for(u32 entityIndex = 0; entityIndex < sceneData.entities.getEntityCount(); ++entityIndex)
+        writeGameObject(sceneData.entities.getEntity(entityIndex), writeJson);
     writeJson.endArray();
+
+    // Written as dense indices, same as the order of objects.
+    const EntityStore &entities = sceneData.entities;
+    PodVector<i32> parents;
+    for(u32 entityIndex = 0; entityIndex < entities.getEntityCount(); ++entityIndex)
+    {
+        u32 parentHandleIndex = sceneData.sceneGraph.getParent(entities.handleIndices[entityIndex]);
+        parents.pushBack(parentHandleIndex == ~0u ? -1 : i32(entities.denseIndices[parentHandleIndex]));
+    }
+    writeJson.addIntegerArray("parents", parents.data(), parents.size());
     writeJson.finishWrite();
     return writeJson.isValid() &&
         writeBytes(filename, writeJson.getString().getBuffer());
 }
 
-u32 Scene::castRay(const Ray &ray, HitPoint &outHitpoint)
+EntityHandle Scene::castRay(const Ray &ray, HitPoint &outHitpoint)
 {
-    u32 result = ~0u;
+    u32 resultHandleIndex = ~0u;
 
     float closestDist = FLT_MAX;
-    u32 index = 0;
     const auto models = sliceFromVector(globalResources->models);
-    for(const auto &entity : sceneData.entities)
+
+    PodVector<BvhRayCandidate> candidates;
+    sceneData.bvh.rayQuery(ray, FLT_MAX, candidates);
+    for(const auto &candidate : candidates)
     {
-        /*
-        if(raySphereIntersect(ray, Sphere{ .pos = entity.transform.pos, .radius = 2.0f }, hitpoint))
-        {
-            float dist = sqrLen(hitpoint.point - ray.pos);
-            if(dist < closestDist)
-            {
-                selectedEntityIndex = index;
-                closestDist = dist;
-                lineTo = hitpoint.point;
-            }
-        }
-        */
-        const auto &model = models[u32(entity.entityType)];
+        // Candidates are sorted by distance to their bounds, none of the rest can be closer.
+        if(candidate.distance * candidate.distance > closestDist)
+            break;
+
+        // Bvh user index is the handle index.
+        u32 entityIndex = sceneData.entities.denseIndices[candidate.userIndex];
+        const auto &model = models[u32(sceneData.entities.entityTypes[entityIndex])];
+        u32 meshIndex = sceneData.entities.meshIndices[entityIndex];
 
         HitPoint hitpoint{ Uninit };
         Bounds bounds;
-        if(entity.meshIndex < model.modelMeshes.size())
-            bounds = model.modelMeshes[entity.meshIndex].bounds;
-        if(rayOOBBBoundsIntersect(ray, bounds, entity.transform, hitpoint))
+        if(meshIndex < model.modelMeshes.size())
+            bounds = model.modelMeshes[meshIndex].bounds;
+        if(rayOOBBBoundsIntersect(ray, bounds, sceneData.sceneGraph.getWorldTransform(candidate.userIndex), hitpoint))
         {
             float dist = sqrLen(hitpoint.point - ray.pos);
             if(dist < closestDist)
             {
-                result = index;
+                resultHandleIndex = candidate.userIndex;
                 closestDist = dist;
                 outHitpoint = hitpoint;
             }
         }
-        ++index;
     }
 
+    EntityHandle result;
+    if(resultHandleIndex != ~0u)
+        result = sceneData.entities.getHandle(sceneData.entities.denseIndices[resultHandleIndex]);
+    return result;
+}
+
+static void getHandlesFromHandleIndices(const EntityStore &entities, const PodVector<u32> &handleIndices,
+    PodVector<EntityHandle> &outHandles)
+{
+    outHandles.clear();
+    for(u32 handleIndex : handleIndices)
+        outHandles.pushBack(entities.getHandle(entities.denseIndices[handleIndex]));
+}
+
+void Scene::queryOverlap(const Bounds &bounds, PodVector<EntityHandle> &outEntities) const
+{
+    PodVector<u32> handleIndices;
+    sceneData.bvh.overlapQuery(bounds, handleIndices);
+    getHandlesFromHandleIndices(sceneData.entities, handleIndices, outEntities);
+}
+
+void Scene::queryNearest(const Vec3 &pos, u32 count, PodVector<EntityHandle> &outEntities) const
+{
+    PodVector<u32> handleIndices;
+    sceneData.bvh.nearestQuery(pos, count, handleIndices);
+    getHandlesFromHandleIndices(sceneData.entities, handleIndices, outEntities);
+}
+
+void Scene::updateEntityBounds(EntityHandle handle)
+{
+    ASSERT(sceneData.entities.isValidHandle(handle));
+    if(!sceneData.entities.isValidHandle(handle))
+        return;
+
+    // Only the entity and its children, other moved entities wait for the update.
+    u32 handleIndex = handle.entityIndex;
+    const EntityStore &entities = sceneData.entities;
+    sceneData.sceneGraph.setLocalTransform(handleIndex, entities.transforms[entities.getDenseIndex(handle)]);
+    sceneData.sceneGraph.updateSubtree(handleIndex);
+    refitUpdatedBounds(sceneData);
+}
+
+bool Scene::setParent(EntityHandle handle, EntityHandle parentHandle)
+{
+    ASSERT(sceneData.entities.isValidHandle(handle));
+    if(!sceneData.entities.isValidHandle(handle))
+        return false;
+
+    u32 parentHandleIndex = ~0u;
+    if(parentHandle != EntityHandle())
+    {
+        if(!sceneData.entities.isValidHandle(parentHandle))
+            return false;
+        parentHandleIndex = parentHandle.entityIndex;
+    }
+    return sceneData.sceneGraph.setParent(handle.entityIndex, parentHandleIndex);
+}
+
+EntityHandle Scene::getParent(EntityHandle handle) const
+{
+    EntityHandle result;
+    if(!sceneData.entities.isValidHandle(handle))
+        return result;
+
+    u32 parentHandleIndex = sceneData.sceneGraph.getParent(handle.entityIndex);
+    if(parentHandleIndex != ~0u)
+        result = sceneData.entities.getHandle(sceneData.entities.denseIndices[parentHandleIndex]);
     return result;
 }
 
+const Transform &Scene::getWorldTransform(EntityHandle handle) const
+{
+    ASSERT(sceneData.entities.isValidHandle(handle));
+    if(!sceneData.entities.isValidHandle(handle))
+    {
+        ConstTransform = Transform();
+        return ConstTransform;
+    }
+    return sceneData.sceneGraph.getWorldTransform(handle.entityIndex);
+}
+
+const Mat3x4 &Scene::getWorldMatrix(EntityHandle handle) const
+{
+    ASSERT(sceneData.entities.isValidHandle(handle));
+    if(!sceneData.entities.isValidHandle(handle))
+        return ConstMatrix;
+    return sceneData.sceneGraph.getWorldMatrix(handle.entityIndex);
+}
@@ -2,19 +2,32 @@
 
 #include <container/stackstring.h>
 #include <render/meshrendersystem.h>
+#include <scene/dynamicbvh.h>
+#include <scene/entitystore.h>
 #include <scene/gameentity.h>
+#include <scene/scenegraph.h>
 
 #include <model/animation.h>
 
+class JobSystem;
 struct Ray;
 struct HitPoint;
 
 // this is bit bad access
 struct SceneData
 {
-    PodVector<AnimationState> animationStates;
-    PodVector<GameEntity> entities;
-    PodVector<u32> freeEnityIndices;
+    EntityStore entities;
+
+    // Per entity proxy in bvh indexed with handle index, world bounds get refitted in update.
+    // Bvh user index is the handle index.
+    PodVector<u32> bvhProxyIndices;
+    DynamicBvh bvh;
+
+    // Node index is the handle index of the entity.
+    SceneGraph sceneGraph;
+
+    // Workers for splitting big scene graph levels, shared with the app through Scene::init.
+    JobSystem *jobSystem = nullptr;
 };
 
 class Scene
@@ -23,23 +36,46 @@ public:
     static constexpr u32 MagicNumber = 1385621965u;
     static constexpr u32 VersionNumber = 1u;
 
-    bool init();
+    // jobSystem has to outlive the scene, nullptr runs scene graph updates and mesh packing
+    // on this thread.
+    bool init(JobSystem *jobSystem = nullptr);
     bool update(double deltaTime);
 
-    u32 castRay(const Ray &ray, HitPoint &hitpoint);
+    EntityHandle castRay(const Ray &ray, HitPoint &hitpoint);
+    void queryOverlap(const Bounds &bounds, PodVector<EntityHandle> &outEntities) const;
+    void queryNearest(const Vec3 &pos, u32 count, PodVector<EntityHandle> &outEntities) const;
+    // Update is refitting the bounds every frame, this is for queries right after moving entity.
+    // Only the entity and its children get their world transform and bounds updated.
+    void updateEntityBounds(EntityHandle handle);
+
+    EntityHandle addGameEntity(const GameEntity& entity, const SmallStackString &str = "");
+    // Last entity gets moved into the removed one's place, handles of other entities stay valid.
+    // Children of removed entity become roots.
+    bool removeEntity(EntityHandle handle);
+    bool isValidEntity(EntityHandle handle) const;
+    // Copy gathered from the entity columns, setEntity writes it back.
+    GameEntity getEntity(EntityHandle handle) const;
+    void setEntity(EntityHandle handle, const GameEntity &entity);
+    Transform &getTransform(EntityHandle handle);
+    Bounds getBounds(EntityHandle handle) const;
 
-    u32 addGameEntity(const GameEntity& entity, const SmallStackString &str = "");
-    GameEntity &getEntity(u32 index) const;
-    Bounds getBounds(u32 entityIndex) const;
+    // Entity transform is relative to its parent. Default handle as parent detaches.
+    bool setParent(EntityHandle handle, EntityHandle parentHandle);
+    EntityHandle getParent(EntityHandle handle) const;
+    // Cached from the last update.
+    const Transform &getWorldTransform(EntityHandle handle) const;
+    const Mat3x4 &getWorldMatrix(EntityHandle handle) const;
+    const SceneGraphStats &getSceneGraphStats() const { return sceneData.sceneGraph.getStats(); }
 
-    const PodVector<GameEntity> &getEntities() const { return sceneData.entities; }
-    PodVector<GameEntity> &getEntities() { return sceneData.entities; }
+    // Columns only contain live entities, use getHandle for dense index to handle.
+    u32 getEntityCount() const { return sceneData.entities.getEntityCount(); }
+    const EntityStore &getEntities() const { return sceneData.entities; }
+    EntityStore &getEntities() { return sceneData.entities; }
 
     // TODO should think where this code should live.
-    u32 addAnimation(u32 entityIndex, const char *animName, PlayMode playMode);
-    u32 addAnimation(u32 entityIndex, u32 animationIndex, PlayMode playMode);
-    u32 replaceAnimation(u32 entityIndex, u32 animationIndex, u32 playingAnimatinIndex);
-    u32 replaceAnimation(u32 entityIndex, const char *animName, u32 playingAnimatinIndex);
+    u32 addAnimation(EntityHandle handle, const char *animName, PlayMode playMode);
+    u32 addAnimation(EntityHandle handle, u32 animationIndex, PlayMode playMode);
+    u32 replaceAnimation(EntityHandle handle, const char *animName, u32 playingAnimatinIndex);
 
     bool readLevel(const char *levelName);
     bool writeLevel(const char *filename) const;
@@ -0,0 +1,351 @@
+#include "scenegraph.h"
+
+#include <components/transform_functions.h>
+
+#include <core/assert.h>
+#include <core/general.h>
+#include <core/jobsystem.h>
+
+#include <math/quaternion_inline_functions.h>
+#include <math/vector3_inline_functions.h>
+
+static Transform sCombineTransforms(const Transform &parent, const Transform &local)
+{
+    Transform result;
+    result.pos = parent.pos + rotateVector(parent.scale * local.pos, parent.rot);
+    result.rot = parent.rot * local.rot;
+    result.scale = parent.scale * local.scale;
+    return result;
+}
+
+static void sUpdateNodeRange(const u32 *RESTRICT nodes, u32 startIndex, u32 endIndex,
+    const u32 *RESTRICT parents, const Transform *RESTRICT localTransforms,
+    Transform *RESTRICT worldTransforms, Mat3x4 *RESTRICT worldMatrices, Mat3x4 *RESTRICT worldNormalMatrices)
+{
+    for(u32 i = startIndex; i < endIndex; ++i)
+    {
+        u32 nodeIndex = nodes[i];
+        u32 parentIndex = parents[nodeIndex];
+
+        const Transform &world = parentIndex == ~0u
+            ? localTransforms[nodeIndex]
+            : sCombineTransforms(worldTransforms[parentIndex], localTransforms[nodeIndex]);
+
+        worldTransforms[nodeIndex] = world;
+        worldMatrices[nodeIndex] = getModelMatrix(world);
+        worldNormalMatrices[nodeIndex] = getModelNormalMatrix(world);
+    }
+}
+
+struct SceneGraphLevelJob
+{
+    const u32 *nodes = nullptr;
+    u32 levelStart = 0u;
+    u32 levelEnd = 0u;
+    const u32 *parents = nullptr;
+    const Transform *localTransforms = nullptr;
+    Transform *worldTransforms = nullptr;
+    Mat3x4 *worldMatrices = nullptr;
+    Mat3x4 *worldNormalMatrices = nullptr;
+};
+
+static void sUpdateNodeRangeJob(void *jobData, u32 jobIndex)
+{
+    const SceneGraphLevelJob &job = *(const SceneGraphLevelJob *)jobData;
+    u32 startIndex = job.levelStart + jobIndex * SceneGraph::NodesPerJob;
+    u32 endIndex = Supa::minu32(startIndex + SceneGraph::NodesPerJob, job.levelEnd);
+    sUpdateNodeRange(job.nodes, startIndex, endIndex, job.parents, job.localTransforms,
+        job.worldTransforms, job.worldMatrices, job.worldNormalMatrices);
+}
+
+void SceneGraph::resize(u32 nodeCount)
+{
+    u32 oldCount = parents.size();
+    if(nodeCount <= oldCount)
+        return;
+
+    parents.resize(nodeCount, ~0u);
+    firstChildren.resize(nodeCount, ~0u);
+    nextSiblings.resize(nodeCount, ~0u);
+    depths.resize(nodeCount, 0u);
+
+    localTransforms.resize(nodeCount, Transform());
+    worldTransforms.resize(nodeCount, Transform());
+    worldMatrices.resize(nodeCount, Mat3x4());
+    worldNormalMatrices.resize(nodeCount, Mat3x4());
+
+    dirtyFlags.resize(nodeCount, 0u);
+    for(u32 i = oldCount; i < nodeCount; ++i)
+        markDirty(i);
+}
+
+void SceneGraph::clear()
+{
+    parents.clear();
+    firstChildren.clear();
+    nextSiblings.clear();
+    depths.clear();
+
+    localTransforms.clear();
+    worldTransforms.clear();
+    worldMatrices.clear();
+    worldNormalMatrices.clear();
+
+    dirtyFlags.clear();
+    dirtyNodes.clear();
+    updatedNodes.clear();
+    stats = SceneGraphStats();
+}
+
+void SceneGraph::detachFromParent(u32 nodeIndex)
+{
+    u32 parentIndex = parents[nodeIndex];
+    if(parentIndex == ~0u)
+        return;
+
+    if(firstChildren[parentIndex] == nodeIndex)
+    {
+        firstChildren[parentIndex] = nextSiblings[nodeIndex];
+    }
+    else
+    {
+        u32 sibling = firstChildren[parentIndex];
+        while(nextSiblings[sibling] != nodeIndex)
+        {
+            ASSERT(nextSiblings[sibling] != ~0u);
+            sibling = nextSiblings[sibling];
+        }
+        nextSiblings[sibling] = nextSiblings[nodeIndex];
+    }
+    nextSiblings[nodeIndex] = ~0u;
+    parents[nodeIndex] = ~0u;
+}
+
+void SceneGraph::updateDepths(u32 nodeIndex)
+{
+    PodVector<u32> stack;
+    stack.pushBack(nodeIndex);
+    while(stack.size() > 0)
+    {
+        u32 index = stack.popBack();
+        u32 child = firstChildren[index];
+        while(child != ~0u)
+        {
+            depths[child] = depths[index] + 1;
+            stack.pushBack(child);
+            child = nextSiblings[child];
+        }
+    }
+}
+
+bool SceneGraph::setParent(u32 nodeIndex, u32 parentIndex)
+{
+    ASSERT(nodeIndex < parents.size());
+    ASSERT(parentIndex == ~0u || parentIndex < parents.size());
+    if(nodeIndex >= parents.size() || (parentIndex != ~0u && parentIndex >= parents.size()))
+        return false;
+
+    if(parents[nodeIndex] == parentIndex)
+        return true;
+
+    // Node cannot be parented under itself or its own children.
+    u32 ancestor = parentIndex;
+    while(ancestor != ~0u)
+    {
+        if(ancestor == nodeIndex)
+            return false;
+        ancestor = parents[ancestor];
+    }
+
+    detachFromParent(nodeIndex);
+    if(parentIndex != ~0u)
+    {
+        parents[nodeIndex] = parentIndex;
+        nextSiblings[nodeIndex] = firstChildren[parentIndex];
+        firstChildren[parentIndex] = nodeIndex;
+        depths[nodeIndex] = depths[parentIndex] + 1;
+    }
+    else
+    {
+        depths[nodeIndex] = 0u;
+    }
+    updateDepths(nodeIndex);
+    markDirty(nodeIndex);
+    return true;
+}
+
+u32 SceneGraph::getParent(u32 nodeIndex) const
+{
+    ASSERT(nodeIndex < parents.size());
+    if(nodeIndex >= parents.size())
+        return ~0u;
+    return parents[nodeIndex];
+}
+
+void SceneGraph::detachNode(u32 nodeIndex)
+{
+    ASSERT(nodeIndex < parents.size());
+    if(nodeIndex >= parents.size())
+        return;
+
+    detachFromParent(nodeIndex);
+    depths[nodeIndex] = 0u;
+    while(firstChildren[nodeIndex] != ~0u)
+    {
+        u32 child = firstChildren[nodeIndex];
+        detachFromParent(child);
+        depths[child] = 0u;
+        updateDepths(child);
+        markDirty(child);
+    }
+}
+
+void SceneGraph::setLocalTransform(u32 nodeIndex, const Transform &transform)
+{
+    ASSERT(nodeIndex < localTransforms.size());
+    Transform &local = localTransforms[nodeIndex];
+    if(Supa::memcmp(&local, &transform, sizeof(Transform)) == 0)
+        return;
+    local = transform;
+    markDirty(nodeIndex);
+}
+
+void SceneGraph::markDirty(u32 nodeIndex)
+{
+    ASSERT(nodeIndex < dirtyFlags.size());
+    if(dirtyFlags[nodeIndex])
+        return;
+    dirtyFlags[nodeIndex] = 1u;
+    dirtyNodes.pushBack(nodeIndex);
+}
+
+void SceneGraph::update(JobSystem *jobSystem)
+{
+    stats = SceneGraphStats();
+    updatedNodes.clear();
+    if(dirtyNodes.size() == 0)
+        return;
+
+    // updateSubtree clears flags of nodes still in the list, and marking them again adds
+    // duplicates. Flag 2 keeps the first one.
+    u32 dirtyCount = 0u;
+    for(u32 nodeIndex : dirtyNodes)
+    {
+        if(dirtyFlags[nodeIndex] != 1u)
+            continue;
+        dirtyFlags[nodeIndex] = 2u;
+        dirtyNodes[dirtyCount++] = nodeIndex;
+    }
+    dirtyNodes.resize(dirtyCount);
+    if(dirtyNodes.size() == 0)
+        return;
+
+    stats.dirtyNodes = dirtyNodes.size();
+
+    // Add whole subtrees of dirty nodes, dirty flag keeps every node in only once.
+    for(u32 i = 0; i < dirtyNodes.size(); ++i)
+    {
+        u32 child = firstChildren[dirtyNodes[i]];
+        while(child != ~0u)
+        {
+            if(!dirtyFlags[child])
+            {
+                dirtyFlags[child] = 1u;
+                dirtyNodes.pushBack(child);
+            }
+            child = nextSiblings[child];
+        }
+    }
+
+    // Counting sort by depth, so parents always come before their children.
+    u32 maxDepth = 0u;
+    for(u32 nodeIndex : dirtyNodes)
+        maxDepth = Supa::maxu32(maxDepth, depths[nodeIndex]);
+
+    levelCounts.clear();
+    levelCounts.resize(maxDepth + 1, 0u);
+    for(u32 nodeIndex : dirtyNodes)
+        ++levelCounts[depths[nodeIndex]];
+
+    u32 levelStart = 0u;
+    for(u32 &levelCount : levelCounts)
+    {
+        if(levelCount > 0)
+            ++stats.levels;
+        u32 count = levelCount;
+        levelCount = levelStart;
+        levelStart += count;
+    }
+
+    updatedNodes.uninitializedResize(dirtyNodes.size());
+    for(u32 nodeIndex : dirtyNodes)
+        updatedNodes[levelCounts[depths[nodeIndex]]++] = nodeIndex;
+    // levelCounts now holds the end index of each level.
+
+    // Levels run one after another, nodes of one level in parallel.
+    bool useJobs = jobSystem && jobSystem->getWorkerCount() > 0u;
+    SceneGraphLevelJob levelJob{
+        .nodes = updatedNodes.data(),
+        .parents = parents.data(),
+        .localTransforms = localTransforms.data(),
+        .worldTransforms = worldTransforms.data(),
+        .worldMatrices = worldMatrices.data(),
+        .worldNormalMatrices = worldNormalMatrices.data(),
+    };
+    levelStart = 0u;
+    for(u32 levelEnd : levelCounts)
+    {
+        u32 levelSize = levelEnd - levelStart;
+        if(useJobs && levelSize > NodesPerJob)
+        {
+            levelJob.levelStart = levelStart;
+            levelJob.levelEnd = levelEnd;
+            u32 jobCount = (levelSize + NodesPerJob - 1u) / NodesPerJob;
+            JobCounter counter;
+            jobSystem->addJobs(sUpdateNodeRangeJob, &levelJob, jobCount, counter);
+            jobSystem->waitForCounter(counter);
+            stats.jobs += jobCount;
+        }
+        else
+        {
+            sUpdateNodeRange(updatedNodes.data(), levelStart, levelEnd,
+                parents.data(), localTransforms.data(),
+                worldTransforms.data(), worldMatrices.data(), worldNormalMatrices.data());
+        }
+        levelStart = levelEnd;
+    }
+
+    for(u32 nodeIndex : updatedNodes)
+        dirtyFlags[nodeIndex] = 0u;
+    dirtyNodes.clear();
+
+    stats.matricesRecomputed = updatedNodes.size();
+}
+
+void SceneGraph::updateSubtree(u32 nodeIndex)
+{
+    ASSERT(nodeIndex < parents.size());
+    stats = SceneGraphStats();
+    updatedNodes.clear();
+    updatedNodes.pushBack(nodeIndex);
+
+    // Breadth first, parents come before their children.
+    for(u32 i = 0; i < updatedNodes.size(); ++i)
+    {
+        u32 child = firstChildren[updatedNodes[i]];
+        while(child != ~0u)
+        {
+            updatedNodes.pushBack(child);
+            child = nextSiblings[child];
+        }
+    }
+
+    sUpdateNodeRange(updatedNodes.data(), 0u, updatedNodes.size(),
+        parents.data(), localTransforms.data(),
+        worldTransforms.data(), worldMatrices.data(), worldNormalMatrices.data());
+
+    for(u32 updatedIndex : updatedNodes)
+        dirtyFlags[updatedIndex] = 0u;
+
+    stats.matricesRecomputed = updatedNodes.size();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <components/transform.h>
+#include <container/podvector.h>
+#include <core/mytypes.h>
+#include <math/matrix.h>
+
+class JobSystem;
+
+struct SceneGraphStats
+{
+    u32 matricesRecomputed = 0u;
+    u32 dirtyNodes = 0u;
+    u32 levels = 0u;
+    u32 jobs = 0u;
+};
+
+// Parent child hierarchy with cached world transforms and matrices in separate arrays.
+// Only subtrees under dirty nodes get recomputed. They are processed one depth level
+// at a time, nodes inside a level only read their parents from earlier levels,
+// so big levels get split between job system threads.
+// World transforms compose scale per axis like the local ones, so a rotated child of a
+// non uniformly scaled parent loses the shear a matrix product would give.
+class SceneGraph
+{
+public:
+    // New nodes are dirty roots with default transform.
+    void resize(u32 nodeCount);
+    void clear();
+
+    // parentIndex ~0u makes node a root. Fails if it would create a cycle.
+    bool setParent(u32 nodeIndex, u32 parentIndex);
+    u32 getParent(u32 nodeIndex) const;
+    // Detaches node from its parent, its children become dirty roots.
+    void detachNode(u32 nodeIndex);
+
+    // Marks the node dirty only if the transform differs from the cached one.
+    void setLocalTransform(u32 nodeIndex, const Transform &transform);
+    void markDirty(u32 nodeIndex);
+
+    // Levels with more than NodesPerJob nodes run on jobSystem when it has workers.
+    void update(JobSystem *jobSystem = nullptr);
+    // Recomputes only the node and its children on this thread, with the cached world
+    // transform of its parent. Recomputed nodes are no longer dirty for the next update.
+    void updateSubtree(u32 nodeIndex);
+
+    u32 getNodeCount() const { return parents.size(); }
+    const Transform &getLocalTransform(u32 nodeIndex) const { return localTransforms[nodeIndex]; }
+    const Transform &getWorldTransform(u32 nodeIndex) const { return worldTransforms[nodeIndex]; }
+    const Mat3x4 &getWorldMatrix(u32 nodeIndex) const { return worldMatrices[nodeIndex]; }
+    const Mat3x4 &getWorldNormalMatrix(u32 nodeIndex) const { return worldNormalMatrices[nodeIndex]; }
+
+    // Nodes recomputed by last update, sorted by depth.
+    const PodVector<u32> &getUpdatedNodes() const { return updatedNodes; }
+    const SceneGraphStats &getStats() const { return stats; }
+
+    static constexpr u32 NodesPerJob = 1024u;
+
+private:
+    void detachFromParent(u32 nodeIndex);
+    void updateDepths(u32 nodeIndex);
+
+    PodVector<u32> parents;
+    PodVector<u32> firstChildren;
+    PodVector<u32> nextSiblings;
+    PodVector<u32> depths;
+
+    PodVector<Transform> localTransforms;
+    PodVector<Transform> worldTransforms;
+    PodVector<Mat3x4> worldMatrices;
+    PodVector<Mat3x4> worldNormalMatrices;
+
+    PodVector<u8> dirtyFlags;
+    PodVector<u32> dirtyNodes;
+
+    PodVector<u32> updatedNodes;
+    PodVector<u32> levelCounts;
+
+    SceneGraphStats stats;
+};
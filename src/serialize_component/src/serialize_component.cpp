@@ -4,7 +4,10 @@
 #include <components/components.h>
 #include <components/generated_components.h>
 #include <components/generated_systems.h>
+#include <components/systemscheduler.h>
+#include <components/transform_functions.h>
 
+#include <container/bytebuffer.h>
 #include <container/podvector.h>
 #include <container/string.h>
 #include <container/stringview.h>
@@ -43,6 +46,8 @@ class TestSystem
 public:
     static bool update(EntitySystems& entitySystems, double dt);
     static bool init(EntitySystems &entitySystems);
+    // Declares the component arrays update uses.
+    static u32 addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems);
     //static void deinit(EntitySystems &entitySystems);
 };
 class TestSystem2
@@ -50,12 +55,14 @@ class TestSystem2
 public:
     static bool update(EntitySystems &entitySystems, double dt);
     static bool init(EntitySystems &entitySystems);
+    static u32 addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems);
     //static void deinit(EntitySystems &entitySystems);
 };
 class TestSystem3
 {
 public:
     static bool update(EntitySystems &entitySystems);
+    static u32 addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems);
 };
 // Implementation here
 struct EntitySystems
@@ -128,6 +135,53 @@ bool TestSystem2::init(EntitySystems &entitySystems)
     return true;
 }
 
+u32 TestSystem::addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems)
+{
+    u32 systemIndex = scheduler.addSystem("TestSystem",
+        [](void *userData, double dt) { return TestSystem::update(*(EntitySystems *)userData, dt); },
+        &entitySystems);
+
+    auto gameEntsWriteComponents = GameEntitySystem::getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+
+    scheduler.addSystemAccess(systemIndex, GameEntitySystem::entitySystemID,
+        0u, gameEntsWriteComponents.componentIndexArray);
+    return systemIndex;
+}
+
+u32 TestSystem2::addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems)
+{
+    u32 systemIndex = scheduler.addSystem("TestSystem2",
+        [](void *userData, double dt) { return TestSystem2::update(*(EntitySystems *)userData, dt); },
+        &entitySystems);
+
+    auto gameEntsReadComponents = GameEntitySystem::getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+
+    auto gameEntsWriteComponents = GameEntitySystem::getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::Mat3x4Component);
+
+    scheduler.addSystemAccess(systemIndex, GameEntitySystem::entitySystemID,
+        gameEntsReadComponents.componentIndexArray, gameEntsWriteComponents.componentIndexArray);
+    return systemIndex;
+}
+
+u32 TestSystem3::addToScheduler(SystemScheduler &scheduler, EntitySystems &entitySystems)
+{
+    u32 systemIndex = scheduler.addSystem("TestSystem3",
+        [](void *userData, double dt) { return TestSystem3::update(*(EntitySystems *)userData); },
+        &entitySystems);
+
+    auto gameEntsReadComponents = GameEntitySystem::getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent)
+        .addComponent(ComponentType::Mat3x4Component)
+        .addComponent(ComponentType::CameraComponent);
+
+    scheduler.addSystemAccess(systemIndex, GameEntitySystem::entitySystemID,
+        gameEntsReadComponents.componentIndexArray, 0u);
+    return systemIndex;
+}
+
 bool TestSystem::update(EntitySystems &entitySystems, double dt)
 {
     if(dt <= 0.0)
@@ -138,21 +192,16 @@ bool TestSystem::update(EntitySystems &entitySystems, double dt)
         .addComponent(ComponentType::TransformComponent);
 
     const auto &gameEntsRWHandle = gameEnts.getRWHandle({}, gameEntsWriteComponents);
-    u32 gameEntCount = gameEnts.getEntityCount();
-
-    TransformComponent* transformComponents = gameEnts.getTransformComponentWriteArray(gameEntsRWHandle);
-    const u64* components = gameEnts.getComponentsReadArray();
-    if(transformComponents == nullptr || components == nullptr)
-        return false;
-    u64 requiredComponents = gameEntsRWHandle.readArrays | gameEntsRWHandle.writeArrays;
 
-    for(u32 i = 0; i < gameEntCount; ++i)
+    auto query = gameEnts.getQuery(gameEntsRWHandle);
+    GameEntitySystem::GameEntitySystemQueryBatch batch;
+    while(query.nextBatch(batch))
     {
-        //if(!gameEnts.hasComponents(i, gameEntsRWHandle))
-        //    continue;
-        if((components[i] & requiredComponents) != requiredComponents)
-            continue;
-        transformComponents[i].position.x += 0.01f * dt;
+        TransformComponent* transformComponents = batch.TransformComponentWriteArray;
+        if(transformComponents == nullptr)
+            return false;
+        for(u32 i = 0; i < batch.count; ++i)
+            transformComponents[i].position.x += 0.01f * dt;
     }
 
     return true;
@@ -171,20 +220,17 @@ bool TestSystem2::update(EntitySystems &entitySystems, double dt)
         .addComponent(ComponentType::Mat3x4Component);
 
     const auto &gameEntsRWHandle = gameEnts.getRWHandle(gameEntsReadComponents, gameEntsWriteComponents);
-    u32 gameEntCount = gameEnts.getEntityCount();
 
-    const TransformComponent *transformComponents = gameEnts.getTransformComponentReadArray(gameEntsRWHandle);
-    Mat4Component* matComponents = gameEnts.getMat4ComponentWriteArray(gameEntsRWHandle);
-
-    if(transformComponents == nullptr || matComponents == nullptr)
-        return false;
-
-    for(u32 i = 0; i < gameEntCount; ++i)
+    auto query = gameEnts.getQuery(gameEntsRWHandle);
+    GameEntitySystem::GameEntitySystemQueryBatch batch;
+    while(query.nextBatch(batch))
     {
-        if(!gameEnts.hasComponents(i, gameEntsRWHandle))
-            continue;
+        const TransformComponent *transformComponents = batch.TransformComponentReadArray;
+        Mat4Component* matComponents = batch.Mat4ComponentWriteArray;
+        if(transformComponents == nullptr || matComponents == nullptr)
+            return false;
 
-        getMatrixFromTransform(transformComponents[i], matComponents[i].mat);
+        getModelMatrices(transformComponents, batch.count, &matComponents[0].mat, sizeof(Mat4Component));
     }
 
     return true;
@@ -241,7 +287,122 @@ bool TestSystem3::update(EntitySystems &entitySystems)
     return true;
 }
 
+// Round trips entities through binary snapshot and compares save + load time against json.
+static bool sTestBinarySerialization()
+{
+    // Json of more entities runs out of mymemory.
+    const u32 entityCount = 4000u;
+    StaticModelEntity source;
+    {
+        auto mtx = source.getLockedMutexHandle();
+        for(u32 i = 0; i < entityCount; ++i)
+        {
+            EntitySystemHandle handle = source.addEntity(mtx);
+            if(i % 2 == 0)
+                source.addHeritaged1Component(handle, Heritaged1Component{ .tempi32 = i32(i), .tempFloat = float(i) * 0.5f });
+            if(i % 3 == 0)
+                source.addHeritaged2Component(handle, Heritaged2Component{ .tempInt2 = i32(i) });
+        }
+        for(u32 i = 0; i < entityCount; i += 7)
+            source.removeEntity(source.getEntitySystemHandle(i), mtx);
+        source.releaseLockedMutexHandle(mtx);
+    }
+    source.syncReadWrites();
+
+    Timer binaryTimer;
+    ByteBuffer buffer(1, BufferType::PODVECTOR);
+    if(!source.serializeBinary(buffer))
+        return false;
 
+    StaticModelEntity binaryLoaded;
+    {
+        u32 readOffset = 0u;
+        auto mtx = binaryLoaded.getLockedMutexHandle();
+        bool loaded = binaryLoaded.deserializeBinary(buffer, readOffset, mtx);
+        binaryLoaded.releaseLockedMutexHandle(mtx);
+        if(!loaded || readOffset != buffer.getSize())
+        {
+            LOG("Failed to load binary snapshot\n");
+            return false;
+        }
+    }
+    binaryLoaded.syncReadWrites();
+    double binaryTime = binaryTimer.getDuration();
+
+    Timer jsonTimer;
+    WriteJson writeJson(1, 1);
+    source.serialize(writeJson);
+    writeJson.finishWrite();
+    JsonBlock json;
+    const String &strJson = writeJson.getString();
+    StaticModelEntity jsonLoaded;
+    if(json.parseJson(StringView(strJson.data(), strJson.size())))
+    {
+        auto mtx = jsonLoaded.getLockedMutexHandle();
+        jsonLoaded.deserialize(json, mtx);
+        jsonLoaded.releaseLockedMutexHandle(mtx);
+    }
+    jsonLoaded.syncReadWrites();
+    double jsonTime = jsonTimer.getDuration();
+
+    auto builder = source.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::HeritagedType)
+        .addComponent(ComponentType::HeritagedType2);
+    const auto &sourceRWHandle = source.getRWHandle(builder, {});
+    const auto &loadedRWHandle = binaryLoaded.getRWHandle(builder, {});
+    const Heritaged1Component *sourceComponents1 = source.getHeritaged1ComponentReadArray(sourceRWHandle);
+    const Heritaged2Component *sourceComponents2 = source.getHeritaged2ComponentReadArray(sourceRWHandle);
+    const Heritaged1Component *loadedComponents1 = binaryLoaded.getHeritaged1ComponentReadArray(loadedRWHandle);
+    const Heritaged2Component *loadedComponents2 = binaryLoaded.getHeritaged2ComponentReadArray(loadedRWHandle);
+
+    bool success = binaryLoaded.getEntityCount() == entityCount;
+    for(u32 i = 0; i < entityCount && success; ++i)
+    {
+        EntitySystemHandle handle = source.getEntitySystemHandle(i);
+        EntitySystemHandle loadedHandle = binaryLoaded.getEntitySystemHandle(i);
+        success &= handle.entityIndexVersion == loadedHandle.entityIndexVersion;
+        success &= source.hasComponents(i, builder) == binaryLoaded.hasComponents(i, builder);
+        if(source.hasComponent(handle, ComponentType::HeritagedType))
+        {
+            success &= binaryLoaded.hasComponent(loadedHandle, ComponentType::HeritagedType);
+            success &= sourceComponents1[i].tempi32 == loadedComponents1[i].tempi32;
+            success &= sourceComponents1[i].tempFloat == loadedComponents1[i].tempFloat;
+        }
+        if(source.hasComponent(handle, ComponentType::HeritagedType2))
+        {
+            success &= binaryLoaded.hasComponent(loadedHandle, ComponentType::HeritagedType2);
+            success &= sourceComponents2[i].tempInt2 == loadedComponents2[i].tempInt2;
+        }
+    }
+    source.syncReadWrites();
+    binaryLoaded.syncReadWrites();
+
+    // Removed entity indices get reused the same way.
+    {
+        auto sourceMtx = source.getLockedMutexHandle();
+        auto loadedMtx = binaryLoaded.getLockedMutexHandle();
+        success &= source.addEntity(sourceMtx).entityIndex == binaryLoaded.addEntity(loadedMtx).entityIndex;
+        source.releaseLockedMutexHandle(sourceMtx);
+        binaryLoaded.releaseLockedMutexHandle(loadedMtx);
+    }
+
+    // Truncated snapshot fails without adding anything.
+    {
+        StaticModelEntity truncated;
+        buffer.resize(buffer.getSize() - 1);
+        u32 readOffset = 0u;
+        auto mtx = truncated.getLockedMutexHandle();
+        success &= !truncated.deserializeBinary(buffer, readOffset, mtx);
+        success &= readOffset == 0u && truncated.getEntityCount() == 0u;
+        truncated.releaseLockedMutexHandle(mtx);
+    }
+
+    LOG("Serialize %u entities, save + load binary: %fms, %u bytes, json: %fms, %u bytes\n",
+        entityCount, binaryTime * 1000.0, buffer.getSize() + 1, jsonTime * 1000.0, strJson.size());
+    if(!success)
+        LOG("Binary snapshot round trip failed\n");
+    return success;
+}
 
 
 
@@ -268,6 +429,8 @@ private:
 
     TransformComponent trans;
     EntitySystems entitySystems;
+    // Runs TestSystems, syncs entitySystems between conflicting ones.
+    SystemScheduler systemScheduler;
 
     MyImguiRenderer imgui;
 
@@ -421,11 +584,26 @@ bool SerializeComponent::init(const char *windowStr, i32 screenWidth, i32 screen
     }
 
 
+    if(!sTestBinarySerialization())
+        return false;
+
     {
         TestSystem::init(entitySystems);
         TestSystem2::init(entitySystems);
     }
 
+    {
+        if(!systemScheduler.init(JobSystem::getHardwareThreadCount() - 1))
+            return false;
+
+        systemScheduler.addEntitySystem(entitySystems.gameEntitySystem);
+        systemScheduler.addEntitySystem(entitySystems.otherEntitySystem);
+
+        TestSystem::addToScheduler(systemScheduler, entitySystems);
+        TestSystem2::addToScheduler(systemScheduler, entitySystems);
+        TestSystem3::addToScheduler(systemScheduler, entitySystems);
+    }
+
     return resized();
 }
 
@@ -462,14 +640,7 @@ void SerializeComponent::logicUpdate()
 {
     VulkanApp::logicUpdate();
 
-    TestSystem::update(entitySystems, getDeltaTime());
-    entitySystems.syncPoints();
-
-    TestSystem2::update(entitySystems, getDeltaTime());
-    entitySystems.syncPoints();
-
-    TestSystem3::update(entitySystems);
-    entitySystems.syncPoints();
+    systemScheduler.update(getDeltaTime());
     {
         bool textNeedsUpdate = false;
         for (i32 i = 0; i < bufferedPressesCount; ++i)
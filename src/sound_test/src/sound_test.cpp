@@ -556,7 +556,7 @@ void SoundTest::logicUpdate()
         editMode = !editMode;
         for(u32 i = 0; i < playingMusicChannelNotes.size(); ++i)
         {
-            releaseChannel(playingMusicChannelNotes[i]);
+            releaseNote(playingMusicChannelNotes[i]);
             playingMusicChannelNotes[i] = ~0u;
         }
     }
@@ -585,9 +585,6 @@ void SoundTest::logicUpdate()
     //if(currentNote.oscType < 0) chosenInstrument = 0;
     //if(chosenInstrument > 4) chosenInstrument = 4;
 
-    AtomicType runnings = getRunningNotes();
-    AtomicType releases = getReleasedNotes();
-
     AtomicType keysDown = 0;
     AtomicType keysUp = 0;
 
@@ -608,7 +605,7 @@ void SoundTest::logicUpdate()
                 {
                     u32 noteIndex = note >> 7u;
                     u32 freqIndex = (note - 1) & 127;
-                    releaseChannel(playingMusicChannelNotes[columnIndex]);
+                    releaseNote(playingMusicChannelNotes[columnIndex]);
                     playingMusicChannelNotes[columnIndex] = ~0u;
 
                     if(note != ~0u)
@@ -634,7 +631,7 @@ void SoundTest::logicUpdate()
     {
         u32 note = currentOctave * 12 + GlobalKeyMap[index] + 1 + (currentNoteIndex << 7u);
         if(((keysUp >> index) & 1) == 1)
-            releaseChannel(playingNoteChannels[index]);
+            releaseNote(playingNoteChannels[index]);
     }
 
     for(AtomicType index = 0; index < NOTE_COUNT; ++index)
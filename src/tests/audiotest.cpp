@@ -0,0 +1,382 @@
+#include "testfuncs.h"
+
+#include <audio/audiosynth.h>
+#include <audio/myaudio.h>
+
+#include <core/assert.h>
+#include <core/general.h>
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+static constexpr u32 AudioTestSampleRate = 48000u;
+static constexpr u32 AudioTestChannels = 2u;
+// 10ms buffers, not multiple of the block size.
+static constexpr u32 AudioTestBufferFrames = 480u;
+
+// All instruments from -3 to 3, some with tuning changing over time.
+static void sSetupNotes(NoteFromMainToThread *notes)
+{
+    for(u32 i = 0; i < NOTE_COUNT; ++i)
+    {
+        NoteFromMainToThread &note = notes[i];
+        note = {};
+        note.oscType = i32(i % 7u) - 3;
+        note.oscLFOType = 0;
+        note.oscLFOHz = 2.0f;
+        note.freqHz = 110.0f + 37.0f * float(i);
+
+        note.attackAmplitude = 0.03f;
+        note.sustainAmplitude = i == 5u ? 0.0f : 0.02f;
+
+        note.attackDuration = 0.05f + 0.01f * float(i % 4u);
+        note.decayDuration = i == 7u ? 0.0f : 0.1f;
+        note.releaseDuration = 0.2f;
+
+        for(u32 j = 0; j < SAMPLE_POINTS; ++j)
+        {
+            note.amplitudes[j] = 1.0f;
+            note.tuning[j] = i % 3u == 0u ? i32(j % 3u) : 0;
+        }
+    }
+}
+
+// Voices started at frame 0 with the notes.
+static void sSetupVoices(AudioVoice *voices)
+{
+    NoteFromMainToThread notes[NOTE_COUNT];
+    sSetupNotes(notes);
+    for(u32 i = 0; i < NOTE_COUNT; ++i)
+    {
+        voices[i] = {};
+        voices[i].note = notes[i];
+        voices[i].thread.phase = NotePlayPhase::Attack;
+        voices[i].noteId = i;
+    }
+}
+
+static u32 sGetPlayingVoiceCount(const AudioVoice *voices, u32 voiceCount)
+{
+    u32 result = 0u;
+    for(u32 i = 0; i < voiceCount; ++i)
+        result += voices[i].thread.phase != NotePlayPhase::Finished ? 1u : 0u;
+    return result;
+}
+
+static void testAudioBlockMatchesPerSample()
+{
+    AudioVoice blockVoices[NOTE_COUNT];
+    AudioVoice sampleVoices[NOTE_COUNT];
+    sSetupVoices(blockVoices);
+    sSetupVoices(sampleVoices);
+
+    u32 blockFinished = 0u;
+    u32 sampleFinished = 0u;
+
+    float blockOut[AudioTestBufferFrames * AudioTestChannels];
+    float sampleOut[AudioTestBufferFrames * AudioTestChannels];
+
+    // Released after one second, everything should be finished after release duration.
+    const u32 bufferCount = 150u;
+    double maxDifference = 0.0;
+    double maxValue = 0.0;
+    u32 differentFrames = 0u;
+    for(u32 buffer = 0; buffer < bufferCount; ++buffer)
+    {
+        for(u32 i = 0; i < NOTE_COUNT; ++i)
+        {
+            blockVoices[i].released = buffer >= 100u;
+            sampleVoices[i].released = buffer >= 100u;
+        }
+        u64 startFrame = u64(buffer) * AudioTestBufferFrames;
+
+        blockFinished += renderNotes(blockVoices, NOTE_COUNT, startFrame,
+            AudioTestSampleRate, AudioTestBufferFrames, AudioTestChannels, blockOut);
+        sampleFinished += renderNotesPerSample(sampleVoices, NOTE_COUNT, startFrame,
+            AudioTestSampleRate, AudioTestBufferFrames, AudioTestChannels, sampleOut);
+
+        for(u32 i = 0; i < AudioTestBufferFrames; ++i)
+        {
+            ASSERT(blockOut[i * AudioTestChannels] == blockOut[i * AudioTestChannels + 1]);
+            double difference = fabs(double(blockOut[i * 2]) - double(sampleOut[i * 2]));
+            maxDifference = Supa::maxd(maxDifference, difference);
+            differentFrames += difference > 1.0e-4 ? 1u : 0u;
+            maxValue = Supa::maxd(maxValue, fabs(double(sampleOut[i * 2])));
+        }
+    }
+    ASSERT(maxValue > 0.05);
+    // Per sample version accumulates the running time in float, so envelope phase changes can
+    // happen one frame apart. Jumps happen with zero decay, otherwise same math.
+    ASSERT(differentFrames < 16u);
+    ASSERT(maxDifference < 0.01);
+    ASSERT(blockFinished == NOTE_COUNT && sampleFinished == NOTE_COUNT);
+    ASSERT(sGetPlayingVoiceCount(blockVoices, NOTE_COUNT) == 0u);
+    ASSERT(sGetPlayingVoiceCount(sampleVoices, NOTE_COUNT) == 0u);
+
+    printf("Audio block synthesis max difference to per sample: %g, frames over 1e-4: %u\n",
+        maxDifference, differentFrames);
+}
+
+static double sMeasureBuffers(bool block, u32 bufferCount)
+{
+    AudioVoice voices[NOTE_COUNT];
+    sSetupVoices(voices);
+    // Long attack keeps every note running for the whole measurement.
+    for(u32 i = 0; i < NOTE_COUNT; ++i)
+        voices[i].note.attackDuration = 100.0f;
+    float out[AudioTestBufferFrames * AudioTestChannels];
+    float sum = 0.0f;
+
+    Timer timer;
+    for(u32 buffer = 0; buffer < bufferCount; ++buffer)
+    {
+        u64 startFrame = u64(buffer) * AudioTestBufferFrames;
+        u32 finished = block
+            ? renderNotes(voices, NOTE_COUNT, startFrame, AudioTestSampleRate,
+                AudioTestBufferFrames, AudioTestChannels, out)
+            : renderNotesPerSample(voices, NOTE_COUNT, startFrame, AudioTestSampleRate,
+                AudioTestBufferFrames, AudioTestChannels, out);
+        ASSERT(finished == 0u);
+        sum += out[0];
+    }
+    double duration = timer.getDuration();
+    ASSERT(sum == sum);
+    return duration / double(bufferCount);
+}
+
+static void testAudioBenchmark()
+{
+    const u32 bufferCount = 200u;
+    double perSampleTime = sMeasureBuffers(false, bufferCount);
+    double blockTime = sMeasureBuffers(true, bufferCount);
+    double bufferDuration = double(AudioTestBufferFrames) / double(AudioTestSampleRate);
+
+    printf("Audio %u notes, %u frame buffer (%.1fms): per sample: %fms, block: %fms per buffer\n",
+        u32(NOTE_COUNT), AudioTestBufferFrames, bufferDuration * 1000.0, perSampleTime * 1000.0, blockTime * 1000.0);
+}
+
+static AudioCommand sGetCommand(AudioCommandType type, u32 noteId, u64 frame)
+{
+    NoteFromMainToThread notes[NOTE_COUNT];
+    sSetupNotes(notes);
+
+    AudioCommand command = {};
+    command.note = notes[0];
+    command.type = type;
+    command.noteId = noteId;
+    command.frame = frame;
+    return command;
+}
+
+static void testAudioCommandQueue()
+{
+    static AudioCommandQueue queue;
+    ASSERT(queue.front() == nullptr);
+
+    // Wraps around the ring a few times.
+    for(u32 round = 0; round < 3u; ++round)
+    {
+        for(u32 i = 0; i < AudioCommandQueue::Capacity; ++i)
+            ASSERT(queue.push(sGetCommand(AudioCommandType::NoteOn, i, u64(round))));
+        ASSERT(!queue.push(sGetCommand(AudioCommandType::NoteOn, 0u, 0u)));
+
+        for(u32 i = 0; i < AudioCommandQueue::Capacity; ++i)
+        {
+            const AudioCommand *command = queue.front();
+            ASSERT(command && command->noteId == i && command->frame == round);
+            queue.pop();
+        }
+        ASSERT(queue.front() == nullptr);
+    }
+
+    // Producer on another thread, consumer has to see every command in order.
+    const u32 commandCount = 100000u;
+    std::thread producer([]()
+    {
+        for(u32 i = 0; i < commandCount; ++i)
+        {
+            AudioCommand command;
+            command.noteId = i;
+            command.frame = u64(i) * 3u;
+            while(!queue.push(command))
+                std::this_thread::yield();
+        }
+    });
+    for(u32 i = 0; i < commandCount; ++i)
+    {
+        const AudioCommand *command = queue.front();
+        while(command == nullptr)
+        {
+            std::this_thread::yield();
+            command = queue.front();
+        }
+        ASSERT(command->noteId == i && command->frame == u64(i) * 3u);
+        queue.pop();
+    }
+    producer.join();
+    ASSERT(queue.front() == nullptr);
+}
+
+// Notes started and released through commands land on the exact frames.
+static void testAudioCommandTiming()
+{
+    static AudioSynth synth;
+    static AudioCommandQueue queue;
+
+    const u64 startFrame = 1000u;
+    const u64 releaseFrame = 2000u;
+    AudioCommand noteOn = sGetCommand(AudioCommandType::NoteOn, 7u, startFrame);
+    noteOn.note.oscType = 0;
+    noteOn.note.attackDuration = 0.001f;
+    noteOn.note.decayDuration = 0.001f;
+    ASSERT(queue.push(noteOn));
+    ASSERT(queue.push(sGetCommand(AudioCommandType::NoteOff, 7u, releaseFrame)));
+
+    // Reference voice gets started directly at the start frame.
+    AudioVoice voice;
+    voice.note = noteOn.note;
+    voice.thread.startTime = double(startFrame) / AudioTestSampleRate;
+
+    float out[AudioTestBufferFrames * AudioTestChannels];
+    float expected[AudioTestBufferFrames * AudioTestChannels];
+    bool heardSound = false;
+    // Release takes 0.2 seconds.
+    for(u32 buffer = 0; buffer < 30u; ++buffer)
+    {
+        u64 frame = u64(buffer) * AudioTestBufferFrames;
+        u32 playing = renderAudio(synth, queue, AudioTestSampleRate, AudioTestBufferFrames,
+            AudioTestChannels, out);
+        ASSERT(synth.frame == frame + AudioTestBufferFrames);
+
+        // Same frames split at start and release like renderAudio does.
+        memset(expected, 0, sizeof(expected));
+        u32 i = 0u;
+        while(i < AudioTestBufferFrames)
+        {
+            u64 currentFrame = frame + i;
+            u64 count = AudioTestBufferFrames - i;
+            if(currentFrame < startFrame && startFrame - currentFrame < count)
+                count = startFrame - currentFrame;
+            else if(currentFrame < releaseFrame && releaseFrame - currentFrame < count)
+                count = releaseFrame - currentFrame;
+            if(currentFrame == startFrame)
+                voice.thread.phase = NotePlayPhase::Attack;
+            voice.released = currentFrame >= releaseFrame;
+            renderNotes(&voice, 1u, currentFrame, AudioTestSampleRate, u32(count), AudioTestChannels,
+                expected + i * AudioTestChannels);
+            i += u32(count);
+        }
+        ASSERT(memcmp(out, expected, sizeof(out)) == 0);
+        ASSERT(playing == (voice.thread.phase != NotePlayPhase::Finished ? 1u : 0u));
+
+        for(u32 j = 0; j < AudioTestBufferFrames; ++j)
+        {
+            u64 currentFrame = frame + j;
+            if(currentFrame <= startFrame)
+                ASSERT(out[j * AudioTestChannels] == 0.0f);
+            heardSound |= out[j * AudioTestChannels] != 0.0f;
+        }
+    }
+    ASSERT(heardSound);
+    ASSERT(voice.thread.phase == NotePlayPhase::Finished);
+    ASSERT(queue.front() == nullptr);
+}
+
+// More notes than voices steals the oldest, parameter changes reach the voice.
+static void testAudioVoiceStealing()
+{
+    static AudioSynth synth;
+    static AudioCommandQueue queue;
+    AudioCommand noteOn = sGetCommand(AudioCommandType::NoteOn, 0u, 0u);
+    noteOn.note.sustainAmplitude = 0.02f;
+
+    float out[AudioTestBufferFrames * AudioTestChannels];
+    for(u32 i = 0; i < AUDIO_VOICE_COUNT + 4u; ++i)
+    {
+        noteOn.noteId = i;
+        noteOn.frame = i;
+        ASSERT(queue.push(noteOn));
+    }
+    // Released notes get stolen before older playing ones.
+    ASSERT(queue.push(sGetCommand(AudioCommandType::NoteOff, 10u, 100u)));
+    noteOn.noteId = 1000u;
+    noteOn.frame = 101u;
+    ASSERT(queue.push(noteOn));
+
+    AudioCommand setNote = sGetCommand(AudioCommandType::SetNote, 20u, 102u);
+    setNote.note.freqHz = 1234.0f;
+    ASSERT(queue.push(setNote));
+
+    u32 playing = renderAudio(synth, queue, AudioTestSampleRate, AudioTestBufferFrames,
+        AudioTestChannels, out);
+    ASSERT(playing == AUDIO_VOICE_COUNT);
+    ASSERT(queue.front() == nullptr);
+
+    bool found[AUDIO_VOICE_COUNT + 4u] = {};
+    bool foundLast = false;
+    for(const AudioVoice &voice : synth.voices)
+    {
+        if(voice.noteId == 1000u)
+            foundLast = true;
+        else
+            found[voice.noteId] = true;
+        if(voice.noteId == 20u)
+            ASSERT(voice.note.freqHz == 1234.0f);
+    }
+    ASSERT(foundLast);
+    for(u32 i = 0; i < AUDIO_VOICE_COUNT + 4u; ++i)
+        ASSERT(found[i] == (i >= 4u && i != 10u));
+}
+
+// Runs the real callback through miniaudio null backend, so no audio device is needed.
+static void testAudioNullDevice()
+{
+    ASSERT(initAudio(true));
+
+    NoteFromMainToThread notes[NOTE_COUNT];
+    sSetupNotes(notes);
+    // Every note in sustain until released.
+    u32 noteIds[NOTE_COUNT];
+    for(u32 i = 0; i < NOTE_COUNT; ++i)
+    {
+        notes[i].sustainAmplitude = 0.02f;
+        noteIds[i] = addNote(notes[i].freqHz, notes[i]);
+        ASSERT(noteIds[i] != ~0u);
+    }
+
+    resetAudioCallbackStats();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    AudioCallbackStats stats = getAudioCallbackStats();
+    ASSERT(stats.callbackCount > 0u);
+    ASSERT(getPlayingNoteCount() == NOTE_COUNT);
+    ASSERT(getAudioFrame() > 0u);
+
+    double bufferFrames = double(stats.frameCount) / double(stats.callbackCount);
+    printf("Audio null device %u notes, %u callbacks, %.0f frames per buffer: average: %fms, max: %fms per buffer\n",
+        u32(NOTE_COUNT), u32(stats.callbackCount), bufferFrames,
+        stats.totalSeconds * 1000.0 / double(stats.callbackCount), stats.maxSeconds * 1000.0);
+
+    // Release is 0.2 seconds.
+    for(u32 i = 0; i < NOTE_COUNT; ++i)
+        ASSERT(releaseNote(noteIds[i]));
+    for(u32 i = 0; i < 100u && getPlayingNoteCount() != 0u; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT(getPlayingNoteCount() == 0u);
+
+    deinitAudio();
+}
+
+void testAudio()
+{
+    testAudioBlockMatchesPerSample();
+    testAudioBenchmark();
+    testAudioCommandQueue();
+    testAudioCommandTiming();
+    testAudioVoiceStealing();
+    testAudioNullDevice();
+}
@@ -0,0 +1,167 @@
+#include "testfuncs.h"
+
+#include <container/podvector.h>
+#include <core/assert.h>
+#include <core/mytypes.h>
+
+#include <myvulkan/buffercopybatch.h>
+
+#include <stdio.h>
+
+static BufferCopyCommand sCopy(u64 srcBuffer, u64 dstBuffer, u64 srcOffset, u64 dstOffset, u64 size)
+{
+    return BufferCopyCommand{ .srcBuffer = srcBuffer, .dstBuffer = dstBuffer, .srcOffset = srcOffset,
+        .dstOffset = dstOffset, .size = size };
+}
+
+static bool sRegionEquals(const BufferCopyRegion &region, u64 srcOffset, u64 dstOffset, u64 size)
+{
+    return region.srcOffset == srcOffset && region.dstOffset == dstOffset && region.size == size;
+}
+
+static void testBufferCopyMerge()
+{
+    BufferCopyBatches batches;
+    // Back to back uploads into one buffer, like addModel writing vertices one after another.
+    BufferCopyCommand copies[] =
+    {
+        sCopy(1u, 10u, 0u, 0u, 64u),
+        sCopy(1u, 10u, 64u, 64u, 64u),
+        sCopy(1u, 10u, 128u, 128u, 32u),
+        // Gap in destination, own region in the same command.
+        sCopy(1u, 10u, 160u, 256u, 16u),
+        sCopy(1u, 20u, 176u, 0u, 16u),
+    };
+    batchBufferCopies(copies, ARRAYSIZES(copies), batches);
+
+    ASSERT(batches.batches.size() == 2u);
+    ASSERT(batches.batches[0].dstBuffer == 10u && batches.batches[0].regionCount == 2u);
+    ASSERT(batches.batches[1].dstBuffer == 20u && batches.batches[1].regionCount == 1u);
+    ASSERT(batches.regions.size() == 3u);
+    ASSERT(sRegionEquals(batches.regions[0], 0u, 0u, 160u));
+    ASSERT(sRegionEquals(batches.regions[1], 160u, 256u, 16u));
+    ASSERT(sRegionEquals(batches.regions[2], 176u, 0u, 16u));
+
+    ASSERT(batches.ranges.size() == 3u);
+    ASSERT(batches.ranges[0].dstBuffer == 10u && batches.ranges[0].offset == 0u && batches.ranges[0].size == 160u);
+    ASSERT(batches.ranges[1].dstBuffer == 10u && batches.ranges[1].offset == 256u);
+    ASSERT(batches.ranges[2].dstBuffer == 20u);
+}
+
+static void testBufferCopyOverlap()
+{
+    BufferCopyBatches batches;
+    BufferCopyCommand copies[] =
+    {
+        // Same uniform written twice, only the last one should remain.
+        sCopy(1u, 10u, 0u, 0u, 64u),
+        sCopy(1u, 10u, 64u, 0u, 64u),
+        // Later copy overwrites the middle of an earlier one, earlier one gets split.
+        sCopy(1u, 20u, 128u, 0u, 100u),
+        sCopy(2u, 20u, 0u, 40u, 20u),
+    };
+    batchBufferCopies(copies, ARRAYSIZES(copies), batches);
+
+    ASSERT(batches.batches.size() == 3u);
+    ASSERT(batches.batches[0].dstBuffer == 10u && batches.batches[0].regionCount == 1u);
+    ASSERT(sRegionEquals(batches.regions[batches.batches[0].firstRegion], 64u, 0u, 64u));
+
+    ASSERT(batches.batches[1].srcBuffer == 1u && batches.batches[1].dstBuffer == 20u);
+    ASSERT(batches.batches[1].regionCount == 2u);
+    ASSERT(sRegionEquals(batches.regions[batches.batches[1].firstRegion], 128u, 0u, 40u));
+    ASSERT(sRegionEquals(batches.regions[batches.batches[1].firstRegion + 1u], 188u, 60u, 40u));
+
+    ASSERT(batches.batches[2].srcBuffer == 2u && batches.batches[2].dstBuffer == 20u);
+    ASSERT(sRegionEquals(batches.regions[batches.batches[2].firstRegion], 0u, 40u, 20u));
+
+    // Pieces from two sources cover 0 to 100 together, one barrier.
+    ASSERT(batches.ranges.size() == 2u);
+    ASSERT(batches.ranges[1].dstBuffer == 20u && batches.ranges[1].offset == 0u && batches.ranges[1].size == 100u);
+}
+
+// Random copies applied to byte arrays in order and through the batches have to give the same result.
+static void testBufferCopyRandom()
+{
+    static constexpr u32 SrcBufferCount = 3u;
+    static constexpr u32 DstBufferCount = 4u;
+    static constexpr u32 BufferSize = 512u;
+
+    u8 srcData[SrcBufferCount][BufferSize];
+    for(u32 i = 0; i < SrcBufferCount; ++i)
+        for(u32 j = 0; j < BufferSize; ++j)
+            srcData[i][j] = u8(i * 71u + j * 13u + 1u);
+
+    BufferCopyBatches batches;
+    PodVector<BufferCopyCommand> copies;
+    u32 seed = 7u;
+    u32 copiesBefore = 0u;
+    u32 copiesAfter = 0u;
+    for(u32 round = 0; round < 200u; ++round)
+    {
+        u8 expected[DstBufferCount][BufferSize] = {};
+        u8 batched[DstBufferCount][BufferSize] = {};
+
+        copies.clear();
+        u32 copyCount = 1u + round % 40u;
+        for(u32 i = 0; i < copyCount; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            u64 size = 1u + (seed >> 8) % 64u;
+            u64 srcOffset = (seed >> 16) % (BufferSize - size);
+            // Mostly continuing the previous copy, so merging gets exercised too.
+            u64 dstOffset = (seed >> 4) % (BufferSize - size);
+            if(i > 0u && (seed & 3u) != 0u)
+            {
+                const BufferCopyCommand &prev = copies.back();
+                if(prev.dstOffset + prev.size + size <= BufferSize && prev.srcOffset + prev.size + size <= BufferSize)
+                {
+                    dstOffset = prev.dstOffset + prev.size;
+                    srcOffset = prev.srcOffset + prev.size;
+                }
+            }
+            copies.pushBack(sCopy((seed >> 24) % SrcBufferCount, (seed >> 20) % DstBufferCount,
+                srcOffset, dstOffset, size));
+        }
+
+        for(const BufferCopyCommand &copy : copies)
+            for(u64 j = 0; j < copy.size; ++j)
+                expected[copy.dstBuffer][copy.dstOffset + j] = srcData[copy.srcBuffer][copy.srcOffset + j];
+
+        batchBufferCopies(copies.data(), copies.size(), batches);
+        for(const BufferCopyBatch &batch : batches.batches)
+        {
+            for(u32 r = 0; r < batch.regionCount; ++r)
+            {
+                const BufferCopyRegion &region = batches.regions[batch.firstRegion + r];
+                for(u64 j = 0; j < region.size; ++j)
+                {
+                    // Regions of one destination never overlap.
+                    ASSERT(batched[batch.dstBuffer][region.dstOffset + j] == 0u);
+                    batched[batch.dstBuffer][region.dstOffset + j] = srcData[batch.srcBuffer][region.srcOffset + j];
+                }
+            }
+        }
+        for(u32 i = 0; i < DstBufferCount; ++i)
+            ASSERT(Supa::memcmp(expected[i], batched[i], BufferSize) == 0);
+
+        // Every written byte is inside some barrier range.
+        for(const BufferCopyCommand &copy : copies)
+        {
+            bool inRange = false;
+            for(const BufferCopyRange &range : batches.ranges)
+                inRange |= range.dstBuffer == copy.dstBuffer && range.offset <= copy.dstOffset
+                    && copy.dstOffset + copy.size <= range.offset + range.size;
+            ASSERT(inRange);
+        }
+        copiesBefore += copies.size();
+        copiesAfter += batches.batches.size();
+    }
+    printf("Buffer copy batching: %u copies became %u copy commands\n", copiesBefore, copiesAfter);
+}
+
+void testBufferCopyBatch()
+{
+    testBufferCopyMerge();
+    testBufferCopyOverlap();
+    testBufferCopyRandom();
+}
@@ -0,0 +1,227 @@
+#include "testfuncs.h"
+
+#include <container/podvector.h>
+
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <math/bounds_inline_functions.h>
+#include <math/hitpoint.h>
+#include <math/quaternion_inline_functions.h>
+#include <math/ray.h>
+#include <math/vector3_inline_functions.h>
+
+#include <scene/dynamicbvh.h>
+
+// FLT_MAX
+#include <float.h>
+#include <stdlib.h>
+
+static float sRandomFloat(float minValue, float maxValue)
+{
+    return minValue + (maxValue - minValue) * float(rand()) / float(RAND_MAX);
+}
+
+static Vec3 sRandomVec(float minValue, float maxValue)
+{
+    return Vec3(sRandomFloat(minValue, maxValue), sRandomFloat(minValue, maxValue), sRandomFloat(minValue, maxValue));
+}
+
+static Ray sRandomRay(float worldSize)
+{
+    Vec3 pos = sRandomVec(-worldSize, worldSize);
+    Vec3 target = sRandomVec(-worldSize, worldSize);
+    return Ray(pos, normalize(target - pos));
+}
+
+// Random entities with oriented boxes, similar to what scene has.
+static void sCreateEntities(u32 count, float worldSize, PodVector<Transform> &outTransforms, PodVector<Bounds> &outWorldBounds)
+{
+    const Bounds localBounds{ .min = Vec3(-0.5f, 0.0f, -0.5f), .max = Vec3(0.5f, 2.0f, 0.5f) };
+    outTransforms.clear();
+    outWorldBounds.clear();
+    for(u32 i = 0; i < count; ++i)
+    {
+        Transform transform;
+        transform.pos = sRandomVec(-worldSize, worldSize);
+        transform.rot = getQuaternionFromAxisAngle(normalize(sRandomVec(-1.0f, 1.0f)), sRandomFloat(0.0f, 6.0f));
+        transform.scale = sRandomVec(0.5f, 2.0f);
+        outTransforms.pushBack(transform);
+        outWorldBounds.pushBack(getWorldBounds(localBounds, transform));
+    }
+}
+
+static u32 sCastRayLinear(const Ray &ray, const Bounds &localBounds, const PodVector<Transform> &transforms,
+    float &closestDist)
+{
+    u32 result = ~0u;
+    closestDist = FLT_MAX;
+    for(u32 i = 0; i < transforms.size(); ++i)
+    {
+        HitPoint hitpoint{ Uninit };
+        if(rayOOBBBoundsIntersect(ray, localBounds, transforms[i], hitpoint) && hitpoint.distance < closestDist)
+        {
+            closestDist = hitpoint.distance;
+            result = i;
+        }
+    }
+    return result;
+}
+
+static u32 sCastRayBvh(const Ray &ray, const Bounds &localBounds, const PodVector<Transform> &transforms,
+    const DynamicBvh &bvh, PodVector<BvhRayCandidate> &candidates, float &closestDist)
+{
+    u32 result = ~0u;
+    closestDist = FLT_MAX;
+    bvh.rayQuery(ray, FLT_MAX, candidates);
+    for(const auto &candidate : candidates)
+    {
+        if(candidate.distance > closestDist)
+            break;
+        HitPoint hitpoint{ Uninit };
+        if(rayOOBBBoundsIntersect(ray, localBounds, transforms[candidate.userIndex], hitpoint) && hitpoint.distance < closestDist)
+        {
+            closestDist = hitpoint.distance;
+            result = candidate.userIndex;
+        }
+    }
+    return result;
+}
+
+static void testBvhQueries()
+{
+    const u32 entityCount = 2000u;
+    const float worldSize = 100.0f;
+    const Bounds localBounds{ .min = Vec3(-0.5f, 0.0f, -0.5f), .max = Vec3(0.5f, 2.0f, 0.5f) };
+
+    PodVector<Transform> transforms;
+    PodVector<Bounds> worldBounds;
+    sCreateEntities(entityCount, worldSize, transforms, worldBounds);
+
+    DynamicBvh bvh;
+    PodVector<u32> proxies;
+    for(u32 i = 0; i < entityCount; ++i)
+        proxies.pushBack(bvh.insertProxy(worldBounds[i], i));
+    ASSERT(bvh.validate());
+    ASSERT(bvh.getProxyCount() == entityCount);
+
+    // Small moves stay inside fat bounds, large ones reinsert.
+    for(u32 i = 0; i < entityCount; i += 3)
+    {
+        Vec3 move = sRandomVec(-5.0f, 5.0f);
+        transforms[i].pos = transforms[i].pos + move;
+        worldBounds[i] = getWorldBounds(localBounds, transforms[i]);
+        bvh.moveProxy(proxies[i], worldBounds[i]);
+    }
+    {
+        Bounds bounds = worldBounds[1];
+        ASSERT(!bvh.moveProxy(proxies[1], bounds));
+    }
+    ASSERT(bvh.validate());
+
+    PodVector<BvhRayCandidate> candidates;
+    PodVector<u32> results;
+    for(u32 i = 0; i < 200; ++i)
+    {
+        Ray ray = sRandomRay(worldSize);
+        // Compare distances, rays starting inside several boxes can pick any of them.
+        float linearDist = 0.0f;
+        float bvhDist = 0.0f;
+        u32 linearHit = sCastRayLinear(ray, localBounds, transforms, linearDist);
+        u32 bvhHit = sCastRayBvh(ray, localBounds, transforms, bvh, candidates, bvhDist);
+        ASSERT((linearHit == ~0u) == (bvhHit == ~0u));
+        ASSERT(linearDist == bvhDist);
+
+        for(u32 j = 1; j < candidates.size(); ++j)
+            ASSERT(candidates[j - 1].distance <= candidates[j].distance);
+
+        Vec3 pos = sRandomVec(-worldSize, worldSize);
+        Bounds queryBounds{ .min = pos - 10.0f, .max = pos + 10.0f };
+        bvh.overlapQuery(queryBounds, results);
+        u32 overlapCount = 0u;
+        for(u32 j = 0; j < entityCount; ++j)
+        {
+            if(boundsOverlap(worldBounds[j], queryBounds))
+                ++overlapCount;
+        }
+        ASSERT(overlapCount == results.size());
+
+        // No entity outside the result can be closer than the furthest one found.
+        const u32 nearestCount = 8u;
+        bvh.nearestQuery(pos, nearestCount, results);
+        ASSERT(results.size() == nearestCount);
+        float furthest = 0.0f;
+        for(u32 j = 0; j < results.size(); ++j)
+        {
+            float dist = sqrDistanceToBounds(pos, worldBounds[results[j]]);
+            ASSERT(dist >= furthest);
+            furthest = dist;
+        }
+        u32 closerCount = 0u;
+        for(u32 j = 0; j < entityCount; ++j)
+        {
+            if(sqrDistanceToBounds(pos, worldBounds[j]) < furthest)
+                ++closerCount;
+        }
+        ASSERT(closerCount < nearestCount);
+    }
+
+    for(u32 i = 0; i < entityCount; i += 2)
+        bvh.removeProxy(proxies[i]);
+    ASSERT(bvh.validate());
+    ASSERT(bvh.getProxyCount() == entityCount / 2);
+
+    bvh.clear();
+    ASSERT(bvh.validate());
+    ASSERT(bvh.getProxyCount() == 0);
+}
+
+static void testBvhBenchmark(u32 entityCount)
+{
+    const u32 rayCount = 256u;
+    const float worldSize = 500.0f;
+    const Bounds localBounds{ .min = Vec3(-0.5f, 0.0f, -0.5f), .max = Vec3(0.5f, 2.0f, 0.5f) };
+
+    PodVector<Transform> transforms;
+    PodVector<Bounds> worldBounds;
+    sCreateEntities(entityCount, worldSize, transforms, worldBounds);
+
+    PodVector<Ray> rays;
+    for(u32 i = 0; i < rayCount; ++i)
+        rays.pushBack(sRandomRay(worldSize));
+
+    DynamicBvh bvh;
+    Timer buildTimer;
+    for(u32 i = 0; i < entityCount; ++i)
+        bvh.insertProxy(worldBounds[i], i);
+    double buildTime = buildTimer.getDuration();
+
+    float dist = 0.0f;
+    u32 linearHits = 0u;
+    Timer linearTimer;
+    for(const Ray &ray : rays)
+        linearHits += sCastRayLinear(ray, localBounds, transforms, dist) != ~0u ? 1 : 0;
+    double linearTime = linearTimer.getDuration();
+
+    u32 bvhHits = 0u;
+    PodVector<BvhRayCandidate> candidates;
+    Timer bvhTimer;
+    for(const Ray &ray : rays)
+        bvhHits += sCastRayBvh(ray, localBounds, transforms, bvh, candidates, dist) != ~0u ? 1 : 0;
+    double bvhTime = bvhTimer.getDuration();
+
+    ASSERT(linearHits == bvhHits);
+    printf("Bvh %u entities, height: %i, build: %fms, %u rays linear: %fms, bvh: %fms, speedup: %.1fx\n",
+        entityCount, bvh.getHeight(), buildTime * 1000.0, rayCount,
+        linearTime * 1000.0, bvhTime * 1000.0, linearTime / (bvhTime > 0.0 ? bvhTime : 1.0e-9));
+}
+
+void testBvh()
+{
+    srand(1234);
+    testBvhQueries();
+
+    testBvhBenchmark(1000u);
+    testBvhBenchmark(10000u);
+    testBvhBenchmark(100000u);
+}
@@ -0,0 +1,288 @@
+#include "testfuncs.h"
+
+#include <components/chunkstorage.h>
+#include <components/generated_components.h>
+#include <components/generated_systems.h>
+
+#include <container/bytebuffer.h>
+#include <core/general.h>
+
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+// Every entity gets transform, every third a camera, every other a matrix. Some get removed.
+template <typename EntitySystem>
+static void sCreateEntities(EntitySystem &entitySystem, u32 entityCount, u32 removeEvery)
+{
+    auto mtx = entitySystem.getLockedMutexHandle();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        EntitySystemHandle handle = entitySystem.addEntity(mtx);
+        entitySystem.addTransformComponent(handle, TransformComponent{ .position = Vector4{ float(i), 0, 0, 1 } });
+        if(i % 3 == 0)
+            entitySystem.addCameraComponent(handle, {});
+        if(i % 2 == 0)
+            entitySystem.addMat4Component(handle, {});
+    }
+    for(u32 i = 0; removeEvery > 0 && i < entityCount; i += removeEvery)
+        entitySystem.removeEntity(entitySystem.getEntitySystemHandle(i), mtx);
+    entitySystem.releaseLockedMutexHandle(mtx);
+    entitySystem.syncReadWrites();
+}
+
+static void testChunkStorageMoves()
+{
+    const u32 componentSizes[] = { sizeof(u32), sizeof(u64) };
+    ChunkStorage storage(componentSizes, 2u);
+
+    const u32 entityCount = 5000u;
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        storage.addEntity(i);
+        storage.setComponentMask(i, 1u);
+        *(u32 *)storage.getComponent(i, 0u) = i;
+        ASSERT(storage.getComponent(i, 1u) == nullptr);
+    }
+    ASSERT(storage.getArchetypeCount() == 2u);
+
+    // Adding a component keeps the old values and zeroes the new one.
+    for(u32 i = 0; i < entityCount; i += 2)
+    {
+        storage.setComponentMask(i, 3u);
+        ASSERT(*(const u64 *)storage.getComponent(i, 1u) == 0u);
+        *(u64 *)storage.getComponent(i, 1u) = u64(i) << 32u;
+    }
+    for(u32 i = 0; i < entityCount; i += 5)
+        storage.removeEntity(i);
+
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        if(i % 5 == 0)
+        {
+            ASSERT(storage.getComponentMask(i) == 0u);
+            ASSERT(storage.getComponent(i, 0u) == nullptr);
+            continue;
+        }
+        ASSERT(*(const u32 *)storage.getComponent(i, 0u) == i);
+        ASSERT(storage.getComponentMask(i) == (i % 2 == 0 ? 3u : 1u));
+        if(i % 2 == 0)
+            ASSERT(*(const u64 *)storage.getComponent(i, 1u) == u64(i) << 32u);
+    }
+
+    // Chunks are full except the last one of each archetype, and columns match entity indices.
+    u32 archetypeIndex = 0u;
+    u32 chunkIndex = 0u;
+    u32 chunkEntityCount = 0u;
+    u32 visitedCount = 0u;
+    while(storage.findNextChunk(1u, archetypeIndex, chunkIndex, chunkEntityCount))
+    {
+        const u32 *entityIndices = storage.getEntityIndices(archetypeIndex, chunkIndex);
+        const u32 *values = (const u32 *)storage.getColumn(archetypeIndex, chunkIndex, 0u);
+        ASSERT(((u64)values % ChunkStorage::ColumnAlignment) == 0u);
+        for(u32 i = 0; i < chunkEntityCount; ++i)
+            ASSERT(values[i] == entityIndices[i]);
+        visitedCount += chunkEntityCount;
+        ++chunkIndex;
+    }
+    ASSERT(visitedCount == entityCount - entityCount / 5u);
+}
+
+static void testChunkEntitySystemQuery()
+{
+    const u32 entityCount = 3000u;
+    const u32 removeEvery = 7u;
+    GameChunkEntitySystem chunkEnts;
+    sCreateEntities(chunkEnts, entityCount, removeEvery);
+
+    auto cameraBuilder = chunkEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent)
+        .addComponent(ComponentType::CameraComponent);
+
+    for(u32 maxBatchCount : { ~0u, 16u })
+    {
+        const auto &rwHandle = chunkEnts.getRWHandle(cameraBuilder, {});
+        auto query = chunkEnts.getQuery(rwHandle, maxBatchCount);
+        GameChunkEntitySystem::GameChunkEntitySystemQueryBatch batch;
+        u32 visitedCount = 0u;
+        while(query.nextBatch(batch))
+        {
+            ASSERT(batch.count > 0 && batch.count <= maxBatchCount);
+            ASSERT(batch.Mat4ComponentReadArray == nullptr);
+            for(u32 i = 0; i < batch.count; ++i)
+            {
+                u32 entityIndex = batch.entityIndices[i];
+                ASSERT(entityIndex % removeEvery != 0 && entityIndex % 3 == 0);
+                ASSERT(chunkEnts.hasComponents(entityIndex, cameraBuilder));
+                ASSERT(batch.TransformComponentReadArray[i].position.x == float(entityIndex));
+            }
+            visitedCount += batch.count;
+        }
+
+        u32 expectedCount = 0u;
+        for(u32 i = 0; i < entityCount; i += 3)
+            expectedCount += i % removeEvery != 0 ? 1u : 0u;
+        ASSERT(visitedCount == expectedCount);
+        chunkEnts.syncReadWrites();
+    }
+
+    // Removing a component moves the entity out of the queried archetypes.
+    {
+        auto mtx = chunkEnts.getLockedMutexHandle();
+        EntitySystemHandle handle = chunkEnts.getEntitySystemHandle(3u);
+        ASSERT(chunkEnts.removeCameraComponent(handle));
+        ASSERT(!chunkEnts.removeCameraComponent(handle));
+        ASSERT(chunkEnts.hasComponent(handle, ComponentType::TransformComponent));
+        chunkEnts.releaseLockedMutexHandle(mtx);
+        chunkEnts.syncReadWrites();
+
+        const auto &rwHandle = chunkEnts.getRWHandle(cameraBuilder, {});
+        auto query = chunkEnts.getQuery(rwHandle);
+        GameChunkEntitySystem::GameChunkEntitySystemQueryBatch batch;
+        while(query.nextBatch(batch))
+        {
+            for(u32 i = 0; i < batch.count; ++i)
+                ASSERT(batch.entityIndices[i] != 3u);
+        }
+        chunkEnts.syncReadWrites();
+    }
+}
+
+static void testChunkEntitySystemBinary()
+{
+    const u32 entityCount = 3000u;
+    GameChunkEntitySystem source;
+    sCreateEntities(source, entityCount, 7u);
+
+    ByteBuffer buffer(1, BufferType::PODVECTOR);
+    ASSERT(source.serializeBinary(buffer));
+
+    GameChunkEntitySystem loaded;
+    u32 readOffset = 0u;
+    auto mtx = loaded.getLockedMutexHandle();
+    ASSERT(loaded.deserializeBinary(buffer, readOffset, mtx));
+    loaded.releaseLockedMutexHandle(mtx);
+    loaded.syncReadWrites();
+    ASSERT(readOffset == buffer.getSize());
+    ASSERT(loaded.getEntityCount() == entityCount);
+
+    auto transformBuilder = loaded.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+    const auto &rwHandle = loaded.getRWHandle(transformBuilder, {});
+    auto query = loaded.getQuery(rwHandle);
+    GameChunkEntitySystem::GameChunkEntitySystemQueryBatch batch;
+    u32 visitedCount = 0u;
+    while(query.nextBatch(batch))
+    {
+        for(u32 i = 0; i < batch.count; ++i)
+        {
+            u32 entityIndex = batch.entityIndices[i];
+            ASSERT(entityIndex % 7u != 0u);
+            ASSERT(batch.TransformComponentReadArray[i].position.x == float(entityIndex));
+            ASSERT(source.getComponentsReadArray()[entityIndex] == loaded.getComponentsReadArray()[entityIndex]);
+        }
+        visitedCount += batch.count;
+    }
+    ASSERT(visitedCount == entityCount - (entityCount + 6u) / 7u);
+    loaded.syncReadWrites();
+
+    // Free indices out of range, repeated or pointing to entities with components fail
+    // without adding anything.
+    BinarySnapshotHeader header;
+    Supa::memcpy(&header, buffer.getBegin(), sizeof(header));
+    ASSERT(header.freeEntityIndexCount >= 2u);
+    u8 *freeIndexData = buffer.getBegin() + sizeof(header) + u64(entityCount) * (sizeof(u16) + sizeof(u64));
+    u32 firstFreeIndex = 0u;
+    Supa::memcpy(&firstFreeIndex, freeIndexData, sizeof(u32));
+    const u32 badFreeIndices[] = { entityCount, firstFreeIndex, 1u };
+    for(u32 badFreeIndex : badFreeIndices)
+    {
+        Supa::memcpy(freeIndexData + sizeof(u32), &badFreeIndex, sizeof(u32));
+        GameChunkEntitySystem corrupted;
+        readOffset = 0u;
+        mtx = corrupted.getLockedMutexHandle();
+        ASSERT(!corrupted.deserializeBinary(buffer, readOffset, mtx));
+        ASSERT(readOffset == 0u && corrupted.getEntityCount() == 0u);
+        corrupted.releaseLockedMutexHandle(mtx);
+    }
+}
+
+template <typename EntitySystem, typename QueryBatch>
+static double sBenchmarkIteration(EntitySystem &entitySystem, u32 frameCount)
+{
+    auto writeBuilder = entitySystem.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+
+    Timer timer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        const auto &rwHandle = entitySystem.getRWHandle({}, writeBuilder);
+        auto query = entitySystem.getQuery(rwHandle);
+        QueryBatch batch;
+        while(query.nextBatch(batch))
+        {
+            TransformComponent *transforms = batch.TransformComponentWriteArray;
+            for(u32 i = 0; i < batch.count; ++i)
+                transforms[i].position.x += transforms[i].scale.x * 0.01f;
+        }
+        entitySystem.syncReadWrites();
+    }
+    return timer.getDuration();
+}
+
+// Toggles camera component on every third entity, once off and once back on.
+template <typename EntitySystem>
+static double sBenchmarkAddRemove(EntitySystem &entitySystem, u32 entityCount)
+{
+    Timer timer;
+    auto mtx = entitySystem.getLockedMutexHandle();
+    for(u32 i = 0; i < entityCount; i += 3)
+        entitySystem.removeCameraComponent(entitySystem.getEntitySystemHandle(i));
+    for(u32 i = 0; i < entityCount; i += 3)
+    {
+        if(entitySystem.hasComponent(i, ComponentType::TransformComponent))
+            entitySystem.addCameraComponent(entitySystem.getEntitySystemHandle(i), {});
+    }
+    entitySystem.releaseLockedMutexHandle(mtx);
+    entitySystem.syncReadWrites();
+    return timer.getDuration();
+}
+
+static void testChunkStorageBenchmark()
+{
+    const u32 entityCount = 100000u;
+    const u32 frameCount = 20u;
+
+    GameEntitySystem arrayEnts;
+    GameChunkEntitySystem chunkEnts;
+
+    Timer arrayCreateTimer;
+    sCreateEntities(arrayEnts, entityCount, 5u);
+    double arrayCreateTime = arrayCreateTimer.getDuration();
+
+    Timer chunkCreateTimer;
+    sCreateEntities(chunkEnts, entityCount, 5u);
+    double chunkCreateTime = chunkCreateTimer.getDuration();
+
+    double arrayIterateTime = sBenchmarkIteration<GameEntitySystem,
+        GameEntitySystem::GameEntitySystemQueryBatch>(arrayEnts, frameCount);
+    double chunkIterateTime = sBenchmarkIteration<GameChunkEntitySystem,
+        GameChunkEntitySystem::GameChunkEntitySystemQueryBatch>(chunkEnts, frameCount);
+
+    double arrayAddRemoveTime = sBenchmarkAddRemove(arrayEnts, entityCount);
+    double chunkAddRemoveTime = sBenchmarkAddRemove(chunkEnts, entityCount);
+
+    printf("Entity storage %u entities, create: arrays %fms, chunks %fms\n",
+        entityCount, arrayCreateTime * 1000.0, chunkCreateTime * 1000.0);
+    printf("Entity storage %u frames transform iteration: arrays %fms, chunks %fms\n",
+        frameCount, arrayIterateTime * 1000.0, chunkIterateTime * 1000.0);
+    printf("Entity storage camera remove + add: arrays %fms, chunks %fms\n",
+        arrayAddRemoveTime * 1000.0, chunkAddRemoveTime * 1000.0);
+}
+
+void testChunkStorage()
+{
+    testChunkStorageMoves();
+    testChunkEntitySystemQuery();
+    testChunkEntitySystemBinary();
+    testChunkStorageBenchmark();
+}
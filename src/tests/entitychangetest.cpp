@@ -0,0 +1,180 @@
+#include "testfuncs.h"
+
+#include <components/generated_components.h>
+#include <components/generated_systems.h>
+
+#include <container/string.h>
+#include <container/stringview.h>
+
+#include <core/json.h>
+#include <core/mytypes.h>
+#include <core/writejson.h>
+
+template <typename EntitySystem>
+static void sAddEntities(EntitySystem &entitySystem, u32 entityCount)
+{
+    auto mtx = entitySystem.getLockedMutexHandle();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        EntitySystemHandle handle = entitySystem.addEntity(mtx);
+        entitySystem.addTransformComponent(handle, TransformComponent{ .position = Vector4{ float(i), 0, 0, 1 } });
+        if(i % 2 == 0)
+            entitySystem.addMat4Component(handle, {});
+    }
+    entitySystem.releaseLockedMutexHandle(mtx);
+    entitySystem.syncReadWrites();
+}
+
+// Returns count of entities written to delta and how many of them were removed.
+template <typename EntitySystem>
+static u32 sCountDeltaEntities(const EntitySystem &entitySystem, u32 sinceSyncIndex, u32 &outRemovedCount)
+{
+    WriteJson writeJson(1, 1);
+    ASSERT(entitySystem.serializeDelta(writeJson, sinceSyncIndex));
+    writeJson.finishWrite();
+
+    JsonBlock json;
+    const String &strJson = writeJson.getString();
+    ASSERT(json.parseJson(StringView(strJson.data(), strJson.size())));
+
+    u32 entityCount = 0u;
+    outRemovedCount = 0u;
+    for(const auto &entityJson : json.getChild(EntitySystem::entitySystemName).getChild("Entities"))
+    {
+        // Empty array parses into one empty child.
+        if(!entityJson.isObject())
+            continue;
+        bool removed = false;
+        ASSERT(entityJson.getChild("Removed").parseBool(removed));
+        outRemovedCount += removed ? 1u : 0u;
+        ++entityCount;
+    }
+    return entityCount;
+}
+
+static void testEntityChangeTrackingArrays()
+{
+    const u32 entityCount = 64u;
+    GameEntitySystem gameEnts;
+    gameEnts.setChangeTracking(true);
+    sAddEntities(gameEnts, entityCount);
+
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        ASSERT(gameEnts.getEntityChangeSyncIndex(i) == 0u);
+        ASSERT(gameEnts.getComponentChangeSyncIndex(i, 0u) == 0u);
+        ASSERT(gameEnts.getComponentChangeSyncIndex(i, 1u) == ~0u);
+    }
+
+    u32 sinceSyncIndex = gameEnts.getCurrentSyncIndex();
+    u32 removedCount = 0u;
+    ASSERT(sCountDeltaEntities(gameEnts, sinceSyncIndex, removedCount) == 0u);
+
+    // Ranged write array only marks the range.
+    auto transformBuilder = gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+    {
+        const auto &rwHandle = gameEnts.getRWHandle({}, transformBuilder);
+        TransformComponent *transforms = gameEnts.getTransformComponentWriteArray(rwHandle, 10u, 5u);
+        for(u32 i = 10u; i < 15u; ++i)
+            transforms[i].position.y = 1.0f;
+        gameEnts.syncReadWrites();
+    }
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        u32 expected = i >= 10u && i < 15u ? sinceSyncIndex : 0u;
+        ASSERT(gameEnts.getComponentChangeSyncIndex(i, 0u) == expected);
+    }
+    ASSERT(sCountDeltaEntities(gameEnts, sinceSyncIndex, removedCount) == 5u);
+
+    // Query batches mark only entities having the components.
+    u32 querySyncIndex = gameEnts.getCurrentSyncIndex();
+    {
+        auto matrixBuilder = gameEnts.getComponentArrayHandleBuilder()
+            .addComponent(ComponentType::Mat3x4Component);
+        const auto &rwHandle = gameEnts.getRWHandle({}, matrixBuilder);
+        auto query = gameEnts.getQuery(rwHandle, 3u);
+        GameEntitySystem::GameEntitySystemQueryBatch batch;
+        while(query.nextBatch(batch))
+            ;
+        gameEnts.syncReadWrites();
+    }
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        u32 expected = i % 2 == 0 ? querySyncIndex : ~0u;
+        ASSERT(gameEnts.getComponentChangeSyncIndex(i, 2u) == expected);
+    }
+    ASSERT(sCountDeltaEntities(gameEnts, querySyncIndex, removedCount) == entityCount / 2u);
+    ASSERT(sCountDeltaEntities(gameEnts, sinceSyncIndex, removedCount) == entityCount / 2u + 2u);
+
+    // Removed entities are written as removed.
+    u32 removeSyncIndex = gameEnts.getCurrentSyncIndex();
+    {
+        auto mtx = gameEnts.getLockedMutexHandle();
+        gameEnts.removeEntity(gameEnts.getEntitySystemHandle(3u), mtx);
+        gameEnts.removeEntity(gameEnts.getEntitySystemHandle(4u), mtx);
+        gameEnts.releaseLockedMutexHandle(mtx);
+        gameEnts.syncReadWrites();
+    }
+    ASSERT(sCountDeltaEntities(gameEnts, removeSyncIndex, removedCount) == 2u);
+    ASSERT(removedCount == 2u);
+
+    // Turned off, nothing gets marked.
+    gameEnts.setChangeTracking(false);
+    u32 offSyncIndex = gameEnts.getCurrentSyncIndex();
+    {
+        const auto &rwHandle = gameEnts.getRWHandle({}, transformBuilder);
+        ASSERT(gameEnts.getTransformComponentWriteArray(rwHandle) != nullptr);
+        gameEnts.syncReadWrites();
+    }
+    ASSERT(sCountDeltaEntities(gameEnts, offSyncIndex, removedCount) == 0u);
+}
+
+static void testEntityChangeTrackingChunks()
+{
+    const u32 entityCount = 64u;
+    GameChunkEntitySystem chunkEnts;
+    sAddEntities(chunkEnts, entityCount);
+
+    // Turning on afterwards, existing entities have no changes.
+    chunkEnts.setChangeTracking(true);
+    u32 sinceSyncIndex = chunkEnts.getCurrentSyncIndex();
+    ASSERT(chunkEnts.getEntityChangeSyncIndex(0u) == ~0u);
+    {
+        auto matrixBuilder = chunkEnts.getComponentArrayHandleBuilder()
+            .addComponent(ComponentType::Mat3x4Component);
+        const auto &rwHandle = chunkEnts.getRWHandle({}, matrixBuilder);
+        auto query = chunkEnts.getQuery(rwHandle);
+        GameChunkEntitySystem::GameChunkEntitySystemQueryBatch batch;
+        while(query.nextBatch(batch))
+            ;
+        chunkEnts.syncReadWrites();
+    }
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        u32 expected = i % 2 == 0 ? sinceSyncIndex : ~0u;
+        ASSERT(chunkEnts.getComponentChangeSyncIndex(i, 2u) == expected);
+        ASSERT(chunkEnts.getComponentChangeSyncIndex(i, 0u) == ~0u);
+    }
+
+    u32 removedCount = 0u;
+    ASSERT(sCountDeltaEntities(chunkEnts, sinceSyncIndex, removedCount) == entityCount / 2u);
+
+    // Removing a component changes the entity.
+    u32 removeSyncIndex = chunkEnts.getCurrentSyncIndex();
+    {
+        auto mtx = chunkEnts.getLockedMutexHandle();
+        ASSERT(chunkEnts.removeMat4Component(chunkEnts.getEntitySystemHandle(2u)));
+        chunkEnts.releaseLockedMutexHandle(mtx);
+        chunkEnts.syncReadWrites();
+    }
+    ASSERT(chunkEnts.getEntityChangeSyncIndex(2u) == removeSyncIndex);
+    ASSERT(sCountDeltaEntities(chunkEnts, removeSyncIndex, removedCount) == 1u);
+    ASSERT(removedCount == 0u);
+}
+
+void testEntityChangeTracking()
+{
+    testEntityChangeTrackingArrays();
+    testEntityChangeTrackingChunks();
+}
@@ -0,0 +1,168 @@
+#include "testfuncs.h"
+
+#include <components/generated_components.h>
+#include <components/generated_systems.h>
+
+#include <core/jobsystem.h>
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <stdio.h>
+
+static constexpr u32 CommandJobCount = 16u;
+
+template <typename EntitySystem>
+struct CommandTestData
+{
+    EntitySystem *entitySystem = nullptr;
+    u32 entitiesPerJob = 0u;
+};
+
+static float sGetSpawnValue(u32 jobIndex, u32 spawnIndex)
+{
+    return float(jobIndex * 1000u + spawnIndex);
+}
+
+// Every job spawns entities, every other one with matrix, sort key is the job index.
+template <typename EntitySystem>
+static void sSpawnJob(void *jobData, u32 jobIndex)
+{
+    CommandTestData<EntitySystem> &data = *(CommandTestData<EntitySystem> *)jobData;
+    for(u32 i = 0; i < data.entitiesPerJob; ++i)
+    {
+        DeferredEntityHandle deferred = data.entitySystem->deferAddEntity(jobIndex);
+        TransformComponent transform;
+        transform.position.x = sGetSpawnValue(jobIndex, i);
+        data.entitySystem->deferAddTransformComponent(deferred, transform, jobIndex);
+        if(i % 2 == 0)
+            data.entitySystem->deferAddMat4Component(deferred, {}, jobIndex);
+    }
+}
+
+// Removes every third existing entity of the job range, and one entity spawned and removed in the same job.
+template <typename EntitySystem>
+static void sDespawnJob(void *jobData, u32 jobIndex)
+{
+    CommandTestData<EntitySystem> &data = *(CommandTestData<EntitySystem> *)jobData;
+    for(u32 i = 0; i < data.entitiesPerJob; i += 3u)
+    {
+        u32 entityIndex = jobIndex * data.entitiesPerJob + i;
+        data.entitySystem->deferRemoveEntity(data.entitySystem->getEntitySystemHandle(entityIndex), jobIndex);
+    }
+    DeferredEntityHandle deferred = data.entitySystem->deferAddEntity(jobIndex);
+    data.entitySystem->deferRemoveEntity(deferred, jobIndex);
+}
+
+template <typename EntitySystem>
+static void sRunJobs(EntitySystem &entitySystem, u32 workerCount, u32 entitiesPerJob, JobFunc func)
+{
+    JobSystem jobSystem;
+    ASSERT(jobSystem.init(workerCount));
+    entitySystem.setCommandJobSystem(&jobSystem);
+
+    CommandTestData<EntitySystem> data { .entitySystem = &entitySystem, .entitiesPerJob = entitiesPerJob };
+    JobCounter counter;
+    jobSystem.addJobs(func, &data, CommandJobCount, counter);
+    jobSystem.waitForCounter(counter);
+    jobSystem.deinit();
+    entitySystem.setCommandJobSystem(nullptr);
+
+    ASSERT(entitySystem.syncReadWrites());
+}
+
+template <typename EntitySystem, typename QueryBatch>
+static void testEntityCommandsOrder(u32 workerCount)
+{
+    const u32 entitiesPerJob = 30u;
+    EntitySystem entitySystem;
+    sRunJobs(entitySystem, workerCount, entitiesPerJob, sSpawnJob<EntitySystem>);
+
+    // Applied in job index order no matter which thread ran the job.
+    ASSERT(entitySystem.getEntityCount() == CommandJobCount * entitiesPerJob);
+    auto transformBuilder = entitySystem.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+    {
+        const auto &rwHandle = entitySystem.getRWHandle(transformBuilder, {});
+        auto query = entitySystem.getQuery(rwHandle);
+        QueryBatch batch;
+        u32 foundCount = 0u;
+        while(query.nextBatch(batch))
+        {
+            for(u32 i = 0; i < batch.count; ++i)
+            {
+                u32 entityIndex = batch.entityIndices ? batch.entityIndices[i] : batch.startIndex + i;
+                float expected = sGetSpawnValue(entityIndex / entitiesPerJob, entityIndex % entitiesPerJob);
+                ASSERT(batch.TransformComponentReadArray[i].position.x == expected);
+                ASSERT(entitySystem.hasComponent(entityIndex, ComponentType::Mat3x4Component) == (entityIndex % 2 == 0));
+                ++foundCount;
+            }
+        }
+        ASSERT(foundCount == CommandJobCount * entitiesPerJob);
+        entitySystem.syncReadWrites();
+    }
+
+    // Entity added and removed in same job ends up removed, freeing index for the next adds.
+    sRunJobs(entitySystem, workerCount, entitiesPerJob, sDespawnJob<EntitySystem>);
+    u32 aliveCount = 0u;
+    for(u32 i = 0; i < entitySystem.getEntityCount(); ++i)
+    {
+        if(entitySystem.hasComponent(i, ComponentType::TransformComponent))
+        {
+            ASSERT(i % entitiesPerJob % 3u != 0u);
+            ++aliveCount;
+        }
+    }
+    ASSERT(aliveCount == CommandJobCount * (entitiesPerJob - entitiesPerJob / 3u));
+}
+
+static void sMutexSpawnJob(void *jobData, u32 jobIndex)
+{
+    CommandTestData<GameEntitySystem> &data = *(CommandTestData<GameEntitySystem> *)jobData;
+    for(u32 i = 0; i < data.entitiesPerJob; ++i)
+    {
+        TransformComponent transform;
+        transform.position.x = sGetSpawnValue(jobIndex, i);
+        auto mtx = data.entitySystem->getLockedMutexHandle();
+        EntitySystemHandle handle = data.entitySystem->addEntity(mtx);
+        data.entitySystem->addTransformComponent(handle, transform);
+        if(i % 2 == 0)
+            data.entitySystem->addMat4Component(handle, {});
+        data.entitySystem->releaseLockedMutexHandle(mtx);
+    }
+}
+
+static void testEntityCommandsBenchmark()
+{
+    const u32 entitiesPerJob = 4000u;
+    u32 workerCount = JobSystem::getHardwareThreadCount();
+
+    double mutexTime = 0.0;
+    {
+        GameEntitySystem gameEnts;
+        Timer timer;
+        sRunJobs(gameEnts, workerCount, entitiesPerJob, sMutexSpawnJob);
+        mutexTime = timer.getDuration();
+    }
+
+    double deferredTime = 0.0;
+    {
+        GameEntitySystem gameEnts;
+        Timer timer;
+        sRunJobs(gameEnts, workerCount, entitiesPerJob, sSpawnJob<GameEntitySystem>);
+        deferredTime = timer.getDuration();
+    }
+
+    printf("Entity commands %u entities, %u workers: locked mutex per add: %fms, deferred commands: %fms\n",
+        CommandJobCount * entitiesPerJob, workerCount, mutexTime * 1000.0, deferredTime * 1000.0);
+}
+
+void testEntityCommands()
+{
+    const u32 workerCounts[] = { 0u, 4u };
+    for(u32 workerCount : workerCounts)
+    {
+        testEntityCommandsOrder<GameEntitySystem, GameEntitySystem::GameEntitySystemQueryBatch>(workerCount);
+        testEntityCommandsOrder<GameChunkEntitySystem, GameChunkEntitySystem::GameChunkEntitySystemQueryBatch>(workerCount);
+    }
+    testEntityCommandsBenchmark();
+}
@@ -0,0 +1,179 @@
+#include "testfuncs.h"
+
+#include <components/generated_components.h>
+#include <components/generated_systems.h>
+
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+// Every entity gets transform, every third a camera, every other a matrix. Some get removed.
+static void sCreateEntities(GameEntitySystem &gameEnts, u32 entityCount, u32 removeEvery)
+{
+    auto mtx = gameEnts.getLockedMutexHandle();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        EntitySystemHandle handle = gameEnts.addEntity(mtx);
+        gameEnts.addTransformComponent(handle, TransformComponent{ .position = Vector4{ float(i), 0, 0, 1 } });
+        if(i % 3 == 0)
+            gameEnts.addCameraComponent(handle, {});
+        if(i % 2 == 0)
+            gameEnts.addMat4Component(handle, {});
+    }
+    for(u32 i = 0; removeEvery > 0 && i < entityCount; i += removeEvery)
+        gameEnts.removeEntity(gameEnts.getEntitySystemHandle(i), mtx);
+    gameEnts.releaseLockedMutexHandle(mtx);
+    gameEnts.syncReadWrites();
+}
+
+static void sCheckQuery(GameEntitySystem &gameEnts, u32 removeEvery,
+    const GameEntitySystem::GameEntitySystemComponentArrayHandleBuilder &readBuilder, u32 maxBatchCount)
+{
+    const auto &rwHandle = gameEnts.getRWHandle(readBuilder, {});
+    const TransformComponent *transforms = gameEnts.getTransformComponentReadArray(rwHandle);
+
+    u32 expectedIndex = 0u;
+    auto findNextExpected = [&]()
+    {
+        while(expectedIndex < gameEnts.getEntityCount())
+        {
+            bool removed = removeEvery > 0 && expectedIndex % removeEvery == 0;
+            if(!removed && gameEnts.hasComponents(expectedIndex, readBuilder))
+                break;
+            ++expectedIndex;
+        }
+    };
+
+    auto query = gameEnts.getQuery(rwHandle, maxBatchCount);
+    GameEntitySystem::GameEntitySystemQueryBatch batch;
+    u32 lastEnd = ~0u;
+    while(query.nextBatch(batch))
+    {
+        ASSERT(batch.count > 0 && batch.count <= maxBatchCount);
+        ASSERT(batch.TransformComponentReadArray == transforms + batch.startIndex);
+        ASSERT(batch.TransformComponentWriteArray == nullptr);
+        // Runs are as long as possible unless limited by maxBatchCount.
+        ASSERT(lastEnd != batch.startIndex || maxBatchCount != ~0u);
+        for(u32 i = 0; i < batch.count; ++i)
+        {
+            findNextExpected();
+            ASSERT(expectedIndex == batch.startIndex + i);
+            ASSERT(batch.TransformComponentReadArray[i].position.x == float(expectedIndex));
+            ++expectedIndex;
+        }
+        lastEnd = batch.startIndex + batch.count;
+    }
+    findNextExpected();
+    ASSERT(expectedIndex == gameEnts.getEntityCount());
+    gameEnts.syncReadWrites();
+}
+
+static void testEntityQueryBatches()
+{
+    const u32 entityCount = 1000u;
+    const u32 removeEvery = 7u;
+    GameEntitySystem gameEnts;
+    sCreateEntities(gameEnts, entityCount, removeEvery);
+
+    auto transformBuilder = gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+    auto cameraBuilder = gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent)
+        .addComponent(ComponentType::CameraComponent);
+    auto allBuilder = gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent)
+        .addComponent(ComponentType::CameraComponent)
+        .addComponent(ComponentType::Mat3x4Component);
+
+    sCheckQuery(gameEnts, removeEvery, transformBuilder, ~0u);
+    sCheckQuery(gameEnts, removeEvery, transformBuilder, 4u);
+    sCheckQuery(gameEnts, removeEvery, cameraBuilder, ~0u);
+    sCheckQuery(gameEnts, removeEvery, allBuilder, ~0u);
+    sCheckQuery(gameEnts, removeEvery, allBuilder, 1u);
+
+    // Empty mask still skips removed entities.
+    {
+        const auto &rwHandle = gameEnts.getRWHandle({}, {});
+        auto query = gameEnts.getQuery(rwHandle);
+        GameEntitySystem::GameEntitySystemQueryBatch batch;
+        u32 aliveCount = 0u;
+        while(query.nextBatch(batch))
+        {
+            ASSERT(batch.TransformComponentReadArray == nullptr);
+            aliveCount += batch.count;
+        }
+        ASSERT(aliveCount == entityCount - (entityCount + removeEvery - 1) / removeEvery);
+        gameEnts.syncReadWrites();
+    }
+
+    // Reusing removed index makes it visible again.
+    {
+        auto mtx = gameEnts.getLockedMutexHandle();
+        EntitySystemHandle handle = gameEnts.addEntity(mtx);
+        ASSERT(handle.entityIndex % removeEvery == 0);
+        gameEnts.releaseLockedMutexHandle(mtx);
+        gameEnts.syncReadWrites();
+
+        const auto &rwHandle = gameEnts.getRWHandle({}, {});
+        auto query = gameEnts.getQuery(rwHandle);
+        GameEntitySystem::GameEntitySystemQueryBatch batch;
+        bool found = false;
+        while(query.nextBatch(batch))
+            found |= batch.startIndex <= handle.entityIndex && handle.entityIndex < batch.startIndex + batch.count;
+        ASSERT(found);
+        gameEnts.syncReadWrites();
+    }
+}
+
+static void testEntityQueryBenchmark()
+{
+    const u32 entityCount = 100000u;
+    const u32 frameCount = 20u;
+    GameEntitySystem gameEnts;
+    sCreateEntities(gameEnts, entityCount, 5u);
+
+    // Every fifth entity removed, so batches are 4 entities long.
+    auto writeBuilder = gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent);
+
+    // Old style, handle checked per entity.
+    Timer handleTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        const auto &rwHandle = gameEnts.getRWHandle({}, writeBuilder);
+        TransformComponent *transforms = gameEnts.getTransformComponentWriteArray(rwHandle);
+        u32 count = gameEnts.getEntityCount();
+        for(u32 i = 0; i < count; ++i)
+        {
+            if(!gameEnts.hasComponents(gameEnts.getEntitySystemHandle(i), writeBuilder))
+                continue;
+            transforms[i].position.x += transforms[i].scale.x * 0.01f;
+        }
+        gameEnts.syncReadWrites();
+    }
+    double handleTime = handleTimer.getDuration();
+
+    Timer queryTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        const auto &rwHandle = gameEnts.getRWHandle({}, writeBuilder);
+        auto query = gameEnts.getQuery(rwHandle);
+        GameEntitySystem::GameEntitySystemQueryBatch batch;
+        while(query.nextBatch(batch))
+        {
+            TransformComponent *transforms = batch.TransformComponentWriteArray;
+            for(u32 i = 0; i < batch.count; ++i)
+                transforms[i].position.x += transforms[i].scale.x * 0.01f;
+        }
+        gameEnts.syncReadWrites();
+    }
+    double queryTime = queryTimer.getDuration();
+
+    printf("Entity query %u entities, %u frames: per entity handle check: %fms, query batches: %fms\n",
+        entityCount, frameCount, handleTime * 1000.0, queryTime * 1000.0);
+}
+
+void testEntityQuery()
+{
+    testEntityQueryBatches();
+    testEntityQueryBenchmark();
+}
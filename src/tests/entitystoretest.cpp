@@ -0,0 +1,266 @@
+#include "testfuncs.h"
+
+#include <components/transform_functions.h>
+
+#include <container/podvector.h>
+
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <math/quaternion_inline_functions.h>
+#include <math/vector3_inline_functions.h>
+
+#include <scene/entitystore.h>
+
+#include <stdlib.h>
+
+static GameEntity sCreateEntity(u32 i)
+{
+    GameEntity entity;
+    entity.name = "Entity";
+    entity.transform.pos = Vec3(float(i % 100), 0.0f, float(i / 100));
+    entity.transform.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), float(i) * 0.01f);
+    entity.entityType = EntityType(i % u32(EntityType::NUM_OF_ENTITY_TYPES));
+    entity.animationIndex = i % 3u;
+    return entity;
+}
+
+static bool sIsAnimated(EntityType entityType)
+{
+    return entityType < EntityType::ARROW;
+}
+
+static void testEntityStoreColumns()
+{
+    EntityStore store;
+    PodVector<EntityHandle> handles;
+    for(u32 i = 0; i < 100; ++i)
+        handles.pushBack(store.addEntity(sCreateEntity(i)));
+    ASSERT(store.getEntityCount() == 100);
+
+    for(u32 i = 0; i < 100; ++i)
+    {
+        u32 entityIndex = store.getDenseIndex(handles[i]);
+        ASSERT(entityIndex == i);
+        ASSERT(store.getHandle(entityIndex) == handles[i]);
+
+        GameEntity entity = store.getEntity(entityIndex);
+        GameEntity expected = sCreateEntity(i);
+        ASSERT(entity.index == i);
+        ASSERT(entity.name == expected.name);
+        ASSERT(entity.entityType == expected.entityType);
+        ASSERT(entity.animationIndex == expected.animationIndex);
+        ASSERT(sqrLen(entity.transform.pos - expected.transform.pos) == 0.0f);
+        ASSERT(store.animationStates[i].entityType == expected.entityType);
+    }
+
+    GameEntity entity = store.getEntity(5);
+    entity.transform.pos = Vec3(1.0f, 2.0f, 3.0f);
+    entity.meshIndex = 2;
+    store.setEntity(5, entity);
+    ASSERT(store.transforms[5].pos.y == 2.0f);
+    ASSERT(store.meshIndices[5] == 2);
+
+    store.clear();
+    ASSERT(store.getEntityCount() == 0);
+    ASSERT(!store.isValidHandle(handles[0]));
+}
+
+static void testEntityStoreHandles()
+{
+    EntityStore store;
+    PodVector<EntityHandle> handles;
+    for(u32 i = 0; i < 10; ++i)
+        handles.pushBack(store.addEntity(sCreateEntity(i)));
+
+    // Last entity gets swapped into the hole, its handle still finds it.
+    ASSERT(store.removeEntity(handles[3]));
+    ASSERT(!store.removeEntity(handles[3]));
+    ASSERT(!store.isValidHandle(handles[3]));
+    ASSERT(store.getDenseIndex(handles[3]) == ~0u);
+    ASSERT(store.getEntityCount() == 9);
+    ASSERT(store.getDenseIndex(handles[9]) == 3);
+    ASSERT(store.transforms[3].pos.x == sCreateEntity(9).transform.pos.x);
+
+    for(u32 i = 0; i < 10; ++i)
+    {
+        if(i == 3)
+            continue;
+        u32 entityIndex = store.getDenseIndex(handles[i]);
+        ASSERT(entityIndex != ~0u);
+        ASSERT(store.entityTypes[entityIndex] == sCreateEntity(i).entityType);
+    }
+
+    // Slot gets reused with a new version, old handle stays invalid.
+    EntityHandle newHandle = store.addEntity(sCreateEntity(20));
+    ASSERT(newHandle.entityIndex == handles[3].entityIndex);
+    ASSERT(newHandle != handles[3]);
+    ASSERT(!store.isValidHandle(handles[3]));
+    ASSERT(store.getDenseIndex(newHandle) == 9);
+    ASSERT(store.getHandleCount() == 10);
+
+    // Removing the last one does not need a swap.
+    ASSERT(store.removeEntity(newHandle));
+    ASSERT(store.getEntityCount() == 9);
+    ASSERT(!store.isValidHandle(EntityHandle()));
+}
+
+// Same work as scene update does per entity before rendering, with entities as structs and as columns.
+static void testEntityStoreBenchmark()
+{
+    const u32 entityCount = 100000u;
+    const u32 frameCount = 20u;
+    const double deltaTime = 1.0 / 60.0;
+
+    PodVector<GameEntity> entities;
+    EntityStore store;
+    entities.uninitializedResize(entityCount);
+    store.reserve(entityCount);
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        entities[i] = sCreateEntity(i);
+        store.addEntity(sCreateEntity(i));
+    }
+
+    PodVector<Mat3x4> matrices;
+    matrices.uninitializedResize(entityCount);
+
+    Mat3x4 *RESTRICT outMatrices = matrices.data();
+
+    Timer structTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        GameEntity *RESTRICT entityData = entities.data();
+        for(u32 i = 0; i < entityCount; ++i)
+        {
+            GameEntity &entity = entityData[i];
+            if(entity.entityType >= EntityType::NUM_OF_ENTITY_TYPES)
+                continue;
+            if(sIsAnimated(entity.entityType))
+                entity.animationTime += deltaTime;
+            outMatrices[i] = getModelMatrix(entity.transform);
+        }
+    }
+    double structTime = structTimer.getDuration();
+
+    Timer columnTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        const EntityType *RESTRICT entityTypes = store.entityTypes.data();
+        const Transform *RESTRICT transforms = store.transforms.data();
+        double *RESTRICT animationTimes = store.animationTimes.data();
+        for(u32 i = 0; i < entityCount; ++i)
+        {
+            EntityType entityType = entityTypes[i];
+            if(entityType >= EntityType::NUM_OF_ENTITY_TYPES)
+                continue;
+            if(sIsAnimated(entityType))
+                animationTimes[i] += deltaTime;
+            outMatrices[i] = getModelMatrix(transforms[i]);
+        }
+    }
+    double columnTime = columnTimer.getDuration();
+
+    for(u32 i = 0; i < entityCount; ++i)
+        ASSERT(entities[i].animationTime == store.animationTimes[i]);
+
+    printf("Entity update %u entities, %u frames: struct: %fms, columns: %fms\n",
+        entityCount, frameCount, structTime * 1000.0, columnTime * 1000.0);
+}
+
+// Spawn and despawn random entities every frame, then update the live ones. Compared against
+// a free list where removed entities leave holes that every loop still has to step over.
+static void testEntityStoreChurnBenchmark()
+{
+    const u32 entityCount = 50000u;
+    const u32 churnCount = 1000u;
+    const u32 frameCount = 100u;
+
+    srand(4321);
+    EntityStore store;
+    store.reserve(entityCount);
+    PodVector<EntityHandle> handles;
+    handles.reserve(entityCount * 2);
+    for(u32 i = 0; i < entityCount; ++i)
+        handles.pushBack(store.addEntity(sCreateEntity(i)));
+
+    PodVector<GameEntity> holeEntities;
+    holeEntities.uninitializedResize(entityCount * 2);
+    PodVector<u32> holeFreeIndices;
+    holeFreeIndices.reserve(entityCount * 2);
+    PodVector<u32> holeLiveIndices;
+    holeLiveIndices.reserve(entityCount * 2);
+    for(u32 i = 0; i < entityCount * 2; ++i)
+    {
+        holeEntities[i] = sCreateEntity(i);
+        if(i < entityCount)
+            holeLiveIndices.pushBack(i);
+        else
+        {
+            holeEntities[i].entityType = EntityType::NUM_OF_ENTITY_TYPES;
+            holeFreeIndices.pushBack(i);
+        }
+    }
+
+    u64 storeVisited = 0u;
+    Timer storeTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        for(u32 i = 0; i < churnCount; ++i)
+        {
+            u32 removeIndex = u32(rand()) % handles.size();
+            ASSERT(store.removeEntity(handles[removeIndex]));
+            handles[removeIndex] = store.addEntity(sCreateEntity(i));
+        }
+        Transform *RESTRICT transforms = store.transforms.data();
+        for(u32 i = 0; i < store.getEntityCount(); ++i)
+            transforms[i].pos.y += 0.1f;
+        storeVisited += store.getEntityCount();
+    }
+    double storeTime = storeTimer.getDuration();
+
+    u64 holeVisited = 0u;
+    Timer holeTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        for(u32 i = 0; i < churnCount; ++i)
+        {
+            u32 liveIndex = u32(rand()) % holeLiveIndices.size();
+            u32 removeIndex = holeLiveIndices[liveIndex];
+            holeEntities[removeIndex].entityType = EntityType::NUM_OF_ENTITY_TYPES;
+            holeFreeIndices.pushBack(removeIndex);
+
+            // Random free slot, so holes keep spreading around the array.
+            u32 freeIndex = u32(rand()) % holeFreeIndices.size();
+            u32 addIndex = holeFreeIndices[freeIndex];
+            holeFreeIndices[freeIndex] = holeFreeIndices.back();
+            holeFreeIndices.popBack();
+            holeEntities[addIndex] = sCreateEntity(i);
+            holeLiveIndices[liveIndex] = addIndex;
+        }
+        GameEntity *RESTRICT entityData = holeEntities.data();
+        for(u32 i = 0; i < holeEntities.size(); ++i)
+        {
+            if(entityData[i].entityType == EntityType::NUM_OF_ENTITY_TYPES)
+                continue;
+            entityData[i].transform.pos.y += 0.1f;
+        }
+        holeVisited += holeEntities.size();
+    }
+    double holeTime = holeTimer.getDuration();
+
+    ASSERT(store.getEntityCount() == entityCount);
+    for(EntityHandle handle : handles)
+        ASSERT(store.isValidHandle(handle));
+
+    printf("Entity churn %u live, %u spawn/despawn per frame, %u frames: dense: %fms (%" PRIu64 " visited), holes: %fms (%" PRIu64 " visited)\n",
+        entityCount, churnCount, frameCount, storeTime * 1000.0, storeVisited, holeTime * 1000.0, holeVisited);
+}
+
+void testEntityStore()
+{
+    testEntityStoreColumns();
+    testEntityStoreHandles();
+    testEntityStoreBenchmark();
+    testEntityStoreChurnBenchmark();
+}
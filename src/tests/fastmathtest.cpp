@@ -0,0 +1,210 @@
+#include "testfuncs.h"
+
+#include <core/general.h>
+#include <core/mytypes.h>
+#include <core/timer.h>
+#include <math/fastmath.h>
+#include <math/quaternion_inline_functions.h>
+
+#include <math.h>
+#include <stdio.h>
+
+static constexpr u32 FastMathSampleCount = 1u << 20;
+
+static float sGetSample(u32 index, float minValue, float maxValue)
+{
+    return minValue + (maxValue - minValue) * (float(index) / float(FastMathSampleCount - 1u));
+}
+
+static double sGetAbsoluteError(float value, double expected)
+{
+    return fabs(double(value) - expected);
+}
+
+static double sGetRelativeError(float value, double expected)
+{
+    return fabs(double(value) - expected) / fabs(expected);
+}
+
+// Max errors documented in fastmath.h, checked against double precision libm.
+static void testFastMathAccuracy()
+{
+    double sinError = 0.0;
+    double cosError = 0.0;
+    for(u32 i = 0; i < FastMathSampleCount; ++i)
+    {
+        float x = sGetSample(i, -8192.0f, 8192.0f);
+        sinError = Supa::maxd(sinError, sGetAbsoluteError(Supa::fastSinf(x), sin(double(x))));
+        cosError = Supa::maxd(cosError, sGetAbsoluteError(Supa::fastCosf(x), cos(double(x))));
+
+        float small = sGetSample(i, -2.0f * PI, 2.0f * PI);
+        sinError = Supa::maxd(sinError, sGetAbsoluteError(Supa::fastSinf(small), sin(double(small))));
+        cosError = Supa::maxd(cosError, sGetAbsoluteError(Supa::fastCosf(small), cos(double(small))));
+    }
+    ASSERT(sinError < 2.0e-7);
+    ASSERT(cosError < 2.0e-7);
+    ASSERT(Supa::fastSinf(0.0f) == 0.0f);
+    ASSERT(Supa::fastCosf(0.0f) == 1.0f);
+
+    double exp2Error = 0.0;
+    double expError = 0.0;
+    for(u32 i = 0; i < FastMathSampleCount; ++i)
+    {
+        float x = sGetSample(i, -125.0f, 126.0f);
+        exp2Error = Supa::maxd(exp2Error, sGetRelativeError(Supa::fastExp2f(x), exp2(double(x))));
+
+        // Rounding x * log2(e) to float adds error growing with x.
+        float e = sGetSample(i, -80.0f, 80.0f);
+        double maxError = 3.0e-7 + 1.0e-7 * fabs(double(e));
+        expError = Supa::maxd(expError, sGetRelativeError(Supa::fastExpf(e), exp(double(e))) / maxError);
+    }
+    ASSERT(exp2Error < 3.0e-7);
+    ASSERT(expError < 1.0);
+    ASSERT(Supa::fastExp2f(3.0f) == 8.0f);
+    ASSERT(Supa::fastExp2f(1000.0f) > 1.0e38f);
+    ASSERT(Supa::fastExp2f(-1000.0f) > 0.0f);
+
+    double log2Error = 0.0;
+    for(u32 i = 0; i < FastMathSampleCount; ++i)
+    {
+        // Away from 1 the float rounding of exponent plus polynomial dominates.
+        float x = sGetSample(i, 1.0e-3f, 4.0f);
+        double expected = log2(double(x));
+        double maxError = 2.0e-7 + 6.0e-8 * fabs(expected);
+        log2Error = Supa::maxd(log2Error, sGetAbsoluteError(Supa::fastLog2f(x), expected) / maxError);
+
+        float big = sGetSample(i, 4.0f, 1.0e30f);
+        expected = log2(double(big));
+        maxError = 2.0e-7 + 6.0e-8 * fabs(expected);
+        log2Error = Supa::maxd(log2Error, sGetAbsoluteError(Supa::fastLog2f(big), expected) / maxError);
+    }
+    ASSERT(log2Error < 1.0);
+    ASSERT(Supa::fastLog2f(1.0f) == 0.0f);
+    ASSERT(Supa::fastLog2f(1024.0f) == 10.0f);
+
+    double powError = 0.0;
+    for(u32 i = 0; i < FastMathSampleCount; ++i)
+    {
+        float a = sGetSample(i, 0.01f, 10.0f);
+        float b = sGetSample(FastMathSampleCount - 1u - i, -4.0f, 4.0f);
+        double expected = pow(double(a), double(b));
+        double maxError = 3.0e-7 + 2.0e-7 * fabs(double(b) * log2(double(a)));
+        powError = Supa::maxd(powError, sGetRelativeError(Supa::fastPowf(a, b), expected) / maxError);
+    }
+    ASSERT(powError < 1.0);
+
+    Quat q = getQuaternionFromAxisAngle(Vec3(1.0f, 2.0f, 3.0f), 1.3f);
+    Quat qFast = getQuaternionFromAxisAngleFast(Vec3(1.0f, 2.0f, 3.0f), 1.3f);
+    ASSERT(fabsf(q.v.x - qFast.v.x) < 1.0e-6f && fabsf(q.v.y - qFast.v.y) < 1.0e-6f);
+    ASSERT(fabsf(q.v.z - qFast.v.z) < 1.0e-6f && fabsf(q.w - qFast.w) < 1.0e-6f);
+
+    printf("Fast math max errors: sin: %g, cos: %g, exp2 relative: %g\n", sinError, cosError, exp2Error);
+}
+
+static void testFastMathSimdParity()
+{
+#if MATH_SIMD
+    for(u32 i = 0; i < FastMathSampleCount; i += 4u)
+    {
+        alignas(16) float input[4];
+        alignas(16) float output[4];
+        for(u32 j = 0; j < 4u; ++j)
+            input[j] = sGetSample(i + j, -8192.0f, 8192.0f);
+
+        simdStore(output, simdFastSin(simdLoad(input)));
+        for(u32 j = 0; j < 4u; ++j)
+            ASSERT(output[j] == Supa::fastSinf(input[j]));
+
+        simdStore(output, simdFastCos(simdLoad(input)));
+        for(u32 j = 0; j < 4u; ++j)
+            ASSERT(output[j] == Supa::fastCosf(input[j]));
+
+        for(u32 j = 0; j < 4u; ++j)
+            input[j] = sGetSample(i + j, -130.0f, 130.0f);
+        simdStore(output, simdFastExp2(simdLoad(input)));
+        for(u32 j = 0; j < 4u; ++j)
+            ASSERT(output[j] == Supa::fastExp2f(input[j]));
+
+        simdStore(output, simdFastExp(simdLoad(input)));
+        for(u32 j = 0; j < 4u; ++j)
+            ASSERT(output[j] == Supa::fastExpf(input[j]));
+
+        for(u32 j = 0; j < 4u; ++j)
+            input[j] = sGetSample(i + j, 1.0e-3f, 1.0e6f);
+        simdStore(output, simdFastLog2(simdLoad(input)));
+        for(u32 j = 0; j < 4u; ++j)
+            ASSERT(output[j] == Supa::fastLog2f(input[j]));
+    }
+#endif
+}
+
+static void testFastMathBenchmark()
+{
+    const u32 loopCount = 16u;
+    static float values[FastMathSampleCount];
+    for(u32 i = 0; i < FastMathSampleCount; ++i)
+        values[i] = sGetSample(i, -100.0f, 100.0f);
+
+    // Sums keep the compiler from dropping the loops.
+    float libmSum = 0.0f;
+    Timer libmTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        for(u32 i = 0; i < FastMathSampleCount; ++i)
+            libmSum += ::sinf(values[i]);
+    }
+    double libmTime = libmTimer.getDuration();
+
+    float fastSum = 0.0f;
+    Timer fastTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        for(u32 i = 0; i < FastMathSampleCount; ++i)
+            fastSum += Supa::fastSinf(values[i]);
+    }
+    double fastTime = fastTimer.getDuration();
+
+    float simdSum = 0.0f;
+    Timer simdTimer;
+#if MATH_SIMD
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        SimdFloat4 sum = simdSplat(0.0f);
+        for(u32 i = 0; i < FastMathSampleCount; i += 4u)
+            sum = simdAdd(sum, simdFastSin(simdLoad(values + i)));
+        simdSum += simdGetX(simdDot4(sum, simdSplat(1.0f)));
+    }
+#endif
+    double simdTime = simdTimer.getDuration();
+
+    float libmExpSum = 0.0f;
+    Timer libmExpTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        for(u32 i = 0; i < FastMathSampleCount; ++i)
+            libmExpSum += ::expf(values[i] * 0.1f);
+    }
+    double libmExpTime = libmExpTimer.getDuration();
+
+    float fastExpSum = 0.0f;
+    Timer fastExpTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        for(u32 i = 0; i < FastMathSampleCount; ++i)
+            fastExpSum += Supa::fastExpf(values[i] * 0.1f);
+    }
+    double fastExpTime = fastExpTimer.getDuration();
+
+    printf("Fast math %u values, %u loops: sin libm: %fms, scalar: %fms, %s: %fms, "
+        "exp libm: %fms, scalar: %fms (sums %f %f %f %f %f)\n",
+        FastMathSampleCount, loopCount, libmTime * 1000.0, fastTime * 1000.0,
+        MATH_SIMD ? "simd" : "scalar only build", simdTime * 1000.0,
+        libmExpTime * 1000.0, fastExpTime * 1000.0, libmSum, fastSum, simdSum, libmExpSum, fastExpSum);
+}
+
+void testFastMath()
+{
+    testFastMathAccuracy();
+    testFastMathSimdParity();
+    testFastMathBenchmark();
+}
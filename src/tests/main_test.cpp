@@ -216,14 +216,29 @@ i32 main()
     testStackString();
     testMemoryStackString();
     testUniformBufferManager();
+    testStagingRing();
+    testBufferCopyBatch();
+    testMeshDrawCommands();
+    testMeshInstanceTable();
+    testRenderGraph();
     testArraySliceView();
 
     testVector();
 
     testMatrix();
     testMathVector();
+    testFastMath();
+    testAudio();
 
     testStrings();
+    testBvh();
+    testSceneGraph();
+    testEntityStore();
+    testSystemScheduler();
+    testEntityQuery();
+    testChunkStorage();
+    testEntityChangeTracking();
+    testEntityCommands();
     deinitMemory();
     return 0;
 }
\ No newline at end of file
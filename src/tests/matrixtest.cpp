@@ -1,9 +1,15 @@
 #include "testfuncs.h"
 
+#include <components/transform_functions.h>
+
+#include <core/timer.h>
+
 #include <math/general_math.h>
 #include <math/matrix_inline_functions.h>
 #include <math/quaternion_inline_functions.h>
 
+#include <stdio.h>
+
 static void testIdentity()
 {
     {
@@ -101,6 +107,203 @@ void testMatrixFromQuaternion()
 }
 
 
+static float sGetRandomFloat(u32 &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1u << 23) - 1.0f;
+}
+
+static TransformComponent sGetRandomTransform(u32 &seed)
+{
+    TransformComponent trans;
+    trans.position = Vec4(sGetRandomFloat(seed) * 100.0f, sGetRandomFloat(seed) * 100.0f, sGetRandomFloat(seed) * 100.0f, 1.0f);
+    trans.rotation = normalizeScalar(Quat(sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed), 1.0f));
+    trans.scale = Vec4(sGetRandomFloat(seed) + 2.0f, sGetRandomFloat(seed) + 2.0f, sGetRandomFloat(seed) + 2.0f, 1.0f);
+    return trans;
+}
+
+static bool sIsEqual(const Mat3x4 &a, const Mat3x4 &b)
+{
+    for(u32 i = 0; i < 12; ++i)
+    {
+        if(a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+
+static bool sIsEqual(const Vec4 &a, const Vec4 &b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+// SIMD versions do the same operations in the same order as the scalar reference ones,
+// so the results have to be exactly the same.
+static void testMatrixSimdParity()
+{
+    u32 seed = 4321u;
+    for(u32 i = 0; i < 1000; ++i)
+    {
+        TransformComponent trans = sGetRandomTransform(seed);
+        Mat3x4 m1 = getMatrixFromTransform(trans);
+        ASSERT(sIsEqual(m1, getMatrixFromTransformScalar(trans)));
+
+        Transform transform{
+            .pos = Vec3(trans.position.x, trans.position.y, trans.position.z),
+            .rot = trans.rotation,
+            .scale = Vec3(trans.scale.x, trans.scale.y, trans.scale.z) };
+        ASSERT(sIsEqual(getMatrixFromTransform(transform), getMatrixFromTransformScalar(transform)));
+
+        Mat3x4 m2 = getMatrixFromTransform(sGetRandomTransform(seed));
+        ASSERT(sIsEqual(m1 * m2, mulScalar(m1, m2)));
+        Matrix mat1(m1);
+        Matrix mat2(m2);
+        mat2._30 = sGetRandomFloat(seed);
+        ASSERT(mat1 * mat2 == mulScalar(mat1, mat2));
+
+        Vec4 v(sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed));
+        ASSERT(sIsEqual(mul(m1, v), mulScalar(m1, v)));
+        ASSERT(sIsEqual(mul(v, m1), mulScalar(v, m1)));
+        ASSERT(sIsEqual(mul(mat2, v), mulScalar(mat2, v)));
+        ASSERT(sIsEqual(mul(v, mat2), mulScalar(v, mat2)));
+    }
+}
+
+static void testMatrixSimdBenchmark()
+{
+    const u32 transformCount = 4096u;
+    const u32 loopCount = 100u;
+    TransformComponent transforms[transformCount];
+    Mat3x4 matrices[transformCount];
+    u32 seed = 1u;
+    for(u32 i = 0; i < transformCount; ++i)
+        transforms[i] = sGetRandomTransform(seed);
+
+    Timer scalarTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        Mat3x4 parent = getMatrixFromTransformScalar(transforms[loop]);
+        for(u32 i = 0; i < transformCount; ++i)
+            matrices[i] = mulScalar(parent, getMatrixFromTransformScalar(transforms[i]));
+    }
+    double scalarTime = scalarTimer.getDuration();
+    float scalarSum = matrices[transformCount - 1]._03;
+
+    Timer simdTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        Mat3x4 parent = getMatrixFromTransform(transforms[loop]);
+        for(u32 i = 0; i < transformCount; ++i)
+            matrices[i] = parent * getMatrixFromTransform(transforms[i]);
+    }
+    double simdTime = simdTimer.getDuration();
+    ASSERT(scalarSum == matrices[transformCount - 1]._03);
+
+    printf("Math %u transforms to matrix and multiply, %u loops: scalar: %fms, %s: %fms\n",
+        transformCount, loopCount, scalarTime * 1000.0, MATH_SIMD ? "simd" : "scalar only build", simdTime * 1000.0);
+}
+
+static Transform sGetTransform(const TransformComponent &trans)
+{
+    return Transform{
+        .pos = Vec3(trans.position.x, trans.position.y, trans.position.z),
+        .rot = trans.rotation,
+        .scale = Vec3(trans.scale.x, trans.scale.y, trans.scale.z) };
+}
+
+static void testModelMatricesBatch()
+{
+    // Not multiple of 4, so the last ones go through per transform path.
+    const u32 transformCount = 103u;
+    TransformComponent transformComponents[transformCount];
+    Transform transforms[transformCount];
+    Vec3 positions[transformCount];
+    Quat rotations[transformCount];
+    Vec3 scales[transformCount];
+    u32 indices[transformCount];
+    u32 seed = 99u;
+    for(u32 i = 0; i < transformCount; ++i)
+    {
+        transformComponents[i] = sGetRandomTransform(seed);
+        transforms[i] = sGetTransform(transformComponents[i]);
+        positions[i] = transforms[i].pos;
+        rotations[i] = transforms[i].rot;
+        scales[i] = transforms[i].scale;
+        // Reversed order.
+        indices[i] = transformCount - 1u - i;
+    }
+
+    Mat3x4 matrices[transformCount];
+    Mat3x4 normalMatrices[transformCount];
+    getModelMatrices(transforms, nullptr, transformCount, matrices, normalMatrices);
+    for(u32 i = 0; i < transformCount; ++i)
+    {
+        ASSERT(sIsEqual(matrices[i], getModelMatrix(transforms[i])));
+        ASSERT(sIsEqual(normalMatrices[i], getModelNormalMatrix(transforms[i])));
+    }
+
+    // Indexed writes only the given ones.
+    Mat3x4 indexedMatrices[transformCount];
+    getModelMatrices(transforms, indices, transformCount / 2u, indexedMatrices, nullptr);
+    for(u32 i = 0; i < transformCount; ++i)
+    {
+        bool written = i >= transformCount - transformCount / 2u;
+        ASSERT(sIsEqual(indexedMatrices[i], written ? matrices[i] : Mat3x4()));
+    }
+
+    Mat3x4 soaMatrices[transformCount];
+    Mat3x4 soaNormalMatrices[transformCount];
+    getModelMatrices(positions, rotations, scales, transformCount, soaMatrices, soaNormalMatrices);
+    for(u32 i = 0; i < transformCount; ++i)
+    {
+        ASSERT(sIsEqual(soaMatrices[i], matrices[i]));
+        ASSERT(sIsEqual(soaNormalMatrices[i], normalMatrices[i]));
+    }
+
+    Mat4Component matComponents[transformCount];
+    getModelMatrices(transformComponents, transformCount, &matComponents[0].mat, sizeof(Mat4Component));
+    for(u32 i = 0; i < transformCount; ++i)
+        ASSERT(sIsEqual(matComponents[i].mat, matrices[i]));
+}
+
+static void testModelMatricesBenchmark()
+{
+    const u32 transformCount = 4096u;
+    const u32 loopCount = 100u;
+    Transform transforms[transformCount];
+    Mat3x4 matrices[transformCount];
+    Mat3x4 normalMatrices[transformCount];
+    u32 seed = 2u;
+    for(u32 i = 0; i < transformCount; ++i)
+        transforms[i] = sGetTransform(sGetRandomTransform(seed));
+
+    Timer singleTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        transforms[loop].pos.x += 1.0f;
+        for(u32 i = 0; i < transformCount; ++i)
+        {
+            matrices[i] = getModelMatrix(transforms[i]);
+            normalMatrices[i] = getModelNormalMatrix(transforms[i]);
+        }
+    }
+    double singleTime = singleTimer.getDuration();
+    float singleValue = matrices[transformCount - 1]._03 + normalMatrices[transformCount - 1]._00;
+
+    Timer batchTimer;
+    for(u32 loop = 0; loop < loopCount; ++loop)
+    {
+        transforms[loop].pos.x -= 1.0f;
+        getModelMatrices(transforms, nullptr, transformCount, matrices, normalMatrices);
+    }
+    double batchTime = batchTimer.getDuration();
+    ASSERT(singleValue == matrices[transformCount - 1]._03 + normalMatrices[transformCount - 1]._00);
+
+    double matrixCount = double(transformCount) * double(loopCount);
+    printf("Model and normal matrices %u transforms, %u loops: one at a time: %fM matrices/s, batched: %fM matrices/s\n",
+        transformCount, loopCount, matrixCount / singleTime / 1.0e6, matrixCount / batchTime / 1.0e6);
+}
+
 void testMatrix()
 {
     testIdentity();
@@ -108,4 +311,8 @@ void testMatrix()
     testMatrixMultiply3x4();
     testQuaternion();
     testMatrixFromQuaternion();
+    testMatrixSimdParity();
+    testMatrixSimdBenchmark();
+    testModelMatricesBatch();
+    testModelMatricesBenchmark();
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "testfuncs.h"
+
+#include <container/podvector.h>
+#include <core/assert.h>
+#include <core/mytypes.h>
+
+#include <render/meshdrawcommands.h>
+
+static bool sCommandEquals(const DrawIndexedIndirectCommand &command, u32 indexCount, u32 instanceCount,
+    u32 firstIndex, i32 vertexOffset, u32 firstInstance)
+{
+    return command.indexCount == indexCount && command.instanceCount == instanceCount
+        && command.firstIndex == firstIndex && command.vertexOffset == vertexOffset
+        && command.firstInstance == firstInstance;
+}
+
+static void testMeshDrawCommandsBuild()
+{
+    MeshDrawRange meshes[] =
+    {
+        { .indexStart = 0u, .indexCount = 36u, .vertexStart = 0u },
+        { .indexStart = 36u, .indexCount = 120u, .vertexStart = 24u },
+        // Entity type without a mesh.
+        { .indexStart = 156u, .indexCount = 0u, .vertexStart = 64u },
+        { .indexStart = 156u, .indexCount = 6u, .vertexStart = 64u },
+    };
+    u32 instanceCounts[] = { 3u, 0u, 2u, 5u };
+
+    PodVector<DrawIndexedIndirectCommand> commands;
+    u32 endInstance = appendMeshDrawCommands(meshes, instanceCounts, ARRAYSIZES(meshes), 7u, commands);
+
+    ASSERT(endInstance == 7u + 3u + 2u + 5u);
+    ASSERT(commands.size() == 2u);
+    ASSERT(sCommandEquals(commands[0], 36u, 3u, 0u, 0, 7u));
+    // Instances of the mesh without indices still get skipped.
+    ASSERT(sCommandEquals(commands[1], 6u, 5u, 156u, 64, 7u + 3u + 2u));
+}
+
+static void testMeshDrawCommandsPasses()
+{
+    // Animated and static passes share one command buffer and one instance range, like the mesh renderer.
+    MeshDrawRange animatedMeshes[] = { { .indexStart = 0u, .indexCount = 12u, .vertexStart = 0u } };
+    MeshDrawRange staticMeshes[] = { { .indexStart = 12u, .indexCount = 24u, .vertexStart = 8u } };
+    u32 animatedInstances[] = { 4u };
+    u32 staticInstances[] = { 9u };
+
+    PodVector<DrawIndexedIndirectCommand> commands;
+    u32 instance = appendMeshDrawCommands(animatedMeshes, animatedInstances, 1u, 0u, commands);
+    u32 staticFirstCommand = commands.size();
+    instance = appendMeshDrawCommands(staticMeshes, staticInstances, 1u, instance, commands);
+
+    ASSERT(instance == 13u);
+    ASSERT(staticFirstCommand == 1u && commands.size() == 2u);
+    ASSERT(sCommandEquals(commands[0], 12u, 4u, 0u, 0, 0u));
+    ASSERT(sCommandEquals(commands[1], 24u, 9u, 12u, 8, 4u));
+
+    static_assert(sizeof(DrawIndexedIndirectCommand) == 5u * sizeof(u32));
+}
+
+void testMeshDrawCommands()
+{
+    testMeshDrawCommandsBuild();
+    testMeshDrawCommandsPasses();
+}
@@ -0,0 +1,145 @@
+#include "testfuncs.h"
+
+#include <container/podvector.h>
+#include <core/assert.h>
+#include <core/mytypes.h>
+
+#include <math/matrix.h>
+#include <render/meshinstancetable.h>
+
+#include <stdio.h>
+
+static constexpr u32 InstanceTableModelCount = 4u;
+static constexpr u32 InstanceTableBufferCount = 2u;
+
+static Mat3x4 sTranslation(float x)
+{
+    Mat3x4 result;
+    result._03 = x;
+    return result;
+}
+
+// Sets instances 0 to count - 1, instance i with model i % modelCount, first animatedCount animated.
+static void sSetInstances(MeshInstanceTable &table, u32 count, u32 animatedCount, float moveOffset)
+{
+    for(u32 i = 0; i < count; ++i)
+        table.setInstance(i, i % InstanceTableModelCount, i < animatedCount,
+            sTranslation(float(i) + moveOffset), Mat3x4());
+}
+
+static void testMeshInstanceTableStatic()
+{
+    MeshInstanceTable table;
+    ASSERT(table.init(1024u, InstanceTableBufferCount));
+
+    u64 bytesPerFrame[8] = {};
+    for(u32 frame = 0; frame < ARRAYSIZES(bytesPerFrame); ++frame)
+    {
+        table.beginFrame();
+        sSetInstances(table, 100u, 0u, 0.0f);
+        table.endFrame(InstanceTableModelCount, frame % InstanceTableBufferCount);
+        bytesPerFrame[frame] = table.getUploadBytes();
+    }
+    // Every buffer gets the matrices and draw slots once, then nothing.
+    u64 fullUpload = 100u * (2u * sizeof(Mat3x4) + sizeof(u32));
+    ASSERT(bytesPerFrame[0] == fullUpload && bytesPerFrame[1] == fullUpload);
+    for(u32 frame = InstanceTableBufferCount; frame < ARRAYSIZES(bytesPerFrame); ++frame)
+        ASSERT(bytesPerFrame[frame] == 0u);
+    ASSERT(table.getInstanceCount() == 100u);
+    printf("Mesh instance table: static scene uploads %u bytes at start, then %u bytes per frame\n",
+        u32(bytesPerFrame[0]), u32(bytesPerFrame[ARRAYSIZES(bytesPerFrame) - 1u]));
+}
+
+static void testMeshInstanceTableMove()
+{
+    MeshInstanceTable table;
+    ASSERT(table.init(1024u, InstanceTableBufferCount));
+    for(u32 frame = 0; frame < InstanceTableBufferCount; ++frame)
+    {
+        table.beginFrame();
+        sSetInstances(table, 16u, 0u, 0.0f);
+        table.endFrame(InstanceTableModelCount, frame % InstanceTableBufferCount);
+    }
+
+    // Instances 5 and 6 move once, both buffers get only them.
+    for(u32 frame = InstanceTableBufferCount; frame < InstanceTableBufferCount * 3u; ++frame)
+    {
+        table.beginFrame();
+        for(u32 i = 0; i < 16u; ++i)
+        {
+            float x = i == 5u ? 100.0f : i == 6u ? 200.0f : float(i);
+            table.setInstance(i, i % InstanceTableModelCount, false, sTranslation(x), Mat3x4());
+        }
+        table.endFrame(InstanceTableModelCount, frame % InstanceTableBufferCount);
+
+        if(frame < InstanceTableBufferCount * 2u)
+        {
+            ASSERT(table.getDirtyRanges().size() == 1u);
+            ASSERT(table.getDirtyRanges()[0].first == 5u && table.getDirtyRanges()[0].count == 2u);
+            ASSERT(!table.getDrawSlotsDirty());
+            ASSERT(table.getUploadBytes() == 2u * 2u * sizeof(Mat3x4));
+        }
+        else
+        {
+            ASSERT(table.getDirtyRanges().size() == 0u);
+        }
+    }
+    ASSERT(table.getSlotMatrices()[5u * 2u]._03 == 100.0f);
+    ASSERT(table.getSlotMatrices()[6u * 2u]._03 == 200.0f);
+}
+
+static void testMeshInstanceTableDrawOrder()
+{
+    MeshInstanceTable table;
+    ASSERT(table.init(1024u, InstanceTableBufferCount));
+
+    table.beginFrame();
+    sSetInstances(table, 10u, 3u, 0.0f);
+    table.endFrame(InstanceTableModelCount, 0u);
+
+    // Animated 0, 1, 2 with models 0, 1, 2, then static models 0: 4, 8; 1: 5, 9; 2: 6; 3: 3, 7.
+    static constexpr u32 expectedSlots[] = { 0u, 1u, 2u, 4u, 8u, 5u, 9u, 6u, 3u, 7u };
+    const PodVector<u32> &drawSlots = table.getDrawSlots();
+    ASSERT(drawSlots.size() == ARRAYSIZES(expectedSlots));
+    for(u32 i = 0; i < ARRAYSIZES(expectedSlots); ++i)
+        ASSERT(drawSlots[i] == expectedSlots[i]);
+    ASSERT(table.getAnimatedInstanceCounts()[0] == 1u && table.getAnimatedInstanceCounts()[3] == 0u);
+    ASSERT(table.getStaticInstanceCounts()[0] == 2u && table.getStaticInstanceCounts()[3] == 2u);
+    ASSERT(table.getDrawSlotsDirty());
+
+    // Instance 4 stops being set, its slot gets freed and reused by a new instance.
+    table.beginFrame();
+    for(u32 i = 0; i < 10u; ++i)
+    {
+        if(i != 4u)
+            table.setInstance(i, i % InstanceTableModelCount, i < 3u, sTranslation(float(i)), Mat3x4());
+    }
+    table.endFrame(InstanceTableModelCount, 1u);
+    ASSERT(table.getInstanceCount() == 9u);
+    ASSERT(table.getStaticInstanceCounts()[0] == 1u);
+    ASSERT(table.getDrawSlots().size() == 9u);
+    ASSERT(table.getDrawSlotsDirty());
+
+    table.beginFrame();
+    sSetInstances(table, 10u, 3u, 0.0f);
+    ASSERT(table.setInstance(20u, 1u, false, sTranslation(20.0f), Mat3x4()) == 10u);
+    table.endFrame(InstanceTableModelCount, 0u);
+    ASSERT(table.getInstanceCount() == 11u);
+    ASSERT(table.getStaticInstanceCounts()[1] == 3u);
+    ASSERT(table.getSlotCount() == 11u);
+
+    // Out of slots.
+    MeshInstanceTable smallTable;
+    ASSERT(smallTable.init(2u, 1u));
+    smallTable.beginFrame();
+    ASSERT(smallTable.setInstance(0u, 0u, false, Mat3x4(), Mat3x4()) == 0u);
+    ASSERT(smallTable.setInstance(7u, 0u, false, Mat3x4(), Mat3x4()) == 1u);
+    ASSERT(smallTable.setInstance(9u, 0u, false, Mat3x4(), Mat3x4()) == ~0u);
+}
+
+void testMeshInstanceTable()
+{
+    testMeshInstanceTableStatic();
+    testMeshInstanceTableMove();
+    testMeshInstanceTableDrawOrder();
+}
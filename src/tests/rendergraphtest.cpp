@@ -0,0 +1,275 @@
+#include "testfuncs.h"
+
+#include <container/podvector.h>
+#include <core/assert.h>
+#include <core/mytypes.h>
+
+#include <render/rendergraph.h>
+
+#include <stdio.h>
+
+static constexpr u64 RenderGraphImageBytes = 1920u * 1080u * 8u;
+
+// Pass data is the index the pass writes into the execution order.
+struct RenderGraphTestRun
+{
+    u32 order[16] = {};
+    u32 count = 0u;
+    u32 barrierCount = 0u;
+    u32 flushCount = 0u;
+};
+
+static RenderGraphTestRun sRun;
+
+static void sTestPass(void *passData)
+{
+    sRun.order[sRun.count++] = u32(uintptr_t(passData));
+}
+
+static void sTestBarrier(void *imageData, const RenderGraphBarrier &barrier)
+{
+    ASSERT(barrier.srcUsage != barrier.dstUsage);
+    // Only discarded contents wait for other work on the memory.
+    ASSERT(barrier.srcUsage == RenderGraphUsage::None || barrier.waitUsage == RenderGraphUsage::None);
+    ++sRun.barrierCount;
+}
+
+static void sTestFlush()
+{
+    ++sRun.flushCount;
+}
+
+static const RenderGraphBarrier *sFindBarrier(const RenderGraph &graph, u32 compiledPassIndex, u32 imageIndex)
+{
+    const RenderGraphCompiledPass &compiledPass = graph.getCompiledPasses()[compiledPassIndex];
+    for(u32 i = compiledPass.firstBarrier; i < compiledPass.firstBarrier + compiledPass.barrierCount; ++i)
+    {
+        if(graph.getBarriers()[i].imageIndex == imageIndex)
+            return &graph.getBarriers()[i];
+    }
+    return nullptr;
+}
+
+static void *sPassData(u32 index)
+{
+    return (void *)uintptr_t(index);
+}
+
+// Deferred frame like common_project draws, normalView swaps lighting for drawing the normals.
+static void sBuildDeferredGraph(RenderGraph &graph, bool normalView)
+{
+    graph.clear();
+    u32 albedo = graph.addImage("albedo", nullptr);
+    u32 normal = graph.addTransientImage("normal", nullptr, RenderGraphImageBytes, 256u, ~0u);
+    u32 depth = graph.addTransientImage("depth", nullptr, RenderGraphImageBytes / 2u, 256u, ~0u);
+    u32 shadow = graph.addTransientImage("shadow", nullptr, RenderGraphImageBytes, 256u, ~0u);
+    u32 lighting = graph.addTransientImage("lighting", nullptr, RenderGraphImageBytes, 256u, ~0u);
+
+    graph.addPass("mesh", sTestPass, sPassData(0));
+    graph.write(albedo, RenderGraphUsage::ColorAttachment);
+    graph.write(normal, RenderGraphUsage::ColorAttachment);
+    graph.write(depth, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("shadow", sTestPass, sPassData(1));
+    graph.write(shadow, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("lighting", sTestPass, sPassData(2));
+    graph.read(albedo, RenderGraphUsage::ComputeSampleRead);
+    graph.read(normal, RenderGraphUsage::ComputeSampleRead);
+    graph.read(depth, RenderGraphUsage::ComputeSampleRead);
+    graph.read(shadow, RenderGraphUsage::ComputeSampleRead);
+    graph.write(lighting, RenderGraphUsage::ComputeImageWrite);
+
+    graph.addPass("tonemap", sTestPass, sPassData(3));
+    graph.read(lighting, RenderGraphUsage::ComputeSampleRead);
+    graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
+
+    if(normalView)
+    {
+        graph.addPass("normals", sTestPass, sPassData(4));
+        graph.read(normal, RenderGraphUsage::ComputeSampleRead);
+        graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
+    }
+
+    graph.addPass("lines", sTestPass, sPassData(5));
+    graph.readWrite(albedo, RenderGraphUsage::ColorAttachment);
+    graph.readWrite(depth, RenderGraphUsage::DepthAttachment);
+
+    graph.addPass("present", sTestPass, sPassData(6), true);
+    graph.read(albedo, RenderGraphUsage::Present);
+}
+
+static void testRenderGraphDeferred()
+{
+    RenderGraph graph;
+    sBuildDeferredGraph(graph, false);
+    ASSERT(graph.compile());
+
+    sRun = {};
+    graph.execute(sTestBarrier, sTestFlush);
+    ASSERT(sRun.count == 6u);
+    u32 expectedOrder[] = { 0u, 1u, 2u, 3u, 5u, 6u };
+    for(u32 i = 0; i < ARRAYSIZES(expectedOrder); ++i)
+        ASSERT(sRun.order[i] == expectedOrder[i]);
+
+    // Same barriers sDraw used to add by hand: 3 + 1 + 5 + 2 + 2 + 1 for presenting.
+    ASSERT(graph.getBarriers().size() == 14u && sRun.barrierCount == 14u);
+    // Font pass is not in the test graph, every pass left has barriers.
+    ASSERT(sRun.flushCount == 6u);
+    const RenderGraphCompiledPass &lighting = graph.getCompiledPasses()[2];
+    ASSERT(lighting.barrierCount == 5u);
+    ASSERT(graph.getBarriers()[lighting.firstBarrier].srcUsage == RenderGraphUsage::ColorAttachment);
+    ASSERT(graph.getBarriers()[lighting.firstBarrier].dstUsage == RenderGraphUsage::ComputeSampleRead);
+    // Lines load albedo and depth, so they only need the usage changed back.
+    const RenderGraphCompiledPass &lines = graph.getCompiledPasses()[4];
+    ASSERT(lines.barrierCount == 2u);
+
+    // Every transient image is alive during lighting, nothing can share.
+    ASSERT(graph.getMemorySlots().size() == 4u);
+    ASSERT(graph.getMemorySlotBytes() == graph.getTransientImageBytes());
+    ASSERT(graph.getMemorySlot(0u) == ~0u);
+
+    // First writes discard the contents and wait for the previous frame's last use of the memory.
+    const u32 albedo = 0u;
+    const u32 normal = 1u;
+    const u32 depth = 2u;
+    const RenderGraphBarrier *barrier = sFindBarrier(graph, 0u, albedo);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::None && barrier->waitUsage == RenderGraphUsage::Present);
+    barrier = sFindBarrier(graph, 0u, normal);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::None && barrier->waitUsage == RenderGraphUsage::ComputeSampleRead);
+    barrier = sFindBarrier(graph, 0u, depth);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::None && barrier->waitUsage == RenderGraphUsage::DepthAttachment);
+    barrier = sFindBarrier(graph, 4u, depth);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::ComputeSampleRead && barrier->waitUsage == RenderGraphUsage::None);
+}
+
+static void testRenderGraphCulling()
+{
+    RenderGraph graph;
+    sBuildDeferredGraph(graph, true);
+    ASSERT(graph.compile());
+
+    // Normal view overwrites the tonemapped albedo, so tonemap, lighting and shadows are dead.
+    sRun = {};
+    graph.execute(sTestBarrier, sTestFlush);
+    u32 expectedOrder[] = { 0u, 4u, 5u, 6u };
+    ASSERT(sRun.count == ARRAYSIZES(expectedOrder));
+    for(u32 i = 0; i < ARRAYSIZES(expectedOrder); ++i)
+        ASSERT(sRun.order[i] == expectedOrder[i]);
+    ASSERT(graph.isPassCulled(1u) && graph.isPassCulled(2u) && graph.isPassCulled(3u));
+    ASSERT(!graph.isPassCulled(0u) && !graph.isPassCulled(4u));
+
+    // Memory still gets planned for every pass, culled or not.
+    ASSERT(graph.getMemorySlots().size() == 4u);
+
+    // Without anything presenting or reading it, only the imported albedo keeps passes alive.
+    graph.clear();
+    u32 albedo = graph.addImage("albedo", nullptr);
+    u32 scratch = graph.addTransientImage("scratch", nullptr, 64u, 64u, ~0u);
+    graph.addPass("unused", sTestPass, sPassData(0));
+    graph.write(scratch, RenderGraphUsage::ComputeImageWrite);
+    graph.addPass("clear", sTestPass, sPassData(1));
+    graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
+    ASSERT(graph.compile());
+    ASSERT(graph.isPassCulled(0u) && !graph.isPassCulled(1u));
+    ASSERT(graph.getCompiledPasses().size() == 1u);
+
+    // Reading a transient image nobody wrote fails.
+    graph.clear();
+    scratch = graph.addTransientImage("scratch", nullptr, 64u, 64u, ~0u);
+    graph.addPass("read", sTestPass, sPassData(0), true);
+    graph.read(scratch, RenderGraphUsage::ComputeSampleRead);
+    ASSERT(!graph.compile());
+    ASSERT(graph.getCompiledPasses().size() == 0u);
+
+    // Read and write with the same usage in one pass are one access.
+    graph.clear();
+    albedo = graph.addImage("albedo", nullptr);
+    graph.addPass("clear", sTestPass, sPassData(0));
+    graph.write(albedo, RenderGraphUsage::ComputeImageWrite);
+    graph.addPass("mixed", sTestPass, sPassData(1));
+    ASSERT(graph.read(albedo, RenderGraphUsage::ComputeSampleRead));
+    ASSERT(graph.write(albedo, RenderGraphUsage::ComputeSampleRead));
+    ASSERT(graph.compile() && graph.getBarriers().size() == 2u);
+
+    // Imported image read first is still in the usage the previous frame ended with.
+    graph.clear();
+    albedo = graph.addImage("albedo", nullptr);
+    graph.addPass("read", sTestPass, sPassData(0));
+    graph.readWrite(albedo, RenderGraphUsage::ColorAttachment);
+    graph.addPass("present", sTestPass, sPassData(1), true);
+    graph.read(albedo, RenderGraphUsage::Present);
+    ASSERT(graph.compile() && graph.getBarriers().size() == 2u);
+    ASSERT(graph.getBarriers()[0].srcUsage == RenderGraphUsage::Present);
+    ASSERT(graph.getBarriers()[0].dstUsage == RenderGraphUsage::ColorAttachment);
+}
+
+static void testRenderGraphAliasing()
+{
+    // Post process chain, every image lives for two passes.
+    RenderGraph graph;
+    u32 output = graph.addImage("output", nullptr);
+    u32 chain[4];
+    for(u32 i = 0; i < ARRAYSIZES(chain); ++i)
+        chain[i] = graph.addTransientImage("chain", nullptr, RenderGraphImageBytes >> i, 256u << i, 0x3u);
+
+    graph.addPass("first", sTestPass, sPassData(0));
+    graph.write(chain[0], RenderGraphUsage::ColorAttachment);
+    for(u32 i = 1; i < ARRAYSIZES(chain); ++i)
+    {
+        graph.addPass("chain", sTestPass, sPassData(i));
+        graph.read(chain[i - 1], RenderGraphUsage::ComputeSampleRead);
+        graph.write(chain[i], RenderGraphUsage::ComputeImageWrite);
+    }
+    graph.addPass("last", sTestPass, sPassData(4));
+    graph.read(chain[3], RenderGraphUsage::ComputeSampleRead);
+    graph.write(output, RenderGraphUsage::ComputeImageWrite);
+    ASSERT(graph.compile());
+
+    // Images two apart never live at the same time.
+    ASSERT(graph.getMemorySlots().size() == 2u);
+    ASSERT(graph.getMemorySlot(chain[0]) == graph.getMemorySlot(chain[2]));
+    ASSERT(graph.getMemorySlot(chain[1]) == graph.getMemorySlot(chain[3]));
+    ASSERT(graph.getMemorySlot(chain[0]) != graph.getMemorySlot(chain[1]));
+    const RenderGraphMemorySlot &slot = graph.getMemorySlots()[graph.getMemorySlot(chain[0])];
+    ASSERT(slot.size == RenderGraphImageBytes && slot.alignment == 256u << 2u && slot.memoryTypeBits == 0x3u);
+    ASSERT(graph.getMemorySlotBytes() == RenderGraphImageBytes + (RenderGraphImageBytes >> 1u));
+
+    // Image taking over a slot waits for the last use of the previous one, the first image in a
+    // slot for the last use at the end of the previous frame.
+    const RenderGraphBarrier *barrier = sFindBarrier(graph, 2u, chain[2]);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::None && barrier->waitUsage == RenderGraphUsage::ComputeSampleRead);
+    barrier = sFindBarrier(graph, 0u, chain[0]);
+    ASSERT(barrier && barrier->srcUsage == RenderGraphUsage::None && barrier->waitUsage == RenderGraphUsage::ComputeSampleRead);
+    barrier = sFindBarrier(graph, 1u, chain[1]);
+    ASSERT(barrier && barrier->waitUsage == RenderGraphUsage::ComputeSampleRead);
+
+    printf("Render graph: %u transient bytes in %u bytes of memory\n",
+        u32(graph.getTransientImageBytes()), u32(graph.getMemorySlotBytes()));
+
+    // Memory types without common bits cannot share.
+    graph.clear();
+    output = graph.addImage("output", nullptr);
+    u32 a = graph.addTransientImage("a", nullptr, 1024u, 256u, 0x1u);
+    u32 b = graph.addTransientImage("b", nullptr, 1024u, 256u, 0x2u);
+    graph.addPass("a", sTestPass, sPassData(0));
+    graph.write(a, RenderGraphUsage::ColorAttachment);
+    graph.addPass("b", sTestPass, sPassData(1));
+    graph.read(a, RenderGraphUsage::ComputeSampleRead);
+    graph.write(output, RenderGraphUsage::ComputeImageWrite);
+    graph.addPass("c", sTestPass, sPassData(2));
+    graph.write(b, RenderGraphUsage::ColorAttachment);
+    graph.addPass("d", sTestPass, sPassData(3));
+    graph.read(b, RenderGraphUsage::ComputeSampleRead);
+    graph.readWrite(output, RenderGraphUsage::ComputeImageWrite);
+    ASSERT(graph.compile());
+    ASSERT(graph.getMemorySlots().size() == 2u);
+    ASSERT(graph.getMemorySlot(a) != graph.getMemorySlot(b));
+}
+
+void testRenderGraph()
+{
+    testRenderGraphDeferred();
+    testRenderGraphCulling();
+    testRenderGraphAliasing();
+}
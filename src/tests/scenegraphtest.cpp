@@ -0,0 +1,226 @@
+#include "testfuncs.h"
+
+#include <components/transform_functions.h>
+
+#include <core/general.h>
+#include <core/jobsystem.h>
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <math/quaternion_inline_functions.h>
+#include <math/vector3_inline_functions.h>
+
+#include <scene/scenegraph.h>
+
+static bool sIsNear(const Vec3 &a, const Vec3 &b)
+{
+    return sqrLen(a - b) < 1.0e-6f;
+}
+
+// World position of a point in node local space, by walking the parent chain.
+static Vec3 sGetWorldPoint(const SceneGraph &graph, u32 nodeIndex, Vec3 point)
+{
+    while(nodeIndex != ~0u)
+    {
+        const Transform &t = graph.getLocalTransform(nodeIndex);
+        point = t.pos + rotateVector(t.scale * point, t.rot);
+        nodeIndex = graph.getParent(nodeIndex);
+    }
+    return point;
+}
+
+static void testSceneGraphHierarchy()
+{
+    SceneGraph graph;
+    graph.resize(4);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 4);
+
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 0);
+
+    // 0 -> 1 -> 2, 3 is its own root
+    ASSERT(graph.setParent(1, 0));
+    ASSERT(graph.setParent(2, 1));
+    ASSERT(!graph.setParent(0, 2));
+    ASSERT(!graph.setParent(1, 1));
+
+    Transform t;
+    t.pos = Vec3(1.0f, 2.0f, 3.0f);
+    t.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), 0.5f);
+    t.scale = Vec3(2.0f, 2.0f, 2.0f);
+    graph.setLocalTransform(0, t);
+    t.pos = Vec3(0.0f, 1.0f, 0.0f);
+    graph.setLocalTransform(1, t);
+    t.rot = getQuaternionFromAxisAngle(Vec3(1.0f, 0.0f, 0.0f), 1.0f);
+    t.scale = Vec3(1.0f, 1.0f, 1.0f);
+    graph.setLocalTransform(2, t);
+    graph.update();
+
+    for(u32 i = 0; i < graph.getNodeCount(); ++i)
+    {
+        const Vec3 point(0.5f, -1.0f, 2.0f);
+        const Mat3x4 &m = graph.getWorldMatrix(i);
+        Vec4 p = mul(m, Vec4(point, 1.0f));
+        ASSERT(sIsNear(Vec3(p.x, p.y, p.z), sGetWorldPoint(graph, i, point)));
+    }
+
+    // Setting same transform does not dirty anything.
+    graph.setLocalTransform(2, t);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 0);
+
+    // Moving the root updates the whole subtree, parents before children.
+    t.pos = Vec3(5.0f, 0.0f, 0.0f);
+    graph.setLocalTransform(0, t);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 3);
+    ASSERT(graph.getStats().levels == 3);
+    const auto &updated = graph.getUpdatedNodes();
+    ASSERT(updated[0] == 0 && updated[1] == 1 && updated[2] == 2);
+
+    // Leaf change only touches the leaf.
+    graph.markDirty(2);
+    graph.markDirty(2);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+
+    // Reparent 2 under 3, moving 1 should not touch it anymore.
+    ASSERT(graph.setParent(2, 3));
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+    graph.markDirty(1);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+    ASSERT(graph.getParent(2) == 3);
+
+    // Detaching 3 makes 2 a root and recomputes it.
+    graph.detachNode(3);
+    ASSERT(graph.getParent(2) == ~0u);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+    ASSERT(sIsNear(graph.getWorldTransform(2).pos, graph.getLocalTransform(2).pos));
+
+    // Subtree update only touches 0 -> 1, and they are not dirty afterwards.
+    t.pos = Vec3(-2.0f, 1.0f, 4.0f);
+    graph.setLocalTransform(0, t);
+    graph.markDirty(2);
+    graph.updateSubtree(0);
+    ASSERT(graph.getStats().matricesRecomputed == 2);
+    ASSERT(updated[0] == 0 && updated[1] == 1);
+    for(u32 i = 0; i < 2; ++i)
+    {
+        const Vec3 point(0.5f, -1.0f, 2.0f);
+        const Mat3x4 &m = graph.getWorldMatrix(i);
+        Vec4 p = mul(m, Vec4(point, 1.0f));
+        ASSERT(sIsNear(Vec3(p.x, p.y, p.z), sGetWorldPoint(graph, i, point)));
+    }
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+    ASSERT(updated[0] == 2);
+
+    // Marking again after a subtree update recomputes the node once.
+    graph.markDirty(1);
+    graph.updateSubtree(1);
+    graph.markDirty(1);
+    graph.update();
+    ASSERT(graph.getStats().matricesRecomputed == 1);
+}
+
+static void testSceneGraphBenchmark()
+{
+    // 10k roots with 9 children each, 1% of roots moving every frame.
+    const u32 rootCount = 10000u;
+    const u32 childCount = 9u;
+    const u32 frameCount = 100u;
+    const u32 nodeCount = rootCount * (childCount + 1);
+
+    SceneGraph graph;
+    graph.resize(nodeCount);
+    for(u32 i = 0; i < rootCount; ++i)
+    {
+        for(u32 j = 1; j <= childCount; ++j)
+            graph.setParent(i * (childCount + 1) + j, i * (childCount + 1));
+    }
+    graph.update();
+
+    u64 recomputed = 0u;
+    Timer timer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        for(u32 i = frame % 100; i < rootCount; i += 100)
+        {
+            Transform t = graph.getLocalTransform(i * (childCount + 1));
+            t.pos.x += 1.0f;
+            graph.setLocalTransform(i * (childCount + 1), t);
+        }
+        graph.update();
+        recomputed += graph.getStats().matricesRecomputed;
+    }
+    double dirtyTime = timer.getDuration();
+
+    Timer fullTimer;
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        for(u32 i = 0; i < rootCount; ++i)
+            graph.markDirty(i * (childCount + 1));
+        graph.update();
+    }
+    double fullTime = fullTimer.getDuration();
+
+    printf("Scene graph %u nodes, %u frames: dirty only: %fms (%" PRIu64 " matrices), all: %fms\n",
+        nodeCount, frameCount, dirtyTime * 1000.0, recomputed, fullTime * 1000.0);
+}
+
+static void sBuildJobTestGraph(SceneGraph &graph, u32 rootCount, u32 childCount)
+{
+    graph.resize(rootCount * (childCount + 1));
+    for(u32 i = 0; i < rootCount; ++i)
+    {
+        u32 rootIndex = i * (childCount + 1);
+        Transform rootTransform;
+        rootTransform.pos = Vec3(float(i), 0.0f, 0.0f);
+        rootTransform.rot = getQuaternionFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), float(i) * 0.01f);
+        graph.setLocalTransform(rootIndex, rootTransform);
+        for(u32 j = 1; j <= childCount; ++j)
+        {
+            Transform childTransform;
+            childTransform.pos = Vec3(0.0f, float(j), 0.0f);
+            graph.setLocalTransform(rootIndex + j, childTransform);
+            graph.setParent(rootIndex + j, rootIndex);
+        }
+    }
+}
+
+static void testSceneGraphJobs()
+{
+    // Both levels are bigger than one job, results have to match updating on one thread.
+    const u32 rootCount = SceneGraph::NodesPerJob * 3u;
+    const u32 childCount = 2u;
+    SceneGraph serialGraph;
+    SceneGraph jobGraph;
+    sBuildJobTestGraph(serialGraph, rootCount, childCount);
+    sBuildJobTestGraph(jobGraph, rootCount, childCount);
+
+    JobSystem jobSystem;
+    ASSERT(jobSystem.init(Supa::minu32(JobSystem::getHardwareThreadCount(), 4u)));
+    serialGraph.update();
+    jobGraph.update(&jobSystem);
+    jobSystem.deinit();
+
+    ASSERT(serialGraph.getStats().jobs == 0u);
+    ASSERT(jobGraph.getStats().jobs == 3u + 6u);
+    ASSERT(jobGraph.getStats().matricesRecomputed == serialGraph.getStats().matricesRecomputed);
+    for(u32 i = 0; i < serialGraph.getNodeCount(); ++i)
+    {
+        ASSERT(Supa::memcmp(&serialGraph.getWorldMatrix(i), &jobGraph.getWorldMatrix(i), sizeof(Mat3x4)) == 0);
+        ASSERT(Supa::memcmp(&serialGraph.getWorldNormalMatrix(i), &jobGraph.getWorldNormalMatrix(i), sizeof(Mat3x4)) == 0);
+    }
+}
+
+void testSceneGraph()
+{
+    testSceneGraphHierarchy();
+    testSceneGraphJobs();
+    testSceneGraphBenchmark();
+}
@@ -0,0 +1,159 @@
+#include "testfuncs.h"
+
+#include <core/assert.h>
+#include <core/mytypes.h>
+
+#include <myvulkan/stagingring.h>
+
+#include <stdio.h>
+
+static void testStagingRingAllocate()
+{
+    StagingRing ring;
+    ring.init(1024u);
+
+    ASSERT(ring.allocate(100u, 16u) == 0u);
+    // Aligned after the previous allocation.
+    ASSERT(ring.allocate(10u, 16u) == 112u);
+    ASSERT(ring.allocate(4u, 256u) == 256u);
+    ASSERT(ring.getFrameBytes() == 114u);
+    ASSERT(ring.getUsedSize() == 260u);
+
+    // Does not fit before the end, nothing retired to wrap into.
+    ASSERT(ring.allocate(800u, 16u) == StagingRing::InvalidOffset);
+    ASSERT(ring.allocate(2000u, 16u) == StagingRing::InvalidOffset);
+    ASSERT(ring.allocate(700u, 16u) == 272u);
+    ASSERT(ring.getUsedSize() == 972u);
+}
+
+static void testStagingRingRetire()
+{
+    StagingRing ring;
+    ring.init(1024u);
+
+    ASSERT(ring.allocate(400u, 16u) == 0u);
+    ring.endFrame(1u);
+    ASSERT(ring.getFrameBytes() == 0u);
+    ASSERT(ring.allocate(400u, 16u) == 400u);
+    ring.endFrame(2u);
+
+    // Frame 1 still in flight, frame 3 cannot fit.
+    ASSERT(ring.allocate(300u, 16u) == StagingRing::InvalidOffset);
+
+    ring.retireFrames(1u);
+    ASSERT(ring.getUsedSize() == 400u);
+    // End of the buffer has 224 bytes, allocation skips it and wraps to the start.
+    ASSERT(ring.allocate(300u, 16u) == 0u);
+    ASSERT(ring.getUsedSize() == 400u + 224u + 300u);
+    ring.endFrame(3u);
+
+    // Frame 2 keeps 400..800 and frame 3 0..300 in use.
+    ASSERT(ring.allocate(200u, 16u) == StagingRing::InvalidOffset);
+    ASSERT(ring.allocate(96u, 16u) == 304u);
+    ring.endFrame(4u);
+
+    ring.retireFrames(2u);
+    ASSERT(ring.allocate(200u, 16u) == 400u);
+    ring.endFrame(5u);
+
+    // Retiring everything leaves the ring empty, whole buffer fits again.
+    ring.retireFrames(5u);
+    ASSERT(ring.getUsedSize() == 0u);
+    ASSERT(ring.allocate(1024u, 16u) == 0u);
+}
+
+static void testStagingRingFlushRanges()
+{
+    StagingRing ring;
+    ring.init(1024u);
+
+    u64 offsets[2] = {};
+    u64 sizes[2] = {};
+    ASSERT(ring.takeUnflushedRanges(offsets, sizes) == 0u);
+
+    ring.allocate(600u, 16u);
+    ASSERT(ring.takeUnflushedRanges(offsets, sizes) == 1u);
+    ASSERT(offsets[0] == 0u && sizes[0] == 600u);
+    ring.endFrame(1u);
+
+    ring.allocate(200u, 16u);
+    ring.retireFrames(1u);
+    ring.endFrame(2u);
+    ring.allocate(300u, 16u);
+    // From 600 to the end and then the wrapped allocation at the start.
+    ASSERT(ring.takeUnflushedRanges(offsets, sizes) == 2u);
+    ASSERT(offsets[0] == 600u && sizes[0] == 424u);
+    ASSERT(offsets[1] == 0u && sizes[1] == 300u);
+    ASSERT(ring.takeUnflushedRanges(offsets, sizes) == 0u);
+}
+
+// Simulates frames in flight with random upload sizes, no live allocation may overlap another.
+static void testStagingRingFrames()
+{
+    static constexpr u32 FramesInFlight = 2u;
+    static constexpr u64 Capacity = 64u * 1024u;
+    static constexpr u32 MaxLive = 1024u;
+
+    struct LiveAllocation
+    {
+        u64 offset;
+        u64 size;
+        u64 frameNumber;
+    };
+    LiveAllocation live[MaxLive];
+    u32 liveCount = 0u;
+
+    StagingRing ring;
+    ring.init(Capacity);
+
+    u32 seed = 12345u;
+    u32 failedCount = 0u;
+    u64 allocatedBytes = 0u;
+    for(u64 frameNumber = 1u; frameNumber < 2000u; ++frameNumber)
+    {
+        if(frameNumber > FramesInFlight)
+        {
+            u64 retired = frameNumber - FramesInFlight;
+            ring.retireFrames(retired);
+            u32 keep = 0u;
+            for(u32 i = 0; i < liveCount; ++i)
+            {
+                if(live[i].frameNumber > retired)
+                    live[keep++] = live[i];
+            }
+            liveCount = keep;
+        }
+
+        seed = seed * 1664525u + 1013904223u;
+        u32 uploadCount = (seed >> 16) % 12u;
+        for(u32 j = 0; j < uploadCount; ++j)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            u64 size = 1u + (seed >> 16) % 8000u;
+            u64 offset = ring.allocate(size, 16u);
+            if(offset == StagingRing::InvalidOffset)
+            {
+                ++failedCount;
+                continue;
+            }
+            ASSERT(offset % 16u == 0u);
+            ASSERT(offset + size <= Capacity);
+            for(u32 i = 0; i < liveCount; ++i)
+                ASSERT(offset + size <= live[i].offset || live[i].offset + live[i].size <= offset);
+            ASSERT(liveCount < MaxLive);
+            live[liveCount++] = LiveAllocation{ offset, size, frameNumber };
+            allocatedBytes += size;
+        }
+        ring.endFrame(frameNumber);
+    }
+    printf("Staging ring: %u bytes allocated over frames, %u allocations did not fit\n",
+        u32(allocatedBytes), failedCount);
+}
+
+void testStagingRing()
+{
+    testStagingRingAllocate();
+    testStagingRingRetire();
+    testStagingRingFlushRanges();
+    testStagingRingFrames();
+}
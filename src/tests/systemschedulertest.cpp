@@ -0,0 +1,302 @@
+#include "testfuncs.h"
+
+#include <components/generated_components.h>
+#include <components/generated_systems.h>
+#include <components/systemscheduler.h>
+#include <components/transform_functions.h>
+
+#include <core/mytypes.h>
+#include <core/timer.h>
+
+#include <math/matrix_inline_functions.h>
+#include <math/quaternion_inline_functions.h>
+
+#include <atomic>
+
+struct SchedulerTestData
+{
+    GameEntitySystem gameEnts;
+    // Loops per entity, to make benchmark systems heavier.
+    u32 workAmount = 1u;
+};
+
+static u64 sGetArrays(ComponentType componentType)
+{
+    return GameEntitySystem::getComponentArrayHandleBuilder().addComponent(componentType).componentIndexArray;
+}
+
+static bool sMoveTransforms(void *userData, double dt)
+{
+    SchedulerTestData &data = *(SchedulerTestData *)userData;
+    GameEntitySystem &gameEnts = data.gameEnts;
+    const auto &rwHandle = gameEnts.getRWHandle({}, gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::TransformComponent));
+
+    TransformComponent *transforms = gameEnts.getTransformComponentWriteArray(rwHandle);
+    if(transforms == nullptr)
+        return false;
+
+    u32 entityCount = gameEnts.getEntityCount();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        for(u32 j = 0; j < data.workAmount; ++j)
+        {
+            transforms[i].position.x += float(dt);
+            transforms[i].rotation = normalize(transforms[i].rotation * getQuaternionFromAxisAngle(Vec3(0, 1, 0), float(dt)));
+        }
+    }
+    return true;
+}
+
+static bool sRotateCameras(void *userData, double dt)
+{
+    SchedulerTestData &data = *(SchedulerTestData *)userData;
+    GameEntitySystem &gameEnts = data.gameEnts;
+    const auto &rwHandle = gameEnts.getRWHandle({}, gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::CameraComponent));
+
+    CameraComponent *cameras = gameEnts.getCameraComponentWriteArray(rwHandle);
+    if(cameras == nullptr)
+        return false;
+
+    u32 entityCount = gameEnts.getEntityCount();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        for(u32 j = 0; j < data.workAmount; ++j)
+        {
+            cameras[i].yaw += float(dt);
+            cameras[i].worldToViewMat = createMatrixFromLookAt(Vec3(cameras[i].yaw, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0));
+        }
+    }
+    return true;
+}
+
+static bool sResetMatrices(void *userData, double dt)
+{
+    SchedulerTestData &data = *(SchedulerTestData *)userData;
+    GameEntitySystem &gameEnts = data.gameEnts;
+    const auto &rwHandle = gameEnts.getRWHandle({}, gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::Mat3x4Component));
+
+    Mat4Component *matrices = gameEnts.getMat4ComponentWriteArray(rwHandle);
+    if(matrices == nullptr)
+        return false;
+
+    u32 entityCount = gameEnts.getEntityCount();
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        for(u32 j = 0; j < data.workAmount; ++j)
+            matrices[i].mat = getMatrixFromScale(Vec3(float(dt) + float(j), 1.0f, 1.0f));
+    }
+    return true;
+}
+
+static bool sTransformsToMatrices(void *userData, double dt)
+{
+    SchedulerTestData &data = *(SchedulerTestData *)userData;
+    GameEntitySystem &gameEnts = data.gameEnts;
+    const auto &rwHandle = gameEnts.getRWHandle(
+        gameEnts.getComponentArrayHandleBuilder().addComponent(ComponentType::TransformComponent),
+        gameEnts.getComponentArrayHandleBuilder().addComponent(ComponentType::Mat3x4Component));
+
+    const TransformComponent *transforms = gameEnts.getTransformComponentReadArray(rwHandle);
+    Mat4Component *matrices = gameEnts.getMat4ComponentWriteArray(rwHandle);
+    if(transforms == nullptr || matrices == nullptr)
+        return false;
+
+    getModelMatrices(transforms, gameEnts.getEntityCount(), &matrices[0].mat, sizeof(Mat4Component));
+    return true;
+}
+
+static bool sReadCameras(void *userData, double dt)
+{
+    SchedulerTestData &data = *(SchedulerTestData *)userData;
+    GameEntitySystem &gameEnts = data.gameEnts;
+    const auto &rwHandle = gameEnts.getRWHandle(gameEnts.getComponentArrayHandleBuilder()
+        .addComponent(ComponentType::CameraComponent), {});
+
+    return gameEnts.getCameraComponentReadArray(rwHandle) != nullptr;
+}
+
+static bool sFailingSystem(void *userData, double dt)
+{
+    return false;
+}
+
+static void sAddEntities(GameEntitySystem &gameEnts, u32 count)
+{
+    auto mtx = gameEnts.getLockedMutexHandle();
+    for(u32 i = 0; i < count; ++i)
+    {
+        EntitySystemHandle handle = gameEnts.addEntity(mtx);
+        gameEnts.addTransformComponent(handle, TransformComponent{ .position = Vector4{ float(i), 0, 0, 1 } });
+        gameEnts.addCameraComponent(handle, {});
+        gameEnts.addMat4Component(handle, {});
+    }
+    gameEnts.releaseLockedMutexHandle(mtx);
+    gameEnts.syncReadWrites();
+}
+
+static void testSystemSchedulerOrder(bool validateAccess)
+{
+    SchedulerTestData data;
+    sAddEntities(data.gameEnts, 64u);
+
+    SystemScheduler scheduler;
+    ASSERT(scheduler.init(2u));
+    ASSERT(scheduler.addEntitySystem(data.gameEnts));
+    scheduler.setValidateAccess(validateAccess);
+
+    const EntitySystemType type = GameEntitySystem::entitySystemID;
+    const u64 transformArrays = sGetArrays(ComponentType::TransformComponent);
+    const u64 cameraArrays = sGetArrays(ComponentType::CameraComponent);
+    const u64 matrixArrays = sGetArrays(ComponentType::Mat3x4Component);
+
+    u32 moveSystem = scheduler.addSystem("Move transforms", sMoveTransforms, &data);
+    scheduler.addSystemAccess(moveSystem, type, 0u, transformArrays);
+    u32 cameraSystem = scheduler.addSystem("Rotate cameras", sRotateCameras, &data);
+    scheduler.addSystemAccess(cameraSystem, type, 0u, cameraArrays);
+    u32 matrixSystem = scheduler.addSystem("Transforms to matrices", sTransformsToMatrices, &data);
+    scheduler.addSystemAccess(matrixSystem, type, transformArrays, matrixArrays);
+    u32 readCameraSystem = scheduler.addSystem("Read cameras", sReadCameras, &data);
+    scheduler.addSystemAccess(readCameraSystem, type, cameraArrays, 0u);
+
+    for(u32 frame = 0; frame < 4; ++frame)
+    {
+        ASSERT(scheduler.update(1.0));
+        ASSERT(scheduler.getStats().syncPoints == 2u);
+        ASSERT(scheduler.getStats().widestSyncPoint == 2u);
+        ASSERT(scheduler.getStats().systemsRun == 4u);
+    }
+    ASSERT(scheduler.getSystemSyncPoint(moveSystem) == 0u);
+    ASSERT(scheduler.getSystemSyncPoint(cameraSystem) == 0u);
+    ASSERT(scheduler.getSystemSyncPoint(matrixSystem) == 1u);
+    ASSERT(scheduler.getSystemSyncPoint(readCameraSystem) == 1u);
+
+    // Matrices must see the transforms written in the same frame.
+    {
+        const auto &rwHandle = data.gameEnts.getRWHandle(
+            data.gameEnts.getComponentArrayHandleBuilder()
+                .addComponent(ComponentType::TransformComponent)
+                .addComponent(ComponentType::Mat3x4Component), {});
+        const TransformComponent *transforms = data.gameEnts.getTransformComponentReadArray(rwHandle);
+        const Mat4Component *matrices = data.gameEnts.getMat4ComponentReadArray(rwHandle);
+        for(u32 i = 0; i < data.gameEnts.getEntityCount(); ++i)
+        {
+            ASSERT(transforms[i].position.x == float(i) + 4.0f);
+            ASSERT(matrices[i].mat._03 == transforms[i].position.x);
+        }
+        data.gameEnts.syncReadWrites();
+    }
+
+    // Disabled system does not hold back the ones depending on it.
+    scheduler.setSystemEnabled(moveSystem, false);
+    ASSERT(scheduler.update(1.0));
+    ASSERT(scheduler.getSystemSyncPoint(moveSystem) == ~0u);
+    ASSERT(scheduler.getSystemSyncPoint(matrixSystem) == 0u);
+    ASSERT(scheduler.getStats().syncPoints == 2u);
+    ASSERT(scheduler.getStats().systemsRun == 3u);
+    scheduler.setSystemEnabled(moveSystem, true);
+
+    // A system without accesses conflicts with nothing.
+    u32 failingSystem = scheduler.addSystem("Failing system", sFailingSystem, &data);
+    ASSERT(!scheduler.update(1.0));
+    ASSERT(scheduler.getSystemSyncPoint(failingSystem) == 0u);
+    ASSERT(scheduler.getStats().systemsFailed == 1u);
+}
+
+static void testSystemSchedulerBenchmark()
+{
+    const u32 entityCount = 20000u;
+    const u32 frameCount = 10u;
+
+    SchedulerTestData data;
+    data.workAmount = 4u;
+    sAddEntities(data.gameEnts, entityCount);
+
+    const EntitySystemType type = GameEntitySystem::entitySystemID;
+    double times[2] = {};
+    u32 workerCounts[2] = { 0u, Supa::minu32(JobSystem::getHardwareThreadCount(), JobSystem::MaxWorkerCount) };
+    for(u32 i = 0; i < 2; ++i)
+    {
+        SystemScheduler scheduler;
+        ASSERT(scheduler.init(workerCounts[i]));
+        ASSERT(scheduler.addEntitySystem(data.gameEnts));
+        u32 systemIndex = scheduler.addSystem("Move transforms", sMoveTransforms, &data);
+        scheduler.addSystemAccess(systemIndex, type, 0u, sGetArrays(ComponentType::TransformComponent));
+        systemIndex = scheduler.addSystem("Rotate cameras", sRotateCameras, &data);
+        scheduler.addSystemAccess(systemIndex, type, 0u, sGetArrays(ComponentType::CameraComponent));
+        systemIndex = scheduler.addSystem("Reset matrices", sResetMatrices, &data);
+        scheduler.addSystemAccess(systemIndex, type, 0u, sGetArrays(ComponentType::Mat3x4Component));
+
+        Timer timer;
+        for(u32 frame = 0; frame < frameCount; ++frame)
+            ASSERT(scheduler.update(0.01));
+        times[i] = timer.getDuration();
+        ASSERT(scheduler.getStats().syncPoints == 1u);
+    }
+
+    printf("System scheduler 3 systems, %u entities, %u frames: serial: %fms, %u workers: %fms\n",
+        entityCount, frameCount, times[0] * 1000.0, workerCounts[1], times[1] * 1000.0);
+}
+
+struct NestedJobData
+{
+    JobSystem *outer = nullptr;
+    JobSystem *inner = nullptr;
+    std::atomic<u32> innerJobsRun {0};
+    std::atomic<u32> wrongIndices {0};
+};
+
+static void sInnerJob(void *jobData, u32 jobIndex)
+{
+    NestedJobData &data = *(NestedJobData *)jobData;
+    // Outer workers waiting for the inner jobs run them too, but no thread is a worker of both.
+    u32 innerIndex = data.inner->getCurrentThreadIndex();
+    u32 outerIndex = data.outer->getCurrentThreadIndex();
+    if((innerIndex >= data.inner->getWorkerCount() && innerIndex != JobSystem::MaxWorkerCount)
+        || (innerIndex != JobSystem::MaxWorkerCount && outerIndex != JobSystem::MaxWorkerCount))
+    {
+        data.wrongIndices.fetch_add(1u);
+    }
+    data.innerJobsRun.fetch_add(1u);
+}
+
+static void sOuterJob(void *jobData, u32 jobIndex)
+{
+    NestedJobData &data = *(NestedJobData *)jobData;
+    u32 outerIndex = data.outer->getCurrentThreadIndex();
+    if(data.inner->getCurrentThreadIndex() != JobSystem::MaxWorkerCount
+        || (outerIndex >= data.outer->getWorkerCount() && outerIndex != JobSystem::MaxWorkerCount))
+    {
+        data.wrongIndices.fetch_add(1u);
+    }
+    JobCounter counter;
+    data.inner->addJobs(sInnerJob, jobData, 8u, counter);
+    data.inner->waitForCounter(counter);
+}
+
+// Jobs of one job system adding and waiting jobs of another.
+static void testJobSystemNested()
+{
+    JobSystem outer;
+    JobSystem inner;
+    ASSERT(outer.init(2u));
+    ASSERT(inner.init(2u));
+    ASSERT(outer.getCurrentThreadIndex() == JobSystem::MaxWorkerCount);
+
+    NestedJobData data { .outer = &outer, .inner = &inner };
+    JobCounter counter;
+    outer.addJobs(sOuterJob, &data, 16u, counter);
+    outer.waitForCounter(counter);
+    ASSERT(data.innerJobsRun.load() == 16u * 8u);
+    ASSERT(data.wrongIndices.load() == 0u);
+}
+
+void testSystemScheduler()
+{
+    testJobSystemNested();
+    testSystemSchedulerOrder(false);
+    testSystemSchedulerOrder(true);
+    testSystemSchedulerBenchmark();
+}
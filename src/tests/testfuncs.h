@@ -3,3 +3,18 @@
 void testMatrix();
 void testMathVector();
 void testStrings();
+void testBvh();
+void testSceneGraph();
+void testEntityStore();
+void testSystemScheduler();
+void testEntityQuery();
+void testChunkStorage();
+void testEntityChangeTracking();
+void testEntityCommands();
+void testFastMath();
+void testAudio();
+void testStagingRing();
+void testBufferCopyBatch();
+void testMeshDrawCommands();
+void testMeshInstanceTable();
+void testRenderGraph();
@@ -1,6 +1,7 @@
 #include "testfuncs.h"
 
 #include <core/mytypes.h>
+#include <math/quaternion_inline_functions.h>
 #include <math/vector3_inline_functions.h>
 
 #include <math.h>
@@ -267,9 +268,53 @@ void testVec4()
     }
 }
 
+static u32 sGetUlpDistance(float a, float b)
+{
+    i32 aBits = 0;
+    i32 bBits = 0;
+    Supa::memcpy(&aBits, &a, sizeof(float));
+    Supa::memcpy(&bBits, &b, sizeof(float));
+    // Map negative floats below positive ones, so both zeros are next to each other.
+    aBits = aBits < 0 ? i32(0x8000'0000u - u32(aBits)) : aBits;
+    bBits = bBits < 0 ? i32(0x8000'0000u - u32(bBits)) : bBits;
+    return aBits > bBits ? u32(aBits - bBits) : u32(bBits - aBits);
+}
+
+static float sGetRandomFloat(u32 &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1u << 23) - 1.0f;
+}
+
+// SIMD versions against the scalar reference ones.
+static void testQuaternionSimd()
+{
+    u32 seed = 1234u;
+    for(u32 i = 0; i < 1000; ++i)
+    {
+        Quat q1(sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed));
+        Quat q2(sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed), sGetRandomFloat(seed));
+        float t = sGetRandomFloat(seed) * 0.5f + 0.5f;
+
+        // Squares get summed in different order.
+        Quat normalized = normalize(q1);
+        Quat normalizedScalar = normalizeScalar(q1);
+        ASSERT(sGetUlpDistance(normalized.v.x, normalizedScalar.v.x) <= 4u);
+        ASSERT(sGetUlpDistance(normalized.v.y, normalizedScalar.v.y) <= 4u);
+        ASSERT(sGetUlpDistance(normalized.v.z, normalizedScalar.v.z) <= 4u);
+        ASSERT(sGetUlpDistance(normalized.w, normalizedScalar.w) <= 4u);
+
+        Quat lerped = lerp(q1, q2, t);
+        Quat lerpedScalar = lerpScalar(q1, q2, t);
+        ASSERT(lerped.v.x == lerpedScalar.v.x && lerped.v.y == lerpedScalar.v.y
+            && lerped.v.z == lerpedScalar.v.z && lerped.w == lerpedScalar.w);
+    }
+}
+
 void testMathVector()
 {
     testVec2();
     testVec3();
     testVec4();
+    testQuaternionSimd();
 }
\ No newline at end of file